@@ -29,6 +29,8 @@
 
 #include "maths.h"
 #include "platform.h"
+#include "simd.h"
+#include "parallel.h"
 
 #include <algorithm>
 #include <iostream>
@@ -39,7 +41,7 @@ using namespace std;
 _declspec (thread) uint32_t AABBTree::s_traceDepth;
 #endif
 
-AABBTree::AABBTree(const Vec3* vertices, uint32_t numVerts, const uint32_t* indices, uint32_t numFaces) 
+AABBTree::AABBTree(const Vec3* vertices, uint32_t numVerts, const uint32_t* indices, uint32_t numFaces, BuildMode mode) 
     : m_vertices(vertices)
     , m_numVerts(numVerts)
     , m_indices(indices)
@@ -50,7 +52,56 @@ AABBTree::AABBTree(const Vec3* vertices, uint32_t numVerts, const uint32_t* indi
     m_innerNodes = 0;
     m_leafNodes = 0;
 
-    Build();
+	m_buildMode = mode;
+
+    Build(mode);
+}
+
+AABBTree::AABBTree(const Vec3* vertices, uint32_t numVerts, const uint32_t* indices, uint32_t numFaces, const Node* nodes, uint32_t numNodes, const uint32_t* faceOrder) 
+    : m_vertices(vertices)
+    , m_numVerts(numVerts)
+    , m_indices(indices)
+    , m_numFaces(numFaces)
+{
+	assert(numNodes > 0);
+
+    m_treeDepth = 0;
+    m_innerNodes = 0;
+    m_leafNodes = 0;
+
+	m_faces.assign(faceOrder, faceOrder+numFaces);
+	m_nodes.assign(nodes, nodes+numNodes);
+
+	for (uint32_t i=0; i < numNodes; ++i)
+	{
+		const Node& n = m_nodes[i];
+
+		if (n.m_numFaces)
+		{
+			assert(n.m_index + n.m_numFaces <= numFaces);
+			++m_leafNodes;
+		}
+		else
+		{
+			assert(n.m_index+1 < numNodes);
+			++m_innerNodes;
+		}
+	}
+
+	m_freeNode = numNodes;
+
+	// the restored tree is the reference for refitting, rebuilds use the default mode
+	m_buildMode = eBuildBinnedSAH;
+
+	StoreBuildAreas(0, numNodes);
+	m_buildCost = GetCost();
+}
+
+void AABBTree::Pack(std::vector<Node>& outNodes, std::vector<uint32_t>& outFaceOrder) const
+{
+	// nodes past m_freeNode are spare capacity from the build
+	outNodes.assign(m_nodes.begin(), m_nodes.begin()+m_freeNode);
+	outFaceOrder = m_faces;
 }
 
 namespace
@@ -128,10 +179,7 @@ void AABBTree::CalculateFaceBounds(uint32_t* faces, uint32_t numFaces, Vector3&
     outMaxExtents = maxExtents;
 }
 
-// track current tree depth
-static uint32_t s_depth = 0;
-
-void AABBTree::Build()
+void AABBTree::Build(BuildMode mode)
 {
     assert(m_numFaces*3);
 
@@ -205,9 +253,7 @@ void AABBTree::Build()
 	m_freeNode = 1;
 
     // start building
-    BuildRecursive(0, &m_faces[0], numFaces);
-
-    assert(s_depth == 0);
+    BuildRecursive(0, &m_faces[0], numFaces, 1, mode);
 
 
 	/*
@@ -224,6 +270,10 @@ void AABBTree::Build()
     // free some memory
     FaceBoundsArray f;
     m_faceBounds.swap(f);
+
+	// reference for refitting
+	StoreBuildAreas(0, m_freeNode);
+	m_buildCost = GetCost();
 }
 
 // partion faces around the median face
@@ -313,7 +363,113 @@ uint32_t AABBTree::PartitionSAH(Node& n, uint32_t* faces, uint32_t numFaces)
 	return bestIndex+1;
 }
 
-void AABBTree::BuildRecursive(uint32_t nodeIndex, uint32_t* faces, uint32_t numFaces)
+// partition faces with the surface area heuristic evaluated between centroid bins
+uint32_t AABBTree::PartitionBinnedSAH(Node& n, uint32_t* faces, uint32_t numFaces)
+{
+	const int kNumBins = 16;
+
+	// bounds of the face centroids (centers of the face bounds), bins are spaced evenly over these
+	Vector3 centroidMin(FLT_MAX);
+	Vector3 centroidMax(-FLT_MAX);
+
+	for (uint32_t i=0; i < numFaces; ++i)
+	{
+		const Bounds& b = m_faceBounds[faces[i]];
+		const Vector3 c = (b.m_min + b.m_max)*0.5f;
+
+		centroidMin = Min(centroidMin, c);
+		centroidMax = Max(centroidMax, c);
+	}
+
+	uint32_t bestAxis = 0;
+	int bestSplit = -1;
+	float bestCost = FLT_MAX;
+	float bestScale = 0.0f;
+
+	for (uint32_t a=0; a < 3; ++a)
+	{
+		const float extent = centroidMax[a]-centroidMin[a];
+
+		if (extent <= 0.0f)
+			continue;
+
+		const float scale = kNumBins/extent;
+
+		Bounds binBounds[kNumBins];
+		uint32_t binCounts[kNumBins] = { 0 };
+
+		for (int b=0; b < kNumBins; ++b)
+			binBounds[b] = Bounds(Vector3(FLT_MAX), Vector3(-FLT_MAX));
+
+		for (uint32_t i=0; i < numFaces; ++i)
+		{
+			const Bounds& b = m_faceBounds[faces[i]];
+			const int bin = Min(int(((b.m_min[a] + b.m_max[a])*0.5f - centroidMin[a])*scale), kNumBins-1);
+
+			binBounds[bin].Union(b);
+			binCounts[bin]++;
+		}
+
+		// sweep from the right to find the area and count above each split
+		float upperArea[kNumBins];
+		uint32_t upperCount[kNumBins];
+
+		Bounds upper(Vector3(FLT_MAX), Vector3(-FLT_MAX));
+		uint32_t count = 0;
+
+		for (int b=kNumBins-1; b > 0; --b)
+		{
+			upper.Union(binBounds[b]);
+			count += binCounts[b];
+
+			upperArea[b] = upper.GetSurfaceArea();
+			upperCount[b] = count;
+		}
+
+		// sweep from the left evaluating the split below each bin
+		Bounds lower(Vector3(FLT_MAX), Vector3(-FLT_MAX));
+		count = 0;
+
+		for (int b=0; b < kNumBins-1; ++b)
+		{
+			lower.Union(binBounds[b]);
+			count += binCounts[b];
+
+			if (count == 0 || upperCount[b+1] == 0)
+				continue;
+
+			const float cost = lower.GetSurfaceArea()*count + upperArea[b+1]*upperCount[b+1];
+
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = b+1;
+				bestAxis = a;
+				bestScale = scale;
+			}
+		}
+	}
+
+	// all centroids coincide, split in half
+	if (bestSplit < 0)
+		return PartitionMedian(n, faces, numFaces);
+
+	const float centroidLower = centroidMin[bestAxis];
+	
+	uint32_t* mid = std::partition(faces, faces+numFaces, [&](uint32_t f)
+	{
+		const Bounds& b = m_faceBounds[f];
+		return Min(int(((b.m_min[bestAxis] + b.m_max[bestAxis])*0.5f - centroidLower)*bestScale), kNumBins-1) < bestSplit;
+	});
+
+	// guard against rounding differences between the binning and partition leaving one side empty
+	if (mid == faces || mid == faces+numFaces)
+		return PartitionMedian(n, faces, numFaces);
+
+	return uint32_t(mid-faces);
+}
+
+void AABBTree::BuildRecursive(uint32_t nodeIndex, uint32_t* faces, uint32_t numFaces, uint32_t depth, BuildMode mode)
 {
     const uint32_t kMaxFacesPerLeaf = 6;
     
@@ -330,16 +486,15 @@ void AABBTree::BuildRecursive(uint32_t nodeIndex, uint32_t* faces, uint32_t numF
     // a reference to the current node, need to be careful here as this reference may become invalid if array is resized
 	Node& n = m_nodes[nodeIndex];
 
-	// track max tree depth
-    ++s_depth;
-    m_treeDepth = max(m_treeDepth, s_depth);
+	// track max tree depth, passed down rather than kept in a global so trees can be built concurrently
+    m_treeDepth = max(m_treeDepth, depth);
 
 	CalculateFaceBounds(faces, numFaces, n.m_minExtents, n.m_maxExtents);
 
 	// calculate bounds of faces and add node  
     if (numFaces <= kMaxFacesPerLeaf)
     {
-        n.m_faces = faces;
+        n.m_index = uint32_t(faces-&m_faces[0]);
         n.m_numFaces = numFaces;		
 
         ++m_leafNodes;
@@ -350,239 +505,917 @@ void AABBTree::BuildRecursive(uint32_t nodeIndex, uint32_t* faces, uint32_t numF
 
         // face counts for each branch
         //const uint32_t leftCount = PartitionMedian(n, faces, numFaces);
-        const uint32_t leftCount = PartitionSAH(n, faces, numFaces);
+        const uint32_t leftCount = (mode == eBuildBinnedSAH) ? PartitionBinnedSAH(n, faces, numFaces) : PartitionSAH(n, faces, numFaces);
         const uint32_t rightCount = numFaces-leftCount;
 
 		// alloc 2 nodes
-		m_nodes[nodeIndex].m_children = m_freeNode;
+		m_nodes[nodeIndex].m_index = m_freeNode;
+		m_nodes[nodeIndex].m_numFaces = 0;
 
 		// allocate two nodes
 		m_freeNode += 2;
   
         // split faces in half and build each side recursively
-        BuildRecursive(m_nodes[nodeIndex].m_children+0, faces, leftCount);
-        BuildRecursive(m_nodes[nodeIndex].m_children+1, faces+leftCount, rightCount);
+        BuildRecursive(m_nodes[nodeIndex].m_index+0, faces, leftCount, depth+1, mode);
+        BuildRecursive(m_nodes[nodeIndex].m_index+1, faces+leftCount, rightCount, depth+1, mode);
     }
+}
 
-    --s_depth;
+namespace
+{
+	// relative cost of visiting a node to testing a face, matches PartitionSAH()
+	const float kNodeCost = 0.125f;
+
+	inline float GetSurfaceArea(const AABBTree::Node& n)
+	{
+		const Vec3 e = n.m_maxExtents-n.m_minExtents;
+		return 2.0f*(e.x*e.y + e.x*e.z + e.y*e.z);
+	}
+
+} // anonymous namespace
+
+float AABBTree::GetCost() const
+{
+	const float rootArea = GetSurfaceArea(m_nodes[0]);
+
+	if (rootArea <= 0.0f)
+		return 0.0f;
+
+	float cost = 0.0f;
+
+	for (uint32_t i=0; i < m_freeNode; ++i)
+	{
+		const Node& n = m_nodes[i];
+
+		if (n.m_numFaces)
+			cost += GetSurfaceArea(n)*n.m_numFaces;
+		else
+			cost += GetSurfaceArea(n)*kNodeCost;
+	}
+
+	return cost/rootArea;
 }
 
-struct StackEntry
+void AABBTree::StoreBuildAreas(uint32_t begin, uint32_t end)
 {
-    uint32_t m_node;   
-    float m_dist;
-};
+	const float rootArea = GetSurfaceArea(m_nodes[0]);
+	const float invRootArea = rootArea > 0.0f ? 1.0f/rootArea : 0.0f;
 
+	m_buildAreas.resize(m_nodes.size());
 
-#define TRACE_STATS 0
+	for (uint32_t i=begin; i < end; ++i)
+		m_buildAreas[i] = GetSurfaceArea(m_nodes[i])*invRootArea;
+}
 
-/*
-bool AABBTree::TraceRay(const Vec3& start, const Vector3& dir, float& outT, float& outU, float& outV, float& outW, float& outSign, uint32_t& outIndex) const
+void AABBTree::RefitBounds()
 {
-#if _WIN32
-    // reset stats
-    s_traceDepth = 0;
-#endif
-	
-    const Vector3 rcp_dir(1.0f/dir.x, 1.0f/dir.y, 1.0f/dir.z);
+	// children are always allocated after their parent so a reverse sweep visits them first
+	for (uint32_t i=m_freeNode; i > 0; --i)
+	{
+		Node& n = m_nodes[i-1];
 
-	// some temp variables
-	Vector3 normal;
-    float t, u, v, w, s;
+		if (n.m_numFaces)
+		{
+			CalculateFaceBounds(&m_faces[n.m_index], n.m_numFaces, n.m_minExtents, n.m_maxExtents);
+		}
+		else
+		{
+			const Node& left = m_nodes[n.m_index+0];
+			const Node& right = m_nodes[n.m_index+1];
 
-    float minT, minU, minV, minW, minSign;
-	minU = minV = minW = minSign = minT = FLT_MAX;
-    
-	uint32_t minIndex = 0;
-    Vector3 minNormal;
+			n.m_minExtents = Min(left.m_minExtents, right.m_minExtents);
+			n.m_maxExtents = Max(left.m_maxExtents, right.m_maxExtents);
+		}
+	}
+}
 
-    const uint32_t kStackDepth = 50;
-    
-    StackEntry stack[kStackDepth];
-    stack[0].m_node = 0;
-    stack[0].m_dist = 0.0f;
+uint32_t AABBTree::Refit(const Vec3* vertices, float maxDegradation)
+{
+	m_vertices = vertices;
 
-    uint32_t stackCount = 1;
+	RefitBounds();
 
-    while (stackCount)
-    {
-        // pop node from back
-        StackEntry& e = stack[--stackCount];
-        
-        // ignore if another node has already come closer
-        if (e.m_dist >= minT)
-        {
-            continue;
-        }
+	if (GetCost() <= m_buildCost*maxDegradation)
+		return 0;
 
-        const Node* node = &m_nodes[e.m_node];
+	const float rootArea = GetSurfaceArea(m_nodes[0]);
+	const float invRootArea = rootArea > 0.0f ? 1.0f/rootArea : 0.0f;
 
-filth:
+	// find the largest subtrees that have degraded the most, these are rebuilt whole
+	std::vector<uint32_t> rebuild;
+	std::vector<uint32_t> stack(1, 0);
 
-        if (node->m_faces == NULL)
-        {
+	while (!stack.empty())
+	{
+		const uint32_t nodeIndex = stack.back();
+		stack.pop_back();
 
-#if TRACE_STATS
-            extern uint32_t g_nodesChecked;
-            ++g_nodesChecked;
-#endif
+		const Node& n = m_nodes[nodeIndex];
 
-#if _WIN32
-			++s_traceDepth;
-#endif
-            // find closest node
-            const Node& leftChild = m_nodes[node->m_children+0];
-            const Node& rightChild = m_nodes[node->m_children+1];
+		if (n.m_numFaces)
+			continue;
 
-            float dist[2] = {FLT_MAX, FLT_MAX};
+		if (nodeIndex > 0 && GetSurfaceArea(n)*invRootArea > m_buildAreas[nodeIndex]*maxDegradation)
+		{
+			rebuild.push_back(nodeIndex);
+			continue;
+		}
 
-            IntersectRayAABBOmpf(start, rcp_dir, leftChild.m_minExtents, leftChild.m_maxExtents, dist[0]);
-            IntersectRayAABBOmpf(start, rcp_dir, rightChild.m_minExtents, rightChild.m_maxExtents, dist[1]);
+		stack.push_back(n.m_index+0);
+		stack.push_back(n.m_index+1);
+	}
 
-            const uint32_t closest = dist[1] < dist[0]; // 0 or 1
-            const uint32_t furthest = closest ^ 1;
+	uint32_t numRebuiltFaces = 0;
 
-            if (dist[furthest] < minT)
-            {
-                StackEntry& e = stack[stackCount++];
-                e.m_node = node->m_children+furthest;
-                e.m_dist = dist[furthest];
-            }
+	if (!rebuild.empty())
+	{
+		m_faceBounds.resize(m_numFaces);
 
-            // lifo
-            if (dist[closest] < minT)
-            {
-                node = &m_nodes[node->m_children+closest];
-                goto filth;
-            }
-        }
-        else
-        {
-            for (uint32_t i=0; i < node->m_numFaces; ++i)
-            {
-                const uint32_t faceIndex = node->m_faces[i];
-                const uint32_t indexStart = faceIndex*3;
+		for (size_t i=0; i < rebuild.size(); ++i)
+			numRebuiltFaces += RebuildSubtree(rebuild[i]);
 
-                const Vec3& a = m_vertices[m_indices[indexStart+0]];
-                const Vec3& b = m_vertices[m_indices[indexStart+1]];
-                const Vec3& c = m_vertices[m_indices[indexStart+2]];
-#if TRACE_STATS
-                extern uint32_t g_trisChecked;
-                ++g_trisChecked;
-#endif
+		FaceBoundsArray f;
+		m_faceBounds.swap(f);
 
-                if (IntersectRayTriTwoSided(start, dir, a, b, c, t, u, v, w, s))
-                {
-                    if (t < minT && t > 0.01f)
-                    {
-                        minT = t;
-                        minU = u;
-                        minV = v;
-                        minW = w;
-						minSign = s;
-                        minIndex = faceIndex;
-                    }
-                }
-            }
-        }
-    }
+		// the old subtrees are left unreferenced in the node array
+		Compact();
+	}
 
-    // copy to outputs
-    outT = minT;
-    outU = minU;
-    outV = minV;
-    outW = minW;
-	outSign = minSign;
-    outIndex = minIndex;
+	// structural degradation above the rebuilt subtrees, start over
+	if (GetCost() > m_buildCost*maxDegradation)
+	{
+		m_faces.clear();
+		m_nodes.clear();
 
-    return (outT != FLT_MAX);
+		m_treeDepth = 0;
+		m_innerNodes = 0;
+		m_leafNodes = 0;
+
+		Build(m_buildMode);
+
+		numRebuiltFaces = m_numFaces;
+	}
+
+	return numRebuiltFaces;
 }
-*/
+
+uint32_t AABBTree::RebuildSubtree(uint32_t nodeIndex)
+{
+	// the faces of a subtree are a contiguous range from its leftmost to its rightmost leaf
+	uint32_t leaf = nodeIndex;
+	while (m_nodes[leaf].m_numFaces == 0)
+		leaf = m_nodes[leaf].m_index;
+
+	uint32_t last = nodeIndex;
+	while (m_nodes[last].m_numFaces == 0)
+		last = m_nodes[last].m_index+1;
+
+	const uint32_t first = m_nodes[leaf].m_index;
+	const uint32_t numFaces = m_nodes[last].m_index + m_nodes[last].m_numFaces - first;
+
+	for (uint32_t i=first; i < first+numFaces; ++i)
+	{
+		Bounds& b = m_faceBounds[m_faces[i]];
+		CalculateFaceBounds(&m_faces[i], 1, b.m_min, b.m_max);
+	}
+
+	// new children are appended after the existing nodes, the subtree's root keeps its index and bounds
+	const uint32_t begin = m_freeNode;
+
+	BuildRecursive(nodeIndex, &m_faces[first], numFaces, 1, m_buildMode);
+
+	StoreBuildAreas(begin, m_freeNode);
+	StoreBuildAreas(nodeIndex, nodeIndex+1);
+
+	return numFaces;
+}
+
+void AABBTree::Compact()
+{
+	NodeArray nodes;
+	std::vector<float> areas;
+
+	nodes.reserve(m_freeNode);
+	areas.reserve(m_freeNode);
+
+	nodes.push_back(m_nodes[0]);
+	areas.push_back(m_buildAreas[0]);
+
+	m_treeDepth = 0;
+	m_innerNodes = 0;
+	m_leafNodes = 0;
+
+	// pairs of children are allocated before descending into the left subtree, the same order as BuildRecursive()
+	struct Entry
+	{
+		uint32_t oldIndex;
+		uint32_t newIndex;
+		uint32_t depth;
+	};
+
+	std::vector<Entry> stack;
+	
+	Entry root = { 0, 0, 1 };
+	stack.push_back(root);
+
+	while (!stack.empty())
+	{
+		const Entry e = stack.back();
+		stack.pop_back();
+
+		m_treeDepth = max(m_treeDepth, e.depth);
+
+		const Node& n = m_nodes[e.oldIndex];
+
+		if (n.m_numFaces)
+		{
+			++m_leafNodes;
+			continue;
+		}
+
+		++m_innerNodes;
+
+		const uint32_t children = uint32_t(nodes.size());
+		nodes[e.newIndex].m_index = children;
+
+		for (uint32_t c=0; c < 2; ++c)
+		{
+			nodes.push_back(m_nodes[n.m_index+c]);
+			areas.push_back(m_buildAreas[n.m_index+c]);
+		}
+
+		Entry right = { n.m_index+1, children+1, e.depth+1 };
+		Entry left = { n.m_index+0, children+0, e.depth+1 };
+
+		stack.push_back(right);
+		stack.push_back(left);
+	}
+
+	m_freeNode = uint32_t(nodes.size());
+
+	m_nodes.swap(nodes);
+	m_buildAreas.swap(areas);
+}
+
+#define TRACE_STATS 0
+
+namespace
+{
+	// reciprocal direction for the slab test, clamped to a finite value so a ray that lies in a 
+	// slab's plane is treated as inside it rather than producing NaNs
+	inline Vector3 RcpDir(const Vector3& dir)
+	{
+		return Vector3(Clamp(1.0f/dir.x, -FLT_MAX, FLT_MAX), 
+					   Clamp(1.0f/dir.y, -FLT_MAX, FLT_MAX), 
+					   Clamp(1.0f/dir.z, -FLT_MAX, FLT_MAX));
+	}
+
+	// distance along the ray to the node's bounds, FLT_MAX if the ray misses them
+	inline float RayNodeDistance(const Vec3& start, const Vector3& rcpDir, const AABBTree::Node& n)
+	{
+		float t;
+		if (IntersectRayAABBOmpf(start, rcpDir, n.m_minExtents, n.m_maxExtents, t) && t < FLT_MAX)
+			return t;
+		else
+			return FLT_MAX;
+	}
+
+	const uint32_t kTraceStackSize = 64;
+
+} // anonymous namespace
 
 bool AABBTree::TraceRay(const Vec3& start, const Vector3& dir, float& outT, float& u, float& v, float& w, float& faceSign, uint32_t& faceIndex) const
 {   
     //s_traceDepth = 0;
 
-    Vector3 rcp_dir(1.0f/dir.x, 1.0f/dir.y, 1.0f/dir.z);
-
     outT = FLT_MAX;
-    TraceRecursive(0, start, dir, outT, u, v, w, faceSign, faceIndex);
+    TraceSubtree(0, start, dir, RcpDir(dir), outT, u, v, w, faceSign, faceIndex);
 
     return (outT != FLT_MAX);
 }
 
-
-void AABBTree::TraceRecursive(uint32_t nodeIndex, const Vec3& start, const Vector3& dir, float& outT, float& outU, float& outV, float& outW, float& faceSign, uint32_t& faceIndex) const
+void AABBTree::TraceSubtree(uint32_t nodeIndex, const Vec3& start, const Vector3& dir, const Vector3& rcpDir, float& outT, float& outU, float& outV, float& outW, float& faceSign, uint32_t& faceIndex) const
 {
-	const Node& node = m_nodes[nodeIndex];
+	// nodes still to visit and their distance along the ray
+	uint32_t stack[kTraceStackSize];
+	float stackDist[kTraceStackSize];
+	uint32_t stackCount = 0;
 
-    if (node.m_faces == NULL)
-    {
+	for (;;)
+	{
+		const Node& node = m_nodes[nodeIndex];
+
+		if (node.m_numFaces == 0)
+		{
 #if _WIN32
-        ++s_traceDepth;
+			++s_traceDepth;
 #endif
 		
 #if TRACE_STATS
-        extern uint32_t g_nodesChecked;
-        ++g_nodesChecked;
+			extern uint32_t g_nodesChecked;
+			++g_nodesChecked;
 #endif
+			// find closest node
+			const float dist[2] = { RayNodeDistance(start, rcpDir, m_nodes[node.m_index+0]), 
+									RayNodeDistance(start, rcpDir, m_nodes[node.m_index+1]) };
 
-        // find closest node
-        const Node& leftChild = m_nodes[node.m_children+0];
-        const Node& rightChild = m_nodes[node.m_children+1];
+			const uint32_t closest = dist[1] < dist[0]; // 0 or 1
+			const uint32_t furthest = closest ^ 1;
 
-        float dist[2] = {FLT_MAX, FLT_MAX};
+			if (dist[closest] < outT)
+			{
+				if (dist[furthest] < outT)
+				{
+					if (stackCount < kTraceStackSize)
+					{
+						// visit the furthest child later, if it is still closer than the nearest hit
+						stack[stackCount] = node.m_index+furthest;
+						stackDist[stackCount] = dist[furthest];
+						++stackCount;
+					}
+					else
+					{
+						// out of stack, trace the closest child with a nested call and then continue with the furthest
+						TraceSubtree(node.m_index+closest, start, dir, rcpDir, outT, outU, outV, outW, faceSign, faceIndex);
+
+						if (dist[furthest] < outT)
+						{
+							nodeIndex = node.m_index+furthest;
+							continue;
+						}
+						
+						goto pop;
+					}
+				}
+
+				nodeIndex = node.m_index+closest;
+				continue;
+			}
+		}
+		else
+		{
+			float t, u, v, w, s;
 
-        IntersectRayAABB(start, dir, leftChild.m_minExtents, leftChild.m_maxExtents, dist[0], NULL);
-        IntersectRayAABB(start, dir, rightChild.m_minExtents, rightChild.m_maxExtents, dist[1], NULL);
-        
-        uint32_t closest = 0;
-        uint32_t furthest = 1;
-		
-        if (dist[1] < dist[0])
-        {
-            closest = 1;
-            furthest = 0;
-        }		
+			for (uint32_t i=0; i < node.m_numFaces; ++i)
+			{
+				const uint32_t face = m_faces[node.m_index+i];
+				const uint32_t indexStart = face*3;
 
-        if (dist[closest] < outT)
-            TraceRecursive(node.m_children+closest, start, dir, outT, outU, outV, outW, faceSign, faceIndex);
+				const Vec3& a = m_vertices[m_indices[indexStart+0]];
+				const Vec3& b = m_vertices[m_indices[indexStart+1]];
+				const Vec3& c = m_vertices[m_indices[indexStart+2]];
+#if TRACE_STATS
+				extern uint32_t g_trisChecked;
+				++g_trisChecked;
+#endif
 
-        if (dist[furthest] < outT)
-            TraceRecursive(node.m_children+furthest, start, dir, outT, outU, outV, outW, faceSign, faceIndex);
+				if (IntersectRayTriTwoSided(start, dir, a, b, c, t, u, v, w, s))
+				{
+					if (t < outT)
+					{
+						outT = t;
+						outU = u;
+						outV = v;
+						outW = w;
+						faceSign = s;
+						faceIndex = face;
+					}
+				}
+			}
+		}
 
-    }
-    else
-    {
-        Vector3 normal;
-        float t, u, v, w, s;
+	pop:
 
-        for (uint32_t i=0; i < node.m_numFaces; ++i)
-        {
-            uint32_t indexStart = node.m_faces[i]*3;
+		// skip nodes that are further away than the closest hit found since they were pushed
+		do
+		{
+			if (stackCount == 0)
+				return;
 
-            const Vec3& a = m_vertices[m_indices[indexStart+0]];
-            const Vec3& b = m_vertices[m_indices[indexStart+1]];
-            const Vec3& c = m_vertices[m_indices[indexStart+2]];
-#if TRACE_STATS
-            extern uint32_t g_trisChecked;
-            ++g_trisChecked;
-#endif
+			--stackCount;
+		}
+		while (stackDist[stackCount] >= outT);
 
-            if (IntersectRayTriTwoSided(start, dir, a, b, c, t, u, v, w, s))
-            {
-                if (t < outT)
-                {
-                    outT = t;
-					outU = u;
-					outV = v;
-					outW = w;
-					faceSign = s;
-					faceIndex = node.m_faces[i];
-                }
-            }
-        }
-    }
+		nodeIndex = stack[stackCount];
+	}
+}
+
+void AABBTree::TraceRayAll(const Vec3& start, const Vector3& dir, std::vector<float>& outT) const
+{
+	TraceAllSubtree(0, start, dir, RcpDir(dir), outT);
+}
+
+void AABBTree::TraceAllSubtree(uint32_t nodeIndex, const Vec3& start, const Vector3& dir, const Vector3& rcpDir, std::vector<float>& outT) const
+{
+	uint32_t stack[kTraceStackSize];
+	uint32_t stackCount = 0;
+
+	for (;;)
+	{
+		const Node& node = m_nodes[nodeIndex];
+
+		if (node.m_numFaces == 0)
+		{
+			// no early out on distance, visit every child the ray passes through
+			const bool hit[2] = { RayNodeDistance(start, rcpDir, m_nodes[node.m_index+0]) < FLT_MAX, 
+								  RayNodeDistance(start, rcpDir, m_nodes[node.m_index+1]) < FLT_MAX };
+
+			if (hit[0] && hit[1])
+			{
+				if (stackCount < kTraceStackSize)
+					stack[stackCount++] = node.m_index+1;
+				else
+					TraceAllSubtree(node.m_index+1, start, dir, rcpDir, outT);
+			}
+
+			if (hit[0] || hit[1])
+			{
+				nodeIndex = node.m_index + (hit[0] ? 0 : 1);
+				continue;
+			}
+		}
+		else
+		{
+			float t, u, v, w, s;
+
+			for (uint32_t i=0; i < node.m_numFaces; ++i)
+			{
+				uint32_t indexStart = m_faces[node.m_index+i]*3;
+
+				const Vec3& a = m_vertices[m_indices[indexStart+0]];
+				const Vec3& b = m_vertices[m_indices[indexStart+1]];
+				const Vec3& c = m_vertices[m_indices[indexStart+2]];
+
+				if (IntersectRayTriTwoSided(start, dir, a, b, c, t, u, v, w, s))
+					outT.push_back(t);
+			}
+		}
+
+		if (stackCount == 0)
+			return;
+
+		nodeIndex = stack[--stackCount];
+	}
+}
+
+// rays of a packet in structure of arrays form, kRayPacketSize rays as groups of kSimdWidth lanes, 
+// unused lanes repeat the last ray so every lane holds valid data
+struct AABBTree::RayPacket
+{
+	enum { kNumGroups = (kRayPacketSize + kSimdWidth - 1)/kSimdWidth };
+
+	SimdVec3 start[kNumGroups];
+	SimdVec3 negDir[kNumGroups];
+	SimdVec3 rcpDir[kNumGroups];
+
+	// closest hit so far, boxes and faces further than this are skipped
+	SimdFloat tMax[kNumGroups];
+
+	// used to order the children of a node
+	Vector3 representativeDir;
+
+	int numRays;
+
+	RayPacket(const Vec3* starts, const Vector3* dirs, int n) : numRays(n)
+	{
+		float s[3][kNumGroups*kSimdWidth];
+		float d[3][kNumGroups*kSimdWidth];
+		float r[3][kNumGroups*kSimdWidth];
+
+		for (int i=0; i < kNumGroups*kSimdWidth; ++i)
+		{
+			const int ray = Min(i, n-1);
+			const Vector3 rcp = RcpDir(dirs[ray]);
+
+			for (int c=0; c < 3; ++c)
+			{
+				s[c][i] = starts[ray][c];
+				d[c][i] = -dirs[ray][c];
+				r[c][i] = rcp[c];
+			}
+		}
+
+		for (int g=0; g < kNumGroups; ++g)
+		{
+			const int offset = g*kSimdWidth;
+
+			start[g].x = SimdLoad(&s[0][offset]);
+			start[g].y = SimdLoad(&s[1][offset]);
+			start[g].z = SimdLoad(&s[2][offset]);
+
+			negDir[g].x = SimdLoad(&d[0][offset]);
+			negDir[g].y = SimdLoad(&d[1][offset]);
+			negDir[g].z = SimdLoad(&d[2][offset]);
+
+			rcpDir[g].x = SimdLoad(&r[0][offset]);
+			rcpDir[g].y = SimdLoad(&r[1][offset]);
+			rcpDir[g].z = SimdLoad(&r[2][offset]);
+
+			tMax[g] = SimdSplat(FLT_MAX);
+		}
+
+		representativeDir = dirs[0];
+	}
+
+	// slab test of the node against each lane of a group, the same test as RayNodeDistance()
+	inline SimdMask IntersectNode(const Node& n, int g) const
+	{
+		SimdFloat l1 = SimdMul(SimdSub(SimdSplat(n.m_minExtents.x), start[g].x), rcpDir[g].x);
+		SimdFloat l2 = SimdMul(SimdSub(SimdSplat(n.m_maxExtents.x), start[g].x), rcpDir[g].x);
+		SimdFloat lmin = SimdMin(l1, l2);
+		SimdFloat lmax = SimdMax(l1, l2);
+
+		l1 = SimdMul(SimdSub(SimdSplat(n.m_minExtents.y), start[g].y), rcpDir[g].y);
+		l2 = SimdMul(SimdSub(SimdSplat(n.m_maxExtents.y), start[g].y), rcpDir[g].y);
+		lmin = SimdMax(SimdMin(l1, l2), lmin);
+		lmax = SimdMin(SimdMax(l1, l2), lmax);
+
+		l1 = SimdMul(SimdSub(SimdSplat(n.m_minExtents.z), start[g].z), rcpDir[g].z);
+		l2 = SimdMul(SimdSub(SimdSplat(n.m_maxExtents.z), start[g].z), rcpDir[g].z);
+		lmin = SimdMax(SimdMin(l1, l2), lmin);
+		lmax = SimdMin(SimdMax(l1, l2), lmax);
+
+		return SimdAnd(SimdAnd(SimdCmpGe(lmax, SimdSplat(0.0f)), SimdCmpGe(lmax, lmin)), SimdCmpLt(lmin, tMax[g]));
+	}
+
+	inline bool IntersectNode(const Node& n) const
+	{
+		int bits = 0;
+		for (int g=0; g < kNumGroups; ++g)
+			bits |= SimdMaskBits(IntersectNode(n, g));
+
+		return bits != 0;
+	}
+
+	// two sided ray triangle test for each lane of a group, the same operations as IntersectRayTriTwoSided(), 
+	// returns the lanes that hit closer than tMax
+	inline SimdMask IntersectTri(const SimdVec3& a, const SimdVec3& ab, const SimdVec3& ac, const SimdVec3& n, int g, SimdFloat& t, SimdFloat& v, SimdFloat& w, SimdFloat& d) const
+	{
+		d = SimdAdd(SimdAdd(SimdMul(negDir[g].x, n.x), SimdMul(negDir[g].y, n.y)), SimdMul(negDir[g].z, n.z));
+
+		const SimdFloat ood = SimdDiv(SimdSplat(1.0f), d);
+		const SimdVec3 ap = SimdSub(start[g], a);
+
+		t = SimdMul(SimdAdd(SimdAdd(SimdMul(ap.x, n.x), SimdMul(ap.y, n.y)), SimdMul(ap.z, n.z)), ood);
+
+		const SimdVec3 e = SimdCross(negDir[g], ap);
+
+		v = SimdMul(SimdAdd(SimdAdd(SimdMul(ac.x, e.x), SimdMul(ac.y, e.y)), SimdMul(ac.z, e.z)), ood);
+		w = SimdMul(SimdSub(SimdSplat(0.0f), SimdAdd(SimdAdd(SimdMul(ab.x, e.x), SimdMul(ab.y, e.y)), SimdMul(ab.z, e.z))), ood);
+
+		SimdMask hit = SimdAnd(SimdCmpGe(t, SimdSplat(0.0f)), SimdCmpLt(t, tMax[g]));
+		hit = SimdAnd(hit, SimdAnd(SimdCmpGe(v, SimdSplat(0.0f)), SimdCmpLe(v, SimdSplat(1.0f))));
+		hit = SimdAnd(hit, SimdAnd(SimdCmpGe(w, SimdSplat(0.0f)), SimdCmpLe(SimdAdd(v, w), SimdSplat(1.0f))));
+
+		return hit;
+	}
+};
+
+void AABBTree::TraceRayPacket(const Vec3* starts, const Vector3* dirs, int numRays, Hit* hits) const
+{
+	assert(numRays > 0 && numRays <= kRayPacketSize);
+
+	RayPacket packet(starts, dirs, numRays);
+
+	for (int i=0; i < numRays; ++i)
+		hits[i].t = FLT_MAX;
+
+	TracePacketSubtree(0, packet, hits);
+}
+
+void AABBTree::TracePacketSubtree(uint32_t nodeIndex, RayPacket& packet, Hit* hits) const
+{
+	// nodes are tested against the packet when they are popped so the test sees the latest hits
+	uint32_t stack[kTraceStackSize];
+	uint32_t stackCount = 0;
+
+	for (;;)
+	{
+		const Node& node = m_nodes[nodeIndex];
+
+		if (packet.IntersectNode(node))
+		{
+			if (node.m_numFaces == 0)
+			{
+				// visit the child on the side the rays come from first
+				const Node& left = m_nodes[node.m_index+0];
+				const Node& right = m_nodes[node.m_index+1];
+
+				const Vector3 separation = (right.m_minExtents + right.m_maxExtents) - (left.m_minExtents + left.m_maxExtents);
+				const uint32_t closest = Dot(separation, packet.representativeDir) < 0.0f;
+
+				if (stackCount < kTraceStackSize)
+				{
+					stack[stackCount++] = node.m_index + (closest^1);
+				}
+				else
+				{
+					// out of stack, trace the closest child with a nested call and then continue with the furthest
+					TracePacketSubtree(node.m_index+closest, packet, hits);
+
+					nodeIndex = node.m_index + (closest^1);
+					continue;
+				}
+
+				nodeIndex = node.m_index+closest;
+				continue;
+			}
+			else
+			{
+				for (uint32_t i=0; i < node.m_numFaces; ++i)
+				{
+					const uint32_t face = m_faces[node.m_index+i];
+					const uint32_t indexStart = face*3;
+
+					const Vec3& a = m_vertices[m_indices[indexStart+0]];
+					const Vec3& b = m_vertices[m_indices[indexStart+1]];
+					const Vec3& c = m_vertices[m_indices[indexStart+2]];
+
+					const Vector3 ab = b - a;
+					const Vector3 ac = c - a;
+					const Vector3 n = Cross(ab, ac);
+
+					const SimdVec3 sa = SimdSplat(a);
+					const SimdVec3 sab = SimdSplat(ab);
+					const SimdVec3 sac = SimdSplat(ac);
+					const SimdVec3 sn = SimdSplat(n);
+
+					for (int g=0; g < RayPacket::kNumGroups; ++g)
+					{
+						SimdFloat t, v, w, d;
+						const SimdMask hit = packet.IntersectTri(sa, sab, sac, sn, g, t, v, w, d);
+						
+						const int bits = SimdMaskBits(hit);
+
+						if (bits)
+						{
+							packet.tMax[g] = SimdSelect(hit, t, packet.tMax[g]);
+
+							float laneT[kSimdWidth], laneV[kSimdWidth], laneW[kSimdWidth], laneD[kSimdWidth];
+							SimdStore(laneT, t);
+							SimdStore(laneV, v);
+							SimdStore(laneW, w);
+							SimdStore(laneD, d);
+
+							for (int l=0; l < kSimdWidth; ++l)
+							{
+								const int ray = g*kSimdWidth + l;
+
+								if ((bits & (1<<l)) && ray < packet.numRays)
+								{
+									Hit& h = hits[ray];
+									h.t = laneT[l];
+									h.u = 1.0f - laneV[l] - laneW[l];
+									h.v = laneV[l];
+									h.w = laneW[l];
+									h.faceSign = laneD[l];
+									h.faceIndex = face;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		if (stackCount == 0)
+			return;
+
+		nodeIndex = stack[--stackCount];
+	}
+}
+
+void AABBTree::TraceRayPacketAll(const Vec3* starts, const Vector3* dirs, int numRays, std::vector<float>* outT) const
+{
+	assert(numRays > 0 && numRays <= kRayPacketSize);
+
+	const RayPacket packet(starts, dirs, numRays);
+
+	TracePacketAllSubtree(0, packet, outT);
+}
+
+void AABBTree::TracePacketAllSubtree(uint32_t nodeIndex, const RayPacket& packet, std::vector<float>* outT) const
+{
+	uint32_t stack[kTraceStackSize];
+	uint32_t stackCount = 0;
+
+	for (;;)
+	{
+		const Node& node = m_nodes[nodeIndex];
+
+		// tMax stays at FLT_MAX so only finite hits are reported
+		if (packet.IntersectNode(node))
+		{
+			if (node.m_numFaces == 0)
+			{
+				if (stackCount < kTraceStackSize)
+					stack[stackCount++] = node.m_index+1;
+				else
+					TracePacketAllSubtree(node.m_index+1, packet, outT);
+
+				nodeIndex = node.m_index;
+				continue;
+			}
+			else
+			{
+				for (uint32_t i=0; i < node.m_numFaces; ++i)
+				{
+					const uint32_t indexStart = m_faces[node.m_index+i]*3;
+
+					const Vec3& a = m_vertices[m_indices[indexStart+0]];
+					const Vec3& b = m_vertices[m_indices[indexStart+1]];
+					const Vec3& c = m_vertices[m_indices[indexStart+2]];
+
+					const Vector3 ab = b - a;
+					const Vector3 ac = c - a;
+
+					const SimdVec3 sa = SimdSplat(a);
+					const SimdVec3 sab = SimdSplat(ab);
+					const SimdVec3 sac = SimdSplat(ac);
+					const SimdVec3 sn = SimdSplat(Cross(ab, ac));
+
+					for (int g=0; g < RayPacket::kNumGroups; ++g)
+					{
+						SimdFloat t, v, w, d;
+						const int bits = SimdMaskBits(packet.IntersectTri(sa, sab, sac, sn, g, t, v, w, d));
+
+						if (bits)
+						{
+							float laneT[kSimdWidth];
+							SimdStore(laneT, t);
+
+							for (int l=0; l < kSimdWidth; ++l)
+							{
+								const int ray = g*kSimdWidth + l;
+
+								if ((bits & (1<<l)) && ray < packet.numRays)
+									outT[ray].push_back(laneT[l]);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		if (stackCount == 0)
+			return;
+
+		nodeIndex = stack[--stackCount];
+	}
+}
+
+void AABBTree::TraceRays(const Vec3* starts, const Vector3* dirs, int numRays, Hit* hits, int numThreads) const
+{
+	const int numPackets = (numRays + kRayPacketSize - 1)/kRayPacketSize;
+
+	GetDefaultThreadPool().ParallelFor(0, numPackets, [&](int begin, int end)
+	{
+		for (int p=begin; p < end; ++p)
+		{
+			const int offset = p*kRayPacketSize;
+			const int count = Min(kRayPacketSize, numRays-offset);
+
+			// packets only pay off when the rays visit the same nodes, rays with 
+			// directions in different octants are traced one at a time instead
+			bool coherent = true;
+
+			for (int i=1; i < count && coherent; ++i)
+			{
+				const Vector3& a = dirs[offset];
+				const Vector3& b = dirs[offset+i];
+
+				coherent = (a.x < 0.0f) == (b.x < 0.0f) && (a.y < 0.0f) == (b.y < 0.0f) && (a.z < 0.0f) == (b.z < 0.0f);
+			}
+
+			if (coherent)
+			{
+				TraceRayPacket(starts + offset, dirs + offset, count, hits + offset);
+			}
+			else
+			{
+				for (int i=offset; i < offset+count; ++i)
+				{
+					Hit& h = hits[i];
+					TraceRay(starts[i], dirs[i], h.t, h.u, h.v, h.w, h.faceSign, h.faceIndex);
+				}
+			}
+		}
+
+	}, numThreads, 64);
+}
+
+namespace
+{
+	// squared distance from a point to the node's bounds, zero inside them
+	inline float PointNodeDistanceSq(const Vec3& p, const AABBTree::Node& n)
+	{
+		return LengthSq(p - ClosestPointToAABB(p, n.m_minExtents, n.m_maxExtents));
+	}
+
+} // anonymous namespace
+
+bool AABBTree::ClosestPoint(const Vec3& point, float maxDist, Vec3& outPoint, float& outDist, uint32_t& outFace) const
+{
+	float distSq = maxDist*maxDist;
+
+	if (m_nodes.empty() || PointNodeDistanceSq(point, m_nodes[0]) >= distSq)
+		return false;
+
+	outFace = uint32_t(-1);
+
+	ClosestPointSubtree(0, point, distSq, outPoint, outFace);
+
+	if (outFace == uint32_t(-1))
+		return false;
+
+	outDist = sqrtf(distSq);
+	return true;
+}
+
+void AABBTree::ClosestPointSubtree(uint32_t nodeIndex, const Vec3& point, float& distSq, Vec3& outPoint, uint32_t& outFace) const
+{
+	// same traversal as TraceSubtree() with the distance to each node's bounds in place of the distance along the ray
+	uint32_t stack[kTraceStackSize];
+	float stackDist[kTraceStackSize];
+	uint32_t stackCount = 0;
+
+	for (;;)
+	{
+		const Node& node = m_nodes[nodeIndex];
+
+		if (node.m_numFaces == 0)
+		{
+			const float dist[2] = { PointNodeDistanceSq(point, m_nodes[node.m_index+0]), 
+									PointNodeDistanceSq(point, m_nodes[node.m_index+1]) };
+
+			const uint32_t closest = dist[1] < dist[0];
+			const uint32_t furthest = closest ^ 1;
+
+			if (dist[closest] < distSq)
+			{
+				if (dist[furthest] < distSq)
+				{
+					if (stackCount < kTraceStackSize)
+					{
+						stack[stackCount] = node.m_index+furthest;
+						stackDist[stackCount] = dist[furthest];
+						++stackCount;
+					}
+					else
+					{
+						ClosestPointSubtree(node.m_index+closest, point, distSq, outPoint, outFace);
+
+						if (dist[furthest] < distSq)
+						{
+							nodeIndex = node.m_index+furthest;
+							continue;
+						}
+
+						goto pop;
+					}
+				}
+
+				nodeIndex = node.m_index+closest;
+				continue;
+			}
+		}
+		else
+		{
+			for (uint32_t i=0; i < node.m_numFaces; ++i)
+			{
+				const uint32_t face = m_faces[node.m_index+i];
+				const uint32_t indexStart = face*3;
+
+				const Vec3& a = m_vertices[m_indices[indexStart+0]];
+				const Vec3& b = m_vertices[m_indices[indexStart+1]];
+				const Vec3& c = m_vertices[m_indices[indexStart+2]];
+
+				float v, w;
+				const Vec3 p = ClosestPointOnTriangle(a, b, c, point, v, w);
+				const float d = LengthSq(point-p);
+
+				if (d < distSq)
+				{
+					distSq = d;
+					outPoint = p;
+					outFace = face;
+				}
+			}
+		}
+
+	pop:
+
+		do
+		{
+			if (stackCount == 0)
+				return;
+
+			--stackCount;
+		}
+		while (stackDist[stackCount] >= distSq);
+
+		nodeIndex = stack[stackCount];
+	}
 }
 
 /*
@@ -39,11 +39,72 @@ class AABBTree
 
 public:
 
-    AABBTree(const Vec3* vertices, uint32_t numVerts, const uint32_t* indices, uint32_t numFaces);
+	// nodes are a flat 32 byte layout, the two children of an inner node are stored next to each 
+	// other and the faces of a leaf are a contiguous range of the face order
+	struct Node
+	{
+		Vec3 m_minExtents;
+		uint32_t m_index;		// first child for inner nodes, first entry in the face order for leaves
+		Vec3 m_maxExtents;
+		uint32_t m_numFaces;	// zero for inner nodes
+	};
+
+	enum BuildMode
+	{
+		eBuildSweepSAH,		// sort the faces along each axis and evaluate every split position
+		eBuildBinnedSAH		// evaluate splits between a fixed number of centroid bins per-axis, much faster to build
+	};
+
+    AABBTree(const Vec3* vertices, uint32_t numVerts, const uint32_t* indices, uint32_t numFaces, BuildMode mode=eBuildBinnedSAH);
+
+	// restore a tree from Pack() output without rebuilding it, the nodes must have been built for the same mesh
+	AABBTree(const Vec3* vertices, uint32_t numVerts, const uint32_t* indices, uint32_t numFaces, const Node* nodes, uint32_t numNodes, const uint32_t* faceOrder);
+
+	void Pack(std::vector<Node>& outNodes, std::vector<uint32_t>& outFaceOrder) const;
 
 	bool TraceRaySlow(const Vec3& start, const Vector3& dir, float& outT, float& u, float& v, float& w, float& faceSign, uint32_t& faceIndex) const;
     bool TraceRay(const Vec3& start, const Vector3& dir, float& outT, float& u, float& v, float& w, float& faceSign, uint32_t& faceIndex) const;
 
+	// finds every intersection along the ray in a single traversal, hit distances are appended to outT (unsorted)
+	void TraceRayAll(const Vec3& start, const Vector3& dir, std::vector<float>& outT) const;
+
+	// closest hit along a ray, t is FLT_MAX if the ray missed
+	struct Hit
+	{
+		float t;
+		float u, v, w;
+		float faceSign;
+		uint32_t faceIndex;
+	};
+
+	// number of rays traced together by the packet functions
+	static const int kRayPacketSize = 8;
+
+	// traces up to kRayPacketSize rays with one traversal, box and triangle tests are done for the whole packet 
+	// with the SIMD backend in core/simd.h, rays should be coherent (nearby starts, similar directions) so they share most nodes
+	void TraceRayPacket(const Vec3* starts, const Vector3* dirs, int numRays, Hit* hits) const;
+
+	// every intersection for up to kRayPacketSize rays, hit distances for ray i are appended to outT[i] (unsorted)
+	void TraceRayPacketAll(const Vec3* starts, const Vector3* dirs, int numRays, std::vector<float>* outT) const;
+
+	// traces numRays rays in packets of consecutive rays spread across numThreads threads of the default thread pool (0 = all threads), 
+	// packets whose directions fall in different octants are traced one ray at a time
+	void TraceRays(const Vec3* starts, const Vector3* dirs, int numRays, Hit* hits, int numThreads=0) const;
+
+	// closest point on the mesh to point, only triangles closer than maxDist are considered and subtrees further away than the 
+	// closest triangle found so far are skipped, so small bounds are cheap to query. Returns false if no triangle is within maxDist
+	bool ClosestPoint(const Vec3& point, float maxDist, Vec3& outPoint, float& outDist, uint32_t& outFace) const;
+
+	// updates the node bounds bottom-up for new vertex positions, the mesh must have the same vertex count and topology as at construction 
+	// (pass the original pointer if the positions were changed in place). Refitting keeps the topology of the tree, so as the mesh deforms 
+	// the bounds grow and overlap, once the SAH cost (see GetCost()) exceeds that of the last full build by more than maxDegradation the 
+	// subtrees whose relative surface area grew by more than maxDegradation are rebuilt, and the whole tree if that is not enough. 
+	// Returns the number of faces in rebuilt subtrees, zero if the tree was only refit
+	uint32_t Refit(const Vec3* vertices, float maxDegradation=1.3f);
+
+	// SAH cost of the tree relative to the surface area of its root, the expected number of node visits and face tests per ray
+	float GetCost() const;
+
     void DebugDraw();
     
     Vector3 GetCenter() const { return (m_nodes[0].m_minExtents+m_nodes[0].m_maxExtents)*0.5f; }
@@ -55,31 +116,12 @@ public:
     static uint32_t GetTraceDepth() { return s_traceDepth; }
 #endif
 	
+	uint32_t GetNumNodes() const { return m_freeNode; }
+
 private:
 
     void DebugDrawRecursive(uint32_t nodeIndex, uint32_t depth);
 
-    struct Node
-    {
-        Node() 	
-            : m_numFaces(0)
-            , m_faces(NULL)
-            , m_minExtents(0.0f)
-            , m_maxExtents(0.0f)
-        {
-        }
-
-		union
-		{
-			uint32_t m_children;
-			uint32_t m_numFaces;			
-		};
-
-		uint32_t* m_faces;        
-        Vector3 m_minExtents;
-        Vector3 m_maxExtents;
-    };
-
 
     struct Bounds
     {
@@ -122,14 +164,31 @@ private:
 	// partition the objects and return the number of objects in the lower partition
 	uint32_t PartitionMedian(Node& n, uint32_t* faces, uint32_t numFaces);
 	uint32_t PartitionSAH(Node& n, uint32_t* faces, uint32_t numFaces);
+	uint32_t PartitionBinnedSAH(Node& n, uint32_t* faces, uint32_t numFaces);
 
-    void Build();
-    void BuildRecursive(uint32_t nodeIndex, uint32_t* faces, uint32_t numFaces);
-    void TraceRecursive(uint32_t nodeIndex, const Vec3& start, const Vector3& dir, float& outT, float& u, float& v, float& w, float& faceSign, uint32_t& faceIndex) const;
+    void Build(BuildMode mode);
+    void BuildRecursive(uint32_t nodeIndex, uint32_t* faces, uint32_t numFaces, uint32_t depth, BuildMode mode);
+
+	// traverse the subtree under nodeIndex with a fixed size stack, subtrees that don't fit are traced with a nested call
+    void TraceSubtree(uint32_t nodeIndex, const Vec3& start, const Vector3& dir, const Vector3& rcpDir, float& outT, float& u, float& v, float& w, float& faceSign, uint32_t& faceIndex) const;
+	void TraceAllSubtree(uint32_t nodeIndex, const Vec3& start, const Vector3& dir, const Vector3& rcpDir, std::vector<float>& outT) const;
+
+	// packet versions of the above, the packet layout depends on the SIMD backend so is defined in aabbtree.cpp
+	struct RayPacket;
+
+	void TracePacketSubtree(uint32_t nodeIndex, RayPacket& packet, Hit* hits) const;
+	void TracePacketAllSubtree(uint32_t nodeIndex, const RayPacket& packet, std::vector<float>* outT) const;
+
+	void ClosestPointSubtree(uint32_t nodeIndex, const Vec3& point, float& distSq, Vec3& outPoint, uint32_t& outFace) const;
  
+	// refit helpers, build areas are stored relative to the root's area at the time each node was built
+	void RefitBounds();
+	uint32_t RebuildSubtree(uint32_t nodeIndex);
+	void StoreBuildAreas(uint32_t begin, uint32_t end);
+	void Compact();
+
     void CalculateFaceBounds(uint32_t* faces, uint32_t numFaces, Vector3& outMinExtents, Vector3& outMaxExtents);
     uint32_t GetNumFaces() const { return m_numFaces; }
-	uint32_t GetNumNodes() const { return uint32_t(m_nodes.size()); }
 
 	// track the next free node
 	uint32_t m_freeNode;
@@ -144,6 +203,11 @@ private:
     NodeArray m_nodes;
     FaceBoundsArray m_faceBounds;    
 
+	// state used to rebuild after refitting
+	BuildMode m_buildMode;
+	float m_buildCost;
+	std::vector<float> m_buildAreas;
+
     // stats
     uint32_t m_treeDepth;
     uint32_t m_innerNodes;
@@ -27,10 +27,12 @@
 
 #include "mesh.h"
 #include "platform.h"
+#include "parallel.h"
 
-#include <map>
 #include <fstream>
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 
 using namespace std;
 
@@ -93,505 +95,1342 @@ void Mesh::CalculateNormals()
 
 namespace 
 {
+	// parsing helpers for memory mapped files, the data is not null terminated so everything takes an end pointer
 
-    enum PlyFormat
-    {
-        eAscii,
-        eBinaryBigEndian    
-    };
+	// whitespace within a line
+	inline bool IsBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
 
-    template <typename T>
-    T PlyRead(ifstream& s, PlyFormat format)
-    {
-        T data = eAscii;
-
-        switch (format)
-        {
-            case eAscii:
-            {
-                s >> data;
-                break;
-            }
-            case eBinaryBigEndian:
-            {
-                char c[sizeof(T)];
-                s.read(c, sizeof(T));
-                reverse(c, c+sizeof(T));
-                data = *(T*)c;
-                break;
-            }      
-			default:
-				assert(0);
-        }
-
-        return data;
-    }
+	inline bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline const char* SkipBlanks(const char* p, const char* end)
+	{
+		while (p < end && IsBlank(*p))
+			++p;
+
+		return p;
+	}
+
+	// returns the start of the next line
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		const char* nl = (const char*)memchr(p, '\n', end-p);
+		return nl ? nl+1 : end;
+	}
+
+	// returns a whitespace (including newline) delimited token in [begin, end), or an empty token if there are no more
+	inline const char* NextToken(const char* p, const char* end, const char*& tokenEnd)
+	{
+		while (p < end && (IsBlank(*p) || *p == '\n'))
+			++p;
+
+		tokenEnd = p;
+		while (tokenEnd < end && !(IsBlank(*tokenEnd) || *tokenEnd == '\n'))
+			++tokenEnd;
+
+		return p;
+	}
+
+	inline bool TokenEquals(const char* begin, const char* end, const char* s)
+	{
+		const size_t len = strlen(s);
+		return size_t(end-begin) == len && strncmp(begin, s, len) == 0;
+	}
+
+	// parses an unsigned integer at p, returns false if there are no digits
+	inline bool ParseUInt(const char*& p, const char* end, uint32_t& out)
+	{
+		if (p == end || !IsDigit(*p))
+			return false;
+
+		uint32_t v = 0;
+		while (p < end && IsDigit(*p))
+			v = v*10 + uint32_t(*p++ - '0');
+
+		out = v;
+		return true;
+	}
+
+	// parses a float after any blanks on the same line, returns false if there is no number. Values with 
+	// few significant digits (most mesh data) are converted exactly using a single float operation, which 
+	// rounds the same as strtof(), the rest fall back to strtof() on a null terminated copy of the token
+	inline bool ParseFloat(const char*& p, const char* end, float& out)
+	{
+		static const float kPow10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+		p = SkipBlanks(p, end);
+
+		const char* start = p;
+		const char* s = p;
+
+		bool negative = false;
+		if (s < end && (*s == '-' || *s == '+'))
+			negative = *s++ == '-';
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int numDigits = 0;
+		bool exact = true;
+
+		for (; s < end && IsDigit(*s); ++s, ++numDigits)
+		{
+			if (mantissa < (1ull << 60))
+				mantissa = mantissa*10 + uint64_t(*s - '0');
+			else
+				exact = false;
+		}
+
+		if (s < end && *s == '.')
+		{
+			for (++s; s < end && IsDigit(*s); ++s, ++numDigits)
+			{
+				if (mantissa < (1ull << 60))
+				{
+					mantissa = mantissa*10 + uint64_t(*s - '0');
+					--exponent;
+				}
+				else
+					exact = false;
+			}
+		}
+
+		if (numDigits == 0)
+		{
+			// not a number, unless it is something only strtof() understands (inf, nan)
+			exact = false;
+		}
+		else if (s < end && (*s == 'e' || *s == 'E'))
+		{
+			const char* e = s+1;
+
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+'))
+				negativeExponent = *e++ == '-';
+
+			uint32_t value;
+			if (ParseUInt(e, end, value) && value < 1000)
+			{
+				exponent += negativeExponent ? -int(value) : int(value);
+				s = e;
+			}
+			else
+				exact = false;
+		}
+
+		// the number must be followed by a delimiter to be handled here
+		if (s < end && !(IsBlank(*s) || *s == '\n'))
+			exact = false;
+
+		if (exact && mantissa <= (1u << 24) && exponent >= -10 && exponent <= 10)
+		{
+			float f = float(mantissa);
+			f = exponent < 0 ? f/kPow10[-exponent] : f*kPow10[exponent];
+
+			out = negative ? -f : f;
+			p = s;
+
+			return true;
+		}
+
+		// general case
+		const char* tokenEnd = start;
+		while (tokenEnd < end && !(IsBlank(*tokenEnd) || *tokenEnd == '\n'))
+			++tokenEnd;
+
+		char buffer[64];
+		const size_t len = Min(size_t(tokenEnd-start), sizeof(buffer)-1);
+
+		memcpy(buffer, start, len);
+		buffer[len] = 0;
+
+		char* parsedEnd;
+		out = strtof(buffer, &parsedEnd);
+
+		if (parsedEnd == buffer)
+			return false;
+
+		p = start + (parsedEnd-buffer);
+		return true;
+	}
+
+	inline uint32_t ReadBigEndianUInt(const char* p)
+	{
+		const uint8_t* b = (const uint8_t*)p;
+		return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3]);
+	}
+
+	inline float ReadBigEndianFloat(const char* p)
+	{
+		const uint32_t u = ReadBigEndianUInt(p);
+
+		float f;
+		memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+	// granularity of the parallel parsing loops
+	const int kMinParseLines = 4096;
+	const size_t kObjChunkSize = 256*1024;
+
+	enum PlyFormat
+	{
+		eAscii,
+		eBinaryBigEndian    
+	};
 
 } // namespace anonymous
 
 
-Mesh* ImportMesh(const char* path)
+Mesh* ImportMesh(const char* path, int numThreads)
 {
 	std::string ext = GetExtension(path);
 
 	Mesh* mesh = NULL;
 
 	if (ext == "ply")
-		mesh = ImportMeshFromPly(path);
+		mesh = ImportMeshFromPly(path, numThreads);
 	else if (ext == "obj")
-		mesh = ImportMeshFromObj(path);
+		mesh = ImportMeshFromObj(path, numThreads);
 
 
 	return mesh;
 }
 
-Mesh* ImportMeshFromBin(const char* path)
+namespace
 {
-	double start = GetSeconds();
+	const uint32_t kMeshBinMagic = 0x48534d46;	// "FMSH"
+	const uint32_t kMeshBinVersion = 1;
+	const uint32_t kMeshBinAlignment = 16;
 
-	FILE* f = fopen(path, "rb");
+	enum MeshBinSection
+	{
+		eMeshBinPositions,
+		eMeshBinNormals,
+		eMeshBinTexcoords,
+		eMeshBinIndices,
+		eMeshBinNodes,
+		eMeshBinFaceOrder,
+
+		eMeshBinNumSections
+	};
 
-	if (f)
+	// the file is written in native (little endian) byte order, sections follow the header in 
+	// order and a section of size zero is absent
+	struct MeshBinHeader
 	{
-		int numVertices;
-		int numIndices;
+		uint32_t magic;
+		uint32_t version;
+		int32_t flags;
+		uint32_t numVertices;
+		uint32_t numIndices;
+		uint32_t numNodes;
 
-		size_t len;
-		len = fread(&numVertices, sizeof(numVertices), 1, f);
-		len = fread(&numIndices, sizeof(numIndices), 1, f);
+		float lower[3];
+		float upper[3];
 
-		Mesh* m = new Mesh();
-		m->m_positions.resize(numVertices);
-		m->m_normals.resize(numVertices);
-		m->m_indices.resize(numIndices);
+		struct
+		{
+			uint32_t offset;
+			uint32_t size;
+
+		} sections[eMeshBinNumSections];
+	};
+
+	inline uint16_t QuantizeUnorm16(float x)
+	{
+		return uint16_t(Clamp(x, 0.0f, 1.0f)*65535.0f + 0.5f);
+	}
+
+	inline int16_t QuantizeSnorm16(float x)
+	{
+		return int16_t(floorf(Clamp(x, -1.0f, 1.0f)*32767.0f + 0.5f));
+	}
+
+	inline float SignNotZero(float x)
+	{
+		return x >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// octahedral normal encoding, maps the unit sphere to a square with nearly uniform precision
+	inline void EncodeNormal(const Vec3& n, int16_t out[2])
+	{
+		const float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+
+		float x = l1 > 0.0f ? n.x/l1 : 0.0f;
+		float y = l1 > 0.0f ? n.y/l1 : 0.0f;
+
+		if (n.z < 0.0f)
+		{
+			const float fx = (1.0f - fabsf(y))*SignNotZero(x);
+			const float fy = (1.0f - fabsf(x))*SignNotZero(y);
+
+			x = fx;
+			y = fy;
+		}
 
-		len = fread(&m->m_positions[0], sizeof(Vec3)*numVertices, 1, f);
-		len = fread(&m->m_normals[0], sizeof(Vec3)*numVertices, 1, f);
-		len = fread(&m->m_indices[0], sizeof(int)*numIndices, 1, f);
+		out[0] = QuantizeSnorm16(x);
+		out[1] = QuantizeSnorm16(y);
+	}
+
+	inline Vec3 DecodeNormal(const int16_t in[2])
+	{
+		Vec3 n(Max(in[0]/32767.0f, -1.0f), Max(in[1]/32767.0f, -1.0f), 0.0f);
+		n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+
+		if (n.z < 0.0f)
+		{
+			const float x = (1.0f - fabsf(n.y))*SignNotZero(n.x);
+			const float y = (1.0f - fabsf(n.x))*SignNotZero(n.y);
+
+			n.x = x;
+			n.y = y;
+		}
 
-		(void)len;
+		return SafeNormalize(n, Vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	inline Vec3 DecodePosition(const uint16_t in[3], const Vec3& lower, const Vec3& scale)
+	{
+		return lower + Vec3(float(in[0]), float(in[1]), float(in[2]))*scale;
+	}
+
+	inline void WriteSection(FILE* f, MeshBinHeader& header, MeshBinSection section, const void* data, size_t size)
+	{
+		if (size == 0)
+			return;
+
+		// pad to alignment
+		const uint32_t offset = uint32_t(ftell(f));
+		const uint32_t alignedOffset = Align(offset, kMeshBinAlignment);
+
+		const char zeros[kMeshBinAlignment] = { 0 };
+		fwrite(zeros, alignedOffset-offset, 1, f);
 		
-		fclose(f);
+		fwrite(data, size, 1, f);
+
+		header.sections[section].offset = alignedOffset;
+		header.sections[section].size = uint32_t(size);
+	}
+
+	// legacy format, vertex and index counts followed by positions, normals and indices
+	Mesh* ImportMeshFromLegacyBin(const char* path)
+	{
+		FILE* f = fopen(path, "rb");
+
+		if (f)
+		{
+			int numVertices;
+			int numIndices;
+
+			size_t len;
+			len = fread(&numVertices, sizeof(numVertices), 1, f);
+			len = fread(&numIndices, sizeof(numIndices), 1, f);
 
+			Mesh* m = new Mesh();
+			m->m_positions.resize(numVertices);
+			m->m_normals.resize(numVertices);
+			m->m_indices.resize(numIndices);
+
+			len = fread(&m->m_positions[0], sizeof(Vec3)*numVertices, 1, f);
+			len = fread(&m->m_normals[0], sizeof(Vec3)*numVertices, 1, f);
+			len = fread(&m->m_indices[0], sizeof(int)*numIndices, 1, f);
+
+			(void)len;
+			
+			fclose(f);
+
+			return m;
+		}
+
+		return NULL;
+	}
+
+} // anonymous namespace
+
+bool MapMeshBin(const char* path, MeshBin& bin)
+{
+	if (!MapFile(path, bin.file))
+		return false;
+
+	const MeshBinHeader* header = (const MeshBinHeader*)bin.file.data;
+	
+	bool valid = bin.file.size >= sizeof(MeshBinHeader) && 
+				 header->magic == kMeshBinMagic && 
+				 header->version == kMeshBinVersion;
+
+	if (valid)
+	{
+		const bool quantizedPositions = (header->flags & eMeshBinQuantizePositions) != 0;
+		const bool quantizedNormals = (header->flags & eMeshBinQuantizeNormals) != 0;
+		const bool indices16 = (header->flags & eMeshBinIndices16) != 0;
+
+		// expected size of each section, normals and texcoords are optional
+		const uint64_t numVertices = header->numVertices;
+		const uint64_t sizes[eMeshBinNumSections] = 
+		{
+			numVertices*(quantizedPositions ? sizeof(uint16_t)*3 : sizeof(Vec3)),
+			numVertices*(quantizedNormals ? sizeof(int16_t)*2 : sizeof(Vec3)),
+			numVertices*sizeof(Vec2),
+			uint64_t(header->numIndices)*(indices16 ? sizeof(uint16_t) : sizeof(uint32_t)),
+			uint64_t(header->numNodes)*sizeof(AABBTree::Node),
+			header->numNodes ? uint64_t(header->numIndices/3)*sizeof(uint32_t) : 0
+		};
+
+		for (int i=0; i < eMeshBinNumSections && valid; ++i)
+		{
+			const uint64_t offset = header->sections[i].offset;
+			const uint64_t size = header->sections[i].size;
+			const bool optional = i == eMeshBinNormals || i == eMeshBinTexcoords;
+
+			valid = (size == sizes[i] || (optional && size == 0)) &&
+					offset % kMeshBinAlignment == 0 && 
+					offset + size <= bin.file.size;
+		}
+	}
+
+	if (!valid)
+	{
+		UnmapFile(bin.file);
+		return false;
+	}
+
+	const char* base = bin.file.data;
+
+	bin.flags = header->flags;
+	bin.numVertices = header->numVertices;
+	bin.numIndices = header->numIndices;
+	bin.numNodes = header->numNodes;
+	bin.lower = Vec3(header->lower);
+	bin.upper = Vec3(header->upper);
+
+	bin.positions = base + header->sections[eMeshBinPositions].offset;
+	bin.normals = header->sections[eMeshBinNormals].size ? base + header->sections[eMeshBinNormals].offset : NULL;
+	bin.texcoords = header->sections[eMeshBinTexcoords].size ? (const Vec2*)(base + header->sections[eMeshBinTexcoords].offset) : NULL;
+	bin.indices = base + header->sections[eMeshBinIndices].offset;
+	bin.nodes = header->numNodes ? (const AABBTree::Node*)(base + header->sections[eMeshBinNodes].offset) : NULL;
+	bin.faceOrder = header->numNodes ? (const uint32_t*)(base + header->sections[eMeshBinFaceOrder].offset) : NULL;
+
+	return true;
+}
+
+void UnmapMeshBin(MeshBin& bin)
+{
+	UnmapFile(bin.file);
+}
+
+Mesh* CreateMeshFromBin(const MeshBin& bin)
+{
+	const uint32_t numVertices = bin.numVertices;
+	const uint32_t numIndices = bin.numIndices;
+
+	Mesh* m = new Mesh();
+	m->m_positions.resize(numVertices);
+	m->m_indices.resize(numIndices);
+
+	if (bin.flags & eMeshBinQuantizePositions)
+	{
+		const uint16_t* positions = (const uint16_t*)bin.positions;
+		const Vec3 scale = (bin.upper-bin.lower)/65535.0f;
+
+		for (uint32_t i=0; i < numVertices; ++i)
+			m->m_positions[i] = Point3(DecodePosition(&positions[i*3], bin.lower, scale));
+	}
+	else if (numVertices)
+	{
+		memcpy(&m->m_positions[0], bin.positions, sizeof(Vec3)*numVertices);
+	}
+
+	if (bin.normals)
+	{
+		m->m_normals.resize(numVertices);
+
+		if (bin.flags & eMeshBinQuantizeNormals)
+		{
+			const int16_t* normals = (const int16_t*)bin.normals;
+
+			for (uint32_t i=0; i < numVertices; ++i)
+				m->m_normals[i] = DecodeNormal(&normals[i*2]);
+		}
+		else if (numVertices)
+		{
+			memcpy(&m->m_normals[0], bin.normals, sizeof(Vec3)*numVertices);
+		}
+	}
+
+	if (bin.texcoords)
+		m->m_texcoords[0].assign(bin.texcoords, bin.texcoords+numVertices);
+
+	if (bin.flags & eMeshBinIndices16)
+	{
+		const uint16_t* indices = (const uint16_t*)bin.indices;
+		std::copy(indices, indices+numIndices, m->m_indices.begin());
+	}
+	else if (numIndices)
+	{
+		memcpy(&m->m_indices[0], bin.indices, sizeof(uint32_t)*numIndices);
+	}
+
+	return m;
+}
+
+Mesh* ImportMeshFromBin(const char* path, AABBTree** outTree)
+{
+	double start = GetSeconds();
+
+	if (outTree)
+		*outTree = NULL;
+
+	Mesh* m = NULL;
+
+	MeshBin bin;
+	if (MapMeshBin(path, bin))
+	{
+		m = CreateMeshFromBin(bin);
+
+		if (outTree && bin.nodes)
+		{
+			*outTree = new AABBTree((const Vec3*)&m->m_positions[0], m->GetNumVertices(), &m->m_indices[0], m->GetNumFaces(), 
+									bin.nodes, bin.numNodes, bin.faceOrder);
+		}
+
+		UnmapMeshBin(bin);
+	}
+	else
+	{
+		m = ImportMeshFromLegacyBin(path);
+	}
+
+	if (m)
+	{
 		double end = GetSeconds();
 
 		printf("Imported mesh %s in %f ms\n", path, (end-start)*1000.0f);
-
-		return m;
 	}
 
-	return NULL;
+	return m;
 }
 
-void ExportMeshToBin(const char* path, const Mesh* m)
+void ExportMeshToBin(const char* path, const Mesh* m, int flags)
 {
 	FILE* f = fopen(path, "wb");
 
 	if (f)
 	{
-		int numVertices = int(m->m_positions.size());
-		int numIndices = int(m->m_indices.size());
+		const uint32_t numVertices = m->GetNumVertices();
+		const uint32_t numIndices = uint32_t(m->m_indices.size());
+
+		// drop options that don't apply
+		if (numVertices > 65536)
+			flags &= ~eMeshBinIndices16;
+
+		if (m->m_normals.size() != numVertices)
+			flags &= ~eMeshBinQuantizeNormals;
+
+		if (numIndices < 3)
+			flags &= ~eMeshBinAABBTree;
+
+		MeshBinHeader header;
+		memset(&header, 0, sizeof(header));
+
+		header.magic = kMeshBinMagic;
+		header.version = kMeshBinVersion;
+		header.flags = flags;
+		header.numVertices = numVertices;
+		header.numIndices = numIndices;
+
+		Vec3 lower(0.0f), upper(0.0f);
+		if (numVertices)
+			m->GetBounds(lower, upper);
+
+		for (int c=0; c < 3; ++c)
+		{
+			header.lower[c] = lower[c];
+			header.upper[c] = upper[c];
+		}
+
+		// header is rewritten once the section offsets are known
+		fwrite(&header, sizeof(header), 1, f);
+
+		// positions, the tree is built over the decoded positions so its bounds match what is loaded
+		std::vector<Vec3> positions(m->m_positions.begin(), m->m_positions.end());
+
+		if (flags & eMeshBinQuantizePositions)
+		{
+			const Vec3 extent = upper-lower;
+			const Vec3 invExtent(extent.x > 0.0f ? 1.0f/extent.x : 0.0f, extent.y > 0.0f ? 1.0f/extent.y : 0.0f, extent.z > 0.0f ? 1.0f/extent.z : 0.0f);
+
+			std::vector<uint16_t> quantized(numVertices*3);
+
+			for (uint32_t i=0; i < numVertices; ++i)
+			{
+				const Vec3 t = (positions[i]-lower)*invExtent;
+
+				for (int c=0; c < 3; ++c)
+					quantized[i*3+c] = QuantizeUnorm16(t[c]);
+
+				positions[i] = DecodePosition(&quantized[i*3], lower, extent/65535.0f);
+			}
+
+			WriteSection(f, header, eMeshBinPositions, quantized.data(), sizeof(uint16_t)*quantized.size());
+		}
+		else
+		{
+			WriteSection(f, header, eMeshBinPositions, positions.data(), sizeof(Vec3)*numVertices);
+		}
+
+		// normals
+		if (m->m_normals.size() == numVertices)
+		{
+			if (flags & eMeshBinQuantizeNormals)
+			{
+				std::vector<int16_t> quantized(numVertices*2);
 
-		fwrite(&numVertices, sizeof(numVertices), 1, f);
-		fwrite(&numIndices, sizeof(numIndices), 1, f);
+				for (uint32_t i=0; i < numVertices; ++i)
+					EncodeNormal(m->m_normals[i], &quantized[i*2]);
+
+				WriteSection(f, header, eMeshBinNormals, quantized.data(), sizeof(int16_t)*quantized.size());
+			}
+			else
+			{
+				WriteSection(f, header, eMeshBinNormals, m->m_normals.data(), sizeof(Vec3)*numVertices);
+			}
+		}
+
+		// texcoords
+		if (m->m_texcoords[0].size() == numVertices)
+			WriteSection(f, header, eMeshBinTexcoords, m->m_texcoords[0].data(), sizeof(Vec2)*numVertices);
+
+		// indices
+		if (flags & eMeshBinIndices16)
+		{
+			std::vector<uint16_t> indices(m->m_indices.begin(), m->m_indices.end());
+			WriteSection(f, header, eMeshBinIndices, indices.data(), sizeof(uint16_t)*numIndices);
+		}
+		else
+		{
+			WriteSection(f, header, eMeshBinIndices, m->m_indices.data(), sizeof(uint32_t)*numIndices);
+		}
+
+		// tree
+		if (flags & eMeshBinAABBTree)
+		{
+			AABBTree tree(positions.data(), numVertices, m->m_indices.data(), numIndices/3);
+
+			std::vector<AABBTree::Node> nodes;
+			std::vector<uint32_t> faceOrder;
+			tree.Pack(nodes, faceOrder);
+
+			header.numNodes = uint32_t(nodes.size());
+
+			WriteSection(f, header, eMeshBinNodes, nodes.data(), sizeof(AABBTree::Node)*nodes.size());
+			WriteSection(f, header, eMeshBinFaceOrder, faceOrder.data(), sizeof(uint32_t)*faceOrder.size());
+		}
 
-		// write data blocks
-		fwrite(&m->m_positions[0], sizeof(Vec3)*numVertices, 1, f);
-		fwrite(&m->m_normals[0], sizeof(Vec3)*numVertices, 1, f);		
-		fwrite(&m->m_indices[0], sizeof(int)*numIndices, 1, f);
+		fseek(f, 0, SEEK_SET);
+		fwrite(&header, sizeof(header), 1, f);
 
 		fclose(f);
 	}
 }
 
-Mesh* ImportMeshFromPly(const char* path)
+Mesh* ImportMeshFromPly(const char* path, int numThreads)
 {
-    ifstream file(path, ios_base::in | ios_base::binary);
+	MappedFile file;
+	if (!MapFile(path, file))
+		return NULL;
 
-    if (!file)
-        return NULL;
+	const char* p = file.data;
+	const char* end = file.data + file.size;
+
+	const char* tokenEnd;
+	const char* token = NextToken(p, end, tokenEnd);
 
-    // some scratch memory
-    const uint32_t kMaxLineLength = 1024;
-    char buffer[kMaxLineLength];
+	if (!TokenEquals(token, tokenEnd, "ply"))
+	{
+		UnmapFile(file);
+		return NULL;
+	}
 
-    //double startTime = GetSeconds();
+	PlyFormat format = eAscii;
 
-    file >> buffer;
-    if (strcmp(buffer, "ply") != 0)
-        return NULL;
+	uint32_t numFaces = 0;
+	uint32_t numVertices = 0;
+	uint32_t numProperties = 0; 
 
-    PlyFormat format = eAscii;
+	bool vertexElement = false;
+	bool header = true;
 
-    uint32_t numFaces = 0;
-    uint32_t numVertices = 0;
+	p = tokenEnd;
 
-    const uint32_t kMaxProperties = 16;
-    uint32_t numProperties = 0; 
-    float properties[kMaxProperties];
+	while (header)
+	{
+		token = NextToken(p, end, tokenEnd);
+		p = tokenEnd;
 
-    bool vertexElement = false;
+		if (token == tokenEnd)
+		{
+			// no end_header
+			UnmapFile(file);
+			return NULL;
+		}
 
-    while (file)
-    {
-        file >> buffer;
-
-        if (strcmp(buffer, "element") == 0)
-        {
-            file >> buffer;
-
-            if (strcmp(buffer, "face") == 0)
-            {                
-                vertexElement = false;
-                file >> numFaces;
-            }
-
-            else if (strcmp(buffer, "vertex") == 0)
-            {
-                vertexElement = true;
-                file >> numVertices;
-            }
-        }
-        else if (strcmp(buffer, "format") == 0)
-        {
-            file >> buffer;
-            if (strcmp(buffer, "ascii") == 0)
-            {
-                format = eAscii;
-            }
-            else if (strcmp(buffer, "binary_big_endian") == 0)
-            {
-                format = eBinaryBigEndian;
-            }
+		if (TokenEquals(token, tokenEnd, "element"))
+		{
+			token = NextToken(p, end, tokenEnd);
+			p = tokenEnd;
+
+			const bool face = TokenEquals(token, tokenEnd, "face");
+			const bool vertex = TokenEquals(token, tokenEnd, "vertex");
+
+			if (face || vertex)
+			{
+				vertexElement = vertex;
+
+				token = NextToken(p, end, tokenEnd);
+				p = tokenEnd;
+
+				uint32_t count = 0;
+				ParseUInt(token, tokenEnd, count);
+
+				if (face)
+					numFaces = count;
+				else
+					numVertices = count;
+			}
+		}
+		else if (TokenEquals(token, tokenEnd, "format"))
+		{
+			token = NextToken(p, end, tokenEnd);
+			p = tokenEnd;
+
+			if (TokenEquals(token, tokenEnd, "ascii"))
+			{
+				format = eAscii;
+			}
+			else if (TokenEquals(token, tokenEnd, "binary_big_endian"))
+			{
+				format = eBinaryBigEndian;
+			}
 			else
 			{
 				printf("Ply: unknown format\n");
+
+				UnmapFile(file);
 				return NULL;
 			}
-        }
-        else if (strcmp(buffer, "property") == 0)
-        {
-            if (vertexElement)
-                ++numProperties;
-        }
-        else if (strcmp(buffer, "end_header") == 0)
-        {
-            break;
-        }
-    }
+		}
+		else if (TokenEquals(token, tokenEnd, "property"))
+		{
+			if (vertexElement)
+				++numProperties;
+		}
+		else if (TokenEquals(token, tokenEnd, "end_header"))
+		{
+			header = false;
+		}
+	}
 
-    // eat newline
-    char nl;
-    file.read(&nl, 1);
+	// eat newline
+	p = Min(p+1, end);
 	
 	// debug
 #if ENABLE_VERBOSE_OUTPUT
 	printf ("Loaded mesh: %s numFaces: %d numVertices: %d format: %d numProperties: %d\n", path, numFaces, numVertices, format, numProperties);
 #endif
 
-    Mesh* mesh = new Mesh;
+	if (numProperties < 3)
+	{
+		printf("Ply: vertices need at least 3 properties\n");
 
-    mesh->m_positions.resize(numVertices);
-    mesh->m_normals.resize(numVertices);
-    mesh->m_colours.resize(numVertices, Colour(1.0f, 1.0f, 1.0f, 1.0f));
+		UnmapFile(file);
+		return NULL;
+	}
 
-    mesh->m_indices.reserve(numFaces*3);
+	// faces are parsed to fixed size records first, then assembled in order
+	std::vector<uint32_t> faceIndices(numFaces*4);
+	std::vector<uint8_t> faceCounts(numFaces);
 
-    // read vertices
-    for (uint32_t v=0; v < numVertices; ++v)
-    {
-        for (uint32_t i=0; i < numProperties; ++i)
-        {
-            properties[i] = PlyRead<float>(file, format);
-        }
+	Mesh* mesh = new Mesh;
 
-        mesh->m_positions[v] = Point3(properties[0], properties[1], properties[2]);
-        mesh->m_normals[v] = Vector3(0.0f, 0.0f, 0.0f);
-    }
+	mesh->m_positions.resize(numVertices);
+	mesh->m_normals.resize(numVertices);
+	mesh->m_colours.resize(numVertices, Colour(1.0f, 1.0f, 1.0f, 1.0f));
 
-    // read indices
-    for (uint32_t f=0; f < numFaces; ++f)
-    {
-        uint32_t numIndices = (format == eAscii)?PlyRead<uint32_t>(file, format):PlyRead<uint8_t>(file, format);
-		uint32_t indices[4];
+	bool valid = true;
 
-		for (uint32_t i=0; i < numIndices; ++i)
+	if (format == eAscii)
+	{
+		// find the start of each vertex and face line, so lines can be parsed independently
+		std::vector<const char*> lines(numVertices + numFaces);
+
+		for (size_t i=0; i < lines.size(); ++i)
 		{
-			indices[i] = PlyRead<uint32_t>(file, format);
+			if (p == end)
+			{
+				valid = false;
+				lines.resize(i);
+				break;
+			}
+
+			lines[i] = p;
+			p = SkipLine(p, end);
 		}
 
-		switch (numIndices)
+		if (valid)
 		{
-		case 3:
-			mesh->m_indices.push_back(indices[0]);
-			mesh->m_indices.push_back(indices[1]);
-			mesh->m_indices.push_back(indices[2]);
-			break;
-		case 4:
-			mesh->m_indices.push_back(indices[0]);
-			mesh->m_indices.push_back(indices[1]);
-			mesh->m_indices.push_back(indices[2]);
+			GetDefaultThreadPool().ParallelFor(0, int(numVertices), [&](int begin, int endVertex)
+			{
+				for (int v=begin; v < endVertex; ++v)
+				{
+					const char* s = lines[v];
 
-			mesh->m_indices.push_back(indices[2]);
-			mesh->m_indices.push_back(indices[3]);
-			mesh->m_indices.push_back(indices[0]);
-			break;
+					// other properties (normals, colors, etc) are skipped 
+					float x = 0.0f, y = 0.0f, z = 0.0f;
+					ParseFloat(s, end, x);
+					ParseFloat(s, end, y);
+					ParseFloat(s, end, z);
 
-		default:
-			assert(!"invalid number of indices, only support tris and quads");
-			break;
-		};
+					mesh->m_positions[v] = Point3(x, y, z);
+				}
 
-		// calculate vertex normals as we go
-        Point3& v0 = mesh->m_positions[indices[0]];
-        Point3& v1 = mesh->m_positions[indices[1]];
-        Point3& v2 = mesh->m_positions[indices[2]];
+			}, numThreads, kMinParseLines);
 
-        Vector3 n = SafeNormalize(Cross(v1-v0, v2-v0), Vector3(0.0f, 1.0f, 0.0f));
+			GetDefaultThreadPool().ParallelFor(0, int(numFaces), [&](int begin, int endFace)
+			{
+				for (int f=begin; f < endFace; ++f)
+				{
+					const char* s = SkipBlanks(lines[numVertices + f], end);
 
-		for (uint32_t i=0; i < numIndices; ++i)
+					uint32_t count = 0;
+					ParseUInt(s, end, count);
+
+					// anything other than tris and quads is rejected during assembly
+					faceCounts[f] = uint8_t(Min(count, 255u));
+
+					for (uint32_t i=0; i < count && i < 4; ++i)
+					{
+						s = SkipBlanks(s, end);
+						ParseUInt(s, end, faceIndices[f*4+i]);
+					}
+				}
+
+			}, numThreads, kMinParseLines);
+		}
+	}
+	else
+	{
+		// vertices are fixed size records of float properties
+		const size_t vertexStride = numProperties*sizeof(float);
+
+		if (size_t(end-p) < vertexStride*numVertices)
+		{
+			valid = false;
+		}
+		else
 		{
-	        mesh->m_normals[indices[i]] += n;
-	    }
+			const char* vertices = p;
+
+			GetDefaultThreadPool().ParallelFor(0, int(numVertices), [&](int begin, int endVertex)
+			{
+				for (int v=begin; v < endVertex; ++v)
+				{
+					const char* s = vertices + v*vertexStride;
+					mesh->m_positions[v] = Point3(ReadBigEndianFloat(s), ReadBigEndianFloat(s+4), ReadBigEndianFloat(s+8));
+				}
+
+			}, numThreads, kMinParseLines);
+
+			p += vertexStride*numVertices;
+
+			// faces are variable length (uchar count followed by int indices) so are read serially
+			for (uint32_t f=0; f < numFaces && valid; ++f)
+			{
+				if (p == end)
+				{
+					valid = false;
+					break;
+				}
+
+				const uint32_t count = uint8_t(*p++);
+
+				if (size_t(end-p) < count*sizeof(uint32_t))
+				{
+					valid = false;
+					break;
+				}
+
+				faceCounts[f] = uint8_t(count);
+
+				for (uint32_t i=0; i < count && i < 4; ++i)
+					faceIndices[f*4+i] = ReadBigEndianUInt(p + i*sizeof(uint32_t));
+
+				p += count*sizeof(uint32_t);
+			}
+		}
 	}
 
-    for (uint32_t i=0; i < numVertices; ++i)
-    {
-        mesh->m_normals[i] = SafeNormalize(mesh->m_normals[i], Vector3(0.0f, 1.0f, 0.0f));
-    }
+	if (!valid)
+	{
+		printf("Ply: unexpected end of file\n");
 
-    //cout << "Imported mesh " << path << " in " << (GetSeconds()-startTime)*1000.f << "ms" << endl;
+		delete mesh;
+		UnmapFile(file);
+		return NULL;
+	}
 
-    return mesh;
+	UnmapFile(file);
 
-}
+	// only tris and quads with valid indices are kept
+	uint32_t numTriangles = 0;
+	uint32_t numInvalid = 0;
 
-// map of Material name to Material
-struct VertexKey
-{
-	VertexKey() :  v(0), vt(0), vn(0) {}
-	
-	uint32_t v, vt, vn;
-	
-	bool operator == (const VertexKey& rhs) const
+	for (uint32_t f=0; f < numFaces; ++f)
 	{
-		return v == rhs.v && vt == rhs.vt && vn == rhs.vn;
+		const uint32_t numIndices = faceCounts[f];
+
+		bool faceValid = numIndices == 3 || numIndices == 4;
+		for (uint32_t i=0; i < numIndices && faceValid; ++i)
+			faceValid = faceIndices[f*4+i] < numVertices;
+
+		if (faceValid)
+		{
+			numTriangles += numIndices-2;
+		}
+		else
+		{
+			faceCounts[f] = 0;
+			++numInvalid;
+		}
 	}
+
+	if (numInvalid)
+		printf("Ply: skipped %d faces, only tris and quads with valid indices are supported\n", numInvalid);
+
+	mesh->m_indices.resize(numTriangles*3);
 	
-	bool operator < (const VertexKey& rhs) const
+	uint32_t* indices = numTriangles ? &mesh->m_indices[0] : NULL;
+
+	// assemble indices and accumulate normals in file order
+	for (uint32_t f=0; f < numFaces; ++f)
 	{
-		if (v != rhs.v)
-			return v < rhs.v;
-		else if (vt != rhs.vt)
-			return vt < rhs.vt;
-		else
-			return vn < rhs.vn;
+		const uint32_t numIndices = faceCounts[f];
+		const uint32_t* face = &faceIndices[f*4];
+
+		if (numIndices == 0)
+			continue;
+
+		*indices++ = face[0];
+		*indices++ = face[1];
+		*indices++ = face[2];
+
+		if (numIndices == 4)
+		{
+			*indices++ = face[2];
+			*indices++ = face[3];
+			*indices++ = face[0];
+		}
+
+		// calculate vertex normals as we go
+		const Point3& v0 = mesh->m_positions[face[0]];
+		const Point3& v1 = mesh->m_positions[face[1]];
+		const Point3& v2 = mesh->m_positions[face[2]];
+
+		const Vector3 n = SafeNormalize(Cross(v1-v0, v2-v0), Vector3(0.0f, 1.0f, 0.0f));
+
+		for (uint32_t i=0; i < numIndices; ++i)
+			mesh->m_normals[face[i]] += n;
+	}
+
+	for (uint32_t i=0; i < numVertices; ++i)
+	{
+		mesh->m_normals[i] = SafeNormalize(mesh->m_normals[i], Vector3(0.0f, 1.0f, 0.0f));
 	}
-};
 
-Mesh* ImportMeshFromObj(const char* path)
+	return mesh;
+}
+
+namespace
 {
-    ifstream file(path);
+	// face corner, indices are 1-based with 0 meaning not present
+	struct VertexKey
+	{
+		VertexKey() :  v(0), vt(0), vn(0) {}
+		
+		uint32_t v, vt, vn;
+	};
 
-    if (!file)
-        return NULL;
+	enum ObjLineType
+	{
+		eObjPosition,
+		eObjNormal,
+		eObjTexcoord,
+		eObjFace,
+		eObjOther
+	};
 
-    Mesh* m = new Mesh();
+	// classifies a line from its first token, p is advanced past the token
+	inline ObjLineType GetObjLineType(const char*& p, const char* end)
+	{
+		p = SkipBlanks(p, end);
 
-    vector<Point3> positions;
-    vector<Vector3> normals;
-    vector<Vector2> texcoords;
-    vector<Vector3> colors;
-    vector<uint32_t>& indices = m->m_indices;
+		if (p == end)
+			return eObjOther;
 
-    //typedef unordered_map<VertexKey, uint32_t, MemoryHash<VertexKey> > VertexMap;
-    typedef map<VertexKey, uint32_t> VertexMap;
-    VertexMap vertexLookup;	
+		const char* tokenEnd = p;
+		while (tokenEnd < end && !(IsBlank(*tokenEnd) || *tokenEnd == '\n'))
+			++tokenEnd;
 
-    // some scratch memory
-    const uint32_t kMaxLineLength = 1024;
-    char buffer[kMaxLineLength];
+		ObjLineType type = eObjOther;
 
-    //double startTime = GetSeconds();
+		if (TokenEquals(p, tokenEnd, "vn"))
+			type = eObjNormal;
+		else if (TokenEquals(p, tokenEnd, "vt"))
+			type = eObjTexcoord;
+		else if (*p == 'v')
+			type = eObjPosition;
+		else if (*p == 'f')
+			type = eObjFace;
 
-    while (file)
-    {
-        file >> buffer;
-	
-        if (strcmp(buffer, "vn") == 0)
-        {
-            // normals
-            float x, y, z;
-            file >> x >> y >> z;
-
-            normals.push_back(Vector3(x, y, z));
-        }
-        else if (strcmp(buffer, "vt") == 0)
-        {
-            // texture coords
-            float u, v;
-            file >> u >> v;
-
-            texcoords.push_back(Vector2(u, v));
-        }
-        else if (buffer[0] == 'v')
-        {
-            // positions
-            float x, y, z;
-            file >> x >> y >> z;
-
-            positions.push_back(Point3(x, y, z));
-        }
-        else if (buffer[0] == 's' || buffer[0] == 'g' || buffer[0] == 'o')
-        {
-            // ignore smoothing groups, groups and objects
-            char linebuf[256];
-            file.getline(linebuf, 256);		
-        }
-        else if (strcmp(buffer, "mtllib") == 0)
-        {
-            // ignored
-            std::string MaterialFile;
-            file >> MaterialFile;
-        }		
-        else if (strcmp(buffer, "usemtl") == 0)
-        {
-            // read Material name
-            std::string materialName;
-            file >> materialName;
-        }
-        else if (buffer[0] == 'f')
-        {
-            // faces
-            uint32_t faceIndices[4];
-            uint32_t faceIndexCount = 0;
-
-            for (int i=0; i < 4; ++i)
-            {
-                VertexKey key;
-
-                file >> key.v;
-
-				if (!file.eof())
+		p = tokenEnd;
+		return type;
+	}
+
+	// a range of whole lines and where its elements go in the combined arrays
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+
+		int numPositions;
+		int numNormals;
+		int numTexcoords;
+		int numFaces;
+	};
+
+} // anonymous namespace
+
+Mesh* ImportMeshFromObj(const char* path, int numThreads)
+{
+	MappedFile file;
+	if (!MapFile(path, file))
+		return NULL;
+
+	const char* data = file.data;
+	const char* end = file.data + file.size;
+
+	// split into chunks at line boundaries
+	std::vector<ObjChunk> chunks;
+
+	for (const char* p = data; p < end; )
+	{
+		ObjChunk c = {};
+		c.begin = p;
+		c.end = SkipLine(Min(p + kObjChunkSize, end-1), end);
+
+		chunks.push_back(c);
+		p = c.end;
+	}
+
+	const int numChunks = int(chunks.size());
+
+	// pass 1, count elements in each chunk
+	GetDefaultThreadPool().ParallelFor(0, numChunks, [&](int begin, int endChunk)
+	{
+		for (int i=begin; i < endChunk; ++i)
+		{
+			ObjChunk& c = chunks[i];
+
+			for (const char* p = c.begin; p < c.end; p = SkipLine(p, c.end))
+			{
+				const char* s = p;
+
+				switch (GetObjLineType(s, c.end))
 				{
-					// failed to read another index continue on
-					if (file.fail())
+				case eObjPosition: ++c.numPositions; break;
+				case eObjNormal: ++c.numNormals; break;
+				case eObjTexcoord: ++c.numTexcoords; break;
+				case eObjFace: ++c.numFaces; break;
+				default: break;
+				}
+			}
+		}
+
+	}, numThreads, 1);
+
+	// exclusive prefix sums give each chunk's output offsets
+	int numPositions = 0;
+	int numNormals = 0;
+	int numTexcoords = 0;
+	int numFaces = 0;
+
+	for (int i=0; i < numChunks; ++i)
+	{
+		ObjChunk& c = chunks[i];
+
+		std::swap(numPositions, c.numPositions);
+		std::swap(numNormals, c.numNormals);
+		std::swap(numTexcoords, c.numTexcoords);
+		std::swap(numFaces, c.numFaces);
+
+		numPositions += c.numPositions;
+		numNormals += c.numNormals;
+		numTexcoords += c.numTexcoords;
+		numFaces += c.numFaces;
+	}
+
+	vector<Point3> positions(numPositions);
+	vector<Vector3> normals(numNormals);
+	vector<Vector2> texcoords(numTexcoords);
+
+	// up to 4 corners per-face, faces with more are counted as 5 and skipped
+	vector<VertexKey> faceKeys(numFaces*4);
+	vector<uint8_t> faceCounts(numFaces);
+
+	// pass 2, parse each chunk into its range of the preallocated arrays
+	GetDefaultThreadPool().ParallelFor(0, numChunks, [&](int begin, int endChunk)
+	{
+		for (int i=begin; i < endChunk; ++i)
+		{
+			ObjChunk& c = chunks[i];
+
+			int positionIndex = c.numPositions;
+			int normalIndex = c.numNormals;
+			int texcoordIndex = c.numTexcoords;
+			int faceIndex = c.numFaces;
+
+			for (const char* p = c.begin; p < c.end; p = SkipLine(p, c.end))
+			{
+				const char* s = p;
+
+				switch (GetObjLineType(s, c.end))
+				{
+					case eObjPosition:
 					{
-						file.clear();
+						float x = 0.0f, y = 0.0f, z = 0.0f;
+						ParseFloat(s, c.end, x);
+						ParseFloat(s, c.end, y);
+						ParseFloat(s, c.end, z);
+
+						positions[positionIndex++] = Point3(x, y, z);
 						break;
 					}
+					case eObjNormal:
+					{
+						float x = 0.0f, y = 0.0f, z = 0.0f;
+						ParseFloat(s, c.end, x);
+						ParseFloat(s, c.end, y);
+						ParseFloat(s, c.end, z);
 
-					if (file.peek() == '/')
+						normals[normalIndex++] = Vector3(x, y, z);
+						break;
+					}
+					case eObjTexcoord:
 					{
-						file.ignore();
+						float u = 0.0f, v = 0.0f;
+						ParseFloat(s, c.end, u);
+						ParseFloat(s, c.end, v);
 
-						if (file.peek() != '/')
+						texcoords[texcoordIndex++] = Vector2(u, v);
+						break;
+					}
+					case eObjFace:
+					{
+						// corners are v, v/vt, v//vn or v/vt/vn
+						VertexKey* keys = &faceKeys[faceIndex*4];
+						int count = 0;
+
+						for (; count < 4; ++count)
 						{
-							file >> key.vt;
+							s = SkipBlanks(s, c.end);
+
+							VertexKey& key = keys[count];
+
+							if (!ParseUInt(s, c.end, key.v))
+								break;
+
+							if (s < c.end && *s == '/')
+							{
+								++s;
+
+								if (s < c.end && *s != '/')
+									ParseUInt(s, c.end, key.vt);
+
+								if (s < c.end && *s == '/')
+								{
+									++s;
+									ParseUInt(s, c.end, key.vn);
+								}
+							}
 						}
 
-						if (file.peek() == '/')
+						// polygons are not triangulated, mark them so they are reported
+						if (count == 4)
 						{
-							file.ignore();
-							file >> key.vn;
+							s = SkipBlanks(s, c.end);
+
+							if (s < c.end && *s >= '0' && *s <= '9')
+								count = 5;
 						}
+
+						faceCounts[faceIndex++] = uint8_t(count);
+						break;
 					}
+					default:
+						break;
+				};
+			}
+		}
 
-					// find / add vertex, index
-					VertexMap::iterator iter = vertexLookup.find(key);
+	}, numThreads, 1);
 
-					if (iter != vertexLookup.end())
-					{
-						faceIndices[faceIndexCount++] = iter->second;
-					}
-					else
-					{
-						// add vertex
-						uint32_t newIndex = uint32_t(m->m_positions.size());
-						faceIndices[faceIndexCount++] = newIndex;
+	UnmapFile(file);
 
-						vertexLookup.insert(make_pair(key, newIndex)); 	
+	Mesh* m = new Mesh();
 
-						// push back vertex data
-						assert(key.v > 0);
+	// de-duplicate corners in file order, vertices are chained per-position so the common 
+	// case of one vertex per-position is a single comparison
+	const uint32_t kInvalid = uint32_t(-1);
 
-						m->m_positions.push_back(positions[key.v-1]);
-						
-						// obj format doesn't support mesh colours so add default value
-						m->m_colours.push_back(Colour(1.0f, 1.0f, 1.0f));
+	vector<uint32_t> firstVertex(numPositions, kInvalid);
+	vector<uint32_t> nextVertex;
+	vector<VertexKey> vertexKeys;
 
-						// normal [optional]
-						if (key.vn)
-						{
-							m->m_normals.push_back(normals[key.vn-1]);
-						}
+	nextVertex.reserve(numPositions);
+	vertexKeys.reserve(numPositions);
 
-						// texcoord [optional]
-						if (key.vt)
-						{
-							m->m_texcoords[0].push_back(texcoords[key.vt-1]);
-						}
-					}
-				}
-            }
-
-            if (faceIndexCount == 3)
-            {
-                // a triangle
-                indices.insert(indices.end(), faceIndices, faceIndices+3);
-            }
-            else if (faceIndexCount == 4)
-            {
-                // a quad, triangulate clockwise
-                indices.insert(indices.end(), faceIndices, faceIndices+3);
-
-                indices.push_back(faceIndices[2]);
-                indices.push_back(faceIndices[3]);
-                indices.push_back(faceIndices[0]);
-            }
-            else
-            {
-                cout << "Face with more than 4 vertices are not supported" << endl;
-            }
-
-        }		
-        else if (buffer[0] == '#')
-        {
-            // comment
-            char linebuf[256];
-            file.getline(linebuf, 256);
-        }
-    }
+	vector<uint32_t>& indices = m->m_indices;
+	indices.reserve(numFaces*3);
 
-    // calculate normals if none specified in file
-    m->m_normals.resize(m->m_positions.size());
+	int numInvalid = 0;
+	int numPolygons = 0;
 
-    const uint32_t numFaces = uint32_t(indices.size())/3;
-    for (uint32_t i=0; i < numFaces; ++i)
-    {
-        uint32_t a = indices[i*3+0];
-        uint32_t b = indices[i*3+1];
-        uint32_t c = indices[i*3+2];
+	for (int f=0; f < numFaces; ++f)
+	{
+		const int count = faceCounts[f];
+		const VertexKey* keys = &faceKeys[f*4];
 
-        Point3& v0 = m->m_positions[a];
-        Point3& v1 = m->m_positions[b];
-        Point3& v2 = m->m_positions[c];
+		if (count > 4)
+		{
+			++numPolygons;
+			continue;
+		}
 
-        Vector3 n = SafeNormalize(Cross(v1-v0, v2-v0), Vector3(0.0f, 1.0f, 0.0f));
+		bool valid = count >= 3;
 
-        m->m_normals[a] += n;
-        m->m_normals[b] += n;
-        m->m_normals[c] += n;
-    }
+		for (int i=0; i < count && valid; ++i)
+		{
+			valid = keys[i].v > 0 && keys[i].v <= uint32_t(numPositions) &&
+					keys[i].vt <= uint32_t(numTexcoords) &&
+					keys[i].vn <= uint32_t(numNormals);
+		}
 
-    for (uint32_t i=0; i < m->m_normals.size(); ++i)
-    {
-        m->m_normals[i] = SafeNormalize(m->m_normals[i], Vector3(0.0f, 1.0f, 0.0f));
-    }
-        
-    //cout << "Imported mesh " << path << " in " << (GetSeconds()-startTime)*1000.f << "ms" << endl;
+		if (!valid)
+		{
+			++numInvalid;
+			continue;
+		}
 
-    return m;
+		uint32_t faceIndices[4];
+
+		for (int i=0; i < count; ++i)
+		{
+			const VertexKey& key = keys[i];
+
+			// find / add vertex, index
+			uint32_t index = firstVertex[key.v-1];
+
+			while (index != kInvalid && (vertexKeys[index].vt != key.vt || vertexKeys[index].vn != key.vn))
+				index = nextVertex[index];
+
+			if (index == kInvalid)
+			{
+				index = uint32_t(vertexKeys.size());
+
+				vertexKeys.push_back(key);
+				nextVertex.push_back(firstVertex[key.v-1]);
+
+				firstVertex[key.v-1] = index;
+			}
+
+			faceIndices[i] = index;
+		}
+
+		// a triangle
+		indices.insert(indices.end(), faceIndices, faceIndices+3);
+
+		if (count == 4)
+		{
+			// a quad, triangulate clockwise
+			indices.push_back(faceIndices[2]);
+			indices.push_back(faceIndices[3]);
+			indices.push_back(faceIndices[0]);
+		}
+	}
+
+	if (numInvalid)
+		cout << "Skipped " << numInvalid << " faces with fewer than 3 vertices or invalid indices" << endl;
+
+	if (numPolygons)
+		cout << "Skipped " << numPolygons << " faces with more than 4 vertices, these are not supported" << endl;
+
+	// fill vertex data, normals and texcoords are only added for vertices that specify them
+	const uint32_t numVertices = uint32_t(vertexKeys.size());
+
+	m->m_positions.resize(numVertices);
+	
+	// obj format doesn't support mesh colours so add default value
+	m->m_colours.resize(numVertices, Colour(1.0f, 1.0f, 1.0f));
+
+	m->m_normals.reserve(numVertices);
+	m->m_texcoords[0].reserve(numVertices);
+
+	for (uint32_t i=0; i < numVertices; ++i)
+	{
+		const VertexKey& key = vertexKeys[i];
+
+		m->m_positions[i] = positions[key.v-1];
+
+		// normal [optional]
+		if (key.vn)
+			m->m_normals.push_back(normals[key.vn-1]);
+
+		// texcoord [optional]
+		if (key.vt)
+			m->m_texcoords[0].push_back(texcoords[key.vt-1]);
+	}
+
+	// calculate normals if none specified in file
+	m->m_normals.resize(numVertices);
+
+	const uint32_t numTris = uint32_t(indices.size())/3;
+	for (uint32_t i=0; i < numTris; ++i)
+	{
+		uint32_t a = indices[i*3+0];
+		uint32_t b = indices[i*3+1];
+		uint32_t c = indices[i*3+2];
+
+		Point3& v0 = m->m_positions[a];
+		Point3& v1 = m->m_positions[b];
+		Point3& v2 = m->m_positions[c];
+
+		Vector3 n = SafeNormalize(Cross(v1-v0, v2-v0), Vector3(0.0f, 1.0f, 0.0f));
+
+		m->m_normals[a] += n;
+		m->m_normals[b] += n;
+		m->m_normals[c] += n;
+	}
+
+	for (uint32_t i=0; i < m->m_normals.size(); ++i)
+	{
+		m->m_normals[i] = SafeNormalize(m->m_normals[i], Vector3(0.0f, 1.0f, 0.0f));
+	}
+
+	return m;
 }
 
 void ExportToObj(const char* path, const Mesh& m)
@@ -31,6 +31,8 @@
 
 #include "core.h"
 #include "maths.h"
+#include "platform.h"
+#include "aabbtree.h"
 
 struct Mesh
 {
@@ -55,16 +57,62 @@ struct Mesh
     std::vector<uint32_t> m_indices;    
 };
 
-// create mesh from file
-Mesh* ImportMeshFromObj(const char* path);
-Mesh* ImportMeshFromPly(const char* path);
-Mesh* ImportMeshFromBin(const char* path);
+// create mesh from file, obj and ply files are memory mapped and parsed in place, 
+// numThreads is passed to the default thread pool (0 = all threads, 1 = calling thread only)
+Mesh* ImportMeshFromObj(const char* path, int numThreads=1);
+Mesh* ImportMeshFromPly(const char* path, int numThreads=1);
+
+// loads a binary mesh written by ExportMeshToBin(), files written before the format was versioned are also 
+// accepted. If outTree is non-NULL it receives the tree stored in the file (or NULL if there isn't one), 
+// the tree references the returned mesh's positions and indices so must be deleted first
+Mesh* ImportMeshFromBin(const char* path, AABBTree** outTree=NULL);
 
 // just switches on filename
-Mesh* ImportMesh(const char* path);
+Mesh* ImportMesh(const char* path, int numThreads=1);
+
+// options for ExportMeshToBin(), flags that don't apply to a mesh are dropped
+enum MeshBinFlags
+{
+	eMeshBinIndices16			= 1<<0,		// 16 bit indices when the mesh has at most 65536 vertices
+	eMeshBinQuantizePositions	= 1<<1,		// 16 bit positions relative to the mesh bounds (lossy)
+	eMeshBinQuantizeNormals		= 1<<2,		// 16 bit octahedral normals (lossy)
+	eMeshBinAABBTree			= 1<<3,		// store an AABB tree over the faces
+
+	eMeshBinDefault = eMeshBinIndices16 | eMeshBinAABBTree
+};
+
+// save a mesh in a versioned binary format, each section is 16 byte aligned so it can be used in place once mapped, 
+// positions, normals, the first texcoord set and indices are stored along with the mesh bounds
+void ExportMeshToBin(const char* path, const Mesh* m, int flags=eMeshBinDefault);
+
+// a binary mesh mapped into memory, the section pointers point into the file and are valid until UnmapMeshBin(), 
+// only the header and section layout are checked when mapping, the contents are trusted
+struct MeshBin
+{
+	int flags;					// MeshBinFlags that were applied when the file was written
+	uint32_t numVertices;
+	uint32_t numIndices;
+	uint32_t numNodes;
+
+	Vec3 lower;
+	Vec3 upper;
+
+	const void* positions;		// Vec3, or uint16_t[3] with eMeshBinQuantizePositions
+	const void* normals;		// Vec3, or int16_t[2] with eMeshBinQuantizeNormals, NULL if the mesh had none
+	const Vec2* texcoords;		// NULL if the mesh had none
+	const void* indices;		// uint32_t, or uint16_t with eMeshBinIndices16
+
+	const AABBTree::Node* nodes;	// NULL without eMeshBinAABBTree
+	const uint32_t* faceOrder;
+
+	MappedFile file;
+};
+
+bool MapMeshBin(const char* path, MeshBin& bin);
+void UnmapMeshBin(MeshBin& bin);
 
-// save a mesh in a flat binary format
-void ExportMeshToBin(const char* path, const Mesh* m);
+// copy a mapped binary mesh into a new mesh, expanding any quantized data
+Mesh* CreateMeshFromBin(const MeshBin& bin);
 
 // create procedural primitives
 Mesh* CreateTriMesh(float size, float y=0.0f);
@@ -0,0 +1,257 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+// returns the number of worker threads to use for parallel loops (at least 1)
+inline int GetNumHardwareThreads()
+{
+	const int n = int(std::thread::hardware_concurrency());
+	return n > 0 ? n : 1;
+}
+
+// splits the range [begin, end) into contiguous chunks and calls func(chunkBegin, chunkEnd) once per-chunk,
+// chunks are processed by up to numThreads threads (0 = one per hardware thread), the calling thread 
+// takes part in the work and the function returns once all chunks have completed. Ranges smaller than 
+// minChunk are processed serially on the calling thread.
+template <typename Func>
+void ParallelFor(int begin, int end, Func func, int numThreads=0, int minChunk=1)
+{
+	const int count = end-begin;
+	if (count <= 0)
+		return;
+
+	if (numThreads <= 0)
+		numThreads = GetNumHardwareThreads();
+
+	numThreads = std::min(numThreads, (count + minChunk - 1)/std::max(minChunk, 1));
+
+	if (numThreads <= 1)
+	{
+		func(begin, end);
+		return;
+	}
+
+	const int chunkSize = (count + numThreads - 1)/numThreads;
+
+	std::vector<std::thread> workers;
+	workers.reserve(numThreads-1);
+
+	// first chunk is processed by the calling thread
+	for (int t=1; t < numThreads; ++t)
+	{
+		const int chunkBegin = begin + t*chunkSize;
+		const int chunkEnd = std::min(chunkBegin + chunkSize, end);
+
+		if (chunkBegin < chunkEnd)
+			workers.push_back(std::thread(func, chunkBegin, chunkEnd));
+	}
+
+	func(begin, std::min(begin + chunkSize, end));
+
+	for (size_t t=0; t < workers.size(); ++t)
+		workers[t].join();
+}
+
+// persistent set of worker threads that execute submitted tasks in FIFO order, avoids the cost of 
+// creating threads for each parallel loop when many small loops are run back to back (e.g.: cooking
+// many assets at level load)
+class ThreadPool
+{
+public:
+
+	// creates numThreads-1 workers (0 = one per hardware thread), the thread calling ParallelFor() is the remaining thread
+	explicit ThreadPool(int numThreads=0) : mQuit(false)
+	{
+		if (numThreads <= 0)
+			numThreads = GetNumHardwareThreads();
+
+		for (int i=1; i < numThreads; ++i)
+			mWorkers.push_back(std::thread(&ThreadPool::WorkerMain, this));
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQuit = true;
+		}
+
+		mWake.notify_all();
+
+		for (size_t i=0; i < mWorkers.size(); ++i)
+			mWorkers[i].join();
+	}
+
+	// number of threads taking part in a ParallelFor(), including the caller
+	int GetNumThreads() const { return int(mWorkers.size()) + 1; }
+
+	// queues a task for execution on a worker, tasks still queued when the pool is destroyed are executed before the workers exit
+	void Submit(const std::function<void()>& task)
+	{
+		if (mWorkers.empty())
+		{
+			task();
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mTasks.push_back(task);
+		}
+
+		mWake.notify_one();
+	}
+
+	// same contract as the free ParallelFor(), numThreads is clamped to the size of the pool. The range is split
+	// into numThreads*4 chunks that the caller and the workers claim until none remain, the caller does not wait 
+	// for workers that are busy with other tasks, so it is safe to call from inside a task running on the pool.
+	template <typename Func>
+	void ParallelFor(int begin, int end, Func func, int numThreads=0, int minChunk=1)
+	{
+		const int count = end-begin;
+		if (count <= 0)
+			return;
+
+		if (numThreads <= 0 || numThreads > GetNumThreads())
+			numThreads = GetNumThreads();
+
+		const int maxChunks = (count + minChunk - 1)/std::max(minChunk, 1);
+		const int numChunks = std::min(numThreads*4, maxChunks);
+
+		if (numThreads <= 1 || numChunks <= 1)
+		{
+			func(begin, end);
+			return;
+		}
+
+		// state is shared with helper tasks that may only start running after the loop has completed
+		struct Loop
+		{
+			std::function<void(int, int)> func;
+			int begin;
+			int end;
+			int chunkSize;
+			int numChunks;
+
+			std::atomic<int> nextChunk;
+			std::atomic<int> chunksDone;
+
+			std::mutex mutex;
+			std::condition_variable done;
+
+			void Run()
+			{
+				for (;;)
+				{
+					const int c = nextChunk++;
+					if (c >= numChunks)
+						return;
+
+					const int chunkBegin = begin + c*chunkSize;
+					func(chunkBegin, std::min(chunkBegin + chunkSize, end));
+
+					if (++chunksDone == numChunks)
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						done.notify_all();
+					}
+				}
+			}
+		};
+
+		std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+		loop->func = func;
+		loop->begin = begin;
+		loop->end = end;
+		loop->chunkSize = (count + numChunks - 1)/numChunks;
+		loop->numChunks = (count + loop->chunkSize - 1)/loop->chunkSize;
+		loop->nextChunk = 0;
+		loop->chunksDone = 0;
+
+		for (int t=1; t < numThreads; ++t)
+			Submit([loop]() { loop->Run(); });
+
+		loop->Run();
+
+		std::unique_lock<std::mutex> lock(loop->mutex);
+		while (loop->chunksDone < loop->numChunks)
+			loop->done.wait(lock);
+
+		// release the caller's reference to func while its captures are still valid
+		loop->func = nullptr;
+	}
+
+private:
+
+	void WorkerMain()
+	{
+		for (;;)
+		{
+			std::function<void()> task;
+
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+
+				while (!mQuit && mTasks.empty())
+					mWake.wait(lock);
+
+				if (mTasks.empty())
+					return;
+
+				task = mTasks.front();
+				mTasks.pop_front();
+			}
+
+			task();
+		}
+	}
+
+	std::vector<std::thread> mWorkers;
+	std::deque<std::function<void()> > mTasks;
+
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	bool mQuit;
+};
+
+// process wide pool shared by the asset cooking functions, created on first use
+inline ThreadPool& GetDefaultThreadPool()
+{
+	static ThreadPool pool;
+	return pool;
+}
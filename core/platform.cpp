@@ -128,45 +128,98 @@ void Sleep(double seconds)
 //	return b == TRUE;
 //}
 //
-//bool FileScan(const char* pattern, vector<string>& files)
-//{
-//	HANDLE          h;
-//	WIN32_FIND_DATA info;
-//
-//	// build a list of files
-//	h = FindFirstFile(pattern, &info);
-//
-//	if (h != INVALID_HANDLE_VALUE)
-//	{
-//		do
-//		{
-//			if (!(strcmp(info.cFileName, ".") == 0 || strcmp(info.cFileName, "..") == 0))
-//			{
-//				files.push_back(info.cFileName);
-//			}
-//		} 
-//		while (FindNextFile(h, &info));
-//
-//		if (GetLastError() != ERROR_NO_MORE_FILES)
-//		{
-//			return false;
-//		}
-//
-//		FindClose(h);
-//	}
-//	else
-//	{
-//		return false;
-//	}
-//
-//	return true;
-//}
+bool FileScan(const char* pattern, vector<string>& files)
+{
+	HANDLE          h;
+	WIN32_FIND_DATAA info;
+
+	// build a list of files
+	h = FindFirstFileA(pattern, &info);
+
+	if (h != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if (!(strcmp(info.cFileName, ".") == 0 || strcmp(info.cFileName, "..") == 0))
+			{
+				files.push_back(info.cFileName);
+			}
+		} 
+		while (FindNextFileA(h, &info));
+
+		if (GetLastError() != ERROR_NO_MORE_FILES)
+		{
+			FindClose(h);
+			return false;
+		}
+
+		FindClose(h);
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool MapFile(const char* filename, MappedFile& file)
+{
+	HANDLE h = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(h, &size);
+
+	file.size = size_t(size.QuadPart);
+	file.data = "";
+	file.handle = NULL;
+
+	// empty files can't be mapped, but are still valid
+	if (file.size)
+	{
+		HANDLE mapping = CreateFileMappingA(h, NULL, PAGE_READONLY, 0, 0, NULL);
+		
+		if (mapping)
+		{
+			file.data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+
+		if (!file.data)
+		{
+			CloseHandle(h);
+			return false;
+		}
+	}
+
+	// the view keeps the mapping alive, so only the file handle needs to be kept
+	file.handle = h;
+	return true;
+}
+
+void UnmapFile(MappedFile& file)
+{
+	if (file.size)
+		UnmapViewOfFile(file.data);
+
+	if (file.handle)
+		CloseHandle(file.handle);
+
+	file = MappedFile();
+}
 
 
 #else
 
 // linux, mac platforms
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glob.h>
 
 double GetSeconds()
 {
@@ -188,6 +241,70 @@ double GetSeconds()
 	return time;
 }
 
+bool FileScan(const char* pattern, vector<string>& files)
+{
+	glob_t g;
+
+	if (glob(pattern, 0, NULL, &g) != 0)
+		return false;
+
+	// return names only to match the Windows version
+	for (size_t i=0; i < g.gl_pathc; ++i)
+		files.push_back(StripPath(g.gl_pathv[i]));
+
+	globfree(&g);
+
+	return true;
+}
+
+bool MapFile(const char* filename, MappedFile& file)
+{
+	const int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat s;
+	if (fstat(fd, &s) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	file.size = size_t(s.st_size);
+	file.data = "";
+	file.handle = NULL;
+
+	// empty files can't be mapped, but are still valid
+	if (file.size)
+	{
+		void* p = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (p == MAP_FAILED)
+		{
+			close(fd);
+			return false;
+		}
+
+		// callers parse the whole file, possibly from several threads, so start paging it in now
+		madvise(p, file.size, MADV_WILLNEED);
+
+		file.data = (const char*)p;
+	}
+
+	// the mapping stays valid once the descriptor is closed
+	close(fd);
+
+	return true;
+}
+
+void UnmapFile(MappedFile& file)
+{
+	if (file.size)
+		munmap((void*)file.data, file.size);
+
+	file = MappedFile();
+}
+
 #endif
 
 
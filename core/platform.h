@@ -138,8 +138,25 @@ uint8_t* LoadFileToBuffer(const char* filename, uint32_t* sizeRead=NULL);
 bool SaveStringToFile(const char* filename, const char* s);
 
 bool FileMove(const char* src, const char* dest);
+// appends the names (without path) of the files matching a wildcard pattern, e.g.: "data/*.obj"
 bool FileScan(const char* pattern, std::vector<std::string>& files);
 
+// read only view of a whole file, the contents are paged in on demand by the OS and are not null terminated
+struct MappedFile
+{
+	MappedFile() : data(NULL), size(0), handle(NULL) {}
+
+	const char* data;
+	size_t size;
+
+	void* handle;	// platform specific mapping object
+};
+
+// maps a file into the address space, returns false if the file could not be opened
+bool MapFile(const char* filename, MappedFile& file);
+// releases a mapping created by MapFile()
+void UnmapFile(MappedFile& file);
+
 // file system stuff
 const uint32_t kMaxPathLength = 2048;
 
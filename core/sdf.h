@@ -35,3 +35,22 @@
 // distance is scaled by 1 / max(dimension)
 void MakeSDF(const uint32_t* input, uint32_t width, uint32_t height, float* output);
 void MakeSDF(const uint32_t* input, uint32_t width, uint32_t height, uint32_t depth, float* output);
+
+// 3d signed distance field computation using a separable exact Euclidean distance transform (Felzenszwalb and Huttenlocher),
+// runs in time linear in the number of voxels with each axis pass distributed over numThreads (0 = one per hardware thread).
+// Uses the same input, sign and scale conventions as MakeSDF(), distances are measured to the nearest voxel of the opposite 
+// type minus half a voxel so that voxels either side of the surface are at +-0.5 voxels
+void MakeSDFExact(const uint32_t* input, uint32_t width, uint32_t height, uint32_t depth, float* output, int numThreads=0);
+
+struct VoxelBricks;
+
+// sparse version of MakeSDFExact(), output holds VoxelBricks::kBrickVoxels values per allocated brick in the same order as the 
+// brick's bits. Unallocated bricks are unknown space, so the transforms run over each run of consecutive allocated bricks. This is 
+// exact for occupied voxels and for empty voxels that share a face with an occupied voxel, other empty voxels store an upper bound
+void MakeSDFBricks(const VoxelBricks& input, float* output, int numThreads=0);
+
+// signed distance field of a triangle mesh sampled at the voxel centers of the grid used by Voxelize(), the output has the layout, sign and 
+// scale of MakeSDF() (voxels are assumed to be cubic). Distances are evaluated exactly against the mesh for voxels within bandWidth voxels 
+// of the surface and propagated outward from there by passing each voxel's closest surface point on to its neighbors, so unlike voxelizing 
+// and then transforming the field keeps sub-voxel accuracy. The sign comes from VoxelizeBits(), work is distributed over numThreads
+void MakeSDFFromMesh(const Vec3* vertices, int numVertices, const int* indices, int numTriangleIndices, uint32_t width, uint32_t height, uint32_t depth, float* output, Vec3 minExtents, Vec3 maxExtents, float bandWidth=2.0f, int numThreads=0);
@@ -0,0 +1,675 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#pragma once
+
+#include "maths.h"
+
+#include <float.h>
+
+// Opt-in SIMD backend for the batch operations used by asset cooking and the moving frame helpers.
+// Building with ENABLE_SIMD=1 selects AVX2 (when the compiler targets it, e.g.: -mavx2 or /arch:AVX2), 
+// SSE2 or NEON from the target architecture. Otherwise SimdFloat is a single float and each routine
+// below reduces to the equivalent scalar loop, so results match the original code exactly.
+//
+// Routines operate on kSimdWidth elements at a time and finish any remainder with scalar code,
+// arrays of Vec3/Vec4 are read with unaligned or strided loads so callers need no special layout.
+
+#ifndef ENABLE_SIMD
+#define ENABLE_SIMD 0
+#endif
+
+#if ENABLE_SIMD && defined(__AVX2__)
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#elif ENABLE_SIMD && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#elif ENABLE_SIMD && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if SIMD_AVX2
+
+typedef __m256 SimdFloat;
+typedef __m256 SimdMask;
+
+const int kSimdWidth = 8;
+
+inline const char* SimdBackendName() { return "AVX2"; }
+
+inline SimdFloat SimdSplat(float f) { return _mm256_set1_ps(f); }
+inline SimdFloat SimdLoad(const float* p) { return _mm256_loadu_ps(p); }
+inline void SimdStore(float* p, SimdFloat v) { _mm256_storeu_ps(p, v); }
+
+// lanes are p[0], p[stride], p[2*stride], ...
+inline SimdFloat SimdLoadStrided(const float* p, int stride)
+{
+	const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+	return _mm256_i32gather_ps(p, offsets, 4);
+}
+
+// lanes are base[indices[0]*stride], base[indices[1]*stride], ...
+inline SimdFloat SimdGather(const float* base, const int* indices, int stride)
+{
+	const __m256i offsets = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)indices), _mm256_set1_epi32(stride));
+	return _mm256_i32gather_ps(base, offsets, 4);
+}
+
+inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a, b); }
+inline SimdFloat SimdSub(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a, b); }
+inline SimdFloat SimdMul(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a, b); }
+inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a, b); }
+inline SimdFloat SimdMin(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a, b); }
+inline SimdFloat SimdMax(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a, b); }
+inline SimdFloat SimdSqrt(SimdFloat a) { return _mm256_sqrt_ps(a); }
+inline SimdFloat SimdFloor(SimdFloat a) { return _mm256_floor_ps(a); }
+
+inline SimdMask SimdCmpGt(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+inline SimdMask SimdCmpLt(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline SimdMask SimdCmpGe(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline SimdMask SimdCmpLe(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+
+inline SimdMask SimdAnd(SimdMask a, SimdMask b) { return _mm256_and_ps(a, b); }
+inline SimdMask SimdOr(SimdMask a, SimdMask b) { return _mm256_or_ps(a, b); }
+
+// bit i is set if lane i of the mask is set
+inline int SimdMaskBits(SimdMask m) { return _mm256_movemask_ps(m); }
+
+// a where mask is set, b elsewhere
+inline SimdFloat SimdSelect(SimdMask mask, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b, a, mask); }
+
+// splits x into a mantissa in [0.5, 1) and an exponent such that x = m*2^e, x must be finite and positive
+inline SimdFloat SimdFrexp(SimdFloat x, SimdFloat& e)
+{
+	const __m256i bits = _mm256_castps_si256(x);
+
+	e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+	return _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x807fffff)), _mm256_set1_epi32(0x3f000000)));
+}
+
+// 2^n for integral n in [-126, 127]
+inline SimdFloat SimdPow2(SimdFloat n)
+{
+	return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+}
+
+#elif SIMD_SSE
+
+typedef __m128 SimdFloat;
+typedef __m128 SimdMask;
+
+const int kSimdWidth = 4;
+
+inline const char* SimdBackendName() { return "SSE2"; }
+
+inline SimdFloat SimdSplat(float f) { return _mm_set1_ps(f); }
+inline SimdFloat SimdLoad(const float* p) { return _mm_loadu_ps(p); }
+inline void SimdStore(float* p, SimdFloat v) { _mm_storeu_ps(p, v); }
+
+inline SimdFloat SimdLoadStrided(const float* p, int stride) 
+{ 
+	return _mm_setr_ps(p[0], p[stride], p[2*stride], p[3*stride]); 
+}
+
+inline SimdFloat SimdGather(const float* base, const int* indices, int stride)
+{
+	return _mm_setr_ps(base[indices[0]*stride], base[indices[1]*stride], base[indices[2]*stride], base[indices[3]*stride]);
+}
+
+inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b) { return _mm_add_ps(a, b); }
+inline SimdFloat SimdSub(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a, b); }
+inline SimdFloat SimdMul(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a, b); }
+inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b) { return _mm_div_ps(a, b); }
+inline SimdFloat SimdMin(SimdFloat a, SimdFloat b) { return _mm_min_ps(a, b); }
+inline SimdFloat SimdMax(SimdFloat a, SimdFloat b) { return _mm_max_ps(a, b); }
+inline SimdFloat SimdSqrt(SimdFloat a) { return _mm_sqrt_ps(a); }
+
+inline SimdMask SimdCmpGt(SimdFloat a, SimdFloat b) { return _mm_cmpgt_ps(a, b); }
+inline SimdMask SimdCmpLt(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a, b); }
+inline SimdMask SimdCmpGe(SimdFloat a, SimdFloat b) { return _mm_cmpge_ps(a, b); }
+inline SimdMask SimdCmpLe(SimdFloat a, SimdFloat b) { return _mm_cmple_ps(a, b); }
+
+inline SimdMask SimdAnd(SimdMask a, SimdMask b) { return _mm_and_ps(a, b); }
+inline SimdMask SimdOr(SimdMask a, SimdMask b) { return _mm_or_ps(a, b); }
+
+inline int SimdMaskBits(SimdMask m) { return _mm_movemask_ps(m); }
+
+inline SimdFloat SimdSelect(SimdMask mask, SimdFloat a, SimdFloat b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+// SSE2 has no round instruction, truncate and correct negative values, valid for |a| < 2^31
+inline SimdFloat SimdFloor(SimdFloat a)
+{
+	const SimdFloat t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+	return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+}
+
+inline SimdFloat SimdFrexp(SimdFloat x, SimdFloat& e)
+{
+	const __m128i bits = _mm_castps_si128(x);
+
+	e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+	return _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x807fffff)), _mm_set1_epi32(0x3f000000)));
+}
+
+inline SimdFloat SimdPow2(SimdFloat n)
+{
+	return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23));
+}
+
+#elif SIMD_NEON
+
+typedef float32x4_t SimdFloat;
+typedef uint32x4_t SimdMask;
+
+const int kSimdWidth = 4;
+
+inline const char* SimdBackendName() { return "NEON"; }
+
+inline SimdFloat SimdSplat(float f) { return vdupq_n_f32(f); }
+inline SimdFloat SimdLoad(const float* p) { return vld1q_f32(p); }
+inline void SimdStore(float* p, SimdFloat v) { vst1q_f32(p, v); }
+
+inline SimdFloat SimdLoadStrided(const float* p, int stride)
+{
+	const float t[4] = { p[0], p[stride], p[2*stride], p[3*stride] };
+	return vld1q_f32(t);
+}
+
+inline SimdFloat SimdGather(const float* base, const int* indices, int stride)
+{
+	const float t[4] = { base[indices[0]*stride], base[indices[1]*stride], base[indices[2]*stride], base[indices[3]*stride] };
+	return vld1q_f32(t);
+}
+
+inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b) { return vaddq_f32(a, b); }
+inline SimdFloat SimdSub(SimdFloat a, SimdFloat b) { return vsubq_f32(a, b); }
+inline SimdFloat SimdMul(SimdFloat a, SimdFloat b) { return vmulq_f32(a, b); }
+inline SimdFloat SimdMin(SimdFloat a, SimdFloat b) { return vminq_f32(a, b); }
+inline SimdFloat SimdMax(SimdFloat a, SimdFloat b) { return vmaxq_f32(a, b); }
+
+#if defined(__aarch64__)
+
+inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b) { return vdivq_f32(a, b); }
+inline SimdFloat SimdSqrt(SimdFloat a) { return vsqrtq_f32(a); }
+inline SimdFloat SimdFloor(SimdFloat a) { return vrndmq_f32(a); }
+
+#else
+
+// ARMv7 lacks vector divide and square root, refine the estimates with two Newton steps
+inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b)
+{
+	SimdFloat r = vrecpeq_f32(b);
+	r = vmulq_f32(vrecpsq_f32(b, r), r);
+	r = vmulq_f32(vrecpsq_f32(b, r), r);
+
+	return vmulq_f32(a, r);
+}
+
+inline SimdFloat SimdSqrt(SimdFloat a)
+{
+	SimdFloat r = vrsqrteq_f32(a);
+	r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+	r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+
+	// rsqrt(0) is infinite, mask those lanes back to zero
+	return vbslq_f32(vceqq_f32(a, vdupq_n_f32(0.0f)), a, vmulq_f32(a, r));
+}
+
+inline SimdFloat SimdFloor(SimdFloat a)
+{
+	const SimdFloat t = vcvtq_f32_s32(vcvtq_s32_f32(a));
+	return vsubq_f32(t, vbslq_f32(vcgtq_f32(t, a), vdupq_n_f32(1.0f), vdupq_n_f32(0.0f)));
+}
+
+#endif
+
+inline SimdMask SimdCmpGt(SimdFloat a, SimdFloat b) { return vcgtq_f32(a, b); }
+inline SimdMask SimdCmpLt(SimdFloat a, SimdFloat b) { return vcltq_f32(a, b); }
+inline SimdMask SimdCmpGe(SimdFloat a, SimdFloat b) { return vcgeq_f32(a, b); }
+inline SimdMask SimdCmpLe(SimdFloat a, SimdFloat b) { return vcleq_f32(a, b); }
+
+inline SimdMask SimdAnd(SimdMask a, SimdMask b) { return vandq_u32(a, b); }
+inline SimdMask SimdOr(SimdMask a, SimdMask b) { return vorrq_u32(a, b); }
+
+inline int SimdMaskBits(SimdMask m)
+{
+	uint32_t t[4];
+	vst1q_u32(t, m);
+
+	return (t[0] & 1) | (t[1] & 2) | (t[2] & 4) | (t[3] & 8);
+}
+
+inline SimdFloat SimdSelect(SimdMask mask, SimdFloat a, SimdFloat b) { return vbslq_f32(mask, a, b); }
+
+inline SimdFloat SimdFrexp(SimdFloat x, SimdFloat& e)
+{
+	const uint32x4_t bits = vreinterpretq_u32_f32(x);
+
+	e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(126)));
+	return vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x807fffff)), vdupq_n_u32(0x3f000000)));
+}
+
+inline SimdFloat SimdPow2(SimdFloat n)
+{
+	return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23));
+}
+
+#else
+
+// scalar fallback
+typedef float SimdFloat;
+typedef bool SimdMask;
+
+const int kSimdWidth = 1;
+
+inline const char* SimdBackendName() { return "Scalar"; }
+
+inline SimdFloat SimdSplat(float f) { return f; }
+inline SimdFloat SimdLoad(const float* p) { return *p; }
+inline void SimdStore(float* p, SimdFloat v) { *p = v; }
+inline SimdFloat SimdLoadStrided(const float* p, int) { return *p; }
+inline SimdFloat SimdGather(const float* base, const int* indices, int stride) { return base[indices[0]*stride]; }
+
+inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b) { return a + b; }
+inline SimdFloat SimdSub(SimdFloat a, SimdFloat b) { return a - b; }
+inline SimdFloat SimdMul(SimdFloat a, SimdFloat b) { return a * b; }
+inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b) { return a / b; }
+inline SimdFloat SimdMin(SimdFloat a, SimdFloat b) { return a < b ? a : b; }
+inline SimdFloat SimdMax(SimdFloat a, SimdFloat b) { return a > b ? a : b; }
+inline SimdFloat SimdSqrt(SimdFloat a) { return sqrtf(a); }
+inline SimdFloat SimdFloor(SimdFloat a) { return floorf(a); }
+
+inline SimdMask SimdCmpGt(SimdFloat a, SimdFloat b) { return a > b; }
+inline SimdMask SimdCmpLt(SimdFloat a, SimdFloat b) { return a < b; }
+inline SimdMask SimdCmpGe(SimdFloat a, SimdFloat b) { return a >= b; }
+inline SimdMask SimdCmpLe(SimdFloat a, SimdFloat b) { return a <= b; }
+
+inline SimdMask SimdAnd(SimdMask a, SimdMask b) { return a && b; }
+inline SimdMask SimdOr(SimdMask a, SimdMask b) { return a || b; }
+
+inline int SimdMaskBits(SimdMask m) { return m ? 1 : 0; }
+
+inline SimdFloat SimdSelect(SimdMask mask, SimdFloat a, SimdFloat b) { return mask ? a : b; }
+
+#endif
+
+inline void SimdStoreStrided(float* p, int stride, SimdFloat v)
+{
+	float t[kSimdWidth];
+	SimdStore(t, v);
+
+	for (int i=0; i < kSimdWidth; ++i)
+		p[i*stride] = t[i];
+}
+
+inline float SimdReduceAdd(SimdFloat v)
+{
+	float t[kSimdWidth];
+	SimdStore(t, v);
+
+	float r = t[0];
+	for (int i=1; i < kSimdWidth; ++i)
+		r += t[i];
+
+	return r;
+}
+
+inline float SimdReduceMax(SimdFloat v)
+{
+	float t[kSimdWidth];
+	SimdStore(t, v);
+
+	float r = t[0];
+	for (int i=1; i < kSimdWidth; ++i)
+		r = Max(r, t[i]);
+
+	return r;
+}
+
+// multiply-add, the operation order matches a*b + c in scalar code
+inline SimdFloat SimdMulAdd(SimdFloat a, SimdFloat b, SimdFloat c) { return SimdAdd(SimdMul(a, b), c); }
+
+#if ENABLE_SIMD && (SIMD_AVX2 || SIMD_SSE || SIMD_NEON)
+
+// natural logarithm for positive finite x, polynomial from Cephes logf(), relative error ~1e-7
+inline SimdFloat SimdLog(SimdFloat x)
+{
+	SimdFloat e;
+	SimdFloat m = SimdFrexp(x, e);
+
+	// shift the mantissa to [sqrt(0.5), sqrt(2)) so the polynomial is evaluated around 1
+	const SimdMask small = SimdCmpLt(m, SimdSplat(0.707106781186547524f));
+	e = SimdSub(e, SimdSelect(small, SimdSplat(1.0f), SimdSplat(0.0f)));
+	m = SimdAdd(SimdSub(m, SimdSplat(1.0f)), SimdSelect(small, m, SimdSplat(0.0f)));
+
+	const SimdFloat z = SimdMul(m, m);
+
+	SimdFloat y = SimdSplat(7.0376836292e-2f);
+	y = SimdMulAdd(y, m, SimdSplat(-1.1514610310e-1f));
+	y = SimdMulAdd(y, m, SimdSplat(1.1676998740e-1f));
+	y = SimdMulAdd(y, m, SimdSplat(-1.2420140846e-1f));
+	y = SimdMulAdd(y, m, SimdSplat(1.4249322787e-1f));
+	y = SimdMulAdd(y, m, SimdSplat(-1.6668057665e-1f));
+	y = SimdMulAdd(y, m, SimdSplat(2.0000714765e-1f));
+	y = SimdMulAdd(y, m, SimdSplat(-2.4999993993e-1f));
+	y = SimdMulAdd(y, m, SimdSplat(3.3333331174e-1f));
+	y = SimdMul(SimdMul(y, m), z);
+
+	y = SimdMulAdd(e, SimdSplat(-2.12194440e-4f), y);
+	y = SimdMulAdd(z, SimdSplat(-0.5f), y);
+
+	return SimdMulAdd(e, SimdSplat(0.693359375f), SimdAdd(m, y));
+}
+
+// e^x, polynomial from Cephes expf(), inputs are clamped so the result stays a normal float
+inline SimdFloat SimdExp(SimdFloat x)
+{
+	x = SimdMin(SimdMax(x, SimdSplat(-87.0f)), SimdSplat(88.0f));
+
+	// x = n*ln(2) + r with |r| <= ln(2)/2, ln(2) is split in two for extra precision
+	const SimdFloat n = SimdFloor(SimdMulAdd(x, SimdSplat(1.44269504088896341f), SimdSplat(0.5f)));
+	
+	x = SimdSub(x, SimdMul(n, SimdSplat(0.693359375f)));
+	x = SimdSub(x, SimdMul(n, SimdSplat(-2.12194440e-4f)));
+
+	const SimdFloat z = SimdMul(x, x);
+
+	SimdFloat y = SimdSplat(1.9875691500e-4f);
+	y = SimdMulAdd(y, x, SimdSplat(1.3981999507e-3f));
+	y = SimdMulAdd(y, x, SimdSplat(8.3334519073e-3f));
+	y = SimdMulAdd(y, x, SimdSplat(4.1665795894e-2f));
+	y = SimdMulAdd(y, x, SimdSplat(1.6666665459e-1f));
+	y = SimdMulAdd(y, x, SimdSplat(5.0000001201e-1f));
+	y = SimdAdd(SimdMulAdd(y, z, x), SimdSplat(1.0f));
+
+	return SimdMul(y, SimdPow2(n));
+}
+
+// x^y for x >= 0, zero maps to zero (y is expected to be positive)
+inline SimdFloat SimdPow(SimdFloat x, SimdFloat y)
+{
+	const SimdMask positive = SimdCmpGt(x, SimdSplat(0.0f));
+
+	// substitute 1 for non-positive lanes so the log stays finite
+	const SimdFloat r = SimdExp(SimdMul(y, SimdLog(SimdSelect(positive, x, SimdSplat(1.0f)))));
+
+	return SimdSelect(positive, r, SimdSplat(0.0f));
+}
+
+#else
+
+inline SimdFloat SimdPow(SimdFloat x, SimdFloat y) { return powf(x, y); }
+
+#endif
+
+// structure of arrays 3-vector, one point per-lane
+struct SimdVec3
+{
+	SimdFloat x, y, z;
+};
+
+// loads kSimdWidth points spaced stride floats apart, e.g.: 4 for the xyz part of a Vec4 array
+inline SimdVec3 SimdLoadVec3(const float* p, int stride)
+{
+	SimdVec3 v;
+	v.x = SimdLoadStrided(p + 0, stride);
+	v.y = SimdLoadStrided(p + 1, stride);
+	v.z = SimdLoadStrided(p + 2, stride);
+
+	return v;
+}
+
+inline void SimdStoreVec3(float* p, int stride, const SimdVec3& v)
+{
+	SimdStoreStrided(p + 0, stride, v.x);
+	SimdStoreStrided(p + 1, stride, v.y);
+	SimdStoreStrided(p + 2, stride, v.z);
+}
+
+inline SimdVec3 SimdSplat(const Vec3& a)
+{
+	SimdVec3 v;
+	v.x = SimdSplat(a.x);
+	v.y = SimdSplat(a.y);
+	v.z = SimdSplat(a.z);
+
+	return v;
+}
+
+inline SimdVec3 SimdAdd(const SimdVec3& a, const SimdVec3& b)
+{
+	SimdVec3 v;
+	v.x = SimdAdd(a.x, b.x);
+	v.y = SimdAdd(a.y, b.y);
+	v.z = SimdAdd(a.z, b.z);
+
+	return v;
+}
+
+inline SimdVec3 SimdSub(const SimdVec3& a, const SimdVec3& b)
+{
+	SimdVec3 v;
+	v.x = SimdSub(a.x, b.x);
+	v.y = SimdSub(a.y, b.y);
+	v.z = SimdSub(a.z, b.z);
+
+	return v;
+}
+
+inline SimdVec3 SimdMul(const SimdVec3& a, SimdFloat s)
+{
+	SimdVec3 v;
+	v.x = SimdMul(a.x, s);
+	v.y = SimdMul(a.y, s);
+	v.z = SimdMul(a.z, s);
+
+	return v;
+}
+
+inline SimdVec3 SimdCross(const SimdVec3& a, const SimdVec3& b)
+{
+	SimdVec3 v;
+	v.x = SimdSub(SimdMul(a.y, b.z), SimdMul(a.z, b.y));
+	v.y = SimdSub(SimdMul(a.z, b.x), SimdMul(a.x, b.z));
+	v.z = SimdSub(SimdMul(a.x, b.y), SimdMul(a.y, b.x));
+
+	return v;
+}
+
+inline SimdFloat SimdDot(const SimdVec3& a, const SimdVec3& b)
+{
+	return SimdAdd(SimdAdd(SimdMul(a.x, b.x), SimdMul(a.y, b.y)), SimdMul(a.z, b.z));
+}
+
+inline SimdFloat SimdLengthSq(const SimdVec3& a)
+{
+	return SimdAdd(SimdAdd(SimdMul(a.x, a.x), SimdMul(a.y, a.y)), SimdMul(a.z, a.z));
+}
+
+// per-lane a if the mask is set, b otherwise
+inline SimdVec3 SimdSelect(SimdMask mask, const SimdVec3& a, const SimdVec3& b)
+{
+	SimdVec3 v;
+	v.x = SimdSelect(mask, a.x, b.x);
+	v.y = SimdSelect(mask, a.y, b.y);
+	v.z = SimdSelect(mask, a.z, b.z);
+
+	return v;
+}
+
+// affine transform of points by a column major matrix, equivalent to Vec3(m*Vec4(p, 1.0f))
+inline SimdVec3 SimdTransformPoint(const Matrix44& m, const SimdVec3& p)
+{
+	SimdVec3 v;
+	v.x = SimdAdd(SimdAdd(SimdAdd(SimdMul(SimdSplat(m.columns[0][0]), p.x), SimdMul(SimdSplat(m.columns[1][0]), p.y)), SimdMul(SimdSplat(m.columns[2][0]), p.z)), SimdSplat(m.columns[3][0]));
+	v.y = SimdAdd(SimdAdd(SimdAdd(SimdMul(SimdSplat(m.columns[0][1]), p.x), SimdMul(SimdSplat(m.columns[1][1]), p.y)), SimdMul(SimdSplat(m.columns[2][1]), p.z)), SimdSplat(m.columns[3][1]));
+	v.z = SimdAdd(SimdAdd(SimdAdd(SimdMul(SimdSplat(m.columns[0][2]), p.x), SimdMul(SimdSplat(m.columns[1][2]), p.y)), SimdMul(SimdSplat(m.columns[2][2]), p.z)), SimdSplat(m.columns[3][2]));
+
+	return v;
+}
+
+// batch operations
+
+// computes the bounds of an array of points, empty arrays return inverted bounds (FLT_MAX, -FLT_MAX)
+inline void SimdBounds(const Vec3* points, int n, Vec3& lower, Vec3& upper)
+{
+	if (kSimdWidth == 1)
+	{
+		// scalar fallback, same as the loops this replaces
+		lower = Vec3(FLT_MAX);
+		upper = Vec3(-FLT_MAX);
+
+		for (int i=0; i < n; ++i)
+		{
+			lower = Min(lower, points[i]);
+			upper = Max(upper, points[i]);
+		}
+
+		return;
+	}
+
+	const float* p = (const float*)points;
+
+	// treat the points as a flat float array, three registers hold kSimdWidth points 
+	// and lane l of register k always holds component (k*kSimdWidth + l)%3
+	SimdFloat lo[3] = { SimdSplat(FLT_MAX), SimdSplat(FLT_MAX), SimdSplat(FLT_MAX) };
+	SimdFloat hi[3] = { SimdSplat(-FLT_MAX), SimdSplat(-FLT_MAX), SimdSplat(-FLT_MAX) };
+
+	const int numBlocks = n/kSimdWidth;
+
+	for (int b=0; b < numBlocks; ++b)
+	{
+		for (int k=0; k < 3; ++k)
+		{
+			const SimdFloat v = SimdLoad(p + (b*3 + k)*kSimdWidth);
+
+			lo[k] = SimdMin(lo[k], v);
+			hi[k] = SimdMax(hi[k], v);
+		}
+	}
+
+	float tlo[3*kSimdWidth];
+	float thi[3*kSimdWidth];
+
+	for (int k=0; k < 3; ++k)
+	{
+		SimdStore(tlo + k*kSimdWidth, lo[k]);
+		SimdStore(thi + k*kSimdWidth, hi[k]);
+	}
+
+	lower = Vec3(FLT_MAX);
+	upper = Vec3(-FLT_MAX);
+
+	for (int i=0; i < 3*kSimdWidth; ++i)
+	{
+		lower[i%3] = Min(lower[i%3], tlo[i]);
+		upper[i%3] = Max(upper[i%3], thi[i]);
+	}
+
+	for (int i=numBlocks*kSimdWidth; i < n; ++i)
+	{
+		lower = Min(lower, points[i]);
+		upper = Max(upper, points[i]);
+	}
+}
+
+// mean of the points referenced by indices, returns zero for an empty set
+inline Vec3 SimdMean(const Vec3* points, const int* indices, int n)
+{
+	const float* p = (const float*)points;
+
+	SimdFloat sx = SimdSplat(0.0f);
+	SimdFloat sy = SimdSplat(0.0f);
+	SimdFloat sz = SimdSplat(0.0f);
+
+	const int end = n - n%kSimdWidth;
+
+	for (int i=0; i < end; i += kSimdWidth)
+	{
+		sx = SimdAdd(sx, SimdGather(p + 0, indices + i, 3));
+		sy = SimdAdd(sy, SimdGather(p + 1, indices + i, 3));
+		sz = SimdAdd(sz, SimdGather(p + 2, indices + i, 3));
+	}
+
+	Vec3 sum(SimdReduceAdd(sx), SimdReduceAdd(sy), SimdReduceAdd(sz));
+
+	for (int i=end; i < n; ++i)
+		sum += points[indices[i]];
+
+	if (n)
+		return sum / float(n);
+	else
+		return sum;
+}
+
+// largest distance from center to the points referenced by indices
+inline float SimdRadius(const Vec3* points, const Vec3& center, const int* indices, int n)
+{
+	const float* p = (const float*)points;
+
+	const SimdVec3 c = SimdSplat(center);
+	SimdFloat radiusSq = SimdSplat(0.0f);
+
+	const int end = n - n%kSimdWidth;
+
+	for (int i=0; i < end; i += kSimdWidth)
+	{
+		SimdVec3 d;
+		d.x = SimdSub(SimdGather(p + 0, indices + i, 3), c.x);
+		d.y = SimdSub(SimdGather(p + 1, indices + i, 3), c.y);
+		d.z = SimdSub(SimdGather(p + 2, indices + i, 3), c.z);
+
+		radiusSq = SimdMax(radiusSq, SimdLengthSq(d));
+	}
+
+	float r = SimdReduceMax(radiusSq);
+
+	for (int i=end; i < n; ++i)
+		r = Max(r, LengthSq(points[indices[i]] - center));
+
+	return sqrtf(r);
+}
+
+// inverse distance skinning weights 1/(d^falloff + 0.0001) from squared distances, distances beyond maxDistSq get zero weight
+inline void SimdInverseDistanceWeights(const float* distancesSq, int n, float falloff, float maxDistSq, float* weights)
+{
+	// the scalar loop skips pow() for clamped bones, so scalar builds use it for all elements
+	const int end = kSimdWidth > 1 ? n - n%kSimdWidth : 0;
+
+	for (int i=0; i < end; i += kSimdWidth)
+	{
+		const SimdFloat d = SimdLoad(distancesSq + i);
+		const SimdFloat w = SimdDiv(SimdSplat(1.0f), SimdAdd(SimdPow(d, SimdSplat(falloff)), SimdSplat(0.0001f)));
+
+		SimdStore(weights + i, SimdSelect(SimdCmpGt(d, SimdSplat(maxDistSq)), SimdSplat(0.0f), w));
+	}
+
+	for (int i=end; i < n; ++i)
+		weights[i] = distancesSq[i] > maxDistSq ? 0.0f : 1.0f / (powf(distancesSq[i], falloff) + 0.0001f);
+}
@@ -27,6 +27,8 @@
 
 #include "aabbtree.h"
 #include "mesh.h"
+#include "parallel.h"
+#include "voxelize.h"
 
 void Voxelize(const Vec3* vertices, int numVertices, const int* indices, int numTriangleIndices, uint32_t width, uint32_t height, uint32_t depth, uint32_t* volume, Vec3 minExtents, Vec3 maxExtents)
 {
@@ -91,3 +93,250 @@ void Voxelize(const Vec3* vertices, int numVertices, const int* indices, int num
 		}
 	}	
 }
+
+namespace
+{
+
+// takes all crossings of a column along +z and calls func(z, zend) for each run of cells [z, zend) inside the mesh
+template <typename Func>
+void VoxelizeColumn(std::vector<float>& hits, float startZ, float minZ, float deltaZ, uint32_t depth, float eps, Func func)
+{
+	std::sort(hits.begin(), hits.end());
+
+	bool inside = false;
+	float segmentStart = startZ;
+	float nextT = 0.0f;
+
+	for (size_t i=0; i < hits.size(); ++i)
+	{
+		const float t = hits[i];
+
+		if (t < nextT)
+			continue;
+
+		// calculate cell in which intersection occurred
+		const float zpos = startZ + t;
+		const float zhit = (zpos-minZ)/deltaZ;
+
+		if (inside)
+		{
+			const uint32_t z = uint32_t(floorf((segmentStart-minZ)/deltaZ + 0.5f));
+			const uint32_t zend = std::min(uint32_t(floorf(zhit + 0.5f)), depth-1);
+
+			if (z < zend)
+				func(z, zend);
+		}
+
+		inside = !inside;
+
+		segmentStart = zpos + eps;
+		nextT = t + eps;
+	}
+}
+
+// traces the columns of row y in packets of adjacent rays and calls func(x, z, zend) for each inside run, hits is scratch storage
+template <typename Func>
+void VoxelizeRow(const AABBTree& tree, uint32_t y, uint32_t width, uint32_t depth, Vec3 minExtents, Vec3 delta, Vec3 offset, float eps, std::vector<float>* hits, Func func)
+{
+	Vec3 starts[AABBTree::kRayPacketSize];
+	Vec3 dirs[AABBTree::kRayPacketSize];
+
+	for (uint32_t x=0; x < width; x += AABBTree::kRayPacketSize)
+	{
+		const int numRays = int(std::min(width-x, uint32_t(AABBTree::kRayPacketSize)));
+
+		for (int i=0; i < numRays; ++i)
+		{
+			starts[i] = minExtents + Vec3((x+i)*delta.x + offset.x, y*delta.y + offset.y, 0.0f);
+			dirs[i] = Vec3(0.0f, 0.0f, 1.0f);
+
+			hits[i].resize(0);
+		}
+
+		// find all crossings of the columns at once rather than re-tracing from each hit
+		tree.TraceRayPacketAll(starts, dirs, numRays, hits);
+
+		for (int i=0; i < numRays; ++i)
+		{
+			VoxelizeColumn(hits[i], minExtents.z, minExtents.z, delta.z, depth, eps, [&](uint32_t z, uint32_t zend)
+			{
+				func(x+i, z, zend);
+			});
+		}
+	}
+}
+
+} // anonymous namespace
+
+void VoxelizeBits(const Vec3* vertices, int numVertices, const int* indices, int numTriangleIndices, uint32_t width, uint32_t height, uint32_t depth, uint32_t* bits, Vec3 minExtents, Vec3 maxExtents, int numThreads)
+{
+	// build an aabb tree of the mesh, read-only during traversal so it is shared by all threads
+	const AABBTree tree(vertices, numVertices, (const uint32_t*)indices, numTriangleIndices/3); 
+
+	VoxelizeBits(tree, width, height, depth, bits, minExtents, maxExtents, numThreads);
+}
+
+void VoxelizeBits(const AABBTree& tree, uint32_t width, uint32_t height, uint32_t depth, uint32_t* bits, Vec3 minExtents, Vec3 maxExtents, int numThreads)
+{
+	memset(bits, 0, sizeof(uint32_t)*GetVoxelWordCount(width, height, depth));
+
+	const Vec3 extents(maxExtents-minExtents);
+	const Vec3 delta(extents.x/width, extents.y/height, extents.z/depth);
+	const Vec3 offset(0.5f*delta.x, 0.5f*delta.y, 0.5f*delta.z);
+
+	// same bias as Voxelize(), crossings closer than this to the previous one are ignored
+	const float eps = 0.00001f*extents.z;
+
+	// each thread processes whole rows so no two threads write the same word
+	GetDefaultThreadPool().ParallelFor(0, int(height), [&](int rowBegin, int rowEnd)
+	{
+		std::vector<float> hits[AABBTree::kRayPacketSize];
+
+		for (uint32_t y=uint32_t(rowBegin); y < uint32_t(rowEnd); ++y)
+		{
+			VoxelizeRow(tree, y, width, depth, minExtents, delta, offset, eps, hits, [&](uint32_t x, uint32_t z, uint32_t zend)
+			{
+				// march along column setting bits
+				for (uint32_t k=z; k < zend; ++k)
+					SetVoxel(bits, width, height, x, y, k);
+			});
+		}
+	}, numThreads);
+}
+
+void UnpackVoxels(const uint32_t* bits, uint32_t width, uint32_t height, uint32_t depth, uint32_t* volume)
+{
+	for (uint32_t z=0; z < depth; ++z)
+		for (uint32_t y=0; y < height; ++y)
+			for (uint32_t x=0; x < width; ++x)
+				volume[z*width*height + y*width + x] = GetVoxel(bits, width, height, x, y, z) ? uint32_t(-1) : 0;
+}
+
+void VoxelizeBricks(const Vec3* vertices, int numVertices, const int* indices, int numTriangleIndices, uint32_t width, uint32_t height, uint32_t depth, VoxelBricks& bricks, Vec3 minExtents, Vec3 maxExtents, int numThreads)
+{
+	const uint32_t kBrickDim = VoxelBricks::kBrickDim;
+
+	bricks.width = width;
+	bricks.height = height;
+	bricks.depth = depth;
+	bricks.bricksX = (width + kBrickDim - 1)/kBrickDim;
+	bricks.bricksY = (height + kBrickDim - 1)/kBrickDim;
+	bricks.bricksZ = (depth + kBrickDim - 1)/kBrickDim;
+
+	const AABBTree tree(vertices, numVertices, (const uint32_t*)indices, numTriangleIndices/3); 
+
+	const Vec3 extents(maxExtents-minExtents);
+	const Vec3 delta(extents.x/width, extents.y/height, extents.z/depth);
+	const Vec3 offset(0.5f*delta.x, 0.5f*delta.y, 0.5f*delta.z);
+
+	const float eps = 0.00001f*extents.z;
+
+	// runs of inside cells for each row of columns, storage is proportional to the number of surface crossings
+	struct Run
+	{
+		uint32_t x;
+		uint32_t z;
+		uint32_t zend;
+	};
+
+	std::vector<std::vector<Run> > rows(height);
+
+	GetDefaultThreadPool().ParallelFor(0, int(height), [&](int rowBegin, int rowEnd)
+	{
+		std::vector<float> hits[AABBTree::kRayPacketSize];
+
+		for (uint32_t y=uint32_t(rowBegin); y < uint32_t(rowEnd); ++y)
+		{
+			VoxelizeRow(tree, y, width, depth, minExtents, delta, offset, eps, hits, [&](uint32_t x, uint32_t z, uint32_t zend)
+			{
+				Run r = { x, z, zend };
+				rows[y].push_back(r);
+			});
+		}
+	}, numThreads);
+
+	// flag bricks overlapped by a run, then their face neighbors
+	const int kOccupied = -2;
+
+	std::vector<int>& table = bricks.brickIndices;
+	table.assign(bricks.bricksX*bricks.bricksY*bricks.bricksZ, -1);
+
+	for (uint32_t y=0; y < height; ++y)
+	{
+		for (size_t i=0; i < rows[y].size(); ++i)
+		{
+			const Run& r = rows[y][i];
+
+			for (uint32_t bz=r.z/kBrickDim; bz <= (r.zend-1)/kBrickDim; ++bz)
+				table[(bz*bricks.bricksY + y/kBrickDim)*bricks.bricksX + r.x/kBrickDim] = kOccupied;
+		}
+	}
+
+	bricks.brickCoords.resize(0);
+
+	for (uint32_t bz=0; bz < bricks.bricksZ; ++bz)
+	{
+		for (uint32_t by=0; by < bricks.bricksY; ++by)
+		{
+			for (uint32_t bx=0; bx < bricks.bricksX; ++bx)
+			{
+				const int neighbors[6][3] = { {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1} };
+
+				bool allocate = table[(bz*bricks.bricksY + by)*bricks.bricksX + bx] == kOccupied;
+
+				for (int n=0; n < 6 && !allocate; ++n)
+				{
+					const int nx = int(bx) + neighbors[n][0];
+					const int ny = int(by) + neighbors[n][1];
+					const int nz = int(bz) + neighbors[n][2];
+
+					if (nx >= 0 && ny >= 0 && nz >= 0 && nx < int(bricks.bricksX) && ny < int(bricks.bricksY) && nz < int(bricks.bricksZ))
+						allocate = table[(nz*bricks.bricksY + ny)*bricks.bricksX + nx] == kOccupied;
+				}
+
+				if (allocate)
+				{
+					bricks.brickCoords.push_back(bx);
+					bricks.brickCoords.push_back(by);
+					bricks.brickCoords.push_back(bz);
+				}
+			}
+		}
+	}
+
+	// assign indices once all flags have been read
+	for (int b=0; b < bricks.GetNumBricks(); ++b)
+	{
+		const int* c = &bricks.brickCoords[b*3];
+		table[(c[2]*bricks.bricksY + c[1])*bricks.bricksX + c[0]] = b;
+	}
+
+	for (size_t i=0; i < table.size(); ++i)
+		if (table[i] == kOccupied)
+			table[i] = -1;
+
+	bricks.bits.assign(bricks.GetNumBricks()*VoxelBricks::kBrickWords, 0);
+
+	// each thread fills whole rows of bricks so no two threads write the same word
+	GetDefaultThreadPool().ParallelFor(0, int(bricks.bricksY), [&](int brickRowBegin, int brickRowEnd)
+	{
+		const uint32_t yBegin = uint32_t(brickRowBegin)*kBrickDim;
+		const uint32_t yEnd = std::min(uint32_t(brickRowEnd)*kBrickDim, height);
+
+		for (uint32_t y=yBegin; y < yEnd; ++y)
+		{
+			for (size_t i=0; i < rows[y].size(); ++i)
+			{
+				const Run& r = rows[y][i];
+
+				for (uint32_t z=r.z; z < r.zend; ++z)
+				{
+					const int brick = bricks.FindBrick(r.x/kBrickDim, y/kBrickDim, z/kBrickDim);
+					const uint32_t bit = ((z%kBrickDim)*kBrickDim + (y%kBrickDim))*kBrickDim + (r.x%kBrickDim);
+
+					bricks.bits[brick*VoxelBricks::kBrickWords + bit/32] |= (1U<<(bit&31));
+				}
+			}
+		}
+	}, numThreads);
+}
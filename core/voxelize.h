@@ -27,7 +27,85 @@
 
 #pragma once
 
+#include <vector>
+
 struct Mesh;
+class AABBTree;
 
 // voxelizes a mesh using a single pass parity algorithm
-void Voxelize(const Vec3* vertices, int numVertices, const int* indices, int numTriangleIndices, uint32_t width, uint32_t height, uint32_t depth, uint32_t* volume, Vec3 minExtents, Vec3 maxExtents);
\ No newline at end of file
+void Voxelize(const Vec3* vertices, int numVertices, const int* indices, int numTriangleIndices, uint32_t width, uint32_t height, uint32_t depth, uint32_t* volume, Vec3 minExtents, Vec3 maxExtents);
+
+// bit-packed volumes store one bit per-voxel, each row of voxels along x is padded to a whole number of 
+// 32-bit words so that rows never share a word, voxel (x,y,z) is bit x&31 of word (z*height + y)*wordsPerRow + x/32
+inline uint32_t GetVoxelWordsPerRow(uint32_t width) { return (width+31)/32; }
+inline uint32_t GetVoxelWordCount(uint32_t width, uint32_t height, uint32_t depth) { return GetVoxelWordsPerRow(width)*height*depth; }
+
+inline bool GetVoxel(const uint32_t* bits, uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint32_t z)
+{
+	return (bits[(z*height + y)*GetVoxelWordsPerRow(width) + x/32] & (1U<<(x&31))) != 0;
+}
+
+inline void SetVoxel(uint32_t* bits, uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint32_t z)
+{
+	bits[(z*height + y)*GetVoxelWordsPerRow(width) + x/32] |= (1U<<(x&31));
+}
+
+// voxelizes a mesh using the same parity algorithm as Voxelize() into a bit-packed volume (GetVoxelWordCount() words), 
+// the crossings along each column are found with a single tree traversal, and rows of columns are distributed 
+// across numThreads worker threads (0 = one per hardware thread)
+void VoxelizeBits(const Vec3* vertices, int numVertices, const int* indices, int numTriangleIndices, uint32_t width, uint32_t height, uint32_t depth, uint32_t* bits, Vec3 minExtents, Vec3 maxExtents, int numThreads=0);
+
+// as above for a mesh that already has a tree, e.g.: to share it with other queries on the same mesh
+void VoxelizeBits(const AABBTree& tree, uint32_t width, uint32_t height, uint32_t depth, uint32_t* bits, Vec3 minExtents, Vec3 maxExtents, int numThreads=0);
+
+// expands a bit-packed volume to one uint32_t per-voxel in the layout used by Voxelize()
+void UnpackVoxels(const uint32_t* bits, uint32_t width, uint32_t height, uint32_t depth, uint32_t* volume);
+
+// sparse bit-packed volume made of 8x8x8 voxel bricks, only bricks that contain occupied voxels and their six face 
+// neighbors are allocated, every other voxel is empty. Bricks are located through a dense table with one entry 
+// per-brick (1/512th of the voxel count), voxel (x,y,z) of a brick is bit (z*64 + y*8 + x) of its 16 words
+struct VoxelBricks
+{
+	enum
+	{
+		kBrickDim = 8,
+		kBrickVoxels = 512,
+		kBrickWords = 16
+	};
+
+	VoxelBricks() : width(0), height(0), depth(0), bricksX(0), bricksY(0), bricksZ(0) {}
+
+	int GetNumBricks() const { return int(brickCoords.size()/3); }
+
+	// returns -1 if the brick is not allocated
+	int FindBrick(uint32_t bx, uint32_t by, uint32_t bz) const
+	{
+		return brickIndices[(bz*bricksY + by)*bricksX + bx];
+	}
+
+	bool GetVoxel(uint32_t x, uint32_t y, uint32_t z) const
+	{
+		const int brick = FindBrick(x/kBrickDim, y/kBrickDim, z/kBrickDim);
+		if (brick < 0)
+			return false;
+
+		const uint32_t bit = ((z%kBrickDim)*kBrickDim + (y%kBrickDim))*kBrickDim + (x%kBrickDim);
+		return (bits[brick*kBrickWords + bit/32] & (1U<<(bit&31))) != 0;
+	}
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+
+	uint32_t bricksX;
+	uint32_t bricksY;
+	uint32_t bricksZ;
+
+	std::vector<int> brickIndices;	// bricksX*bricksY*bricksZ entries, index of the allocated brick or -1
+	std::vector<int> brickCoords;	// brick coordinates (bx, by, bz) of each allocated brick
+	std::vector<uint32_t> bits;		// kBrickWords per allocated brick
+};
+
+// voxelizes a mesh using the same parity algorithm as VoxelizeBits() into a sparse brick volume, memory is proportional to
+// the number of bricks the mesh occupies (plus the brick table) rather than the bounding volume
+void VoxelizeBricks(const Vec3* vertices, int numVertices, const int* indices, int numTriangleIndices, uint32_t width, uint32_t height, uint32_t depth, VoxelBricks& bricks, Vec3 minExtents, Vec3 maxExtents, int numThreads=0);
@@ -426,3 +426,1401 @@ void BenchmarkUpdateGraph()
 {
 }
 //-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Asset cooking benchmark (-cookbenchmark), times the CPU cooking paths on the
+// bundled meshes, prints the results and exits without creating a device
+//-----------------------------------------------------------------------------
+const char* cookBenchmarkMeshes[] = { "apple.obj", "banana.obj", "bowl.obj", "dragon.obj", "pear.obj", "rope.obj", "sandcastle.obj", "torus.obj" };
+const int cookBenchmarkDim = 64;
+const int cookBenchmarkRepeats = 4;
+const int cookBenchmarkSDFDim = 128;
+
+void CookBenchmarkVoxelize(const Mesh* mesh, Vec3 lower, Vec3 upper)
+{
+	const int dim = cookBenchmarkDim;
+
+	std::vector<uint32_t> volume(dim*dim*dim);
+	std::vector<uint32_t> bits(GetVoxelWordCount(dim, dim, dim));
+
+	double serialTime = 0.0;
+	double parallelTime = 0.0;
+
+	for (int r=0; r < cookBenchmarkRepeats; ++r)
+	{
+		double start = GetSeconds();
+		Voxelize((const Vec3*)&mesh->m_positions[0], mesh->m_positions.size(), (const int*)&mesh->m_indices[0], mesh->m_indices.size(), dim, dim, dim, &volume[0], lower, upper);
+		serialTime += GetSeconds()-start;
+
+		start = GetSeconds();
+		VoxelizeBits((const Vec3*)&mesh->m_positions[0], mesh->m_positions.size(), (const int*)&mesh->m_indices[0], mesh->m_indices.size(), dim, dim, dim, &bits[0], lower, upper);
+		parallelTime += GetSeconds()-start;
+	}
+
+	// both paths should produce the same occupancy
+	int mismatches = 0;
+	for (int z=0; z < dim; ++z)
+		for (int y=0; y < dim; ++y)
+			for (int x=0; x < dim; ++x)
+				mismatches += (volume[z*dim*dim + y*dim + x] != 0) != GetVoxel(&bits[0], dim, dim, x, y, z);
+
+	printf("  Voxelize %d^3          serial %8.2fms  parallel %8.2fms  speedup %5.2fx  mismatches %d\n", dim, 
+		serialTime*1000.0/cookBenchmarkRepeats, parallelTime*1000.0/cookBenchmarkRepeats, serialTime/std::max(parallelTime, 1e-9), mismatches);
+}
+
+void CookBenchmarkSDF(const Mesh* mesh, Vec3 lower, Vec3 upper)
+{
+	const int dim = cookBenchmarkSDFDim;
+
+	std::vector<uint32_t> volume(dim*dim*dim);
+	Voxelize((const Vec3*)&mesh->m_positions[0], mesh->m_positions.size(), (const int*)&mesh->m_indices[0], mesh->m_indices.size(), dim, dim, dim, &volume[0], lower, upper);
+
+	std::vector<float> fmm(dim*dim*dim);
+	std::vector<float> edt(dim*dim*dim);
+
+	double start = GetSeconds();
+	MakeSDF(&volume[0], dim, dim, dim, &fmm[0]);
+	const double fmmTime = GetSeconds()-start;
+
+	start = GetSeconds();
+	MakeSDFExact(&volume[0], dim, dim, dim, &edt[0]);
+	const double edtTime = GetSeconds()-start;
+
+	// difference between the two fields in voxels
+	double sumError = 0.0;
+	double maxError = 0.0;
+	int signMismatches = 0;
+
+	for (int i=0; i < dim*dim*dim; ++i)
+	{
+		const double error = fabs(fmm[i]-edt[i])*dim;
+
+		sumError += error;
+		maxError = std::max(maxError, error);
+
+		signMismatches += (fmm[i] < 0.0f) != (edt[i] < 0.0f);
+	}
+
+	printf("  MakeSDF %d^3          fmm    %8.2fms  edt      %8.2fms  speedup %5.2fx  mean diff %.3f max diff %.3f voxels  sign mismatches %d\n", dim, 
+		fmmTime*1000.0, edtTime*1000.0, fmmTime/std::max(edtTime, 1e-9), sumError/(dim*dim*dim), maxError, signMismatches);
+}
+
+// narrow band SDF straight from the mesh against voxelizing and transforming, both measured against exact
+// closest point queries on a subset of the voxel centers
+void CookBenchmarkMeshSDF(const Mesh* mesh, Vec3 lower, Vec3 upper)
+{
+	const int dim = cookBenchmarkSDFDim;
+
+	const Vec3* vertices = (const Vec3*)&mesh->m_positions[0];
+	const int* indices = (const int*)&mesh->m_indices[0];
+
+	std::vector<float> edt(dim*dim*dim);
+	std::vector<float> band(dim*dim*dim);
+
+	double start = GetSeconds();
+
+	std::vector<uint32_t> volume(dim*dim*dim);
+	Voxelize(vertices, mesh->m_positions.size(), indices, mesh->m_indices.size(), dim, dim, dim, &volume[0], lower, upper);
+	MakeSDFExact(&volume[0], dim, dim, dim, &edt[0]);
+
+	const double edtTime = GetSeconds()-start;
+
+	start = GetSeconds();
+	MakeSDFFromMesh(vertices, mesh->m_positions.size(), indices, mesh->m_indices.size(), dim, dim, dim, &band[0], lower, upper);
+	const double bandTime = GetSeconds()-start;
+
+	AABBTree tree(vertices, mesh->GetNumVertices(), &mesh->m_indices[0], mesh->GetNumFaces());
+
+	const Vec3 delta = (upper-lower)/float(dim);
+	const float scale = 1.0f/(dim*std::max(std::max(delta.x, delta.y), delta.z));
+
+	double sumError[2] = { 0.0, 0.0 };
+	double maxError[2] = { 0.0, 0.0 };
+	int numSamples = 0;
+
+	for (int i=0; i < dim*dim*dim; i += 7)
+	{
+		const int x = i%dim;
+		const int y = (i/dim)%dim;
+		const int z = i/(dim*dim);
+
+		Vec3 closest;
+		float dist;
+		uint32_t face;
+
+		if (!tree.ClosestPoint(lower + Vec3(x+0.5f, y+0.5f, z+0.5f)*delta, FLT_MAX, closest, dist, face))
+			continue;
+
+		const float fields[2] = { edt[i], band[i] };
+
+		for (int k=0; k < 2; ++k)
+		{
+			const double error = fabs(fabs(fields[k]) - dist*scale)*dim;
+
+			sumError[k] += error;
+			maxError[k] = std::max(maxError[k], error);
+		}
+
+		++numSamples;
+	}
+
+	numSamples = std::max(numSamples, 1);
+
+	printf("  MakeSDFFromMesh %d^3  voxelize+edt %8.2fms  band %8.2fms  speedup %5.2fx  error voxelize+edt mean %.3f max %.3f  band mean %.3f max %.3f voxels\n", dim, 
+		edtTime*1000.0, bandTime*1000.0, edtTime/std::max(bandTime, 1e-9), sumError[0]/numSamples, maxError[0], sumError[1]/numSamples, maxError[1]);
+}
+
+// sparse brick voxelization and SDF against the dense path at increasing resolution
+void CookBenchmarkBricks(const Mesh* mesh, Vec3 lower, Vec3 upper)
+{
+	const int dims[] = { 64, 128, 256 };
+
+	for (int d=0; d < 3; ++d)
+	{
+		const int dim = dims[d];
+
+		double start = GetSeconds();
+
+		std::vector<uint32_t> bits(GetVoxelWordCount(dim, dim, dim));
+		VoxelizeBits((const Vec3*)&mesh->m_positions[0], mesh->m_positions.size(), (const int*)&mesh->m_indices[0], mesh->m_indices.size(), dim, dim, dim, &bits[0], lower, upper);
+
+		std::vector<uint32_t> volume(dim*dim*dim);
+		UnpackVoxels(&bits[0], dim, dim, dim, &volume[0]);
+
+		std::vector<float> sdf(dim*dim*dim);
+		MakeSDFExact(&volume[0], dim, dim, dim, &sdf[0]);
+
+		const double denseTime = GetSeconds()-start;
+
+		start = GetSeconds();
+
+		VoxelBricks bricks;
+		VoxelizeBricks((const Vec3*)&mesh->m_positions[0], mesh->m_positions.size(), (const int*)&mesh->m_indices[0], mesh->m_indices.size(), dim, dim, dim, bricks, lower, upper);
+
+		std::vector<float> brickSDF(bricks.GetNumBricks()*VoxelBricks::kBrickVoxels);
+		if (brickSDF.size())
+			MakeSDFBricks(bricks, &brickSDF[0]);
+
+		const double brickTime = GetSeconds()-start;
+
+		// occupancy must match everywhere, distances must match on occupied voxels and their face neighbors which
+		// is where rigid cooking samples the field, further inside allocated bricks the sparse field is an upper bound
+		int occupancyMismatches = 0;
+		int sdfMismatches = 0;
+
+		for (int z=0; z < dim; ++z)
+		{
+			for (int y=0; y < dim; ++y)
+			{
+				for (int x=0; x < dim; ++x)
+				{
+					const int index = z*dim*dim + y*dim + x;
+
+					occupancyMismatches += (volume[index] != 0) != bricks.GetVoxel(x, y, z);
+
+					bool sampled = volume[index] != 0;
+					sampled |= x > 0 && volume[index-1];
+					sampled |= x < dim-1 && volume[index+1];
+					sampled |= y > 0 && volume[index-dim];
+					sampled |= y < dim-1 && volume[index+dim];
+					sampled |= z > 0 && volume[index-dim*dim];
+					sampled |= z < dim-1 && volume[index+dim*dim];
+
+					if (sampled)
+					{
+						const int brick = bricks.FindBrick(x/VoxelBricks::kBrickDim, y/VoxelBricks::kBrickDim, z/VoxelBricks::kBrickDim);
+						const int local = ((z%VoxelBricks::kBrickDim)*VoxelBricks::kBrickDim + (y%VoxelBricks::kBrickDim))*VoxelBricks::kBrickDim + (x%VoxelBricks::kBrickDim);
+
+						sdfMismatches += brick < 0 || brickSDF[brick*VoxelBricks::kBrickVoxels + local] != sdf[index];
+					}
+				}
+			}
+		}
+
+		// voxel bits + distances for both layouts, plus the brick table and coordinates for the sparse one
+		const double denseMB = (bits.size()*sizeof(uint32_t) + sdf.size()*sizeof(float))/(1024.0*1024.0);
+		const double brickMB = (bricks.bits.size()*sizeof(uint32_t) + brickSDF.size()*sizeof(float) + bricks.brickIndices.size()*sizeof(int) + bricks.brickCoords.size()*sizeof(int))/(1024.0*1024.0);
+
+		printf("  Bricks %3d^3           dense  %8.2fms  bricks   %8.2fms  speedup %5.2fx  memory %8.2fMB vs %8.2fMB  occupancy mismatches %d  sdf mismatches %d\n", dim, 
+			denseTime*1000.0, brickTime*1000.0, denseTime/std::max(brickTime, 1e-9), denseMB, brickMB, occupancyMismatches, sdfMismatches);
+	}
+}
+
+// rigid cooking at resolutions beyond the previous 64 voxels per-side limit
+void CookBenchmarkRigid()
+{
+	struct RigidInstance
+	{
+		const char* file;
+		int dim;
+	};
+
+	const RigidInstance instances[] =
+	{
+		{ "bunny.ply", 64 },
+		{ "bunny.ply", 256 },
+		{ "dragon.obj", 256 },
+		{ "bowl.obj", 512 },
+	};
+
+	for (int i=0; i < int(sizeof(instances)/sizeof(instances[0])); ++i)
+	{
+		std::string path = std::string("../../data/") + instances[i].file;
+
+		Mesh* mesh = ImportMesh(GetFilePathByPlatform(path.c_str()).c_str());
+		if (!mesh)
+		{
+			printf("Could not load %s\n", path.c_str());
+			continue;
+		}
+
+		mesh->Normalize(1.0f);
+
+		// slightly smaller than the voxel size so that the longest edge spans dim voxels
+		const float radius = 0.999f/instances[i].dim;
+
+		const double start = GetSeconds();
+
+		NvFlexExtAsset* asset = NvFlexExtCreateRigidFromMesh((const float*)&mesh->m_positions[0], mesh->m_positions.size(), (const int*)&mesh->m_indices[0], mesh->m_indices.size(), radius, -radius*0.5f);
+
+		const double time = GetSeconds()-start;
+
+		printf("Rigid: %-20s %4d per-side  cook %8.2fms  particles %d\n", instances[i].file, instances[i].dim, time*1000.0, asset ? asset->numParticles : 0);
+
+		if (asset)
+			NvFlexExtDestroyAsset(asset);
+
+		delete mesh;
+	}
+}
+
+// soft body cooking parameters matching the instances of the demo's softbody scenes
+struct CookBenchmarkSoftInstance
+{
+	const char* file;
+	Vec3 scale;
+	float radius;
+	float clusterSpacing;
+	float clusterRadius;
+	float linkRadius;
+	float surfaceSampling;
+};
+
+const CookBenchmarkSoftInstance cookBenchmarkSoftInstances[] =
+{
+	{ "softs/octopus.obj", Vec3(32.0f), 0.1f, 2.75f, 3.0f, 0.0f, 1.0f },
+	{ "rope.obj", Vec3(50.0f), 0.1f, 1.5f, 0.0f, 0.0f, 0.0f },
+	{ "bowl_high.ply", Vec3(10.0f), 0.1f, 2.0f, 2.0f, 0.0f, 0.0f },
+	{ "box_ultra_high.ply", Vec3(20.0f, 0.2f, 20.0f), 0.05f, 1.0f, 2.0f, 2.0f, 0.0f },
+	{ "box_very_high.ply", Vec3(20.0f, 2.0f, 2.0f), 0.1f, 2.0f, 2.0f, 0.0f, 0.0f },
+	{ "teapot.ply", Vec3(25.0f), 0.1f, 3.0f, 0.0f, 0.0f, 0.0f },
+	{ "armadillo.ply", Vec3(25.0f), 0.1f, 3.0f, 0.0f, 0.0f, 0.0f },
+	{ "bunny.ply", Vec3(20.0f), 0.1f, 3.5f, 0.0f, 0.0f, 0.0f },
+};
+
+NvFlexExtAsset* CookBenchmarkCreateSoft(const Mesh* mesh, const CookBenchmarkSoftInstance& instance, NvFlexExtNeighborQuery query, int numThreads, double* time)
+{
+	NvFlexExtSoftCookDesc desc;
+	NvFlexExtSetSoftCookDescDefaults(&desc);
+
+	desc.samplingQuery = query;
+	desc.clusterQuery = query;
+	desc.linkQuery = query;
+	desc.numThreads = numThreads;
+
+	const float radius = instance.radius;
+
+	double start = GetSeconds();
+
+	NvFlexExtAsset* asset = NvFlexExtCreateSoftFromMeshWithDesc((const float*)&mesh->m_positions[0], mesh->m_positions.size(), (const int*)&mesh->m_indices[0], mesh->m_indices.size(), 
+		radius, 4.0f, instance.surfaceSampling, instance.clusterSpacing*radius, instance.clusterRadius*radius, 0.5f, instance.linkRadius*radius, 0.5f, 0.0f, 0.0f, 0.0f, &desc);
+
+	*time = GetSeconds()-start;
+
+	return asset;
+}
+
+// returns true if two soft assets are bitwise identical
+bool CookBenchmarkCompareSoft(const NvFlexExtAsset* a, const NvFlexExtAsset* b)
+{
+	if (a->numParticles != b->numParticles || a->numShapes != b->numShapes || a->numShapeIndices != b->numShapeIndices || a->numSprings != b->numSprings)
+		return false;
+
+	bool match = memcmp(a->particles, b->particles, sizeof(float)*4*a->numParticles) == 0;
+	match &= memcmp(a->shapeIndices, b->shapeIndices, sizeof(int)*a->numShapeIndices) == 0;
+	match &= memcmp(a->shapeOffsets, b->shapeOffsets, sizeof(int)*a->numShapes) == 0;
+	match &= memcmp(a->shapeCenters, b->shapeCenters, sizeof(float)*3*a->numShapes) == 0;
+
+	if (a->numSprings)
+	{
+		match &= memcmp(a->springIndices, b->springIndices, sizeof(int)*2*a->numSprings) == 0;
+		match &= memcmp(a->springRestLengths, b->springRestLengths, sizeof(float)*a->numSprings) == 0;
+	}
+
+	return match;
+}
+
+void CookBenchmarkSoft()
+{
+	const int numInstances = sizeof(cookBenchmarkSoftInstances)/sizeof(cookBenchmarkSoftInstances[0]);
+
+	for (int i=0; i < numInstances; ++i)
+	{
+		const CookBenchmarkSoftInstance& instance = cookBenchmarkSoftInstances[i];
+
+		std::string path = std::string("../../data/") + instance.file;
+
+		Mesh* mesh = ImportMesh(GetFilePathByPlatform(path.c_str()).c_str());
+		if (!mesh)
+		{
+			printf("Could not load %s\n", path.c_str());
+			continue;
+		}
+
+		// same transform as the softbody scenes
+		mesh->Normalize();
+		mesh->Transform(ScaleMatrix(instance.scale*instance.radius));
+
+		double sapTime;
+		double gridTime;
+		double parallelTime;
+
+		// serial sweep and prune is the reference, the other configurations should produce an identical asset
+		NvFlexExtAsset* sapAsset = CookBenchmarkCreateSoft(mesh, instance, eNvFlexExtNeighborQuerySweepAndPrune, 1, &sapTime);
+		NvFlexExtAsset* gridAsset = CookBenchmarkCreateSoft(mesh, instance, eNvFlexExtNeighborQueryHashGrid, 1, &gridTime);
+		NvFlexExtAsset* parallelAsset = CookBenchmarkCreateSoft(mesh, instance, eNvFlexExtNeighborQueryHashGrid, 0, &parallelTime);
+
+		printf("Soft: %-20s particles %6d  shapes %5d  springs %7d  sweep and prune %8.2fms  hash grid %8.2fms  hash grid parallel %8.2fms  speedup %5.2fx  %s\n", instance.file,
+			sapAsset->numParticles, sapAsset->numShapes, sapAsset->numSprings, sapTime*1000.0, gridTime*1000.0, parallelTime*1000.0, sapTime/std::max(parallelTime, 1e-9),
+			(CookBenchmarkCompareSoft(sapAsset, gridAsset) && CookBenchmarkCompareSoft(sapAsset, parallelAsset)) ? "match" : "MISMATCH");
+
+		NvFlexExtDestroyAsset(sapAsset);
+		NvFlexExtDestroyAsset(gridAsset);
+		NvFlexExtDestroyAsset(parallelAsset);
+
+		delete mesh;
+	}
+}
+
+// cooks every soft instance synchronously and then as one batch on a cook queue, reports how long the
+// submitting thread is blocked and the time until the whole batch is available
+void CookBenchmarkQueue()
+{
+	const int numInstances = sizeof(cookBenchmarkSoftInstances)/sizeof(cookBenchmarkSoftInstances[0]);
+
+	std::vector<Mesh*> meshes;
+	std::vector<NvFlexExtCookJobDesc> jobs;
+
+	for (int i=0; i < numInstances; ++i)
+	{
+		const CookBenchmarkSoftInstance& instance = cookBenchmarkSoftInstances[i];
+
+		std::string path = std::string("../../data/") + instance.file;
+
+		Mesh* mesh = ImportMesh(GetFilePathByPlatform(path.c_str()).c_str());
+		if (!mesh)
+			continue;
+
+		mesh->Normalize();
+		mesh->Transform(ScaleMatrix(instance.scale*instance.radius));
+
+		const float radius = instance.radius;
+
+		NvFlexExtCookJobDesc job;
+		memset(&job, 0, sizeof(job));
+
+		job.type = eNvFlexExtCookSoft;
+		job.vertices = (const float*)&mesh->m_positions[0];
+		job.numVertices = mesh->m_positions.size();
+		job.indices = (const int*)&mesh->m_indices[0];
+		job.numIndices = mesh->m_indices.size();
+
+		job.soft.particleSpacing = radius;
+		job.soft.volumeSampling = 4.0f;
+		job.soft.surfaceSampling = instance.surfaceSampling;
+		job.soft.clusterSpacing = instance.clusterSpacing*radius;
+		job.soft.clusterRadius = instance.clusterRadius*radius;
+		job.soft.clusterStiffness = 0.5f;
+		job.soft.linkRadius = instance.linkRadius*radius;
+		job.soft.linkStiffness = 0.5f;
+
+		// parallelism comes from running jobs side by side
+		NvFlexExtSetSoftCookDescDefaults(&job.soft.desc);
+		job.soft.desc.numThreads = 1;
+
+		meshes.push_back(mesh);
+		jobs.push_back(job);
+	}
+
+	const int numJobs = int(jobs.size());
+	if (!numJobs)
+		return;
+
+	std::vector<NvFlexExtAsset*> serialAssets(numJobs);
+
+	double start = GetSeconds();
+
+	for (int i=0; i < numJobs; ++i)
+	{
+		const NvFlexExtCookJobDesc& job = jobs[i];
+		const NvFlexExtSoftCookParams& p = job.soft;
+
+		serialAssets[i] = NvFlexExtCreateSoftFromMeshWithDesc(job.vertices, job.numVertices, job.indices, job.numIndices, p.particleSpacing, p.volumeSampling, p.surfaceSampling, 
+			p.clusterSpacing, p.clusterRadius, p.clusterStiffness, p.linkRadius, p.linkStiffness, p.globalStiffness, p.clusterPlasticThreshold, p.clusterPlasticCreep, &p.desc);
+	}
+
+	const double serialTime = GetSeconds()-start;
+
+	NvFlexExtCookQueue* queue = NvFlexExtCreateCookQueue(0);
+	std::vector<NvFlexExtCookJob*> handles(numJobs);
+
+	start = GetSeconds();
+
+	NvFlexExtSubmitCookJobs(queue, &jobs[0], numJobs, &handles[0]);
+
+	const double submitTime = GetSeconds()-start;
+
+	// poll as a game loop would between frames
+	int numPolls = 0;
+	for (int i=0; i < numJobs; ++i)
+	{
+		while (!NvFlexExtIsCookJobComplete(handles[i]))
+		{
+			++numPolls;
+			Sleep(0.001);
+		}
+	}
+
+	const double queueTime = GetSeconds()-start;
+
+	bool match = true;
+
+	for (int i=0; i < numJobs; ++i)
+	{
+		NvFlexExtAsset* asset = NvFlexExtReleaseCookJob(handles[i]);
+
+		match &= CookBenchmarkCompareSoft(serialAssets[i], asset);
+
+		NvFlexExtDestroyAsset(asset);
+		NvFlexExtDestroyAsset(serialAssets[i]);
+	}
+
+	NvFlexExtDestroyCookQueue(queue);
+
+	for (int i=0; i < numJobs; ++i)
+		delete meshes[i];
+
+	printf("Cook queue: %d soft jobs  synchronous %8.2fms  queued %8.2fms  submit blocked %6.3fms  polls %d  %s\n", numJobs, 
+		serialTime*1000.0, queueTime*1000.0, submitTime*1000.0, numPolls, match ? "match" : "MISMATCH");
+}
+
+// with -assetcache=<dir> cooks each soft instance through the cache twice, the first pass cooks (unless 
+// the entry exists from a previous run) and the second must be a hit that matches a fresh cook
+void CookBenchmarkCache()
+{
+	if (!g_assetCache)
+		return;
+
+	const int numInstances = sizeof(cookBenchmarkSoftInstances)/sizeof(cookBenchmarkSoftInstances[0]);
+
+	for (int i=0; i < numInstances; ++i)
+	{
+		const CookBenchmarkSoftInstance& instance = cookBenchmarkSoftInstances[i];
+
+		std::string path = std::string("../../data/") + instance.file;
+
+		Mesh* mesh = ImportMesh(GetFilePathByPlatform(path.c_str()).c_str());
+		if (!mesh)
+			continue;
+
+		mesh->Normalize();
+		mesh->Transform(ScaleMatrix(instance.scale*instance.radius));
+
+		double cookTime;
+		double firstTime;
+		double hitTime;
+
+		NvFlexExtSetAssetCacheDirectory(NULL);
+		NvFlexExtAsset* cooked = CookBenchmarkCreateSoft(mesh, instance, eNvFlexExtNeighborQueryHashGrid, 0, &cookTime);
+
+		NvFlexExtSetAssetCacheDirectory(g_assetCache);
+		NvFlexExtAsset* first = CookBenchmarkCreateSoft(mesh, instance, eNvFlexExtNeighborQueryHashGrid, 0, &firstTime);
+		NvFlexExtAsset* hit = CookBenchmarkCreateSoft(mesh, instance, eNvFlexExtNeighborQueryHashGrid, 0, &hitTime);
+
+		printf("Cache: %-20s cook %8.2fms  first %8.2fms  cached %8.2fms  speedup %7.2fx  %s\n", instance.file, 
+			cookTime*1000.0, firstTime*1000.0, hitTime*1000.0, cookTime/std::max(hitTime, 1e-9), (CookBenchmarkCompareSoft(cooked, first) && CookBenchmarkCompareSoft(cooked, hit)) ? "match" : "MISMATCH");
+
+		NvFlexExtDestroyAsset(cooked);
+		NvFlexExtDestroyAsset(first);
+		NvFlexExtDestroyAsset(hit);
+
+		delete mesh;
+	}
+}
+
+void CookBenchmark()
+{
+	const int numMeshes = sizeof(cookBenchmarkMeshes)/sizeof(cookBenchmarkMeshes[0]);
+
+	// cook timings should not be served from the asset cache, CookBenchmarkCache() enables it again
+	NvFlexExtSetAssetCacheDirectory(NULL);
+
+	for (int i=0; i < numMeshes; ++i)
+	{
+		std::string path = std::string("../../data/") + cookBenchmarkMeshes[i];
+
+		Mesh* mesh = ImportMesh(GetFilePathByPlatform(path.c_str()).c_str());
+		if (!mesh)
+		{
+			printf("Could not load %s\n", path.c_str());
+			continue;
+		}
+
+		// voxelize inside a slightly expanded unit cube
+		mesh->Normalize(0.9f);
+		mesh->Transform(TranslationMatrix(Point3(0.05f, 0.05f, 0.05f)));
+
+		printf("Mesh: %s (%d triangles)\n", cookBenchmarkMeshes[i], mesh->GetNumFaces());
+
+		CookBenchmarkVoxelize(mesh, Vec3(0.0f), Vec3(1.0f));
+		CookBenchmarkSDF(mesh, Vec3(0.0f), Vec3(1.0f));
+		CookBenchmarkMeshSDF(mesh, Vec3(0.0f), Vec3(1.0f));
+		CookBenchmarkBricks(mesh, Vec3(0.0f), Vec3(1.0f));
+
+		delete mesh;
+	}
+
+	CookBenchmarkRigid();
+	CookBenchmarkSoft();
+	CookBenchmarkQueue();
+	CookBenchmarkCache();
+}
+
+// Instance update benchmark (-instancebenchmark), times NvFlexExtUpdateInstances() on containers of small
+// rigid instances against a serial per-element copy from the mapped shape data
+void InstanceBenchmark(NvFlexLibrary* lib)
+{
+	Mesh* box = CreateCubeMesh();
+
+	NvFlexExtAsset* asset = NvFlexExtCreateRigidFromMesh((const float*)&box->m_positions[0], box->m_positions.size(), (const int*)&box->m_indices[0], box->m_indices.size(), 0.4f, 0.0f);
+
+	delete box;
+
+	if (!asset)
+		return;
+
+	const int counts[] = { 1000, 10000, 100000 };
+	const int numIterations = 20;
+
+	for (int k=0; k < int(sizeof(counts)/sizeof(counts[0])); ++k)
+	{
+		const int numInstances = counts[k];
+
+		NvFlexSolverDesc desc;
+		NvFlexSetSolverDescDefaults(&desc);
+		desc.maxParticles = numInstances*asset->numParticles;
+
+		NvFlexSolver* solver = NvFlexCreateSolver(lib, &desc);
+		NvFlexExtContainer* container = NvFlexExtCreateContainer(lib, solver, desc.maxParticles);
+
+		std::vector<NvFlexExtInstance*> instances(numInstances);
+
+		NvFlexExtParticleData particles = NvFlexExtMapParticleData(container);
+
+		for (int i=0; i < numInstances; ++i)
+		{
+			const Matrix44 transform = TranslationMatrix(Point3(float(i%100), 0.0f, float(i/100)));
+
+			instances[i] = NvFlexExtCreateInstance(container, &particles, asset, transform, 0.0f, 0.0f, 0.0f, NvFlexMakePhase(i, 0), 1.0f);
+		}
+
+		NvFlexExtUnmapParticleData(container);
+
+		NvFlexExtPushToDevice(container);
+		NvFlexExtPullFromDevice(container);
+
+		// previous implementation, one element at a time from the container's mapped arrays
+		double start = GetSeconds();
+
+		for (int n=0; n < numIterations; ++n)
+		{
+			NvFlexExtShapeData shapes = NvFlexExtMapShapeData(container);
+
+			for (int i=0; i < numInstances; ++i)
+			{
+				NvFlexExtInstance* inst = instances[i];
+
+				for (int s=0; s < inst->asset->numShapes; ++s)
+				{
+					((Vec3*)inst->shapeTranslations)[s] = ((Vec3*)shapes.positions)[inst->shapeIndex + s];
+					((Quat*)inst->shapeRotations)[s] = ((Quat*)shapes.rotations)[inst->shapeIndex + s];
+				}
+			}
+
+			NvFlexExtUnmapShapeData(container);
+		}
+
+		const double serialTime = (GetSeconds()-start)/numIterations;
+
+		start = GetSeconds();
+
+		for (int n=0; n < numIterations; ++n)
+			NvFlexExtUpdateInstances(container);
+
+		const double parallelTime = (GetSeconds()-start)/numIterations;
+
+		start = GetSeconds();
+
+		for (int n=0; n < numIterations; ++n)
+			NvFlexExtUpdateInstancesNoCopy(container);
+
+		const double transformsTime = (GetSeconds()-start)/numIterations;
+
+		// instance copies and the shared transform arrays should match the container's data
+		NvFlexExtShapeTransforms transforms;
+		NvFlexExtGetShapeTransforms(container, &transforms);
+
+		NvFlexExtShapeData shapes = NvFlexExtMapShapeData(container);
+
+		int mismatches = 0;
+
+		for (int i=0; i < numInstances; ++i)
+		{
+			const NvFlexExtInstance* inst = instances[i];
+
+			const size_t translationBytes = sizeof(float)*3*inst->asset->numShapes;
+			const size_t rotationBytes = sizeof(float)*4*inst->asset->numShapes;
+
+			if (memcmp(inst->shapeTranslations, &shapes.positions[inst->shapeIndex*3], translationBytes) != 0 ||
+				memcmp(inst->shapeRotations, &shapes.rotations[inst->shapeIndex*4], rotationBytes) != 0 ||
+				memcmp(&transforms.translations[inst->shapeIndex*3], &shapes.positions[inst->shapeIndex*3], translationBytes) != 0 ||
+				memcmp(&transforms.rotations[inst->shapeIndex*4], &shapes.rotations[inst->shapeIndex*4], rotationBytes) != 0)
+				++mismatches;
+		}
+
+		NvFlexExtUnmapShapeData(container);
+
+		printf("Instances: %6d  serial copy %7.3fms  parallel update %7.3fms  shared arrays only %7.3fms  mismatches %d\n", 
+			numInstances, serialTime*1000.0, parallelTime*1000.0, transformsTime*1000.0, mismatches);
+
+		for (int i=0; i < numInstances; ++i)
+			NvFlexExtDestroyInstance(container, instances[i]);
+
+		NvFlexExtDestroyContainer(container);
+		NvFlexDestroySolver(solver);
+	}
+
+	NvFlexExtDestroyAsset(asset);
+}
+
+// Buffer pool benchmark (-poolbenchmark), grows a set of vectors with push_back() the way scenes fill
+// SimBuffers during Init(), then destroys and rebuilds them as a scene reset does, with and without a pool
+template <typename Vector>
+void BufferPoolBenchmarkFill(std::vector<Vector*>& vectors, int numElements)
+{
+	for (size_t v=0; v < vectors.size(); ++v)
+	{
+		Vector& vec = *vectors[v];
+
+		vec.map();
+
+		for (int i=0; i < numElements; ++i)
+			vec.push_back(Vec4(float(i), float(v), 0.0f, 1.0f));
+
+		vec.unmap();
+	}
+}
+
+void BufferPoolBenchmark(NvFlexLibrary* lib)
+{
+	const int numVectors = 200;
+	const int numResets = 5;
+	const int counts[] = { 1000, 10000, 100000 };
+
+	for (int k=0; k < int(sizeof(counts)/sizeof(counts[0])); ++k)
+	{
+		const int numElements = counts[k];
+
+		double times[2];
+		NvFlexExtBufferPoolStats stats;
+
+		for (int usePool=0; usePool < 2; ++usePool)
+		{
+			NvFlexExtBufferPool* pool = usePool ? NvFlexExtCreateBufferPool(lib, 0) : NULL;
+
+			const double start = GetSeconds();
+
+			for (int r=0; r < numResets; ++r)
+			{
+				std::vector<NvFlexVector<Vec4>*> vectors(numVectors);
+
+				for (int v=0; v < numVectors; ++v)
+					vectors[v] = pool ? new NvFlexVector<Vec4>(NvFlexVectorPool(), pool) : new NvFlexVector<Vec4>(lib);
+
+				BufferPoolBenchmarkFill(vectors, numElements);
+
+				// fragmentation while the scene is loaded, peaks cover all resets
+				if (pool && r == numResets-1)
+					NvFlexExtGetBufferPoolStats(pool, &stats);
+
+				for (int v=0; v < numVectors; ++v)
+					delete vectors[v];
+			}
+
+			times[usePool] = (GetSeconds()-start)/numResets;
+
+			if (pool)
+				NvFlexExtDestroyBufferPool(pool);
+		}
+
+		printf("Elements: %6d  library buffers %7.2fms  pooled %7.2fms  allocs %d recycled %d  peak requested %.1fMB peak reserved %.1fMB fragmentation %.2f\n",
+			numElements, times[0]*1000.0, times[1]*1000.0, stats.numAllocs, stats.numRecycled,
+			stats.peakRequestedBytes/(1024.0*1024.0), stats.peakReservedBytes/(1024.0*1024.0), stats.fragmentation);
+	}
+}
+
+// SIMD microbenchmarks (-simdbenchmark), compares the batch routines in core/simd.h against the 
+// scalar loops they replace, build with ENABLE_SIMD=1 to select a vector backend
+template <typename Func>
+double SimdBenchmarkTime(Func func, int numIterations)
+{
+	const double start = GetSeconds();
+
+	for (int i=0; i < numIterations; ++i)
+		func();
+
+	return (GetSeconds()-start)/numIterations;
+}
+
+void SimdBenchmarkReport(const char* name, double scalarTime, double simdTime, float maxError)
+{
+	printf("%-24s scalar %8.3fms  %s %8.3fms  speedup %5.2fx  max error %g\n", 
+		name, scalarTime*1000.0, SimdBackendName(), simdTime*1000.0, scalarTime/simdTime, maxError);
+}
+
+void SimdBenchmark()
+{
+	const int numPoints = 1000000;
+	const int numIterations = 20;
+
+	RandInit();
+
+	std::vector<Vec3> points(numPoints);
+	std::vector<int> indices(numPoints);
+
+	for (int i=0; i < numPoints; ++i)
+	{
+		points[i] = RandomUnitVector()*Randf(0.0f, 10.0f);
+		indices[i] = Rand()%numPoints;
+	}
+
+	// bounds
+	{
+		Vec3 lower[2], upper[2];
+
+		const double scalarTime = SimdBenchmarkTime([&]()
+		{
+			lower[0] = Vec3(FLT_MAX);
+			upper[0] = Vec3(-FLT_MAX);
+
+			for (int i=0; i < numPoints; ++i)
+			{
+				lower[0] = Min(lower[0], points[i]);
+				upper[0] = Max(upper[0], points[i]);
+			}
+		}, numIterations);
+
+		const double simdTime = SimdBenchmarkTime([&]() { SimdBounds(&points[0], numPoints, lower[1], upper[1]); }, numIterations);
+
+		SimdBenchmarkReport("Bounds", scalarTime, simdTime, Max(Length(lower[1]-lower[0]), Length(upper[1]-upper[0])));
+	}
+
+	// mean and radius of an indexed cluster
+	{
+		Vec3 mean[2];
+		float radius[2];
+
+		const double scalarTime = SimdBenchmarkTime([&]()
+		{
+			Vec3 sum;
+			for (int i=0; i < numPoints; ++i)
+				sum += points[indices[i]];
+
+			mean[0] = sum/float(numPoints);
+
+			float radiusSq = 0.0f;
+			for (int i=0; i < numPoints; ++i)
+				radiusSq = Max(radiusSq, LengthSq(points[indices[i]] - mean[0]));
+
+			radius[0] = sqrtf(radiusSq);
+		}, numIterations);
+
+		const double simdTime = SimdBenchmarkTime([&]()
+		{
+			mean[1] = SimdMean(&points[0], &indices[0], numPoints);
+			radius[1] = SimdRadius(&points[0], mean[1], &indices[0], numPoints);
+		}, numIterations);
+
+		SimdBenchmarkReport("Mean and radius", scalarTime, simdTime, Max(Length(mean[1]-mean[0]), fabsf(radius[1]-radius[0])));
+	}
+
+	// skinning weights, four squared bone distances per-vertex
+	{
+		const float falloff = 1.5f;
+		const float maxDistSq = 50.0f;
+
+		std::vector<float> distances(numPoints);
+		std::vector<float> weights[2] = { std::vector<float>(numPoints), std::vector<float>(numPoints) };
+
+		for (int i=0; i < numPoints; ++i)
+			distances[i] = LengthSq(points[i]);
+
+		const double scalarTime = SimdBenchmarkTime([&]()
+		{
+			for (int i=0; i < numPoints; ++i)
+				weights[0][i] = distances[i] > maxDistSq ? 0.0f : 1.0f/(powf(distances[i], falloff) + 0.0001f);
+		}, numIterations);
+
+		const double simdTime = SimdBenchmarkTime([&]() { SimdInverseDistanceWeights(&distances[0], numPoints, falloff, maxDistSq, &weights[1][0]); }, numIterations);
+
+		float maxError = 0.0f;
+		for (int i=0; i < numPoints; ++i)
+			maxError = Max(maxError, fabsf(weights[1][i]-weights[0][i])/Max(weights[0][i], 1.0f));
+
+		SimdBenchmarkReport("Skinning weights", scalarTime, simdTime, maxError);
+	}
+
+	// moving frame, reference is the per-particle loop from MovingFrame
+	{
+		// copies for the scalar reference, the single threaded and the threaded apply
+		std::vector<Vec4> positions[3];
+		std::vector<Vec3> velocities[3];
+
+		NvFlexExtMovingFrame frame;
+		const Vec3 startTranslation(0.0f);
+		const Quat startRotation;
+		NvFlexExtMovingFrameInit(&frame, startTranslation, startRotation);
+
+		const Vec3 translation(0.1f, 0.0f, 0.05f);
+		const Quat rotation = QuatFromAxisAngle(Vec3(0.0f, 1.0f, 0.0f), 0.05f);
+		NvFlexExtMovingFrameUpdate(&frame, translation, rotation, 1.0f/60.0f);
+
+		for (int k=0; k < 3; ++k)
+		{
+			positions[k].resize(numPoints);
+			velocities[k].resize(numPoints);
+
+			for (int i=0; i < numPoints; ++i)
+			{
+				positions[k][i] = Vec4(points[i], 1.0f);
+				velocities[k][i] = Vec3(0.0f);
+			}
+		}
+
+		const Matrix44 delta(&frame.delta[0][0]);
+		const Vec3 position(frame.position);
+		const Vec3 omega(frame.omega);
+		const Vec3 tau(frame.tau);
+		const Vec3 linearForce = -Vec3(frame.acceleration);
+		const float dt = 1.0f/60.0f;
+
+		const double scalarTime = SimdBenchmarkTime([&]()
+		{
+			for (int i=0; i < numPoints; ++i)
+			{
+				const Vec3 p = Vec3(positions[0][i]);
+				const Vec3 d = p - position;
+				const Vec3 angularForce = -Cross(omega, Cross(omega, d)) - Cross(tau, d);
+
+				const Vec3 q = Vec3(delta*Vec4(p, 1.0f));
+				positions[0][i] = Vec4(q, positions[0][i].w);
+				velocities[0][i] += (linearForce + angularForce)*dt;
+			}
+		}, numIterations);
+
+		const double simdTime = SimdBenchmarkTime([&]()
+		{
+			NvFlexExtMovingFrameApply(&frame, (float*)&positions[1][0], (float*)&velocities[1][0], numPoints, 1.0f, 1.0f, dt);
+		}, numIterations);
+
+		float maxError = 0.0f;
+		for (int i=0; i < numPoints; ++i)
+			maxError = Max(maxError, Max(Length(Vec3(positions[1][i])-Vec3(positions[0][i])), Length(velocities[1][i]-velocities[0][i])));
+
+		SimdBenchmarkReport("Moving frame apply", scalarTime, simdTime, maxError);
+
+		const double threadedTime = SimdBenchmarkTime([&]()
+		{
+			NvFlexExtMovingFrameApplyThreaded(&frame, (float*)&positions[2][0], (float*)&velocities[2][0], numPoints, 1.0f, 1.0f, dt, 0);
+		}, numIterations);
+
+		// threads process disjoint ranges with the same kernel so the result should match the single threaded apply exactly
+		maxError = 0.0f;
+		for (int i=0; i < numPoints; ++i)
+			maxError = Max(maxError, Max(Length(Vec3(positions[2][i])-Vec3(positions[1][i])), Length(velocities[2][i]-velocities[1][i])));
+
+		SimdBenchmarkReport("Moving frame threaded", scalarTime, threadedTime, maxError);
+	}
+}
+
+// Force field benchmark (-forcefieldbenchmark), times solver updates with an increasing number of force fields 
+// scattered through a block of particles, reported relative to an update with an empty field set so the cost of 
+// the callback is visible separately from the rest of the step
+double ForceFieldBenchmarkUpdate(NvFlexSolver* solver, NvFlexBuffer* positions, NvFlexBuffer* velocities, NvFlexBuffer* result, int numIterations)
+{
+	double minTime = FLT_MAX;
+
+	// fastest of several updates from the same start state, the field cost is small compared to the step so this filters out most of the noise
+	for (int i=0; i < numIterations; ++i)
+	{
+		NvFlexSetParticles(solver, positions, NULL);
+		NvFlexSetVelocities(solver, velocities, NULL);
+
+		const double start = GetSeconds();
+
+		NvFlexUpdateSolver(solver, 1.0f/60.0f, 1, false);
+
+		// read back to wait for the update to complete
+		NvFlexGetVelocities(solver, result, NULL);
+		NvFlexMap(result, eNvFlexMapWait);
+		NvFlexUnmap(result);
+
+		minTime = Min(minTime, GetSeconds()-start);
+	}
+
+	return minTime;
+}
+
+void ForceFieldBenchmark(NvFlexLibrary* lib)
+{
+	const int dim = 48;
+	const int numParticles = dim*dim*dim;
+	const float spacing = 0.1f;
+	const int numIterations = 10;
+
+	NvFlexSolverDesc desc;
+	NvFlexSetSolverDescDefaults(&desc);
+	desc.maxParticles = numParticles;
+
+	NvFlexSolver* solver = NvFlexCreateSolver(lib, &desc);
+
+	NvFlexParams params;
+	NvFlexGetParams(solver, &params);
+	params.radius = spacing;
+	params.gravity[0] = params.gravity[1] = params.gravity[2] = 0.0f;
+	params.numIterations = 1;
+	NvFlexSetParams(solver, &params);
+
+	NvFlexBuffer* positions = NvFlexAllocBuffer(lib, numParticles, sizeof(Vec4), eNvFlexBufferHost);
+	NvFlexBuffer* velocities = NvFlexAllocBuffer(lib, numParticles, sizeof(Vec3), eNvFlexBufferHost);
+	NvFlexBuffer* result = NvFlexAllocBuffer(lib, numParticles, sizeof(Vec3), eNvFlexBufferHost);
+	NvFlexBuffer* phases = NvFlexAllocBuffer(lib, numParticles, sizeof(int), eNvFlexBufferHost);
+	NvFlexBuffer* active = NvFlexAllocBuffer(lib, numParticles, sizeof(int), eNvFlexBufferHost);
+
+	Vec4* p = (Vec4*)NvFlexMap(positions, eNvFlexMapWait);
+	Vec3* v = (Vec3*)NvFlexMap(velocities, eNvFlexMapWait);
+	int* phase = (int*)NvFlexMap(phases, eNvFlexMapWait);
+	int* a = (int*)NvFlexMap(active, eNvFlexMapWait);
+
+	for (int i=0; i < numParticles; ++i)
+	{
+		p[i] = Vec4(float(i%dim), float((i/dim)%dim), float(i/(dim*dim)), 1.0f/spacing)*spacing;
+		v[i] = Vec3(0.0f);
+		phase[i] = NvFlexMakePhase(0, 0);
+		a[i] = i;
+	}
+
+	NvFlexUnmap(positions);
+	NvFlexUnmap(velocities);
+	NvFlexUnmap(phases);
+	NvFlexUnmap(active);
+
+	NvFlexSetParticles(solver, positions, NULL);
+	NvFlexSetVelocities(solver, velocities, NULL);
+	NvFlexSetPhases(solver, phases, NULL);
+	NvFlexSetActive(solver, active, NULL);
+	NvFlexSetActiveCount(solver, numParticles);
+
+	NvFlexExtForceFieldCallback* callback = NvFlexExtCreateForceFieldCallback(solver);
+
+	RandInit();
+
+	// small explosions scattered through the block, only a few overlap any one particle
+	std::vector<NvFlexExtForceField> forceFields;
+	
+	for (int numForceFields=1; numForceFields <= 1024; numForceFields *= 2)
+	{
+		while (int(forceFields.size()) < numForceFields)
+		{
+			NvFlexExtForceField f;
+			(Vec3&)f.mPosition = RandomUnitVector()*Randf(0.0f, 0.5f*dim*spacing) + Vec3(0.5f*dim*spacing);
+			f.mRadius = Randf(0.2f, 0.8f);
+			f.mStrength = -0.01f;
+			f.mMode = eNvFlexExtModeVelocityChange;
+			f.mLinearFalloff = true;
+
+			forceFields.push_back(f);
+		}
+
+		// baseline with the callback registered but no fields, measured alongside each field count to track drift in the solver cost
+		NvFlexExtSetForceFields(callback, NULL, 0);
+
+		const double baseTime = ForceFieldBenchmarkUpdate(solver, positions, velocities, result, numIterations);
+
+		const double start = GetSeconds();
+
+		NvFlexExtSetForceFields(callback, &forceFields[0], numForceFields);
+
+		const double setTime = GetSeconds()-start;
+
+		// fields are applied on every update once set
+		const double updateTime = ForceFieldBenchmarkUpdate(solver, positions, velocities, result, numIterations);
+
+		printf("Force fields: %4d  set %7.3fms  update %7.3fms  callback %7.3fms\n", 
+			numForceFields, setTime*1000.0, updateTime*1000.0, (updateTime-baseTime)*1000.0);
+	}
+
+	NvFlexExtDestroyForceFieldCallback(callback);
+	
+	NvFlexFreeBuffer(positions);
+	NvFlexFreeBuffer(velocities);
+	NvFlexFreeBuffer(result);
+	NvFlexFreeBuffer(phases);
+	NvFlexFreeBuffer(active);
+
+	NvFlexDestroySolver(solver);
+}
+
+// Mesh import benchmark (-meshbenchmark), times loading every obj and ply file in the data directory 
+// using only the calling thread and then using every thread in the default pool, then compares parsing 
+// the file and building an AABB tree against loading the same mesh and tree from the binary format
+void MeshBenchmark()
+{
+	const char* binPath = "meshbenchmark.bin";
+
+	const char* directories[] = { "../../data/", "../../data/softs/" };
+	const char* patterns[] = { "*.obj", "*.ply" };
+
+	printf("%-32s %10s %10s %12s %12s %10s %10s %12s %12s\n", "Mesh", "KB", "Vertices", "1 thread", "All threads", "MB/s", "Speedup", "Parse+tree", "Binary+tree");
+
+	double totalTime[4] = { 0.0, 0.0, 0.0, 0.0 };
+	double totalBytes = 0.0;
+
+	for (int d=0; d < int(sizeof_array(directories)); ++d)
+	{
+		for (int p=0; p < int(sizeof_array(patterns)); ++p)
+		{
+			std::vector<std::string> files;
+			FileScan((std::string(directories[d]) + patterns[p]).c_str(), files);
+
+			for (int f=0; f < int(files.size()); ++f)
+			{
+				const std::string path = std::string(directories[d]) + files[f];
+
+				MappedFile file;
+				if (!MapFile(path.c_str(), file))
+					continue;
+
+				const double bytes = double(file.size);
+				UnmapFile(file);
+
+				double times[4];
+				int numVertices = 0;
+
+				for (int t=0; t < 2; ++t)
+				{
+					// fastest of a few loads, the first one also warms the file cache
+					times[t] = FLT_MAX;
+
+					for (int i=0; i < 3; ++i)
+					{
+						const double start = GetSeconds();
+
+						Mesh* mesh = ImportMesh(path.c_str(), t == 0 ? 1 : 0);
+
+						times[t] = Min(times[t], GetSeconds()-start);
+
+						if (mesh)
+							numVertices = int(mesh->GetNumVertices());
+
+						delete mesh;
+					}
+
+					totalTime[t] += times[t];
+				}
+
+				// startup cost of a scene that needs the mesh and a tree over it
+				Mesh* mesh = ImportMesh(path.c_str(), 0);
+
+				if (!mesh || mesh->GetNumFaces() == 0)
+				{
+					delete mesh;
+					continue;
+				}
+
+				{
+					const double start = GetSeconds();
+
+					AABBTree tree((const Vec3*)&mesh->m_positions[0], mesh->GetNumVertices(), &mesh->m_indices[0], mesh->GetNumFaces());
+
+					times[2] = times[1] + GetSeconds()-start;
+				}
+
+				ExportMeshToBin(binPath, mesh);
+				delete mesh;
+
+				times[3] = FLT_MAX;
+
+				for (int i=0; i < 3; ++i)
+				{
+					const double start = GetSeconds();
+
+					MeshBin bin;
+					if (!MapMeshBin(binPath, bin))
+						break;
+
+					Mesh* binMesh = CreateMeshFromBin(bin);
+					AABBTree tree((const Vec3*)&binMesh->m_positions[0], binMesh->GetNumVertices(), &binMesh->m_indices[0], binMesh->GetNumFaces(), bin.nodes, bin.numNodes, bin.faceOrder);
+
+					UnmapMeshBin(bin);
+
+					times[3] = Min(times[3], GetSeconds()-start);
+
+					delete binMesh;
+				}
+
+				totalTime[2] += times[2];
+				totalTime[3] += times[3];
+				totalBytes += bytes;
+
+				printf("%-32s %10.1f %10d %10.2fms %10.2fms %10.1f %9.2fx %10.2fms %10.2fms\n", 
+					files[f].c_str(), bytes/1024.0, numVertices, times[0]*1000.0, times[1]*1000.0, bytes/(1024.0*1024.0)/times[1], times[0]/times[1], times[2]*1000.0, times[3]*1000.0);
+			}
+		}
+	}
+
+	remove(binPath);
+
+	printf("%-32s %10.1f %10s %10.2fms %10.2fms %10.1f %9.2fx %10.2fms %10.2fms\n", 
+		"Total", totalBytes/1024.0, "", totalTime[0]*1000.0, totalTime[1]*1000.0, totalBytes/(1024.0*1024.0)/totalTime[1], totalTime[0]/totalTime[1], totalTime[2]*1000.0, totalTime[3]*1000.0);
+}
+
+// AABB tree benchmark (-aabbtreebenchmark), compares the sweep and binned SAH builds on build time, closest hit 
+// rays cast into the mesh from outside its bounds the way PickParticle() casts them into the scene, and the all 
+// hits axis aligned columns traced by the voxelizer, each one ray at a time and as packets (on one thread)
+// refitting against rebuilding each frame for a mesh twisting about its vertical axis, 
+// pick rays are traced through both trees to show the cost of refit degradation
+void AABBTreeRefitBenchmark(const Mesh* mesh, const char* name)
+{
+	const int numFrames = 60;
+	const int numRays = 20000;
+
+	const std::vector<Vec3> rest((const Vec3*)&mesh->m_positions[0], (const Vec3*)&mesh->m_positions[0] + mesh->GetNumVertices());
+	std::vector<Vec3> positions(rest);
+
+	Vec3 lower, upper;
+	mesh->GetBounds(lower, upper);
+
+	const Vec3 center = 0.5f*(lower+upper);
+	const float radius = Length(upper-lower);
+	const float height = std::max(upper.y-lower.y, FLT_EPSILON);
+
+	RandInit();
+
+	std::vector<Vec3> starts(numRays);
+	std::vector<Vec3> dirs(numRays);
+
+	for (int i=0; i < numRays; ++i)
+	{
+		starts[i] = center + RandomUnitVector()*radius;
+		dirs[i] = Normalize(lower + Vec3(Randf(), Randf(), Randf())*(upper-lower) - starts[i]);
+	}
+
+	std::vector<AABBTree::Hit> hits(numRays);
+
+	AABBTree tree(&positions[0], mesh->GetNumVertices(), &mesh->m_indices[0], mesh->GetNumFaces());
+
+	double refitTime = 0.0;
+	double rebuildTime = 0.0;
+	double refitTraceTime = 0.0;
+	double rebuildTraceTime = 0.0;
+	
+	uint32_t rebuiltFaces = 0;
+	float refitCost = 0.0f;
+	float rebuildCost = 0.0f;
+
+	for (int f=0; f < numFrames; ++f)
+	{
+		// up to one and a half turns of twist from the bottom to the top of the mesh
+		const float twist = kPi*3.0f*(f+1)/numFrames;
+
+		for (size_t i=0; i < rest.size(); ++i)
+		{
+			const Vec3 p = rest[i]-center;
+			const float angle = twist*(rest[i].y-lower.y)/height;
+
+			positions[i] = center + Vec3(cosf(angle)*p.x - sinf(angle)*p.z, p.y, sinf(angle)*p.x + cosf(angle)*p.z);
+		}
+
+		double start = GetSeconds();
+		rebuiltFaces += tree.Refit(&positions[0]);
+		refitTime += GetSeconds()-start;
+
+		start = GetSeconds();
+		tree.TraceRays(&starts[0], &dirs[0], numRays, &hits[0], 1);
+		refitTraceTime += GetSeconds()-start;
+
+		start = GetSeconds();
+		AABBTree rebuilt(&positions[0], mesh->GetNumVertices(), &mesh->m_indices[0], mesh->GetNumFaces());
+		rebuildTime += GetSeconds()-start;
+
+		start = GetSeconds();
+		rebuilt.TraceRays(&starts[0], &dirs[0], numRays, &hits[0], 1);
+		rebuildTraceTime += GetSeconds()-start;
+
+		refitCost += tree.GetCost();
+		rebuildCost += rebuilt.GetCost();
+	}
+
+	const double scale = 1000.0/numFrames;
+
+	printf("%-24s %8d %8.2fms %8.2fms %10.2fms %10.2fms %8.2f %8.2f %12.2f\n", name, mesh->GetNumFaces(), refitTime*scale, rebuildTime*scale, refitTraceTime*scale, rebuildTraceTime*scale, 
+		refitCost/numFrames, rebuildCost/numFrames, float(rebuiltFaces)/(numFrames*mesh->GetNumFaces()));
+}
+
+void AABBTreeBenchmark()
+{
+	const char* paths[] = { "../../data/bunny.ply", "../../data/armadillo.ply", "../../data/dragon.obj", "../../data/testzone.bin" };
+
+	const int numRays = 100000;
+	const int numColumns = 256;
+
+	printf("%-24s %8s %10s %12s %12s %12s %12s %12s\n", "Mesh", "Faces", "Build", "Nodes", "Pick rays", "Pick packets", "Columns", "Col packets");
+
+	for (int p=0; p < int(sizeof_array(paths)); ++p)
+	{
+		const std::string path = GetFilePathByPlatform(paths[p]);
+
+		Mesh* mesh = (GetExtension(path.c_str()) == "bin") ? ImportMeshFromBin(path.c_str()) : ImportMesh(path.c_str());
+
+		if (!mesh)
+			continue;
+
+		const Vec3* vertices = (const Vec3*)&mesh->m_positions[0];
+
+		Vec3 lower, upper;
+		mesh->GetBounds(lower, upper);
+
+		const Vec3 center = 0.5f*(lower+upper);
+		const float radius = Length(upper-lower);
+
+		// rays start outside the bounds and pass through a random point inside them
+		RandInit();
+
+		std::vector<Vec3> starts(numRays);
+		std::vector<Vec3> dirs(numRays);
+
+		for (int i=0; i < numRays; ++i)
+		{
+			starts[i] = center + RandomUnitVector()*radius;
+			dirs[i] = Normalize(lower + Vec3(Randf(), Randf(), Randf())*(upper-lower) - starts[i]);
+		}
+
+		const AABBTree::BuildMode modes[] = { AABBTree::eBuildSweepSAH, AABBTree::eBuildBinnedSAH };
+		const char* modeNames[] = { "sweep", "binned" };
+
+		for (int m=0; m < 2; ++m)
+		{
+			double start = GetSeconds();
+
+			AABBTree tree(vertices, mesh->GetNumVertices(), &mesh->m_indices[0], mesh->GetNumFaces(), modes[m]);
+
+			const double buildTime = GetSeconds()-start;
+
+			start = GetSeconds();
+
+			for (int i=0; i < numRays; ++i)
+			{
+				float t, u, v, w, sign;
+				uint32_t face;
+
+				tree.TraceRay(starts[i], dirs[i], t, u, v, w, sign, face);
+			}
+
+			const double pickTime = GetSeconds()-start;
+
+			std::vector<AABBTree::Hit> packetHits(numRays);
+
+			start = GetSeconds();
+
+			tree.TraceRays(&starts[0], &dirs[0], numRays, &packetHits[0], 1);
+
+			const double pickPacketTime = GetSeconds()-start;
+
+			start = GetSeconds();
+
+			std::vector<float> hits;
+
+			for (int y=0; y < numColumns; ++y)
+			{
+				for (int x=0; x < numColumns; ++x)
+				{
+					const Vec3 columnStart(Lerp(lower.x, upper.x, (x+0.5f)/numColumns), Lerp(lower.y, upper.y, (y+0.5f)/numColumns), lower.z-1.0f);
+
+					hits.resize(0);
+					tree.TraceRayAll(columnStart, Vec3(0.0f, 0.0f, 1.0f), hits);
+				}
+			}
+
+			const double columnTime = GetSeconds()-start;
+
+			start = GetSeconds();
+
+			std::vector<float> packetColumnHits[AABBTree::kRayPacketSize];
+
+			for (int y=0; y < numColumns; ++y)
+			{
+				for (int x=0; x < numColumns; x += AABBTree::kRayPacketSize)
+				{
+					Vec3 columnStarts[AABBTree::kRayPacketSize];
+					Vec3 columnDirs[AABBTree::kRayPacketSize];
+
+					for (int i=0; i < AABBTree::kRayPacketSize; ++i)
+					{
+						columnStarts[i] = Vec3(Lerp(lower.x, upper.x, (x+i+0.5f)/numColumns), Lerp(lower.y, upper.y, (y+0.5f)/numColumns), lower.z-1.0f);
+						columnDirs[i] = Vec3(0.0f, 0.0f, 1.0f);
+
+						packetColumnHits[i].resize(0);
+					}
+
+					tree.TraceRayPacketAll(columnStarts, columnDirs, AABBTree::kRayPacketSize, packetColumnHits);
+				}
+			}
+
+			const double columnPacketTime = GetSeconds()-start;
+
+			char name[64];
+			sprintf(name, "%s (%s)", StripPath(path.c_str()).c_str(), modeNames[m]);
+
+			printf("%-24s %8d %8.2fms %12d %10.2fms %10.2fms %10.2fms %10.2fms\n", name, mesh->GetNumFaces(), buildTime*1000.0, tree.GetNumNodes(), pickTime*1000.0, pickPacketTime*1000.0, columnTime*1000.0, columnPacketTime*1000.0);
+		}
+
+		delete mesh;
+	}
+
+	// per-frame averages for an animated mesh, the rebuilt column is the fraction of faces in rebuilt subtrees
+	printf("\n%-24s %8s %10s %10s %12s %12s %8s %8s %12s\n", "Mesh", "Faces", "Refit", "Rebuild", "Refit rays", "Rebuild rays", "Refit", "Rebuild", "Rebuilt");
+
+	for (int p=0; p < int(sizeof_array(paths)); ++p)
+	{
+		const std::string path = GetFilePathByPlatform(paths[p]);
+
+		Mesh* mesh = (GetExtension(path.c_str()) == "bin") ? ImportMeshFromBin(path.c_str()) : ImportMesh(path.c_str());
+
+		if (!mesh)
+			continue;
+
+		AABBTreeRefitBenchmark(mesh, StripPath(path.c_str()).c_str());
+
+		delete mesh;
+	}
+}
@@ -3,6 +3,9 @@
 ProjectName = flexExtCUDA
 flexExtCUDA_cppfiles   += ./../../../extensions/flexExtCloth.cpp
 flexExtCUDA_cppfiles   += ./../../../extensions/flexExtContainer.cpp
+flexExtCUDA_cppfiles   += ./../../../extensions/flexExtCook.cpp
+flexExtCUDA_cppfiles   += ./../../../extensions/flexExtForceField.cpp
+flexExtCUDA_cppfiles   += ./../../../extensions/flexExtBufferPool.cpp
 flexExtCUDA_cppfiles   += ./../../../extensions/flexExtMovingFrame.cpp
 flexExtCUDA_cppfiles   += ./../../../extensions/flexExtRigid.cpp
 flexExtCUDA_cppfiles   += ./../../../extensions/flexExtSoft.cpp
@@ -218,7 +218,7 @@ void CreateParticleShape(const Mesh* srcMesh, Vec3 lower, Vec3 scale, float rota
 
 		vector<int> indices(maxDim*maxDim*maxDim);
 		vector<float> sdf(maxDim*maxDim*maxDim);
-		MakeSDF(&voxels[0], maxDim, maxDim, maxDim, &sdf[0]);
+		MakeSDFExact(&voxels[0], maxDim, maxDim, maxDim, &sdf[0]);
 
 		for (int x=0; x < maxDim; ++x)
 		{
@@ -508,24 +508,13 @@ void CreateSDF(const Mesh* mesh, uint32_t dim, Vec3 lower, Vec3 upper, float* sd
 {
 	if (mesh)
 	{
-		printf("Begin mesh voxelization\n");
-
-		double startVoxelize = GetSeconds();
-
-		uint32_t* volume = new uint32_t[dim*dim*dim];
-		Voxelize((const Vec3*)&mesh->m_positions[0], mesh->m_positions.size(), (const int*)&mesh->m_indices[0], mesh->m_indices.size(), dim, dim, dim, volume, lower, upper);
-
-		printf("End mesh voxelization (%.2fs)\n", (GetSeconds()-startVoxelize));
-	
-		printf("Begin SDF gen (fast marching method)\n");
+		printf("Begin SDF gen (narrow band)\n");
 
 		double startSDF = GetSeconds();
 
-		MakeSDF(volume, dim, dim, dim, sdf);
+		MakeSDFFromMesh((const Vec3*)&mesh->m_positions[0], mesh->m_positions.size(), (const int*)&mesh->m_indices[0], mesh->m_indices.size(), dim, dim, dim, sdf, lower, upper);
 
 		printf("End SDF gen (%.2fs)\n", (GetSeconds()-startSDF));
-	
-		delete[] volume;
 	}
 }
 
@@ -36,6 +36,7 @@
 #include "../core/perlin.h"
 #include "../core/convex.h"
 #include "../core/cloth.h"
+#include "../core/simd.h"
 
 #include "../external/SDL2-2.0.4/include/SDL.h"
 
@@ -124,6 +125,14 @@ bool g_vsync = true;
 bool g_benchmark = false;
 bool g_extensions = true;
 bool g_teamCity = false;
+bool g_cookBenchmark = false;
+bool g_instanceBenchmark = false;
+bool g_poolBenchmark = false;
+bool g_simdBenchmark = false;
+bool g_forceFieldBenchmark = false;
+bool g_meshBenchmark = false;
+bool g_aabbTreeBenchmark = false;
+const char* g_assetCache = NULL;
 bool g_interop = true;
 bool g_d3d12 = false;
 bool g_useAsyncCompute = true;		
@@ -230,22 +239,25 @@ struct SimBuffers
 	NvFlexVector<Vec3> triangleNormals;
 	NvFlexVector<Vec3> uvs;
 
-	SimBuffers(NvFlexLibrary* l) :
-		positions(l), restPositions(l), velocities(l), phases(l), densities(l),
-		anisotropy1(l), anisotropy2(l), anisotropy3(l), normals(l), smoothPositions(l),
-		diffusePositions(l), diffuseVelocities(l), diffuseCount(l), activeIndices(l),
-		shapeGeometry(l), shapePositions(l), shapeRotations(l), shapePrevPositions(l),
-		shapePrevRotations(l),	shapeFlags(l), rigidOffsets(l), rigidIndices(l), rigidMeshSize(l),
-		rigidCoefficients(l), rigidPlasticThresholds(l), rigidPlasticCreeps(l), rigidRotations(l), rigidTranslations(l),
-		rigidLocalPositions(l), rigidLocalNormals(l), inflatableTriOffsets(l),
-		inflatableTriCounts(l), inflatableVolumes(l), inflatableCoefficients(l),
-		inflatablePressures(l), springIndices(l), springLengths(l),
-		springStiffness(l), triangles(l), triangleNormals(l), uvs(l)
+	SimBuffers(NvFlexExtBufferPool* l) :
+		positions(NvFlexVectorPool(), l), restPositions(NvFlexVectorPool(), l), velocities(NvFlexVectorPool(), l), phases(NvFlexVectorPool(), l), densities(NvFlexVectorPool(), l),
+		anisotropy1(NvFlexVectorPool(), l), anisotropy2(NvFlexVectorPool(), l), anisotropy3(NvFlexVectorPool(), l), normals(NvFlexVectorPool(), l), smoothPositions(NvFlexVectorPool(), l),
+		diffusePositions(NvFlexVectorPool(), l), diffuseVelocities(NvFlexVectorPool(), l), diffuseCount(NvFlexVectorPool(), l), activeIndices(NvFlexVectorPool(), l),
+		shapeGeometry(NvFlexVectorPool(), l), shapePositions(NvFlexVectorPool(), l), shapeRotations(NvFlexVectorPool(), l), shapePrevPositions(NvFlexVectorPool(), l),
+		shapePrevRotations(NvFlexVectorPool(), l),	shapeFlags(NvFlexVectorPool(), l), rigidOffsets(NvFlexVectorPool(), l), rigidIndices(NvFlexVectorPool(), l), rigidMeshSize(NvFlexVectorPool(), l),
+		rigidCoefficients(NvFlexVectorPool(), l), rigidPlasticThresholds(NvFlexVectorPool(), l), rigidPlasticCreeps(NvFlexVectorPool(), l), rigidRotations(NvFlexVectorPool(), l), rigidTranslations(NvFlexVectorPool(), l),
+		rigidLocalPositions(NvFlexVectorPool(), l), rigidLocalNormals(NvFlexVectorPool(), l), inflatableTriOffsets(NvFlexVectorPool(), l),
+		inflatableTriCounts(NvFlexVectorPool(), l), inflatableVolumes(NvFlexVectorPool(), l), inflatableCoefficients(NvFlexVectorPool(), l),
+		inflatablePressures(NvFlexVectorPool(), l), springIndices(NvFlexVectorPool(), l), springLengths(NvFlexVectorPool(), l),
+		springStiffness(NvFlexVectorPool(), l), triangles(NvFlexVectorPool(), l), triangleNormals(NvFlexVectorPool(), l), uvs(NvFlexVectorPool(), l)
 	{}
 };
 
 SimBuffers* g_buffers;
 
+// recycles the storage of SimBuffers between scenes and across vector growth during Init()
+NvFlexExtBufferPool* g_bufferPool;
+
 void MapBuffers(SimBuffers* buffers)
 {
 	buffers->positions.map();
@@ -355,9 +367,9 @@ void UnmapBuffers(SimBuffers* buffers)
 
 }
 
-SimBuffers* AllocBuffers(NvFlexLibrary* lib)
+SimBuffers* AllocBuffers(NvFlexExtBufferPool* pool)
 {
-	return new SimBuffers(lib);
+	return new SimBuffers(pool);
 }
 
 void DestroyBuffers(SimBuffers* buffers)
@@ -600,7 +612,7 @@ void Init(int scene, bool centerCamera = true)
 	}
 
 	// alloc buffers
-	g_buffers = AllocBuffers(g_flexLib);
+	g_buffers = AllocBuffers(g_bufferPool);
 
 	// map during initialization
 	MapBuffers(g_buffers);
@@ -1053,6 +1065,7 @@ void Shutdown()
 	g_meshes.clear();
 
 	NvFlexDestroySolver(g_solver);
+	NvFlexExtDestroyBufferPool(g_bufferPool);
 	NvFlexShutdown(g_flexLib);
 
 #if _WIN32
@@ -2811,6 +2824,47 @@ int main(int argc, char* argv[])
 			g_teamCity = true;
 		}
 
+		if (strcmp(argv[i], "-cookbenchmark") == 0)
+		{
+			g_cookBenchmark = true;
+		}
+
+		if (strcmp(argv[i], "-instancebenchmark") == 0)
+		{
+			g_instanceBenchmark = true;
+		}
+
+		if (strcmp(argv[i], "-poolbenchmark") == 0)
+		{
+			g_poolBenchmark = true;
+		}
+
+		if (strcmp(argv[i], "-simdbenchmark") == 0)
+		{
+			g_simdBenchmark = true;
+		}
+
+		if (strcmp(argv[i], "-forcefieldbenchmark") == 0)
+		{
+			g_forceFieldBenchmark = true;
+		}
+
+		if (strcmp(argv[i], "-meshbenchmark") == 0)
+		{
+			g_meshBenchmark = true;
+		}
+
+		if (strcmp(argv[i], "-aabbtreebenchmark") == 0)
+		{
+			g_aabbTreeBenchmark = true;
+		}
+
+		if (strncmp(argv[i], "-assetcache=", 12) == 0)
+		{
+			g_assetCache = argv[i] + 12;
+			NvFlexExtSetAssetCacheDirectory(g_assetCache);
+		}
+
 		if (sscanf(argv[i], "-msaa=%d", &d))
 			g_msaaSamples = d;
 
@@ -2872,6 +2926,33 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	// cooking benchmark runs on the CPU only and does not need a window or device
+	if (g_cookBenchmark)
+	{
+		CookBenchmark();
+		return 0;
+	}
+
+	// SIMD microbenchmarks run on the CPU only
+	if (g_simdBenchmark)
+	{
+		SimdBenchmark();
+		return 0;
+	}
+
+	// mesh import only touches files and the CPU
+	if (g_meshBenchmark)
+	{
+		MeshBenchmark();
+		return 0;
+	}
+
+	if (g_aabbTreeBenchmark)
+	{
+		AABBTreeBenchmark();
+		return 0;
+	}
+
 	// opening scene
 	g_scenes.push_back(new PotPourri("Pot Pourri"));
 
@@ -3256,6 +3337,32 @@ int main(int argc, char* argv[])
 	strcpy(g_deviceName, NvFlexGetDeviceName(g_flexLib));
 	printf("Compute Device: %s\n\n", g_deviceName);
 
+	// instance update benchmark only needs the compute device
+	if (g_instanceBenchmark)
+	{
+		InstanceBenchmark(g_flexLib);
+		NvFlexShutdown(g_flexLib);
+		return 0;
+	}
+
+	// buffer pool benchmark only needs the compute device
+	if (g_poolBenchmark)
+	{
+		BufferPoolBenchmark(g_flexLib);
+		NvFlexShutdown(g_flexLib);
+		return 0;
+	}
+
+	// force field benchmark only needs the compute device
+	if (g_forceFieldBenchmark)
+	{
+		ForceFieldBenchmark(g_flexLib);
+		NvFlexShutdown(g_flexLib);
+		return 0;
+	}
+
+	g_bufferPool = NvFlexExtCreateBufferPool(g_flexLib, 0);
+
 	if (g_benchmark)
 		g_scene = BenchmarkInit();
 
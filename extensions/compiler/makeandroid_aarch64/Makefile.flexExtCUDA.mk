@@ -3,6 +3,9 @@
 ProjectName = flexExtCUDA
 flexExtCUDA_cppfiles   += ./../../flexExtCloth.cpp
 flexExtCUDA_cppfiles   += ./../../flexExtContainer.cpp
+flexExtCUDA_cppfiles   += ./../../flexExtCook.cpp
+flexExtCUDA_cppfiles   += ./../../flexExtForceField.cpp
+flexExtCUDA_cppfiles   += ./../../flexExtBufferPool.cpp
 flexExtCUDA_cppfiles   += ./../../flexExtMovingFrame.cpp
 flexExtCUDA_cppfiles   += ./../../flexExtRigid.cpp
 flexExtCUDA_cppfiles   += ./../../flexExtSoft.cpp
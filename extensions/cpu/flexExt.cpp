@@ -0,0 +1,194 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#include "../../core/core.h"
+#include "../../core/maths.h"
+
+#include "../../include/NvFlex.h"
+#include "../../include/NvFlexExt.h"
+
+#include "../flexExtMovingFrame.h"
+#include "../flexExtForceField.h"
+
+#include <vector>
+
+// CPU implementations of the extension solver callbacks, these run on the solver's host 
+// particle data directly and are used when the library is linked against the CPU solver
+
+struct NvFlexExtForceFieldCallback
+{
+	NvFlexExtForceFieldCallback(NvFlexSolver* solver) : mSolver(solver)
+	{
+		mPrevCallback.function = NULL;
+		mPrevCallback.userData = NULL;
+		mRegistered = false;
+	}
+
+	std::vector<NvFlexExtForceField> mForceFields;
+
+	// broadphase over the field spheres, rebuilt by NvFlexExtSetForceFields()
+	ForceFieldGrid mGrid;
+
+	NvFlexSolver* mSolver;
+
+	// callback that was registered before this one, called first and restored on destroy
+	NvFlexSolverCallback mPrevCallback;
+	bool mRegistered;
+};
+
+NvFlexExtForceFieldCallback* NvFlexExtCreateForceFieldCallback(NvFlexSolver* solver)
+{
+	return new NvFlexExtForceFieldCallback(solver);
+}
+
+void NvFlexExtDestroyForceFieldCallback(NvFlexExtForceFieldCallback* callback)
+{
+	// hand the stage back to the previous callback so the solver is not left calling into freed memory
+	if (callback->mRegistered)
+		NvFlexRegisterSolverCallback(callback->mSolver, callback->mPrevCallback, eNvFlexStageUpdateEnd);
+
+	delete callback;
+}
+
+void ApplyForceFieldsCallback(NvFlexSolverCallbackParams params)
+{
+	NvFlexExtForceFieldCallback* c = (NvFlexExtForceFieldCallback*)params.userData;
+
+	// only one callback can be registered per-stage, run the one this replaced
+	if (c->mPrevCallback.function)
+	{
+		NvFlexSolverCallbackParams prevParams = params;
+		prevParams.userData = c->mPrevCallback.userData;
+
+		c->mPrevCallback.function(prevParams);
+	}
+
+	if (params.numActive && c->mForceFields.size())
+		ApplyForceFields(c->mGrid, &c->mForceFields[0], params.particles, params.velocities, params.numActive, params.dt, 0);
+}
+
+void NvFlexExtSetForceFields(NvFlexExtForceFieldCallback* c, const NvFlexExtForceField* forceFields, int numForceFields)
+{
+	c->mForceFields.assign(forceFields, forceFields + numForceFields);
+
+	BuildForceFieldGrid(c->mGrid, forceFields, numForceFields);
+
+	if (!c->mRegistered)
+	{
+		NvFlexSolverCallback callback;
+		callback.function = ApplyForceFieldsCallback;
+		callback.userData = c;
+
+		// register a callback to calculate the forces at the end of the time-step, keeping any callback already registered for the stage
+		c->mPrevCallback = NvFlexRegisterSolverCallback(c->mSolver, callback, eNvFlexStageUpdateEnd);
+		c->mRegistered = true;
+	}
+}
+
+struct NvFlexExtMovingFrameCallback
+{
+	NvFlexExtMovingFrameCallback(NvFlexSolver* solver) : mSolver(solver)
+	{
+		mPrevCallback.function = NULL;
+		mPrevCallback.userData = NULL;
+		mRegistered = false;
+
+		mLinearScale = 0.0f;
+		mAngularScale = 0.0f;
+		mPending = false;
+	}
+
+	NvFlexExtMovingFrame mFrame;
+
+	float mLinearScale;
+	float mAngularScale;
+
+	// true when the frame has been set but not yet applied
+	bool mPending;
+
+	NvFlexSolver* mSolver;
+
+	// callback that was registered before this one, called first and restored on destroy
+	NvFlexSolverCallback mPrevCallback;
+	bool mRegistered;
+};
+
+NvFlexExtMovingFrameCallback* NvFlexExtCreateMovingFrameCallback(NvFlexSolver* solver)
+{
+	return new NvFlexExtMovingFrameCallback(solver);
+}
+
+void NvFlexExtDestroyMovingFrameCallback(NvFlexExtMovingFrameCallback* callback)
+{
+	// hand the stage back to the previous callback so the solver is not left calling into freed memory
+	if (callback->mRegistered)
+		NvFlexRegisterSolverCallback(callback->mSolver, callback->mPrevCallback, eNvFlexStageUpdateEnd);
+
+	delete callback;
+}
+
+void ApplyMovingFrameCallback(NvFlexSolverCallbackParams params)
+{
+	NvFlexExtMovingFrameCallback* c = (NvFlexExtMovingFrameCallback*)params.userData;
+
+	// only one callback can be registered per-stage, run the one this replaced
+	if (c->mPrevCallback.function)
+	{
+		NvFlexSolverCallbackParams prevParams = params;
+		prevParams.userData = c->mPrevCallback.userData;
+
+		c->mPrevCallback.function(prevParams);
+	}
+
+	if (params.numActive && c->mPending)
+	{
+		// solver velocities are float4, split across the shared pool
+		ApplyMovingFrame(&c->mFrame, params.particles, params.velocities, 4, params.numActive, c->mLinearScale, c->mAngularScale, params.dt, 0);
+	}
+
+	// each frame update is applied exactly once
+	c->mPending = false;
+}
+
+void NvFlexExtSetMovingFrame(NvFlexExtMovingFrameCallback* c, const NvFlexExtMovingFrame* frame, float linearScale, float angularScale)
+{
+	c->mFrame = *frame;
+	c->mLinearScale = linearScale;
+	c->mAngularScale = angularScale;
+	c->mPending = true;
+
+	if (!c->mRegistered)
+	{
+		NvFlexSolverCallback callback;
+		callback.function = ApplyMovingFrameCallback;
+		callback.userData = c;
+
+		// register a callback to apply the frame at the end of the time-step, keeping any callback already registered for the stage
+		c->mPrevCallback = NvFlexRegisterSolverCallback(c->mSolver, callback, eNvFlexStageUpdateEnd);
+		c->mRegistered = true;
+	}
+}
@@ -38,20 +38,79 @@
 #include "../../include/NvFlex.h"
 #include "../../include/NvFlexExt.h"
 
+#include "../flexExtForceField.h"
+
 #define CudaCheck(x) { cudaError_t err = x; if (err != cudaSuccess) { printf("Cuda error: %d in %s at %s:%d\n", err, #x, __FILE__, __LINE__); assert(0); } }
 
 static const int kNumThreadsPerBlock = 256;
 
+// copies count elements to a pinned host array and starts an async transfer to the device array, 
+// both arrays are grown as necessary and capacity holds their current size in elements
+template <typename T>
+void UploadAsync(const T* src, int count, T*& cpu, T*& gpu, int& capacity)
+{
+	// re-alloc if necessary
+	if (count > capacity)
+	{
+		CudaCheck(cudaFreeHost(cpu));
+		CudaCheck(cudaMallocHost(&cpu, sizeof(T)*count));
+
+		CudaCheck(cudaFree(gpu));
+		CudaCheck(cudaMalloc(&gpu, sizeof(T)*count));
+
+		capacity = count;
+	}
+
+	if (count > 0)
+	{
+		// copy to pinned host memory
+		memcpy(cpu, src, count*sizeof(T));
+
+		cudaMemcpyKind kind = cudaMemcpyHostToDevice;
+		CudaCheck(cudaMemcpyAsync(gpu, cpu, count*sizeof(T), kind, 0));
+	}
+}
+
+// returns true for pointers to device memory, host pointers that were not allocated through CUDA fail the query on older runtimes
+bool IsDevicePointer(const void* ptr)
+{
+	cudaPointerAttributes attributes;
+
+	if (cudaPointerGetAttributes(&attributes, ptr) != cudaSuccess)
+	{
+		// clear the error so it is not reported by a later call
+		cudaGetLastError();
+		return false;
+	}
+
+#if CUDART_VERSION >= 10000
+	return attributes.type == cudaMemoryTypeDevice;
+#else
+	return attributes.memoryType == cudaMemoryTypeDevice;
+#endif
+}
+
 struct NvFlexExtForceFieldCallback
 {
 	NvFlexExtForceFieldCallback(NvFlexSolver* solver) : mSolver(solver)
 	{
+		mPrevCallback.function = NULL;
+		mPrevCallback.userData = NULL;
+		mRegistered = false;
+
 		// force fields
 		mForceFieldsCpu = NULL;
 		mForceFieldsGpu = NULL;
 		mMaxForceFields = 0;
 		mNumForceFields = 0;
 
+		// broadphase
+		mCellStartsCpu = NULL;
+		mCellStartsGpu = NULL;
+		mCellFieldsCpu = NULL;
+		mCellFieldsGpu = NULL;
+		mMaxCellStarts = 0;
+		mMaxCellFields = 0;
 	}
 
 	~NvFlexExtForceFieldCallback()
@@ -59,6 +118,12 @@ struct NvFlexExtForceFieldCallback
 		// force fields
 		CudaCheck(cudaFreeHost(mForceFieldsCpu));
 		CudaCheck(cudaFree(mForceFieldsGpu));
+
+		// broadphase
+		CudaCheck(cudaFreeHost(mCellStartsCpu));
+		CudaCheck(cudaFree(mCellStartsGpu));
+		CudaCheck(cudaFreeHost(mCellFieldsCpu));
+		CudaCheck(cudaFree(mCellFieldsGpu));
 	}
 	
 	NvFlexExtForceField* mForceFieldsCpu;	// pinned host copy for async transfer
@@ -67,7 +132,25 @@ struct NvFlexExtForceFieldCallback
 	int mMaxForceFields;
 	int mNumForceFields;
 
+	// host copy of fields passed in device memory, read back so they can be binned
+	std::vector<NvFlexExtForceField> mForceFieldsHost;
+
+	// grid over the field spheres, built on the host in NvFlexExtSetForceFields()
+	ForceFieldGrid mGrid;
+
+	int* mCellStartsCpu;
+	int* mCellStartsGpu;
+	int* mCellFieldsCpu;
+	int* mCellFieldsGpu;
+
+	int mMaxCellStarts;
+	int mMaxCellFields;
+
 	NvFlexSolver* mSolver;
+
+	// callback that was registered before this one, called first and restored on destroy
+	NvFlexSolverCallback mPrevCallback;
+	bool mRegistered;
 };
 
 NvFlexExtForceFieldCallback* NvFlexExtCreateForceFieldCallback(NvFlexSolver* solver)
@@ -77,71 +160,40 @@ NvFlexExtForceFieldCallback* NvFlexExtCreateForceFieldCallback(NvFlexSolver* sol
 
 void NvFlexExtDestroyForceFieldCallback(NvFlexExtForceFieldCallback* callback)
 {
+	// hand the stage back to the previous callback so the solver is not left calling into freed memory
+	if (callback->mRegistered)
+		NvFlexRegisterSolverCallback(callback->mSolver, callback->mPrevCallback, eNvFlexStageUpdateEnd);
+
 	delete callback;
 }
 
 
-__global__ void UpdateForceFields(int numParticles, const Vec4* __restrict__ positions, Vec4* __restrict__ velocities, const NvFlexExtForceField* __restrict__ forceFields, int numForceFields, float dt)
+__global__ void UpdateForceFields(int numParticles, const Vec4* __restrict__ positions, Vec4* __restrict__ velocities, const NvFlexExtForceField* __restrict__ forceFields, const int* __restrict__ cellStarts, const int* __restrict__ cellFields, ForceFieldGridParams grid, float dt)
 {
 	const int i = blockIdx.x*blockDim.x + threadIdx.x;
-	
-	for (int f = 0; f < numForceFields; f++)
-	{
-		const NvFlexExtForceField& forceField = forceFields[f];
-
-		if (i < numParticles)
-		{
-			const int index = i;
-
-			Vec4 p = positions[index];
-			Vec3 v = Vec3(velocities[index]);
-
-			Vec3 localPos = Vec3(p.x, p.y, p.z) - Vec3(forceField.mPosition[0], forceField.mPosition[1], forceField.mPosition[2]);
-
-			float length = Length(localPos);
-			if (length >= forceField.mRadius)
-			{
-				continue;
-			}
-			
-			Vec3 fieldDir;
-			if (length > 0.0f)
-			{
-				fieldDir = localPos / length;
-			}
-			else
-			{
-				fieldDir = localPos;
-			}
-
-			// If using linear falloff, scale with distance.
-			float fieldStrength = forceField.mStrength;
-			if (forceField.mLinearFalloff)
-			{
-				fieldStrength *= (1.0f - (length / forceField.mRadius));
-			}
-
-			// Apply force
-			Vec3 force = localPos * fieldStrength;
-
-			float unitMultiplier;
-			if (forceField.mMode == eNvFlexExtModeForce)
-			{
-				unitMultiplier = dt * p.w; // time/mass
-			} 
-			else if (forceField.mMode == eNvFlexExtModeImpulse)
-			{
-				unitMultiplier = p.w; // 1/mass
-			}
-			else if (forceField.mMode == eNvFlexExtModeVelocityChange)
-			{
-				unitMultiplier = 1.0f;
-			}
-
-			Vec3 deltaVelocity = fieldDir * fieldStrength * unitMultiplier;
-			velocities[index] = Vec4(v + deltaVelocity, 0.0f);
-		}
-	}
+
+	if (i >= numParticles)
+		return;
+
+	const Vec4 p = positions[i];
+
+	// only fields binned in the particle's cell can overlap it
+	const int cell = GetForceFieldCell(grid, Vec3(p));
+	if (cell < 0)
+		return;
+
+	const int start = cellStarts[cell];
+	const int end = cellStarts[cell+1];
+
+	if (start == end)
+		return;
+
+	Vec3 v = Vec3(velocities[i]);
+
+	for (int f = start; f < end; f++)
+		v += EvaluateForceField(forceFields[cellFields[f]], Vec3(p), p.w, dt);
+
+	velocities[i] = Vec4(v, 0.0f);
 }
 
 void ApplyForceFieldsCallback(NvFlexSolverCallbackParams params)
@@ -150,7 +202,16 @@ void ApplyForceFieldsCallback(NvFlexSolverCallbackParams params)
 
 	NvFlexExtForceFieldCallback* c = (NvFlexExtForceFieldCallback*)params.userData;
 
-	if (params.numActive && c->mNumForceFields)
+	// only one callback can be registered per-stage, run the one this replaced
+	if (c->mPrevCallback.function)
+	{
+		NvFlexSolverCallbackParams prevParams = params;
+		prevParams.userData = c->mPrevCallback.userData;
+
+		c->mPrevCallback.function(prevParams);
+	}
+
+	if (params.numActive && c->mGrid.GetNumCells())
 	{
 		const int kNumBlocks = (params.numActive+kNumThreadsPerBlock-1)/kNumThreadsPerBlock;
 
@@ -159,40 +220,169 @@ void ApplyForceFieldsCallback(NvFlexSolverCallbackParams params)
 	   		(Vec4*)params.particles,
 	   		(Vec4*)params.velocities,
 			c->mForceFieldsGpu,
-			c->mNumForceFields,
+			c->mCellStartsGpu,
+			c->mCellFieldsGpu,
+			c->mGrid.mParams,
 			params.dt);
 	}
 }
 
 void NvFlexExtSetForceFields(NvFlexExtForceFieldCallback* c, const NvFlexExtForceField* forceFields, int numForceFields)
 {
-	// re-alloc if necessary
-	if (numForceFields > c->mMaxForceFields)
+	if (numForceFields > 0 && IsDevicePointer(forceFields))
 	{
-		CudaCheck(cudaFreeHost(c->mForceFieldsCpu));
-		CudaCheck(cudaMallocHost(&c->mForceFieldsCpu, sizeof(NvFlexExtForceField)*numForceFields));
+		c->mForceFieldsHost.resize(numForceFields);
+		CudaCheck(cudaMemcpy(&c->mForceFieldsHost[0], forceFields, numForceFields*sizeof(NvFlexExtForceField), cudaMemcpyDeviceToHost));
 
-		CudaCheck(cudaFree(c->mForceFieldsGpu));
-		CudaCheck(cudaMalloc(&c->mForceFieldsGpu, sizeof(NvFlexExtForceField)*numForceFields));
+		forceFields = &c->mForceFieldsHost[0];
+	}
 
+	UploadAsync(forceFields, numForceFields, c->mForceFieldsCpu, c->mForceFieldsGpu, c->mMaxForceFields);
+	c->mNumForceFields = numForceFields;
+
+	// bin the fields so each particle only evaluates the fields overlapping its cell
+	BuildForceFieldGrid(c->mGrid, forceFields, numForceFields);
 
-		c->mMaxForceFields = numForceFields;
+	if (c->mGrid.GetNumCells())
+	{
+		UploadAsync(&c->mGrid.mCellStarts[0], int(c->mGrid.mCellStarts.size()), c->mCellStartsCpu, c->mCellStartsGpu, c->mMaxCellStarts);
+		UploadAsync(&c->mGrid.mCellFields[0], int(c->mGrid.mCellFields.size()), c->mCellFieldsCpu, c->mCellFieldsGpu, c->mMaxCellFields);
 	}
-	c->mNumForceFields = numForceFields;
 
-	if (numForceFields > 0)
+	if (!c->mRegistered)
 	{
-		// copy to pinned host memory
-		memcpy(c->mForceFieldsCpu, forceFields, numForceFields*sizeof(NvFlexExtForceField));
+		NvFlexSolverCallback callback;
+		callback.function = ApplyForceFieldsCallback;
+		callback.userData = c;
 
-		cudaMemcpyKind kind = cudaMemcpyHostToDevice;
-		CudaCheck(cudaMemcpyAsync(c->mForceFieldsGpu, &c->mForceFieldsCpu[0], numForceFields*sizeof(NvFlexExtForceField), kind, 0));
+		// register a callback to calculate the forces at the end of the time-step, keeping any callback already registered for the stage
+		c->mPrevCallback = NvFlexRegisterSolverCallback(c->mSolver, callback, eNvFlexStageUpdateEnd);
+		c->mRegistered = true;
 	}
+}
+
+struct NvFlexExtMovingFrameCallback
+{
+	NvFlexExtMovingFrameCallback(NvFlexSolver* solver) : mSolver(solver)
+	{
+		mPrevCallback.function = NULL;
+		mPrevCallback.userData = NULL;
+		mRegistered = false;
+
+		mLinearScale = 0.0f;
+		mAngularScale = 0.0f;
+		mPending = false;
+	}
+
+	NvFlexExtMovingFrame mFrame;	// host copy, passed to the kernel by value
+
+	float mLinearScale;
+	float mAngularScale;
+
+	// true when the frame has been set but not yet applied
+	bool mPending;
+
+	NvFlexSolver* mSolver;
+
+	// callback that was registered before this one, called first and restored on destroy
+	NvFlexSolverCallback mPrevCallback;
+	bool mRegistered;
+};
+
+NvFlexExtMovingFrameCallback* NvFlexExtCreateMovingFrameCallback(NvFlexSolver* solver)
+{
+	return new NvFlexExtMovingFrameCallback(solver);
+}
+
+void NvFlexExtDestroyMovingFrameCallback(NvFlexExtMovingFrameCallback* callback)
+{
+	// hand the stage back to the previous callback so the solver is not left calling into freed memory
+	if (callback->mRegistered)
+		NvFlexRegisterSolverCallback(callback->mSolver, callback->mPrevCallback, eNvFlexStageUpdateEnd);
+
+	delete callback;
+}
+
+__global__ void ApplyMovingFrame(int numParticles, Vec4* __restrict__ positions, Vec4* __restrict__ velocities, const NvFlexExtMovingFrame frame, float linearScale, float angularScale, float dt)
+{
+	const int i = blockIdx.x*blockDim.x + threadIdx.x;
+
+	if (i >= numParticles)
+		return;
+
+	const Vec4 p = positions[i];
+	const Vec4 v = velocities[i];
 
-	NvFlexSolverCallback callback;
-	callback.function = ApplyForceFieldsCallback;
-	callback.userData = c;
+	const Vec3 framePosition(frame.position);
+	const Vec3 omega(frame.omega);
+	const Vec3 tau(frame.tau);
+
+	// centrifugal and Euler forces depend on the particle's offset from the frame
+	const Vec3 d = Vec3(p)-framePosition;
+	const Vec3 angularForce = -Cross(omega, Cross(omega, d)) - Cross(tau, d);
+	const Vec3 linearForce = -Vec3(frame.acceleration);
+
+	// transform particle to the frame's new location, delta is stored column major
+	const float (&m)[4][4] = frame.delta;
 	
-	// register a callback to calculate the forces at the end of the time-step
-	NvFlexRegisterSolverCallback(c->mSolver, callback, eNvFlexStageUpdateEnd);
+	const Vec3 newPos(
+		m[0][0]*p.x + m[1][0]*p.y + m[2][0]*p.z + m[3][0],
+		m[0][1]*p.x + m[1][1]*p.y + m[2][1]*p.z + m[3][1],
+		m[0][2]*p.x + m[1][2]*p.y + m[2][2]*p.z + m[3][2]);
+
+	const Vec3 newVel = Vec3(v) + (linearForce*linearScale + angularForce*angularScale)*dt;
+
+	// w (inverse mass) is left untouched
+	positions[i] = Vec4(newPos, p.w);
+	velocities[i] = Vec4(newVel, v.w);
+}
+
+void ApplyMovingFrameCallback(NvFlexSolverCallbackParams params)
+{
+	NvFlexExtMovingFrameCallback* c = (NvFlexExtMovingFrameCallback*)params.userData;
+
+	// only one callback can be registered per-stage, run the one this replaced
+	if (c->mPrevCallback.function)
+	{
+		NvFlexSolverCallbackParams prevParams = params;
+		prevParams.userData = c->mPrevCallback.userData;
+
+		c->mPrevCallback.function(prevParams);
+	}
+
+	if (params.numActive && c->mPending)
+	{
+		const int kNumBlocks = (params.numActive+kNumThreadsPerBlock-1)/kNumThreadsPerBlock;
+
+		ApplyMovingFrame<<<kNumBlocks, kNumThreadsPerBlock>>>(
+			params.numActive,
+			(Vec4*)params.particles,
+			(Vec4*)params.velocities,
+			c->mFrame,
+			c->mLinearScale,
+			c->mAngularScale,
+			params.dt);
+	}
+
+	// each frame update is applied exactly once
+	c->mPending = false;
+}
+
+void NvFlexExtSetMovingFrame(NvFlexExtMovingFrameCallback* c, const NvFlexExtMovingFrame* frame, float linearScale, float angularScale)
+{
+	c->mFrame = *frame;
+	c->mLinearScale = linearScale;
+	c->mAngularScale = angularScale;
+	c->mPending = true;
+
+	if (!c->mRegistered)
+	{
+		NvFlexSolverCallback callback;
+		callback.function = ApplyMovingFrameCallback;
+		callback.userData = c;
+
+		// register a callback to apply the frame at the end of the time-step, keeping any callback already registered for the stage
+		c->mPrevCallback = NvFlexRegisterSolverCallback(c->mSolver, callback, eNvFlexStageUpdateEnd);
+		c->mRegistered = true;
+	}
 }
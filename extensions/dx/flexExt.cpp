@@ -36,19 +36,33 @@
 
 #include "flexExt_dx_common.h"
 
+#include "../flexExtForceField.h"
+
 #include "shaders\flexExt.UpdateForceFields.h"
+#include "shaders\flexExt.ApplyMovingFrame.h"
 
 
 struct NvFlexExtForceFieldCallback
 {
 	NvFlexExtForceFieldCallback(NvFlexSolver* solver) : mSolver(solver)
 	{
+		mPrevCallback.function = NULL;
+		mPrevCallback.userData = NULL;
+		mRegistered = false;
+
 		// force fields
 		mMaxForceFields = 0;
 		mNumForceFields = 0;
 		
 		mForceFieldsGpu = NULL;
 
+		// broadphase
+		mMaxCellStarts = 0;
+		mMaxCellFields = 0;
+
+		mCellStartsGpu = NULL;
+		mCellFieldsGpu = NULL;
+
 		mDevice = NULL;
 		mContext = NULL;
 
@@ -70,7 +84,7 @@ struct NvFlexExtForceFieldCallback
 			// constant buffer
 			NvFlex::ConstantBufferDesc desc;
 			desc.stride = sizeof(int);
-			desc.dim = 4;
+			desc.dim = sizeof(FlexExtConstParams)/sizeof(int);
 			desc.uploadAccess = true;
 			
 			mConstantBuffer = mContext->createConstantBuffer(&desc);
@@ -81,12 +95,23 @@ struct NvFlexExtForceFieldCallback
 	{
 		// force fields
 		delete mForceFieldsGpu;
+		delete mCellStartsGpu;
+		delete mCellFieldsGpu;
 		delete mConstantBuffer;
 		delete mShaderUpdateForceFields;
 	}
 	
 	NvFlex::Buffer* mForceFieldsGpu;
 
+	// grid over the field spheres, built on the host in NvFlexExtSetForceFields()
+	ForceFieldGrid mGrid;
+
+	NvFlex::Buffer* mCellStartsGpu;
+	NvFlex::Buffer* mCellFieldsGpu;
+
+	int mMaxCellStarts;
+	int mMaxCellFields;
+
 	// DX Specific
 	NvFlex::ComputeShader* mShaderUpdateForceFields;
 	NvFlex::ConstantBuffer* mConstantBuffer;
@@ -100,6 +125,9 @@ struct NvFlexExtForceFieldCallback
 
 	NvFlexSolver* mSolver;
 
+	// callback that was registered before this one, called first and restored on destroy
+	NvFlexSolverCallback mPrevCallback;
+	bool mRegistered;
 };
 
 NvFlexExtForceFieldCallback* NvFlexExtCreateForceFieldCallback(NvFlexSolver* solver)
@@ -109,6 +137,10 @@ NvFlexExtForceFieldCallback* NvFlexExtCreateForceFieldCallback(NvFlexSolver* sol
 
 void NvFlexExtDestroyForceFieldCallback(NvFlexExtForceFieldCallback* callback)
 {
+	// hand the stage back to the previous callback so the solver is not left calling into freed memory
+	if (callback->mRegistered)
+		NvFlexRegisterSolverCallback(callback->mSolver, callback->mPrevCallback, eNvFlexStageUpdateEnd);
+
 	delete callback;
 }
 
@@ -118,7 +150,16 @@ void ApplyForceFieldsCallback(NvFlexSolverCallbackParams params)
 
 	NvFlexExtForceFieldCallback* c = (NvFlexExtForceFieldCallback*)params.userData;
 
-	if (params.numActive && c->mNumForceFields)
+	// only one callback can be registered per-stage, run the one this replaced
+	if (c->mPrevCallback.function)
+	{
+		NvFlexSolverCallbackParams prevParams = params;
+		prevParams.userData = c->mPrevCallback.userData;
+
+		c->mPrevCallback.function(prevParams);
+	}
+
+	if (params.numActive && c->mGrid.GetNumCells())
 	{
 		const unsigned int numThreadsPerBlock = 256;
 		const unsigned int kNumBlocks = (params.numActive + numThreadsPerBlock - 1) / numThreadsPerBlock;
@@ -128,12 +169,22 @@ void ApplyForceFieldsCallback(NvFlexSolverCallbackParams params)
 
 		// Init constant buffer
 		{
-			FlexExtConstParams constBuffer;
+			FlexExtConstParams constBuffer = {};
 
 			constBuffer.kNumParticles = params.numActive;
 			constBuffer.kNumForceFields = c->mNumForceFields;
 			constBuffer.kDt = params.dt;
 
+			const ForceFieldGridParams& grid = c->mGrid.mParams;
+
+			constBuffer.kGridLowerX = grid.mLower[0];
+			constBuffer.kGridLowerY = grid.mLower[1];
+			constBuffer.kGridLowerZ = grid.mLower[2];
+			constBuffer.kGridInvCellSize = grid.mInvCellSize;
+			constBuffer.kGridDimX = grid.mDim[0];
+			constBuffer.kGridDimY = grid.mDim[1];
+			constBuffer.kGridDimZ = grid.mDim[2];
+
 			memcpy(c->mContext->map(c->mConstantBuffer), &constBuffer, sizeof(FlexExtConstParams));
 			c->mContext->unmap(c->mConstantBuffer);
 		}
@@ -144,6 +195,8 @@ void ApplyForceFieldsCallback(NvFlexSolverCallbackParams params)
 			params.readWrite[0] = velocities->getResourceRW();
 			params.readOnly[0] = particles->getResource();
 			params.readOnly[1] = c->mForceFieldsGpu->getResource();
+			params.readOnly[2] = c->mCellStartsGpu->getResource();
+			params.readOnly[3] = c->mCellFieldsGpu->getResource();
 			params.gridDim = { kNumBlocks , 1, 1 };
 			params.rootConstantBuffer = c->mConstantBuffer;
 
@@ -152,42 +205,231 @@ void ApplyForceFieldsCallback(NvFlexSolverCallbackParams params)
 	}
 }
 
-void NvFlexExtSetForceFields(NvFlexExtForceFieldCallback* c, const NvFlexExtForceField* forceFields, int numForceFields)
+// copies count elements through a structured buffer's staging copy to the device, the buffer is recreated
+// when it needs to grow and capacity holds its current size in elements
+template <typename T>
+void UploadStructuredBuffer(NvFlex::Context* context, NvFlex::Buffer*& buffer, int& capacity, const T* src, int count)
 {
-	// re-alloc if necessary
-	if (numForceFields > c->mMaxForceFields)
+	if (count > capacity)
 	{
-		delete c->mForceFieldsGpu;
+		delete buffer;
 
 		NvFlex::BufferDesc desc {};
-		desc.dim = numForceFields;
-		desc.stride = sizeof(NvFlexExtForceField);
+		desc.dim = count;
+		desc.stride = sizeof(T);
 		desc.bufferType = NvFlex::eBuffer | NvFlex::eUAV_SRV | NvFlex::eStructured | NvFlex::eStage; 
 		desc.format = NvFlexFormat::eNvFlexFormat_unknown;
 		desc.data = NULL;
 	
-		c->mForceFieldsGpu = c->mContext->createBuffer(&desc);
+		buffer = context->createBuffer(&desc);
 
-		c->mMaxForceFields = numForceFields;
+		capacity = count;
 	}
-	c->mNumForceFields = numForceFields;
 
-	if (numForceFields > 0)
+	if (count > 0)
 	{
 		// update staging buffer
-		void* dstPtr = c->mContext->map(c->mForceFieldsGpu, NvFlex::eMapWrite);
-		memcpy(dstPtr, forceFields, numForceFields*sizeof(NvFlexExtForceField));
-		c->mContext->unmap(c->mForceFieldsGpu);
+		void* dstPtr = context->map(buffer, NvFlex::eMapWrite);
+		memcpy(dstPtr, src, count*sizeof(T));
+		context->unmap(buffer);
 
 		// upload to device buffer
-		c->mContext->upload(c->mForceFieldsGpu, 0, numForceFields*sizeof(NvFlexExtForceField));
+		context->upload(buffer, 0, count*sizeof(T));
+	}
+}
+
+void NvFlexExtSetForceFields(NvFlexExtForceFieldCallback* c, const NvFlexExtForceField* forceFields, int numForceFields)
+{
+	UploadStructuredBuffer(c->mContext, c->mForceFieldsGpu, c->mMaxForceFields, forceFields, numForceFields);
+	c->mNumForceFields = numForceFields;
+
+	// bin the fields so each particle only evaluates the fields overlapping its cell
+	BuildForceFieldGrid(c->mGrid, forceFields, numForceFields);
+
+	if (c->mGrid.GetNumCells())
+	{
+		UploadStructuredBuffer(c->mContext, c->mCellStartsGpu, c->mMaxCellStarts, &c->mGrid.mCellStarts[0], int(c->mGrid.mCellStarts.size()));
+		UploadStructuredBuffer(c->mContext, c->mCellFieldsGpu, c->mMaxCellFields, &c->mGrid.mCellFields[0], int(c->mGrid.mCellFields.size()));
+	}
+
+	if (!c->mRegistered)
+	{
+		NvFlexSolverCallback callback;
+		callback.function = ApplyForceFieldsCallback;
+		callback.userData = c;
+
+		// register a callback to calculate the forces at the end of the time-step, keeping any callback already registered for the stage
+		c->mPrevCallback = NvFlexRegisterSolverCallback(c->mSolver, callback, eNvFlexStageUpdateEnd);
+		c->mRegistered = true;
+	}
+}
+
+static_assert(sizeof(FlexExtMovingFrameD3D) == sizeof(NvFlexExtMovingFrame) + 2*sizeof(float), "Size mismatch for FlexExtMovingFrameD3D");
+
+struct NvFlexExtMovingFrameCallback
+{
+	NvFlexExtMovingFrameCallback(NvFlexSolver* solver) : mSolver(solver)
+	{
+		mPrevCallback.function = NULL;
+		mPrevCallback.userData = NULL;
+		mRegistered = false;
+
+		mPending = false;
+
+		mDevice = NULL;
+		mContext = NULL;
+
+		NvFlexLibrary* lib = NvFlexGetSolverLibrary(solver);
+		NvFlexGetDeviceAndContext(lib, (void**)&mDevice, (void**)&mContext);
+
+		{
+			// moving frame shader
+			NvFlex::ComputeShaderDesc desc{};
+			desc.cs = (void*)g_flexExt_ApplyMovingFrame;
+			desc.cs_length = sizeof(g_flexExt_ApplyMovingFrame);
+			desc.label = L"NvFlexExtMovingFrameCallback";
+			desc.NvAPI_Slot = 0;
+
+			mShaderApplyMovingFrame = mContext->createComputeShader(&desc);
+		}
+
+		{
+			// frame buffer, a single element
+			NvFlex::BufferDesc desc {};
+			desc.dim = 1;
+			desc.stride = sizeof(FlexExtMovingFrameD3D);
+			desc.bufferType = NvFlex::eBuffer | NvFlex::eUAV_SRV | NvFlex::eStructured | NvFlex::eStage; 
+			desc.format = NvFlexFormat::eNvFlexFormat_unknown;
+			desc.data = NULL;
+
+			mFrameGpu = mContext->createBuffer(&desc);
+		}
+
+		{
+			// constant buffer
+			NvFlex::ConstantBufferDesc desc;
+			desc.stride = sizeof(int);
+			desc.dim = sizeof(FlexExtConstParams)/sizeof(int);
+			desc.uploadAccess = true;
+			
+			mConstantBuffer = mContext->createConstantBuffer(&desc);
+		}
+	}
+
+	~NvFlexExtMovingFrameCallback()
+	{
+		delete mFrameGpu;
+		delete mConstantBuffer;
+		delete mShaderApplyMovingFrame;
+	}
+
+	NvFlex::Buffer* mFrameGpu;
+
+	// DX Specific
+	NvFlex::ComputeShader* mShaderApplyMovingFrame;
+	NvFlex::ConstantBuffer* mConstantBuffer;
+
+	// true when the frame has been set but not yet applied
+	bool mPending;
+
+	// D3D device and context wrappers for the solver library
+	NvFlex::Device* mDevice;
+	NvFlex::Context* mContext;
+
+	NvFlexSolver* mSolver;
+
+	// callback that was registered before this one, called first and restored on destroy
+	NvFlexSolverCallback mPrevCallback;
+	bool mRegistered;
+};
+
+NvFlexExtMovingFrameCallback* NvFlexExtCreateMovingFrameCallback(NvFlexSolver* solver)
+{
+	return new NvFlexExtMovingFrameCallback(solver);
+}
+
+void NvFlexExtDestroyMovingFrameCallback(NvFlexExtMovingFrameCallback* callback)
+{
+	// hand the stage back to the previous callback so the solver is not left calling into freed memory
+	if (callback->mRegistered)
+		NvFlexRegisterSolverCallback(callback->mSolver, callback->mPrevCallback, eNvFlexStageUpdateEnd);
+
+	delete callback;
+}
+
+void ApplyMovingFrameCallback(NvFlexSolverCallbackParams params)
+{
+	NvFlexExtMovingFrameCallback* c = (NvFlexExtMovingFrameCallback*)params.userData;
+
+	// only one callback can be registered per-stage, run the one this replaced
+	if (c->mPrevCallback.function)
+	{
+		NvFlexSolverCallbackParams prevParams = params;
+		prevParams.userData = c->mPrevCallback.userData;
 
+		c->mPrevCallback.function(prevParams);
 	}
 
-	NvFlexSolverCallback callback;
-	callback.function = ApplyForceFieldsCallback;
-	callback.userData = c;
+	if (params.numActive && c->mPending)
+	{
+		const unsigned int numThreadsPerBlock = 256;
+		const unsigned int kNumBlocks = (params.numActive + numThreadsPerBlock - 1) / numThreadsPerBlock;
 
-	// register a callback to calculate the forces at the end of the time-step
-	NvFlexRegisterSolverCallback(c->mSolver, callback, eNvFlexStageUpdateEnd);
+		NvFlex::Buffer* particles = (NvFlex::Buffer*)params.particles;
+		NvFlex::Buffer* velocities = (NvFlex::Buffer*)params.velocities;
+
+		// Init constant buffer
+		{
+			FlexExtConstParams constBuffer = {};
+
+			constBuffer.kNumParticles = params.numActive;
+			constBuffer.kDt = params.dt;
+
+			memcpy(c->mContext->map(c->mConstantBuffer), &constBuffer, sizeof(FlexExtConstParams));
+			c->mContext->unmap(c->mConstantBuffer);
+		}
+
+		{
+			NvFlex::DispatchParams params = {};
+			params.shader = c->mShaderApplyMovingFrame;
+			params.readWrite[0] = particles->getResourceRW();
+			params.readWrite[1] = velocities->getResourceRW();
+			params.readOnly[0] = c->mFrameGpu->getResource();
+			params.gridDim = { kNumBlocks , 1, 1 };
+			params.rootConstantBuffer = c->mConstantBuffer;
+
+			c->mContext->dispatch(&params);
+		}
+	}
+
+	// each frame update is applied exactly once
+	c->mPending = false;
+}
+
+void NvFlexExtSetMovingFrame(NvFlexExtMovingFrameCallback* c, const NvFlexExtMovingFrame* frame, float linearScale, float angularScale)
+{
+	FlexExtMovingFrameD3D* dst = (FlexExtMovingFrameD3D*)c->mContext->map(c->mFrameGpu, NvFlex::eMapWrite);
+	
+	// update staging buffer
+	memcpy(dst, frame, sizeof(NvFlexExtMovingFrame));
+	dst->mLinearScale = linearScale;
+	dst->mAngularScale = angularScale;
+
+	c->mContext->unmap(c->mFrameGpu);
+
+	// upload to device buffer
+	c->mContext->upload(c->mFrameGpu, 0, sizeof(FlexExtMovingFrameD3D));
+
+	c->mPending = true;
+
+	if (!c->mRegistered)
+	{
+		NvFlexSolverCallback callback;
+		callback.function = ApplyMovingFrameCallback;
+		callback.userData = c;
+
+		// register a callback to apply the frame at the end of the time-step, keeping any callback already registered for the stage
+		c->mPrevCallback = NvFlexRegisterSolverCallback(c->mSolver, callback, eNvFlexStageUpdateEnd);
+		c->mRegistered = true;
+	}
 }
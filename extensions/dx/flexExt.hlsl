@@ -35,6 +35,8 @@ namespace UpdateForceFields
 {
 	StructuredBuffer<float4> positions : register(t0);
 	StructuredBuffer<FlexExtForceFieldD3D> forceFields : register(t1);
+	StructuredBuffer<int> cellStarts : register(t2);
+	StructuredBuffer<int> cellFields : register(t3);
 
 	RWStructuredBuffer<float4> velocities : register(u0);
 
@@ -42,65 +44,119 @@ namespace UpdateForceFields
 	{
 		const int i = globalIdx.x;
 		const int numParticles = gParams.kNumParticles;
-		const int numForceFields = gParams.kNumForceFields;
 		const float dt = gParams.kDt;
 		
-		for (int f = 0; f < numForceFields; f++)
+		if (i >= numParticles)
+			return;
+
+		float4 p = positions[i];
+		float3 v = velocities[i].xyz;
+
+		// only fields binned in the particle's cell can overlap it, see GetForceFieldCell()
+		const float3 t = (p.xyz - float3(gParams.kGridLowerX, gParams.kGridLowerY, gParams.kGridLowerZ))*gParams.kGridInvCellSize;
+		const int3 dim = int3(gParams.kGridDimX, gParams.kGridDimY, gParams.kGridDimZ);
+		const int3 cell = int3(t);
+
+		if (any(t < 0.0f) || any(cell >= dim))
+			return;
+
+		const int c = (cell.z*dim.y + cell.y)*dim.x + cell.x;
+		const int start = cellStarts[c];
+		const int end = cellStarts[c+1];
+
+		if (start == end)
+			return;
+
+		for (int f = start; f < end; f++)
 		{
-			const FlexExtForceFieldD3D forceField = forceFields[f];
+			const FlexExtForceFieldD3D forceField = forceFields[cellFields[f]];
 			
-			if (i < numParticles)
+			float3 localPos = p.xyz - float3(forceField.mPosition[0], forceField.mPosition[1], forceField.mPosition[2]);
+
+			float dist = length(localPos);
+			if (dist >= forceField.mRadius)
+			{
+				continue;
+			}
+
+			float3 fieldDir;
+			if (dist > 0.0f)
+			{
+				fieldDir = localPos / dist;
+			}
+			else
+			{
+				fieldDir = localPos;
+			}
+
+			// If using linear falloff, scale with distance.
+			float fieldStrength = forceField.mStrength;
+			if (forceField.mLinearFalloff)
+			{
+				fieldStrength *= (1.0f - (dist / forceField.mRadius));
+			}
+
+			float unitMultiplier;
+			if (forceField.mMode == eNvFlexExtModeForce)
+			{
+				unitMultiplier = dt * p.w; // time/mass
+			}
+			else if (forceField.mMode == eNvFlexExtModeImpulse)
+			{
+				unitMultiplier = p.w; // 1/mass
+			}
+			else if (forceField.mMode == eNvFlexExtModeVelocityChange)
 			{
-				const int index = i;
-				
-				float4 p = positions[index];
-				float3 v = velocities[index].xyz;
-				
-				float3 localPos = float3(p.x, p.y, p.z) - float3(forceField.mPosition[0], forceField.mPosition[1], forceField.mPosition[2]);
-
-				float dist = length(localPos);
-				if (dist >= forceField.mRadius)
-				{
-					continue;
-				}
-
-				float3 fieldDir;
-				if (dist > 0.0f)
-				{
-					fieldDir = localPos / dist;
-				}
-				else
-				{
-					fieldDir = localPos;
-				}
-
-				// If using linear falloff, scale with distance.
-				float fieldStrength = forceField.mStrength;
-				if (forceField.mLinearFalloff)
-				{
-					fieldStrength *= (1.0f - (dist / forceField.mRadius));
-				}
-
-				// Apply force
-				float3 force = localPos * fieldStrength;
-
-				float unitMultiplier;
-				if (forceField.mMode == eNvFlexExtModeForce)
-				{
-					unitMultiplier = dt * p.w; // time/mass
-				}
-				else if (forceField.mMode == eNvFlexExtModeImpulse)
-				{
-					unitMultiplier = p.w; // 1/mass
-				}
-				else if (forceField.mMode == eNvFlexExtModeVelocityChange)
-				{
-					unitMultiplier = 1.0f;
-				}
-
-				float3 deltaVelocity = fieldDir * fieldStrength * unitMultiplier;
-				velocities[index] = float4(v + deltaVelocity, 0.0f);
+				unitMultiplier = 1.0f;
 			}
+
+			v += fieldDir * fieldStrength * unitMultiplier;
+		}
+
+		velocities[i] = float4(v, 0.0f);
+	}
+}
+
+namespace ApplyMovingFrame
+{
+	StructuredBuffer<FlexExtMovingFrameD3D> frames : register(t0);
+
+	RWStructuredBuffer<float4> positions : register(u0);
+	RWStructuredBuffer<float4> velocities : register(u1);
+
+	[numthreads(kNumThreadsPerBlock, 1, 1)] void execute(uint3 globalIdx : SV_DispatchThreadID)
+	{
+		const int i = globalIdx.x;
+		const int numParticles = gParams.kNumParticles;
+		const float dt = gParams.kDt;
+
+		if (i < numParticles)
+		{
+			const FlexExtMovingFrameD3D frame = frames[0];
+
+			float4 p = positions[i];
+			float4 v = velocities[i];
+
+			float3 framePosition = float3(frame.mPosition[0], frame.mPosition[1], frame.mPosition[2]);
+			float3 omega = float3(frame.mOmega[0], frame.mOmega[1], frame.mOmega[2]);
+			float3 tau = float3(frame.mTau[0], frame.mTau[1], frame.mTau[2]);
+			float3 linearForce = -float3(frame.mAcceleration[0], frame.mAcceleration[1], frame.mAcceleration[2]);
+
+			// centrifugal and Euler forces depend on the particle's offset from the frame
+			float3 d = p.xyz - framePosition;
+			float3 angularForce = -cross(omega, cross(omega, d)) - cross(tau, d);
+
+			// transform particle to the frame's new location
+			float3 newPos = float3(
+				frame.mDelta[0][0]*p.x + frame.mDelta[1][0]*p.y + frame.mDelta[2][0]*p.z + frame.mDelta[3][0],
+				frame.mDelta[0][1]*p.x + frame.mDelta[1][1]*p.y + frame.mDelta[2][1]*p.z + frame.mDelta[3][1],
+				frame.mDelta[0][2]*p.x + frame.mDelta[1][2]*p.y + frame.mDelta[2][2]*p.z + frame.mDelta[3][2]);
+
+			float3 newVel = v.xyz + (linearForce*frame.mLinearScale + angularForce*frame.mAngularScale)*dt;
+
+			// w (inverse mass) is left untouched
+			positions[i] = float4(newPos, p.w);
+			velocities[i] = float4(newVel, v.w);
 		}
 	}
 }
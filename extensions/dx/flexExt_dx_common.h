@@ -39,6 +39,17 @@ struct FlexExtConstParams
 	int kNumForceFields;
 	float kDt;
 	float _pad;
+
+	// force field broadphase, see ForceFieldGridParams
+	float kGridLowerX;
+	float kGridLowerY;
+	float kGridLowerZ;
+	float kGridInvCellSize;
+
+	int kGridDimX;
+	int kGridDimY;
+	int kGridDimZ;
+	int _pad1;
 };
 
 #ifdef WIN32
@@ -62,4 +73,24 @@ struct FlexExtForceFieldD3D
 	bool mLinearFalloff;	//!< Linear or no falloff 
 };
 
+/**
+* Moving frame data, mirrors NvFlexExtMovingFrame followed by the scales passed to NvFlexExtSetMovingFrame()
+*/
+struct FlexExtMovingFrameD3D
+{
+	float mPosition[3];		//!< Frame origin
+	float mRotation[4];		//!< Frame orientation (quaternion)
+
+	float mVelocity[3];		//!< Linear velocity
+	float mOmega[3];		//!< Angular velocity
+
+	float mAcceleration[3];	//!< Linear acceleration
+	float mTau[3];			//!< Angular acceleration
+
+	float mDelta[4][4];		//!< Column major transform from the frame's previous to current location
+
+	float mLinearScale;		//!< Scale applied to the translational inertial forces
+	float mAngularScale;	//!< Scale applied to the angular inertial forces
+};
+
 #endif	// FLEXEXT_DX_COMMON_H
@@ -0,0 +1,300 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#include "../include/NvFlexExt.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+
+namespace
+{
+
+// size classes are multiples of a cache line, below 256 bytes every multiple is a class,
+// above that there are four classes per power of two so a request wastes at most 25%
+const size_t kPoolAlignment = 64;
+const size_t kPoolLinearClasses = 4*kPoolAlignment;
+
+size_t SizeClass(size_t bytes)
+{
+	if (bytes <= kPoolLinearClasses)
+		return std::max(kPoolAlignment, (bytes + kPoolAlignment - 1) & ~(kPoolAlignment - 1));
+
+	size_t p = kPoolLinearClasses;
+	while (p*2 < bytes)
+		p *= 2;
+
+	const size_t step = p/4;
+	return (bytes + step - 1) & ~(step - 1);
+}
+
+// buffers are only interchangeable when they share memory space, stride and size class
+struct PoolKey
+{
+	size_t classBytes;
+	int stride;
+	NvFlexBufferType type;
+
+	bool operator<(const PoolKey& rhs) const
+	{
+		if (classBytes != rhs.classBytes) return classBytes < rhs.classBytes;
+		if (stride != rhs.stride) return stride < rhs.stride;
+		return type < rhs.type;
+	}
+};
+
+struct PoolAllocation
+{
+	PoolKey key;
+	size_t requestedBytes;
+
+	// set by NvFlexExtPoolSetBufferOwner(), detached if the pool is destroyed first
+	void* owner;
+	NvFlexExtPoolDetachCallback detach;
+};
+
+} // anonymous namespace
+
+struct NvFlexExtBufferPool
+{
+	NvFlexLibrary* lib;
+	size_t maxRetainedBytes;
+
+	std::map<PoolKey, std::vector<NvFlexBuffer*> > freeLists;
+	std::unordered_map<NvFlexBuffer*, PoolAllocation> live;
+
+	NvFlexExtBufferPoolStats stats;
+
+	std::mutex mutex;
+};
+
+namespace
+{
+
+void UpdatePeaks(NvFlexExtBufferPool* pool)
+{
+	NvFlexExtBufferPoolStats& s = pool->stats;
+
+	s.peakRequestedBytes = std::max(s.peakRequestedBytes, s.requestedBytes);
+	s.peakReservedBytes = std::max(s.peakReservedBytes, s.allocatedBytes + s.retainedBytes);
+}
+
+} // anonymous namespace
+
+NvFlexExtBufferPool* NvFlexExtCreateBufferPool(NvFlexLibrary* lib, size_t maxRetainedBytes)
+{
+	NvFlexExtBufferPool* pool = new NvFlexExtBufferPool();
+	pool->lib = lib;
+	pool->maxRetainedBytes = maxRetainedBytes;
+
+	memset(&pool->stats, 0, sizeof(pool->stats));
+
+	return pool;
+}
+
+void NvFlexExtDestroyBufferPool(NvFlexExtBufferPool* pool)
+{
+	if (!pool)
+		return;
+
+	NvFlexExtTrimBufferPool(pool);
+
+#ifndef NDEBUG
+	if (!pool->live.empty())
+		printf("NvFlexExtDestroyBufferPool: %d buffers were not returned to the pool\n", int(pool->live.size()));
+#endif
+
+	// buffers that were never returned are released so the library does not leak them, 
+	// their owners are detached first so they don't return or free the buffers again
+	for (std::unordered_map<NvFlexBuffer*, PoolAllocation>::iterator it=pool->live.begin(); it != pool->live.end(); ++it)
+	{
+		if (it->second.detach)
+			it->second.detach(it->second.owner, it->first);
+
+		NvFlexFreeBuffer(it->first);
+	}
+
+	delete pool;
+}
+
+NvFlexLibrary* NvFlexExtGetBufferPoolLibrary(NvFlexExtBufferPool* pool)
+{
+	return pool->lib;
+}
+
+NvFlexBuffer* NvFlexExtPoolAllocBuffer(NvFlexExtBufferPool* pool, int elementCount, int elementByteStride, NvFlexBufferType type, int* capacity)
+{
+	assert(elementByteStride > 0);
+
+	const size_t requestedBytes = size_t(std::max(elementCount, 1))*elementByteStride;
+
+	PoolKey key;
+	key.classBytes = SizeClass(requestedBytes);
+	key.stride = elementByteStride;
+	key.type = type;
+
+	const int classCapacity = int(key.classBytes/elementByteStride);
+
+	NvFlexBuffer* buf = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+
+		pool->stats.numAllocs++;
+
+		std::map<PoolKey, std::vector<NvFlexBuffer*> >::iterator it = pool->freeLists.find(key);
+		if (it != pool->freeLists.end() && !it->second.empty())
+		{
+			buf = it->second.back();
+			it->second.pop_back();
+
+			pool->stats.retainedBytes -= key.classBytes;
+			pool->stats.numRecycled++;
+		}
+	}
+
+	// allocate outside the lock, library allocations of pinned memory can be slow
+	if (!buf)
+		buf = NvFlexAllocBuffer(pool->lib, classCapacity, elementByteStride, type);
+
+	if (!buf)
+		return NULL;
+
+	PoolAllocation alloc;
+	alloc.key = key;
+	alloc.requestedBytes = requestedBytes;
+	alloc.owner = NULL;
+	alloc.detach = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+
+		pool->live[buf] = alloc;
+
+		pool->stats.requestedBytes += requestedBytes;
+		pool->stats.allocatedBytes += key.classBytes;
+		pool->stats.numBuffers++;
+
+		UpdatePeaks(pool);
+	}
+
+	if (capacity)
+		*capacity = classCapacity;
+
+	return buf;
+}
+
+void NvFlexExtPoolFreeBuffer(NvFlexExtBufferPool* pool, NvFlexBuffer* buf)
+{
+	if (!buf)
+		return;
+
+	bool release = false;
+
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+
+		std::unordered_map<NvFlexBuffer*, PoolAllocation>::iterator it = pool->live.find(buf);
+		if (it == pool->live.end())
+		{
+			// not allocated from this pool
+			assert(0);
+			return;
+		}
+
+		const PoolAllocation alloc = it->second;
+		pool->live.erase(it);
+
+		pool->stats.requestedBytes -= alloc.requestedBytes;
+		pool->stats.allocatedBytes -= alloc.key.classBytes;
+		pool->stats.numBuffers--;
+
+		if (pool->maxRetainedBytes == 0 || pool->stats.retainedBytes + alloc.key.classBytes <= pool->maxRetainedBytes)
+		{
+			pool->freeLists[alloc.key].push_back(buf);
+			pool->stats.retainedBytes += alloc.key.classBytes;
+		}
+		else
+		{
+			release = true;
+		}
+	}
+
+	if (release)
+		NvFlexFreeBuffer(buf);
+}
+
+void NvFlexExtPoolSetBufferOwner(NvFlexExtBufferPool* pool, NvFlexBuffer* buf, void* owner, NvFlexExtPoolDetachCallback detach)
+{
+	if (!buf)
+		return;
+
+	std::lock_guard<std::mutex> lock(pool->mutex);
+
+	std::unordered_map<NvFlexBuffer*, PoolAllocation>::iterator it = pool->live.find(buf);
+	if (it == pool->live.end())
+	{
+		// not allocated from this pool
+		assert(0);
+		return;
+	}
+
+	it->second.owner = owner;
+	it->second.detach = detach;
+}
+
+void NvFlexExtTrimBufferPool(NvFlexExtBufferPool* pool)
+{
+	std::vector<NvFlexBuffer*> buffers;
+
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+
+		for (std::map<PoolKey, std::vector<NvFlexBuffer*> >::iterator it=pool->freeLists.begin(); it != pool->freeLists.end(); ++it)
+			buffers.insert(buffers.end(), it->second.begin(), it->second.end());
+
+		pool->freeLists.clear();
+		pool->stats.retainedBytes = 0;
+	}
+
+	for (size_t i=0; i < buffers.size(); ++i)
+		NvFlexFreeBuffer(buffers[i]);
+}
+
+void NvFlexExtGetBufferPoolStats(NvFlexExtBufferPool* pool, NvFlexExtBufferPoolStats* stats)
+{
+	std::lock_guard<std::mutex> lock(pool->mutex);
+
+	*stats = pool->stats;
+
+	const size_t reserved = pool->stats.allocatedBytes + pool->stats.retainedBytes;
+	stats->fragmentation = reserved ? 1.0f - float(pool->stats.requestedBytes)/float(reserved) : 0.0f;
+}
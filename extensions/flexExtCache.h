@@ -0,0 +1,113 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#pragma once
+
+// internal interface between the asset creation functions and the on-disk asset cache (implemented in flexExtCook.cpp)
+
+#include "../include/NvFlexExt.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// identifies the creation function an asset was cooked by, part of the cache key
+enum AssetCacheType
+{
+	eAssetCacheRigid = 1,
+	eAssetCacheSoft = 2,
+	eAssetCacheCloth = 3,
+};
+
+// version of the cooking code for each asset type, kAssetFileVersion only covers the file layout so these must
+// be bumped by any change that alters the cooked output, otherwise assets cooked by the old code keep being returned
+const int kRigidCookVersion = 2;
+const int kSoftCookVersion = 2;
+const int kClothCookVersion = 2;
+
+inline int GetCookVersion(AssetCacheType type)
+{
+	switch (type)
+	{
+		case eAssetCacheRigid: return kRigidCookVersion;
+		case eAssetCacheSoft: return kSoftCookVersion;
+		case eAssetCacheCloth: return kClothCookVersion;
+	}
+
+	return 0;
+}
+
+// 64-bit content hash of the inputs to an asset creation function, consumes 8 bytes per step
+struct AssetCacheKey
+{
+	AssetCacheKey(AssetCacheType type) : hash(14695981039346656037ULL)
+	{
+		Add(int(type));
+		Add(GetCookVersion(type));
+	}
+
+	void Add(const void* data, size_t bytes)
+	{
+		const uint8_t* p = (const uint8_t*)data;
+
+		// mix in the length so that adjacent arrays cannot alias
+		Mix(uint64_t(bytes));
+
+		for (; bytes >= 8; p += 8, bytes -= 8)
+		{
+			uint64_t word;
+			memcpy(&word, p, 8);
+			Mix(word);
+		}
+
+		if (bytes)
+		{
+			uint64_t word = 0;
+			memcpy(&word, p, bytes);
+			Mix(word);
+		}
+	}
+
+	void Add(int x) { Mix(uint64_t(uint32_t(x))); }
+	void Add(float x) { uint32_t u; memcpy(&u, &x, 4); Mix(u); }
+
+	void Mix(uint64_t word)
+	{
+		hash = (hash ^ word)*1099511628211ULL;
+		hash ^= hash >> 29;
+	}
+
+	uint64_t hash;
+};
+
+// true if a cache directory has been set, creation functions only compute keys when the cache is enabled
+bool IsAssetCacheEnabled();
+
+// returns a new asset loaded from the cache, or NULL if there is no entry for key
+NvFlexExtAsset* LoadCachedAsset(const AssetCacheKey& key);
+
+// writes an asset to the cache, NULL assets (failed cooks) are not stored
+void StoreCachedAsset(const AssetCacheKey& key, const NvFlexExtAsset* asset);
@@ -26,62 +26,482 @@
 // Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
 
 #include "../include/NvFlexExt.h"
+#include "flexExtCache.h"
 
 #include "../core/cloth.h"
+#include "../core/parallel.h"
+
+#include <queue>
 
 namespace
 {
-	struct Key
+	// welding bins vertices into a hash grid with cells at least twice the threshold across, so a vertex can only have
+	// duplicates in its own cell and, on each axis, the one neighbor on the side of the cell it is within the threshold of
+	const int kCellBits = 21;
+	const int kMaxCell = (1<<kCellBits)-1;
+
+	const uint64_t kEmptyCell = ~uint64_t(0);
+
+	inline uint64_t GetCellKey(int x, int y, int z)
 	{
-		Key(int i, float d) : index(i), depth(d) {}
+		return (uint64_t(x) << (2*kCellBits)) | (uint64_t(y) << kCellBits) | uint64_t(z);
+	}
+
+	// open addressing map from cell keys to cell indices
+	class CellTable
+	{
+	public:
+
+		CellTable(int numCells)
+		{
+			uint32_t capacity = 64;
+			while (capacity < uint32_t(numCells)*2)
+				capacity *= 2;
+
+			const Entry empty = { kEmptyCell, -1 };
+
+			m_entries.assign(capacity, empty);
+			m_mask = capacity-1;
+		}
+
+		// returns the cell stored for key, or stores and returns cell if the key is new
+		int Insert(uint64_t key, int cell)
+		{
+			for (uint32_t i=GetSlot(key); ; i = (i+1)&m_mask)
+			{
+				Entry& e = m_entries[i];
+
+				if (e.key == key)
+					return e.cell;
+
+				if (e.key == kEmptyCell)
+				{
+					e.key = key;
+					e.cell = cell;
+
+					return cell;
+				}
+			}
+		}
+
+		// returns -1 if the cell is empty
+		int Find(uint64_t key) const
+		{
+			for (uint32_t i=GetSlot(key); ; i = (i+1)&m_mask)
+			{
+				const Entry& e = m_entries[i];
+
+				if (e.key == key)
+					return e.cell;
+
+				if (e.key == kEmptyCell)
+					return -1;
+			}
+		}
+
+	private:
+
+		uint32_t GetSlot(uint64_t key) const
+		{
+			return uint32_t((key*0x9E3779B97F4A7C15ull) >> 32) & m_mask;
+		}
+
+		struct Entry
+		{
+			uint64_t key;
+			int cell;
+		};
 
-		int index;
-		float depth;
-		
-		bool operator < (const Key& rhs) const { return depth < rhs.depth; }
+		std::vector<Entry> m_entries;
+		uint32_t m_mask;
 	};
 }
 
 int NvFlexExtCreateWeldedMeshIndices(const float* vertices, int numVertices, int* uniqueIndices, int* originalToUniqueMap, float threshold)
 {
-	memset(originalToUniqueMap, -1, numVertices*sizeof(int));
+	if (numVertices <= 0)
+		return 0;
 
 	const Vec3* positions = (const Vec3*)vertices;
 
-	// use a sweep and prune style search to accelerate neighbor finding
-	std::vector<Key> keys;
-	for (int i=0; i < numVertices; i++)
-		keys.push_back(Key(i, positions[i].z));
+	threshold = Max(threshold, 0.0f);
+
+	Vec3 lower(FLT_MAX);
+	Vec3 upper(-FLT_MAX);
+
+	for (int i=0; i < numVertices; ++i)
+	{
+		lower = Min(lower, positions[i]);
+		upper = Max(upper, positions[i]);
+	}
+
+	// cells may need to be larger than the threshold so the coordinates fit the key
+	const Vec3 edges = upper-lower;
+	const float maxEdge = Max(Max(edges.x, edges.y), edges.z);
+
+	float cellSize = Max(2.0f*threshold, maxEdge/(kMaxCell-1));
+	if (cellSize <= 0.0f)
+		cellSize = 1.0f;
 
-	std::sort(keys.begin(), keys.end());
+	const float invCellSize = 1.0f/cellSize;
 
+	ThreadPool& pool = GetDefaultThreadPool();
+
+	// cell coordinates of each vertex
+	std::vector<uint64_t> keys(numVertices);
+
+	pool.ParallelFor(0, numVertices, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const Vec3 p = (positions[i]-lower)*invCellSize;
+			keys[i] = GetCellKey(Min(int(p.x), kMaxCell), Min(int(p.y), kMaxCell), Min(int(p.z), kMaxCell));
+		}
+	}, 0, 16384);
+
+	// bin the vertices by cell, in increasing index order within each cell
+	CellTable table(numVertices);
+
+	std::vector<uint64_t> cellKeys;
+	std::vector<int> cellStarts;
+	std::vector<int> vertexCells(numVertices);
+
+	for (int i=0; i < numVertices; ++i)
+	{
+		const int cell = table.Insert(keys[i], int(cellKeys.size()));
+
+		if (cell == int(cellKeys.size()))
+		{
+			cellKeys.push_back(keys[i]);
+			cellStarts.push_back(0);
+		}
+
+		cellStarts[cell]++;
+		vertexCells[i] = cell;
+	}
+
+	const int numCells = int(cellKeys.size());
+
+	int offset = 0;
+	for (int c=0; c < numCells; ++c)
+	{
+		const int count = cellStarts[c];
+
+		cellStarts[c] = offset;
+		offset += count;
+	}
+
+	cellStarts.push_back(offset);
+
+	std::vector<int> cellVertices(numVertices);
+	std::vector<int> cellCursors(cellStarts.begin(), cellStarts.end()-1);
+
+	for (int i=0; i < numVertices; ++i)
+		cellVertices[cellCursors[vertexCells[i]]++] = i;
+
+	// cells are welded in eight passes by the parity of their coordinates, cells of the same parity are never neighbors so each
+	// pass can run in parallel and the result doesn't depend on the thread count. A vertex is welded to the closest vertex kept 
+	// by an earlier pass or earlier in its own cell, otherwise it is kept, -1 marks vertices that haven't been visited yet
+	std::vector<int> colorCells[8];
+
+	for (int c=0; c < numCells; ++c)
+	{
+		const uint64_t key = cellKeys[c];
+		colorCells[((key >> (2*kCellBits))&1) | (((key >> kCellBits)&1) << 1) | ((key&1) << 2)].push_back(c);
+	}
+
+	std::vector<int> representatives(numVertices, -1);
+
+	// allow for rounding in the distance to the cell boundary
+	const float boundaryDist = threshold*invCellSize*1.001f;
+	const float thresholdSq = threshold*threshold;
+
+	for (int color=0; color < 8; ++color)
+	{
+		const std::vector<int>& cells = colorCells[color];
+
+		pool.ParallelFor(0, int(cells.size()), [&](int begin, int end)
+		{
+			for (int c=begin; c < end; ++c)
+			{
+				const uint64_t key = cellKeys[cells[c]];
+				const int cell[3] = { int(key >> (2*kCellBits)), int((key >> kCellBits)&kMaxCell), int(key&kMaxCell) };
+
+				for (int v=cellStarts[cells[c]]; v < cellStarts[cells[c]+1]; ++v)
+				{
+					const int i = cellVertices[v];
+					const Vec3 p = (positions[i]-lower)*invCellSize;
+
+					// neighboring cells within the threshold on each axis, the vertex's own cell first
+					int offsets[3][2];
+					int numOffsets[3];
+
+					for (int a=0; a < 3; ++a)
+					{
+						const float f = p[a]-cell[a];
+
+						offsets[a][0] = 0;
+						numOffsets[a] = 1;
+
+						if (f <= boundaryDist && cell[a] > 0)
+							offsets[a][numOffsets[a]++] = -1;
+						else if (1.0f-f <= boundaryDist && cell[a] < kMaxCell)
+							offsets[a][numOffsets[a]++] = 1;
+					}
+
+					int closest = i;
+					float closestDistSq = FLT_MAX;
+
+					for (int x=0; x < numOffsets[0]; ++x)
+					{
+						for (int y=0; y < numOffsets[1]; ++y)
+						{
+							for (int z=0; z < numOffsets[2]; ++z)
+							{
+								const int neighbor = (x|y|z) ? table.Find(GetCellKey(cell[0]+offsets[0][x], cell[1]+offsets[1][y], cell[2]+offsets[2][z])) : cells[c];
+
+								if (neighbor == -1)
+									continue;
+
+								for (int n=cellStarts[neighbor]; n < cellStarts[neighbor+1]; ++n)
+								{
+									const int j = cellVertices[n];
+
+									if (representatives[j] != j)
+										continue;
+
+									const float distSq = LengthSq(positions[i]-positions[j]);
+
+									if (distSq <= thresholdSq && distSq < closestDistSq)
+									{
+										closest = j;
+										closestDistSq = distSq;
+									}
+								}
+							}
+						}
+					}
+
+					representatives[i] = closest;
+				}
+			}
+		}, 0, 1024);
+	}
+
+	// unique vertices are numbered in index order
 	int uniqueCount = 0;
 
-	// sweep keys to find matching verts
 	for (int i=0; i < numVertices; ++i)
 	{
-		// we are a duplicate, skip
-		if (originalToUniqueMap[keys[i].index] != -1)
-			continue;
+		if (representatives[i] == i)
+		{
+			originalToUniqueMap[i] = uniqueCount;
+			uniqueIndices[uniqueCount++] = i;
+		}
+	}
+
+	pool.ParallelFor(0, numVertices, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			if (representatives[i] != i)
+				originalToUniqueMap[i] = originalToUniqueMap[representatives[i]];
+		}
+
+	}, 0, 16384);
+
+	return uniqueCount;
+}
+
+namespace
+{
+
+// implicit k-d tree over the anchor particles, each range of the anchor order is split at its middle element on the longest axis of its bounds
+class AnchorTree
+{
+public:
+
+	AnchorTree(const Vec4* particles, const std::vector<int>& anchors) : m_particles(particles), m_anchors(anchors), m_axes(anchors.size())
+	{
+		Build(0, int(anchors.size()));
+	}
+
+	// returns the closest anchor to p and its squared distance, ties go to the lowest particle index
+	int FindClosest(const Vec3& p, float& outDistSq) const
+	{
+		int closest = -1;
+		outDistSq = FLT_MAX;
+
+		FindClosest(0, int(m_anchors.size()), p, closest, outDistSq);
+
+		return closest;
+	}
+
+private:
+
+	void Build(int begin, int end)
+	{
+		if (end-begin <= 1)
+			return;
+
+		Vec3 lower(FLT_MAX);
+		Vec3 upper(-FLT_MAX);
+
+		for (int i=begin; i < end; ++i)
+		{
+			lower = Min(lower, Vec3(m_particles[m_anchors[i]]));
+			upper = Max(upper, Vec3(m_particles[m_anchors[i]]));
+		}
+
+		const Vec3 edges = upper-lower;
+		const int axis = (edges.x > edges.y) ? (edges.x > edges.z ? 0 : 2) : (edges.y > edges.z ? 1 : 2);
+
+		const int mid = (begin+end)/2;
 
-		// scan forward until no vertex can be closer than threshold
-		for (int j=i+1; j < numVertices && (keys[j].depth-keys[i].depth) <= threshold; ++j)
+		const Vec4* particles = m_particles;
+		std::nth_element(m_anchors.begin()+begin, m_anchors.begin()+mid, m_anchors.begin()+end, [particles, axis](int a, int b) 
 		{
-			float distance = Length(Vector3(positions[keys[i].index])-Vector3(positions[keys[j].index]));
+			return particles[a][axis] < particles[b][axis];
+		});
 
-			if (distance <= threshold)
-				originalToUniqueMap[keys[j].index] = uniqueCount;
+		m_axes[mid] = uint8_t(axis);
+
+		Build(begin, mid);
+		Build(mid+1, end);
+	}
+
+	void FindClosest(int begin, int end, const Vec3& p, int& closest, float& closestDistSq) const
+	{
+		if (begin >= end)
+			return;
+
+		const int mid = (begin+end)/2;
+		const int anchor = m_anchors[mid];
+
+		const float distSq = LengthSq(p-Vec3(m_particles[anchor]));
+
+		if (distSq < closestDistSq || (distSq == closestDistSq && anchor < closest))
+		{
+			closest = anchor;
+			closestDistSq = distSq;
 		}
 
-		originalToUniqueMap[keys[i].index] = uniqueCount;
+		if (end-begin == 1)
+			return;
+
+		const int axis = m_axes[mid];
+		const float planeDist = p[axis]-m_particles[anchor][axis];
+
+		// near side first, the far side only if it can hold an anchor at least as close
+		if (planeDist < 0.0f)
+		{
+			FindClosest(begin, mid, p, closest, closestDistSq);
+
+			if (planeDist*planeDist <= closestDistSq)
+				FindClosest(mid+1, end, p, closest, closestDistSq);
+		}
+		else
+		{
+			FindClosest(mid+1, end, p, closest, closestDistSq);
 
-		uniqueIndices[uniqueCount++] = keys[i].index;
+			if (planeDist*planeDist <= closestDistSq)
+				FindClosest(begin, mid, p, closest, closestDistSq);
+		}
 	}
 
-	return uniqueCount;
+	const Vec4* m_particles;
+
+	std::vector<int> m_anchors;
+	std::vector<uint8_t> m_axes;
+};
+
+// closest anchor to each particle by straight line distance
+void FindClosestAnchors(const Vec4* particles, int numParticles, const std::vector<int>& anchors, std::vector<int>& closest, std::vector<float>& distances)
+{
+	const AnchorTree tree(particles, anchors);
+
+	GetDefaultThreadPool().ParallelFor(0, numParticles, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			float distSq;
+			closest[i] = tree.FindClosest(Vec3(particles[i]), distSq);
+			distances[i] = sqrtf(distSq);
+		}
+	}, 0, 1024);
 }
 
-NvFlexExtAsset* NvFlexExtCreateClothFromMesh(const float* particles, int numVertices, const int* indices, int numTriangles, float stretchStiffness, float bendStiffness, float tetherStiffness, float tetherGive, float pressure)
+// closest anchor to each particle by the length of the shortest path along the mesh edges, found with a Dijkstra search started
+// from every anchor at once. Particles that are not connected to an anchor through the mesh are left with no anchor (-1)
+void FindClosestAnchorsGeodesic(const Vec4* particles, int numParticles, const int* indices, int numTriangles, const std::vector<int>& anchors, std::vector<int>& closest, std::vector<float>& distances)
+{
+	// edges of each particle, shared edges are listed once per triangle
+	std::vector<int> edgeStarts(numParticles+1, 0);
+	std::vector<int> edges(numTriangles*6);
+
+	for (int i=0; i < numTriangles*3; ++i)
+		edgeStarts[indices[i]+1] += 2;
+
+	for (int i=0; i < numParticles; ++i)
+		edgeStarts[i+1] += edgeStarts[i];
+
+	std::vector<int> cursors(edgeStarts.begin(), edgeStarts.end()-1);
+
+	for (int t=0; t < numTriangles; ++t)
+	{
+		for (int e=0; e < 3; ++e)
+		{
+			const int a = indices[t*3+e];
+			const int b = indices[t*3+(e+1)%3];
+
+			edges[cursors[a]++] = b;
+			edges[cursors[b]++] = a;
+		}
+	}
+
+	closest.assign(numParticles, -1);
+	distances.assign(numParticles, FLT_MAX);
+
+	typedef std::pair<float, int> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+
+	for (size_t a=0; a < anchors.size(); ++a)
+	{
+		closest[anchors[a]] = anchors[a];
+		distances[anchors[a]] = 0.0f;
+
+		queue.push(Entry(0.0f, anchors[a]));
+	}
+
+	while (!queue.empty())
+	{
+		const Entry top = queue.top();
+		queue.pop();
+
+		const int i = top.second;
+
+		// stale entry, the particle was reached by a shorter path since
+		if (top.first > distances[i])
+			continue;
+
+		for (int e=edgeStarts[i]; e < edgeStarts[i+1]; ++e)
+		{
+			const int j = edges[e];
+			const float dist = distances[i] + Length(Vec3(particles[i])-Vec3(particles[j]));
+
+			// equal paths go to the lowest anchor so the result doesn't depend on the visiting order
+			if (dist < distances[j] || (dist == distances[j] && closest[i] < closest[j]))
+			{
+				distances[j] = dist;
+				closest[j] = closest[i];
+
+				queue.push(Entry(dist, j));
+			}
+		}
+	}
+}
+
+NvFlexExtAsset* CookClothFromMesh(const float* particles, int numVertices, const int* indices, int numTriangles, float stretchStiffness, float bendStiffness, float tetherStiffness, float tetherGive, float pressure, bool geodesicTethers)
 {
 	NvFlexExtAsset* asset = new NvFlexExtAsset();
 	memset(asset, 0, sizeof(*asset));
@@ -119,6 +539,14 @@ NvFlexExtAsset* NvFlexExtCreateClothFromMesh(const float* particles, int numVert
 
 			if (anchors.size())
 			{
+				std::vector<int> closest(numVertices);
+				std::vector<float> distances(numVertices);
+
+				if (geodesicTethers)
+					FindClosestAnchorsGeodesic((const Vec4*)particles, numVertices, indices, numTriangles, anchors, closest, distances);
+				else
+					FindClosestAnchors((const Vec4*)particles, numVertices, anchors, closest, distances);
+
 				// create tethers
 				for (int i=0; i < numVertices; ++i)
 				{
@@ -126,28 +554,12 @@ NvFlexExtAsset* NvFlexExtCreateClothFromMesh(const float* particles, int numVert
 					if (particle.w == 0.0f)
 						continue;
 
-					float minSqrDist = FLT_MAX;
-					int minIndex = -1;
-
-					// find the closest attachment point
-					for (int a=0; a < int(anchors.size()); ++a)
-					{
-						Vec4& attachment = ((Vec4*)particles)[anchors[a]];
-
-						float distSqr = LengthSq(Vec3(particle)-Vec3(attachment));
-						if (distSqr < minSqrDist)
-						{
-							minSqrDist = distSqr;
-							minIndex = anchors[a];
-						}
-					}
-
 					// add a tether
-					if (minIndex != -1)
+					if (closest[i] != -1)
 					{						
 						cloth.mConstraintIndices.push_back(i);
-						cloth.mConstraintIndices.push_back(minIndex);
-						cloth.mConstraintRestLengths.push_back(sqrtf(minSqrDist)*(1.0f + tetherGive));						
+						cloth.mConstraintIndices.push_back(closest[i]);
+						cloth.mConstraintRestLengths.push_back(distances[i]*(1.0f + tetherGive));						
 						
 						// negative stiffness indicates tether (unilateral constraint)
 						cloth.mConstraintCoefficients.push_back(-tetherStiffness);
@@ -188,6 +600,44 @@ NvFlexExtAsset* NvFlexExtCreateClothFromMesh(const float* particles, int numVert
 	return asset;
 }
 
+NvFlexExtAsset* CreateClothFromMesh(const float* particles, int numVertices, const int* indices, int numTriangles, float stretchStiffness, float bendStiffness, float tetherStiffness, float tetherGive, float pressure, bool geodesicTethers)
+{
+	if (!IsAssetCacheEnabled())
+		return CookClothFromMesh(particles, numVertices, indices, numTriangles, stretchStiffness, bendStiffness, tetherStiffness, tetherGive, pressure, geodesicTethers);
+
+	AssetCacheKey key(eAssetCacheCloth);
+	key.Add(particles, sizeof(float)*4*numVertices);
+	key.Add(indices, sizeof(int)*3*numTriangles);
+	key.Add(stretchStiffness);
+	key.Add(bendStiffness);
+	key.Add(tetherStiffness);
+	key.Add(tetherGive);
+	key.Add(pressure);
+	key.Add(int(geodesicTethers));
+
+	NvFlexExtAsset* asset = LoadCachedAsset(key);
+
+	if (!asset)
+	{
+		asset = CookClothFromMesh(particles, numVertices, indices, numTriangles, stretchStiffness, bendStiffness, tetherStiffness, tetherGive, pressure, geodesicTethers);
+		StoreCachedAsset(key, asset);
+	}
+
+	return asset;
+}
+
+} // anonymous namespace
+
+NvFlexExtAsset* NvFlexExtCreateClothFromMesh(const float* particles, int numVertices, const int* indices, int numTriangles, float stretchStiffness, float bendStiffness, float tetherStiffness, float tetherGive, float pressure)
+{
+	return CreateClothFromMesh(particles, numVertices, indices, numTriangles, stretchStiffness, bendStiffness, tetherStiffness, tetherGive, pressure, false);
+}
+
+NvFlexExtAsset* NvFlexExtCreateClothFromMeshWithGeodesicTethers(const float* particles, int numVertices, const int* indices, int numTriangles, float stretchStiffness, float bendStiffness, float tetherStiffness, float tetherGive, float pressure)
+{
+	return CreateClothFromMesh(particles, numVertices, indices, numTriangles, stretchStiffness, bendStiffness, tetherStiffness, tetherGive, pressure, true);
+}
+
 struct FlexExtTearingClothAsset : public NvFlexExtAsset
 {
 	ClothMesh* mMesh;
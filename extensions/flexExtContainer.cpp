@@ -27,61 +27,124 @@
 
 #include <vector>
 #include <limits>
+#include <climits>
 #include <algorithm>
 
 #include "../core/core.h"
 #include "../core/maths.h"
+#include "../core/parallel.h"
 
 #include "../include/NvFlex.h"
 #include "../include/NvFlexExt.h"
 
-class Bitmap
+// element ranges of a buffer that have been modified on the host, ranges separated by small gaps are
+// merged before upload so that each push issues a handful of copies rather than one per-element
+class DirtyRanges
 {
 public:
 
-	typedef unsigned int Word;
+	// maximum gap in elements that is uploaded rather than starting a new copy
+	static const int kMergeGap = 256;
+	// maximum number of copies issued for one buffer, gaps are widened until the ranges fit
+	static const int kMaxRanges = 32;
 
-	static const int kWordSize = sizeof(Word)*8;
+	void Add(int begin, int end)
+	{
+		if (begin >= end)
+			return;
+
+		mRanges.push_back(Range(begin, end));
+
+		// bound memory when many scattered elements are marked between pushes
+		if (mRanges.size() >= 4096)
+			Merge();
+	}
 
-	Bitmap(int numBits) : mBits((numBits+kWordSize-1)/kWordSize)
+	void Clear()
 	{
+		mRanges.resize(0);
 	}
 
-	inline void Set(int bit)
+	// drops any part of the ranges at or beyond end
+	void Clamp(int end)
 	{
-		const int wordIndex = bit/kWordSize;
-		const int bitIndex = bit&(kWordSize-1);
+		size_t count = 0;
 
-		const Word word = mBits[wordIndex];
+		for (size_t i=0; i < mRanges.size(); ++i)
+		{
+			if (mRanges[i].first < end)
+			{
+				mRanges[count] = mRanges[i];
+				mRanges[count].second = Min(mRanges[count].second, end);
+				++count;
+			}
+		}
 
-		mBits[wordIndex] = word|(1<<bitIndex);
+		mRanges.resize(count);
 	}
 
-	inline void Reset(int bit)
+	bool Empty() const
 	{
-		const int wordIndex = bit/kWordSize;
-		const int bitIndex = bit&(kWordSize-1);
-
-		const Word word = mBits[wordIndex];
-
-		mBits[wordIndex] = word&~(1<<bitIndex);
+		return mRanges.empty();
 	}
 
-	inline bool IsSet(int bit)
+	// sorts and coalesces ranges, returns the merged ranges
+	const std::vector<std::pair<int, int> >& Merge()
 	{
-		const int wordIndex = bit/kWordSize;
-		const int bitIndex = bit&(kWordSize-1);
+		std::sort(mRanges.begin(), mRanges.end());
 
-		const Word word = mBits[wordIndex];
+		int gap = kMergeGap;
 
-		return (word & (1<<bitIndex)) != 0;
+		for (;;)
+		{
+			size_t count = 0;
+
+			for (size_t i=0; i < mRanges.size(); ++i)
+			{
+				if (count && mRanges[i].first <= mRanges[count-1].second + gap)
+					mRanges[count-1].second = Max(mRanges[count-1].second, mRanges[i].second);
+				else
+					mRanges[count++] = mRanges[i];
+			}
+
+			mRanges.resize(count);
+
+			if (count <= kMaxRanges)
+				break;
+
+			gap *= 4;
+		}
+
+		return mRanges;
 	}
 
 private:
 
-	std::vector<Word> mBits;
+	typedef std::pair<int, int> Range;
+
+	std::vector<Range> mRanges;
+};
+
+
+// start offsets or counts of a set of constraints in each of the container's constraint arrays
+struct ConstraintRange
+{
+	int springs;
+	int triangles;
+	int shapes;
+	int shapeIndices;
 };
 
+// the constraints owned by one instance or soft joint, blocks are kept in the same order as their constraints
+// so that each constraint array is a sequence of block ranges, destroyed instances and joints leave holes
+struct ConstraintBlock
+{
+	NvFlexExtInstance* instance;
+	NvFlexExtSoftJoint* joint;
+
+	ConstraintRange start;		// start.springs is -1 until the block's constraints have been written
+	ConstraintRange count;
+};
 
 struct NvFlexExtContainer
 {
@@ -93,6 +156,14 @@ struct NvFlexExtContainer
 	// first n indices 
 	NvFlexVector<int> mActiveList;
 	
+	// host copy of the active list, particles are appended when allocated and swap-removed when freed
+	std::vector<int> mActiveIndices;
+	// position of each particle in the active list, -1 for free particles
+	std::vector<int> mActivePositions;
+	// active list entries modified since the last push
+	DirtyRanges mDirtyActive;
+
+	// free particles used as a LIFO stack, freed particles are pushed on the back and allocated from there first
 	std::vector<int> mFreeList;
 	std::vector<NvFlexExtInstance*> mInstances;
 
@@ -115,6 +186,10 @@ struct NvFlexExtContainer
 	NvFlexVector<Vec3> mShapeTranslations;
 	NvFlexVector<Vec3> mShapeRestPositions;
 
+	// host copy of the shape transforms made by NvFlexExtUpdateInstancesNoCopy(), see NvFlexExtGetShapeTransforms()
+	std::vector<Vec3> mHostShapeTranslations;
+	std::vector<Quat> mHostShapeRotations;
+
 	// springs
 	NvFlexVector<int> mSpringIndices;
 	NvFlexVector<float> mSpringLengths;
@@ -134,7 +209,30 @@ struct NvFlexExtContainer
 	NvFlexVector<Vec3> mBoundsLower;
 	NvFlexVector<Vec3> mBoundsUpper;
 
-	// needs compact
+	// particle ranges modified on the host since the last push
+	DirtyRanges mDirtyParticles;
+	DirtyRanges mDirtyRestParticles;
+	DirtyRanges mDirtyVelocities;
+	DirtyRanges mDirtyPhases;
+	DirtyRanges mDirtyNormals;
+
+	// transfers issued by the most recent push
+	NvFlexExtPushStats mPushStats;
+
+	// constraint blocks of instances and joints in array order
+	std::vector<ConstraintBlock> mBlocks;
+	// first block that is a hole or not yet written, INT_MAX if there are none
+	int mFirstDirtyBlock;
+
+	bool mPlasticDeformation;
+
+	// constraint types that need to be sent to the solver
+	bool mSpringsDirty;
+	bool mTrianglesDirty;
+	bool mShapesDirty;
+	bool mInflatablesDirty;
+
+	// needs all constraints rebuilt from their assets
 	bool mNeedsCompact;
 	// needs to update active list
 	bool mNeedsActiveListRebuild;
@@ -149,8 +247,12 @@ struct NvFlexExtContainer
 		mSpringCoefficients(l),mTriangleIndices(l),mTriangleNormals(l),
 		mInflatableStarts(l),mInflatableCounts(l),mInflatableRestVolumes(l),
 		mInflatableCoefficients(l),mInflatableOverPressures(l), mBoundsLower(l), mBoundsUpper(l),
+		mFirstDirtyBlock(INT_MAX), mPlasticDeformation(false),
+		mSpringsDirty(false), mTrianglesDirty(false), mShapesDirty(false), mInflatablesDirty(false),
 		mNeedsCompact(false), mNeedsActiveListRebuild(false)
-	{}
+	{
+		memset(&mPushStats, 0, sizeof(mPushStats));
+	}
 };
 
 
@@ -158,151 +260,175 @@ struct NvFlexExtContainer
 namespace
 {
 
-// compacts all constraints into linear arrays
-void CompactObjects(NvFlexExtContainer* c)
+template <typename T>
+void MoveRange(NvFlexVector<T>& v, int dst, int src, int n)
 {
-	int totalNumSprings = 0;
-	int totalNumTris = 0;
-	int totalNumShapes = 0;
-	int totalNumShapeIndices = 0;
+	if (n && dst != src)
+		memmove(&v[dst], &v[src], n*sizeof(T));
+}
 
-	bool plasticDeformation = false;
+bool IsHole(const ConstraintBlock& b)
+{
+	return b.instance == NULL && b.joint == NULL;
+}
 
-	// pre-calculate array sizes
-	for (size_t i = 0; i < c->mInstances.size(); ++i)
-	{
-		NvFlexExtInstance* inst = c->mInstances[i];
+bool IsPlaced(const ConstraintBlock& b)
+{
+	return b.start.springs >= 0;
+}
 
-		const NvFlexExtAsset* asset = inst->asset;
+bool RangesEqual(const ConstraintRange& a, const ConstraintRange& b)
+{
+	return a.springs == b.springs && a.triangles == b.triangles && a.shapes == b.shapes && a.shapeIndices == b.shapeIndices;
+}
 
-		// index into the triangle array for this instance
-		inst->triangleIndex = totalNumTris;
+// flags the constraint types a block contributes to so that only those are sent to the solver
+void MarkDirty(NvFlexExtContainer* c, const ConstraintBlock& b)
+{
+	c->mSpringsDirty |= b.count.springs > 0;
+	c->mTrianglesDirty |= b.count.triangles > 0;
+	c->mShapesDirty |= b.count.shapes > 0;
+	c->mInflatablesDirty |= b.instance && b.instance->asset->inflatable && b.count.triangles > 0;
+}
 
-		totalNumSprings += asset->numSprings;
-		totalNumTris += asset->numTriangles;
+void ResizeConstraints(NvFlexExtContainer* c, const ConstraintRange& total)
+{
+	// springs
+	c->mSpringIndices.resize(total.springs * 2);
+	c->mSpringLengths.resize(total.springs);
+	c->mSpringCoefficients.resize(total.springs);
 
-		totalNumShapeIndices += asset->numShapeIndices;
-		totalNumShapes += asset->numShapes;
+	// cloth
+	c->mTriangleIndices.resize(total.triangles * 3);
+	c->mTriangleNormals.resize(total.triangles);
 
-		if (asset->shapePlasticThresholds && asset->shapePlasticCreeps)
-		{ 
-			plasticDeformation = true;
-		}
-	}
+	// shapes
+	c->mShapeIndices.resize(total.shapeIndices);
+	c->mShapeRestPositions.resize(total.shapeIndices);
+	c->mShapeOffsets.resize(total.shapes ? total.shapes + 1 : 0);
+	c->mShapeCoefficients.resize(total.shapes);
 
-	// each joint corresponds to one shape matching constraint
-	for (size_t i = 0; i < c->mSoftJoints.size(); ++i)
+	if (c->mPlasticDeformation)
 	{
-		const NvFlexExtSoftJoint* joint = c->mSoftJoints[i];
-
-		totalNumShapeIndices += joint->numParticles;
-		++totalNumShapes;
+		c->mShapePlasticThresholds.resize(total.shapes, 0.0f);
+		c->mShapePlasticCreeps.resize(total.shapes, 0.0f);
 	}
 
-	//----------------------
-	// map buffers
+	c->mShapeTranslations.resize(total.shapes);
+	c->mShapeRotations.resize(total.shapes);
 
-	// springs
-	c->mSpringIndices.map();
-	c->mSpringLengths.map();
-	c->mSpringCoefficients.map();
-
-	// cloth
-	c->mTriangleIndices.map();
-	c->mTriangleNormals.map();
+	// leading zero
+	if (total.shapes)
+		c->mShapeOffsets[0] = 0;
+}
 
-	// inflatables
-	c->mInflatableStarts.map();
-	c->mInflatableCounts.map();
-	c->mInflatableRestVolumes.map();
-	c->mInflatableCoefficients.map();
-	c->mInflatableOverPressures.map();
+void SetBlockStart(ConstraintBlock& b, const ConstraintRange& start)
+{
+	b.start = start;
 
-	// shapes
-	c->mShapeIndices.map();
-	c->mShapeRestPositions.map();
-	c->mShapeOffsets.map();
-	c->mShapeCoefficients.map();
+	if (b.instance)
+	{
+		b.instance->triangleIndex = start.triangles;
+		b.instance->shapeIndex = b.count.shapes ? start.shapes : -1;
+	}
 
-	c->mShapePlasticThresholds.map();
-	c->mShapePlasticCreeps.map();
+	if (b.joint)
+		b.joint->shapeIndex = start.shapes;
+}
 
-	c->mShapeTranslations.map();
-	c->mShapeRotations.map();
+// moves a placed block's constraints down to dst, the particle indices are already remapped so this is a straight copy
+void MoveBlock(NvFlexExtContainer* c, ConstraintBlock& b, const ConstraintRange& dst)
+{
+	assert(dst.springs <= b.start.springs && dst.triangles <= b.start.triangles && dst.shapes <= b.start.shapes && dst.shapeIndices <= b.start.shapeIndices);
 
-	//----------------------
-	// resize buffers
+	const ConstraintRange& src = b.start;
+	const ConstraintRange& n = b.count;
 
 	// springs
-	c->mSpringIndices.resize(totalNumSprings * 2);
-	c->mSpringLengths.resize(totalNumSprings);
-	c->mSpringCoefficients.resize(totalNumSprings);
+	MoveRange(c->mSpringIndices, dst.springs*2, src.springs*2, n.springs*2);
+	MoveRange(c->mSpringLengths, dst.springs, src.springs, n.springs);
+	MoveRange(c->mSpringCoefficients, dst.springs, src.springs, n.springs);
 
 	// cloth
-	c->mTriangleIndices.resize(totalNumTris * 3);
-	c->mTriangleNormals.resize(totalNumTris);
-
-	// inflatables
-	c->mInflatableStarts.resize(0);
-	c->mInflatableCounts.resize(0);
-	c->mInflatableRestVolumes.resize(0);
-	c->mInflatableCoefficients.resize(0);
-	c->mInflatableOverPressures.resize(0);
+	MoveRange(c->mTriangleIndices, dst.triangles*3, src.triangles*3, n.triangles*3);
+	MoveRange(c->mTriangleNormals, dst.triangles, src.triangles, n.triangles);
 
 	// shapes
-	c->mShapeIndices.resize(totalNumShapeIndices);
-	c->mShapeRestPositions.resize(totalNumShapeIndices);
-	c->mShapeOffsets.resize(1 + totalNumShapes);
-	c->mShapeCoefficients.resize(totalNumShapes);
+	MoveRange(c->mShapeIndices, dst.shapeIndices, src.shapeIndices, n.shapeIndices);
+	MoveRange(c->mShapeRestPositions, dst.shapeIndices, src.shapeIndices, n.shapeIndices);
+	MoveRange(c->mShapeCoefficients, dst.shapes, src.shapes, n.shapes);
+	MoveRange(c->mShapeTranslations, dst.shapes, src.shapes, n.shapes);
+	MoveRange(c->mShapeRotations, dst.shapes, src.shapes, n.shapes);
 
-	if (plasticDeformation) 
-	{
-		c->mShapePlasticThresholds.resize(totalNumShapes);
-		c->mShapePlasticCreeps.resize(totalNumShapes);
-	}
-	else
+	if (c->mPlasticDeformation)
 	{
-		c->mShapePlasticThresholds.resize(0);
-		c->mShapePlasticCreeps.resize(0);
+		MoveRange(c->mShapePlasticThresholds, dst.shapes, src.shapes, n.shapes);
+		MoveRange(c->mShapePlasticCreeps, dst.shapes, src.shapes, n.shapes);
 	}
 
-	c->mShapeTranslations.resize(totalNumShapes);
-	c->mShapeRotations.resize(totalNumShapes);
+	// offsets store the end of each shape's indices so shift them along with the indices
+	const int indexDelta = dst.shapeIndices - src.shapeIndices;
+
+	for (int s=0; s < n.shapes; ++s)
+		c->mShapeOffsets[dst.shapes + 1 + s] = c->mShapeOffsets[src.shapes + 1 + s] + indexDelta;
+
+	SetBlockStart(b, dst);
+	MarkDirty(c, b);
+}
 
-	int* __restrict dstSpringIndices = (totalNumSprings) ? &c->mSpringIndices[0] : NULL;
-	float* __restrict dstSpringLengths = (totalNumSprings) ? &c->mSpringLengths[0] : NULL;
-	float* __restrict dstSpringCoefficients = (totalNumSprings) ? &c->mSpringCoefficients[0] : NULL;
+ConstraintRange GetBlockCount(const ConstraintBlock& b)
+{
+	ConstraintRange count = { 0, 0, 0, 0 };
 
-	int* __restrict dstTriangleIndices = (totalNumTris) ? &c->mTriangleIndices[0] : NULL;
+	if (b.instance)
+	{
+		const NvFlexExtAsset* asset = b.instance->asset;
 
-	int* __restrict dstShapeIndices = (totalNumShapeIndices) ? &c->mShapeIndices[0] : NULL;
-	Vec3* __restrict dstShapeRestPositions = (totalNumShapeIndices) ? &c->mShapeRestPositions[0] : NULL;
-	int* __restrict dstShapeOffsets = (totalNumShapes) ? &c->mShapeOffsets[0] : NULL;
-	float* __restrict dstShapeCoefficients = (totalNumShapes) ? &c->mShapeCoefficients[0] : NULL;
-	float* __restrict dstShapePlasticThresholds = NULL;
-	float* __restrict dstShapePlasticCreeps = NULL;
-	if (plasticDeformation)
+		count.springs = asset->numSprings;
+		count.triangles = asset->numTriangles;
+		count.shapes = asset->numShapes;
+		count.shapeIndices = asset->numShapeIndices;
+	}
+	else if (b.joint)
 	{
-		dstShapePlasticThresholds = (totalNumShapes) ? &c->mShapePlasticThresholds[0] : NULL;
-		dstShapePlasticCreeps = (totalNumShapes) ? &c->mShapePlasticCreeps[0] : NULL;
+		// each joint corresponds to one shape matching constraint
+		count.shapes = 1;
+		count.shapeIndices = b.joint->numParticles;
 	}
-	Vec3* __restrict dstShapeTranslations = (totalNumShapes) ? &c->mShapeTranslations[0] : NULL;
-	Quat* __restrict dstShapeRotations = (totalNumShapes) ? &c->mShapeRotations[0] : NULL;
 
-	// push leading zero if necessary
-	if (totalNumShapes != 0)
+	return count;
+}
+
+// writes a new block's constraints at the end of the arrays
+void AppendBlock(NvFlexExtContainer* c, ConstraintBlock& b, const ConstraintRange& dst)
+{
+	b.count = GetBlockCount(b);
+
+	if (b.instance)
 	{
-		*dstShapeOffsets = 0;
-		++dstShapeOffsets;
+		const NvFlexExtAsset* asset = b.instance->asset;
+
+		// enable plasticity for all shapes the first time an asset uses it
+		if (asset->shapePlasticThresholds && asset->shapePlasticCreeps && !c->mPlasticDeformation)
+		{
+			c->mPlasticDeformation = true;
+
+			c->mShapePlasticThresholds.resize(c->mShapeCoefficients.size(), 0.0f);
+			c->mShapePlasticCreeps.resize(c->mShapeCoefficients.size(), 0.0f);
+		}
 	}
 
-	int shapeIndexOffset = 0;
-	int shapeIndex = 0;
+	ConstraintRange total = { dst.springs + b.count.springs, dst.triangles + b.count.triangles, dst.shapes + b.count.shapes, dst.shapeIndices + b.count.shapeIndices };
+	ResizeConstraints(c, total);
 
-	// go through each instance and update springs, shapes, etc
-	for (size_t i = 0; i < c->mInstances.size(); ++i)
+	SetBlockStart(b, dst);
+	MarkDirty(c, b);
+
+	int shapeIndexOffset = dst.shapeIndices;
+
+	if (b.instance)
 	{
-		NvFlexExtInstance* inst = c->mInstances[i];
+		NvFlexExtInstance* inst = b.instance;
 
 		const NvFlexExtAsset* asset = inst->asset;
 
@@ -310,125 +436,222 @@ void CompactObjects(NvFlexExtContainer* c)
 		const int* __restrict remap = &inst->particleIndices[0];
 
 		// flatten spring data
-		int numSprings = asset->numSprings;
-		const int numSpringIndices = asset->numSprings * 2;
-		const int* __restrict srcSpringIndices = asset->springIndices;
+		for (int i=0; i < asset->numSprings*2; ++i)
+			c->mSpringIndices[dst.springs*2 + i] = remap[asset->springIndices[i]];
 
-		for (int i = 0; i < numSpringIndices; ++i)
+		if (asset->numSprings)
 		{
-			*dstSpringIndices = remap[*srcSpringIndices];
-
-			++dstSpringIndices;
-			++srcSpringIndices;
+			memcpy(&c->mSpringLengths[dst.springs], asset->springRestLengths, asset->numSprings*sizeof(float));
+			memcpy(&c->mSpringCoefficients[dst.springs], asset->springCoefficients, asset->numSprings*sizeof(float));
 		}
 
-		memcpy(dstSpringLengths, asset->springRestLengths, numSprings*sizeof(float));
-		memcpy(dstSpringCoefficients, asset->springCoefficients, numSprings*sizeof(float));
-
-		dstSpringLengths += numSprings;
-		dstSpringCoefficients += numSprings;
-
 		// shapes
-		if (asset->numShapes)
-		{
-			const int indexOffset = shapeIndexOffset;
+		int shapeStart = 0;
 
-			// store start index into shape array
-			inst->shapeIndex = shapeIndex;
+		for (int s=0; s < asset->numShapes; ++s)
+		{
+			const int shapeIndex = dst.shapes + s;
 
-			int shapeStart = 0;
+			c->mShapeOffsets[shapeIndex + 1] = asset->shapeOffsets[s] + dst.shapeIndices;
+			c->mShapeCoefficients[shapeIndex] = asset->shapeCoefficients[s];
 
-			for (int s=0; s < asset->numShapes; ++s)
+			if (c->mPlasticDeformation)
 			{
-				dstShapeOffsets[shapeIndex] = asset->shapeOffsets[s] + indexOffset;
-				dstShapeCoefficients[shapeIndex]  = asset->shapeCoefficients[s];
-				if (plasticDeformation)
-				{
-					if (asset->shapePlasticThresholds)
-						dstShapePlasticThresholds[shapeIndex] = asset->shapePlasticThresholds[s];
-					else
-						dstShapePlasticThresholds[shapeIndex] = 0.0f;
-
-					if (asset->shapePlasticCreeps)
-						dstShapePlasticCreeps[shapeIndex]  = asset->shapePlasticCreeps[s];
-					else
-						dstShapePlasticCreeps[shapeIndex] = 0.0f;
-				}
-				dstShapeTranslations[shapeIndex]  = Vec3(&inst->shapeTranslations[s*3]);
-				dstShapeRotations[shapeIndex]  = Quat(&inst->shapeRotations[s*4]);
+				c->mShapePlasticThresholds[shapeIndex] = asset->shapePlasticThresholds ? asset->shapePlasticThresholds[s] : 0.0f;
+				c->mShapePlasticCreeps[shapeIndex] = asset->shapePlasticCreeps ? asset->shapePlasticCreeps[s] : 0.0f;
+			}
 
-				++shapeIndex;
+			c->mShapeTranslations[shapeIndex] = Vec3(&inst->shapeTranslations[s*3]);
+			c->mShapeRotations[shapeIndex] = Quat(&inst->shapeRotations[s*4]);
 
-				const int shapeEnd = asset->shapeOffsets[s];
+			const int shapeEnd = asset->shapeOffsets[s];
 
-				for (int i=shapeStart; i < shapeEnd; ++i)
-				{
-					const int currentParticle = asset->shapeIndices[i];
+			for (int i=shapeStart; i < shapeEnd; ++i)
+			{
+				const int currentParticle = asset->shapeIndices[i];
 
-					// remap indices and create local space positions for each shape
-					dstShapeRestPositions[shapeIndexOffset] = Vec3(&asset->particles[currentParticle*4]) - Vec3(&asset->shapeCenters[s*3]);
-					dstShapeIndices[shapeIndexOffset] = remap[asset->shapeIndices[i]];
+				// remap indices and create local space positions for each shape
+				c->mShapeRestPositions[shapeIndexOffset] = Vec3(&asset->particles[currentParticle*4]) - Vec3(&asset->shapeCenters[s*3]);
+				c->mShapeIndices[shapeIndexOffset] = remap[currentParticle];
 
-					++shapeIndexOffset;
-				}
+				++shapeIndexOffset;
+			}
 
-				shapeStart = shapeEnd;
-			}		
+			shapeStart = shapeEnd;
 		}
 
-		if (asset->numTriangles)
+		// triangles
+		for (int i=0; i < asset->numTriangles*3; ++i)
+			c->mTriangleIndices[dst.triangles*3 + i] = remap[asset->triangleIndices[i]];
+	}
+	else if (b.joint)
+	{
+		NvFlexExtSoftJoint* joint = b.joint;
+
+		// add shape matching constraint for the joint particles
+		for (int i=0; i < joint->numParticles; ++i)
 		{
-			// triangles
-			const int numTriIndices = asset->numTriangles * 3;
-			const int* __restrict srcTriIndices = asset->triangleIndices;
+			c->mShapeIndices[shapeIndexOffset] = joint->particleIndices[i];
+			c->mShapeRestPositions[shapeIndexOffset] = Vec3(&joint->particleLocalPositions[3*i]);
 
-			for (int i = 0; i < numTriIndices; ++i)
-			{
-				*dstTriangleIndices = remap[*srcTriIndices];
+			++shapeIndexOffset;
+		}
 
-				++dstTriangleIndices;
-				++srcTriIndices;
-			}
+		c->mShapeOffsets[dst.shapes + 1] = shapeIndexOffset;
+		c->mShapeCoefficients[dst.shapes] = joint->stiffness;
 
-			if (asset->inflatable)
-			{
-				c->mInflatableStarts.push_back(inst->triangleIndex);
-				c->mInflatableCounts.push_back(asset->numTriangles);
-				c->mInflatableRestVolumes.push_back(asset->inflatableVolume);
-				c->mInflatableCoefficients.push_back(asset->inflatableStiffness);
-				c->mInflatableOverPressures.push_back(asset->inflatablePressure);
-			}
+		if (c->mPlasticDeformation)
+		{
+			c->mShapePlasticThresholds[dst.shapes] = 0.0f;
+			c->mShapePlasticCreeps[dst.shapes] = 0.0f;
 		}
+
+		c->mShapeTranslations[dst.shapes] = Vec3(joint->shapeTranslations);
+		c->mShapeRotations[dst.shapes] = Quat(joint->shapeRotations);
 	}
+}
 
+// inflatables reference triangle ranges and are few in number, so they are regenerated whenever one moves
+void BuildInflatables(NvFlexExtContainer* c)
+{
+	c->mInflatableStarts.resize(0);
+	c->mInflatableCounts.resize(0);
+	c->mInflatableRestVolumes.resize(0);
+	c->mInflatableCoefficients.resize(0);
+	c->mInflatableOverPressures.resize(0);
 
-	// go through each joint and add shape matching constraint to the solver
-	for (size_t i = 0; i < c->mSoftJoints.size(); ++i)
+	for (size_t i=0; i < c->mBlocks.size(); ++i)
 	{
-		NvFlexExtSoftJoint* joint = c->mSoftJoints[i];
-		const int numJointParticles = joint->numParticles;
+		NvFlexExtInstance* inst = c->mBlocks[i].instance;
 
-		// store start index into shape array
-		joint->shapeIndex = shapeIndex;
+		if (!inst)
+			continue;
 
-		const int offset = dstShapeOffsets[shapeIndex - 1];
-		dstShapeOffsets[shapeIndex] = offset + numJointParticles;
+		const NvFlexExtAsset* asset = inst->asset;
 
-		for (int i = 0; i < numJointParticles; ++i)
+		if (asset->numTriangles && asset->inflatable)
 		{
-			dstShapeIndices[shapeIndexOffset] = joint->particleIndices[i];
-			dstShapeRestPositions[shapeIndexOffset] = Vec3(joint->particleLocalPositions[3 * i + 0], joint->particleLocalPositions[3 * i + 1], joint->particleLocalPositions[3 * i + 2]);
+			inst->inflatableIndex = c->mInflatableCounts.size();
 
-			++shapeIndexOffset;
+			c->mInflatableStarts.push_back(inst->triangleIndex);
+			c->mInflatableCounts.push_back(asset->numTriangles);
+			c->mInflatableRestVolumes.push_back(asset->inflatableVolume);
+			c->mInflatableCoefficients.push_back(asset->inflatableStiffness);
+			c->mInflatableOverPressures.push_back(asset->inflatablePressure);
+		}
+	}
+}
+
+// closes holes left by destroyed instances and joints and appends new ones, the cost is proportional to the 
+// constraints that are added or moved rather than the total number of constraints in the container
+void UpdateConstraints(NvFlexExtContainer* c)
+{
+	std::vector<ConstraintBlock>& blocks = c->mBlocks;
+
+	const int first = c->mFirstDirtyBlock;
+
+	//----------------------
+	// map buffers
+
+	// springs
+	c->mSpringIndices.map();
+	c->mSpringLengths.map();
+	c->mSpringCoefficients.map();
+
+	// cloth
+	c->mTriangleIndices.map();
+	c->mTriangleNormals.map();
+
+	// inflatables
+	c->mInflatableStarts.map();
+	c->mInflatableCounts.map();
+	c->mInflatableRestVolumes.map();
+	c->mInflatableCoefficients.map();
+	c->mInflatableOverPressures.map();
+
+	// shapes
+	c->mShapeIndices.map();
+	c->mShapeRestPositions.map();
+	c->mShapeOffsets.map();
+	c->mShapeCoefficients.map();
+
+	c->mShapePlasticThresholds.map();
+	c->mShapePlasticCreeps.map();
+
+	c->mShapeTranslations.map();
+	c->mShapeRotations.map();
+
+	// fill holes with the last placed block when it has exactly the same size, this is the 
+	// common case of many instances of one asset being spawned and destroyed
+	int last = int(blocks.size())-1;
+
+	for (int h=first; h < last; ++h)
+	{
+		if (!IsHole(blocks[h]) || !IsPlaced(blocks[h]))
+			continue;
+
+		while (last > h && (IsHole(blocks[last]) || !IsPlaced(blocks[last])))
+			--last;
+
+		if (last > h && RangesEqual(blocks[last].count, blocks[h].count))
+		{
+			const ConstraintRange start = blocks[h].start;
+
+			MoveBlock(c, blocks[last], start);
+			std::swap(blocks[h], blocks[last]);
 		}
+	}
 
-		dstShapeTranslations[shapeIndex] = Vec3(joint->shapeTranslations);
-		dstShapeRotations[shapeIndex] = Quat(joint->shapeRotations);
-		dstShapeCoefficients[shapeIndex] = joint->stiffness;
+	// slide the remaining blocks down over any holes, then place new blocks at the end
+	ConstraintRange cursor = { 0, 0, 0, 0 };
 
-		++shapeIndex;
+	if (first > 0)
+	{
+		const ConstraintBlock& prev = blocks[first-1];
+
+		cursor.springs = prev.start.springs + prev.count.springs;
+		cursor.triangles = prev.start.triangles + prev.count.triangles;
+		cursor.shapes = prev.start.shapes + prev.count.shapes;
+		cursor.shapeIndices = prev.start.shapeIndices + prev.count.shapeIndices;
 	}
 
+	int write = first;
+
+	for (int read=first; read < int(blocks.size()); ++read)
+	{
+		ConstraintBlock b = blocks[read];
+
+		if (IsHole(b))
+			continue;
+
+		if (!IsPlaced(b))
+			AppendBlock(c, b, cursor);
+		else if (!RangesEqual(b.start, cursor))
+			MoveBlock(c, b, cursor);
+
+		cursor.springs += b.count.springs;
+		cursor.triangles += b.count.triangles;
+		cursor.shapes += b.count.shapes;
+		cursor.shapeIndices += b.count.shapeIndices;
+
+		blocks[write++] = b;
+	}
+
+	blocks.resize(write);
+
+	ResizeConstraints(c, cursor);
+
+	if (cursor.shapes == 0 && c->mPlasticDeformation)
+	{
+		c->mPlasticDeformation = false;
+
+		c->mShapePlasticThresholds.resize(0);
+		c->mShapePlasticCreeps.resize(0);
+	}
+
+	if (c->mInflatablesDirty)
+		BuildInflatables(c);
+
 	//----------------------
 	// unmap buffers
 
@@ -461,41 +684,220 @@ void CompactObjects(NvFlexExtContainer* c)
 	c->mShapeRotations.unmap();
 
 	// ----------------------
-	// Flex update
+	// Flex update, only constraint types that changed are sent to the solver
 
 	// springs
-	if (c->mSpringLengths.size())
-		NvFlexSetSprings(c->mSolver, c->mSpringIndices.buffer, c->mSpringLengths.buffer, c->mSpringCoefficients.buffer, int(c->mSpringLengths.size()));
-	else
-		NvFlexSetSprings(c->mSolver, NULL, NULL, NULL, 0);
-
-	// shapes
-	if (c->mShapeCoefficients.size())
+	if (c->mSpringsDirty)
 	{
-		NvFlexSetRigids(c->mSolver, c->mShapeOffsets.buffer, c->mShapeIndices.buffer, c->mShapeRestPositions.buffer, NULL, c->mShapeCoefficients.buffer, c->mShapePlasticThresholds.buffer, c->mShapePlasticCreeps.buffer, c->mShapeRotations.buffer, c->mShapeTranslations.buffer, int(c->mShapeCoefficients.size()), c->mShapeIndices.size());
+		if (c->mSpringLengths.size())
+			NvFlexSetSprings(c->mSolver, c->mSpringIndices.buffer, c->mSpringLengths.buffer, c->mSpringCoefficients.buffer, int(c->mSpringLengths.size()));
+		else
+			NvFlexSetSprings(c->mSolver, NULL, NULL, NULL, 0);
+
+		c->mPushStats.constraintBytes += c->mSpringIndices.size()*sizeof(int) + c->mSpringLengths.size()*sizeof(float)*2;
 	}
-	else
+
+	// shapes
+	if (c->mShapesDirty)
 	{
-		c->mShapeRotations.resize(0);
-		c->mShapeTranslations.resize(0);
+		// plastic buffers may still be allocated from earlier assets, only pass them when they hold one entry per-shape
+		NvFlexBuffer* plasticThresholds = c->mPlasticDeformation ? c->mShapePlasticThresholds.buffer : NULL;
+		NvFlexBuffer* plasticCreeps = c->mPlasticDeformation ? c->mShapePlasticCreeps.buffer : NULL;
+
+		if (c->mShapeCoefficients.size())
+			NvFlexSetRigids(c->mSolver, c->mShapeOffsets.buffer, c->mShapeIndices.buffer, c->mShapeRestPositions.buffer, NULL, c->mShapeCoefficients.buffer, plasticThresholds, plasticCreeps, c->mShapeRotations.buffer, c->mShapeTranslations.buffer, int(c->mShapeCoefficients.size()), c->mShapeIndices.size());
+		else
+			NvFlexSetRigids(c->mSolver, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0);
 
-		NvFlexSetRigids(c->mSolver, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0);		
+		const int numShapes = c->mShapeCoefficients.size();
+		const int numShapeIndices = c->mShapeIndices.size();
+
+		c->mPushStats.constraintBytes += numShapes ? (numShapes + 1)*sizeof(int) : 0;
+		c->mPushStats.constraintBytes += numShapeIndices*(sizeof(int) + sizeof(Vec3));
+		c->mPushStats.constraintBytes += numShapes*(sizeof(float) + sizeof(Quat) + sizeof(Vec3));
+		c->mPushStats.constraintBytes += c->mPlasticDeformation ? numShapes*sizeof(float)*2 : 0;
 	}
 
 	// triangles
-	if (c->mTriangleIndices.size())
-		NvFlexSetDynamicTriangles(c->mSolver, c->mTriangleIndices.buffer, NULL, int(c->mTriangleIndices.size()/3));
-	else
-		NvFlexSetDynamicTriangles(c->mSolver, NULL, NULL, 0);
+	if (c->mTrianglesDirty)
+	{
+		if (c->mTriangleIndices.size())
+			NvFlexSetDynamicTriangles(c->mSolver, c->mTriangleIndices.buffer, NULL, int(c->mTriangleIndices.size()/3));
+		else
+			NvFlexSetDynamicTriangles(c->mSolver, NULL, NULL, 0);
+
+		c->mPushStats.constraintBytes += c->mTriangleIndices.size()*sizeof(int);
+	}
 
 	// inflatables
-	if (c->mInflatableCounts.size())
-		NvFlexSetInflatables(c->mSolver, c->mInflatableStarts.buffer, c->mInflatableCounts.buffer, c->mInflatableRestVolumes.buffer, c->mInflatableOverPressures.buffer, c->mInflatableCoefficients.buffer, int(c->mInflatableCounts.size()));
-	else
-		NvFlexSetInflatables(c->mSolver, NULL, NULL, NULL, NULL, NULL, 0);
+	if (c->mInflatablesDirty)
+	{
+		if (c->mInflatableCounts.size())
+			NvFlexSetInflatables(c->mSolver, c->mInflatableStarts.buffer, c->mInflatableCounts.buffer, c->mInflatableRestVolumes.buffer, c->mInflatableOverPressures.buffer, c->mInflatableCoefficients.buffer, int(c->mInflatableCounts.size()));
+		else
+			NvFlexSetInflatables(c->mSolver, NULL, NULL, NULL, NULL, NULL, 0);
+
+		c->mPushStats.constraintBytes += c->mInflatableCounts.size()*(sizeof(int)*2 + sizeof(float)*3);
+	}
+
+	c->mFirstDirtyBlock = INT_MAX;
+
+	c->mSpringsDirty = false;
+	c->mTrianglesDirty = false;
+	c->mShapesDirty = false;
+	c->mInflatablesDirty = false;
+}
+
+// compacts all constraints into linear arrays, used when assets have changed since the blocks were placed
+void CompactObjects(NvFlexExtContainer* c)
+{
+	std::vector<ConstraintBlock>& blocks = c->mBlocks;
+
+	// blocks are rebuilt from the per-instance transforms, which are stale when NvFlexExtUpdateInstancesNoCopy() copies to
+	// the contiguous arrays instead, so first write back the container's transforms for instances that are already placed
+	c->mShapeTranslations.map();
+	c->mShapeRotations.map();
+
+	for (size_t i=0; i < blocks.size(); ++i)
+	{
+		NvFlexExtInstance* inst = blocks[i].instance;
+
+		// the old transforms can't be matched to the asset's shapes if their number changed
+		if (!inst || !IsPlaced(blocks[i]) || blocks[i].count.shapes != inst->asset->numShapes)
+			continue;
+
+		for (int s=0; s < blocks[i].count.shapes; ++s)
+		{
+			((Vec3*)inst->shapeTranslations)[s] = c->mShapeTranslations[blocks[i].start.shapes + s];
+			((Quat*)inst->shapeRotations)[s] = c->mShapeRotations[blocks[i].start.shapes + s];
+		}
+	}
+
+	c->mShapeTranslations.unmap();
+	c->mShapeRotations.unmap();
+
+	int write = 0;
+
+	for (size_t i=0; i < blocks.size(); ++i)
+	{
+		if (IsHole(blocks[i]))
+			continue;
+
+		// mark as not placed so that the block is regenerated from its asset
+		blocks[i].start.springs = -1;
+		blocks[write++] = blocks[i];
+	}
+
+	blocks.resize(write);
+
+	c->mPlasticDeformation = false;
+
+	c->mShapePlasticThresholds.map();
+	c->mShapePlasticCreeps.map();
+	c->mShapePlasticThresholds.resize(0);
+	c->mShapePlasticCreeps.resize(0);
+	c->mShapePlasticThresholds.unmap();
+	c->mShapePlasticCreeps.unmap();
+
+	c->mFirstDirtyBlock = 0;
+
+	c->mSpringsDirty = true;
+	c->mTrianglesDirty = true;
+	c->mShapesDirty = true;
+	c->mInflatablesDirty = true;
+
+	UpdateConstraints(c);
 
 	c->mNeedsCompact = false;
+}
+
+// adds a block for a new instance or joint, its constraints are written by the next UpdateConstraints()
+void AddBlock(NvFlexExtContainer* c, NvFlexExtInstance* inst, NvFlexExtSoftJoint* joint)
+{
+	ConstraintBlock b;
+	b.instance = inst;
+	b.joint = joint;
+	b.start.springs = -1;
+	b.start.triangles = -1;
+	b.start.shapes = -1;
+	b.start.shapeIndices = -1;
+	b.count = GetBlockCount(b);
+
+	c->mBlocks.push_back(b);
+	c->mFirstDirtyBlock = Min(c->mFirstDirtyBlock, int(c->mBlocks.size())-1);
+}
+
+// leaves a hole in place of an instance or joint's constraints, holes are closed by the next UpdateConstraints()
+void RemoveBlock(NvFlexExtContainer* c, const NvFlexExtInstance* inst, const NvFlexExtSoftJoint* joint)
+{
+	for (int i=int(c->mBlocks.size())-1; i >= 0; --i)
+	{
+		ConstraintBlock& b = c->mBlocks[i];
+
+		if ((inst && b.instance == inst) || (joint && b.joint == joint))
+		{
+			if (IsPlaced(b))
+				MarkDirty(c, b);
 
+			b.instance = NULL;
+			b.joint = NULL;
+
+			c->mFirstDirtyBlock = Min(c->mFirstDirtyBlock, i);
+			return;
+		}
+	}
+
+	assert(0);
+}
+
+// marks host modified particle data to be sent by the next push
+void MarkParticlesDirty(NvFlexExtContainer* c, int flags, int begin, int end)
+{
+	if (flags & eNvFlexExtParticleDataPositions)
+		c->mDirtyParticles.Add(begin, end);
+
+	if (flags & eNvFlexExtParticleDataRestPositions)
+		c->mDirtyRestParticles.Add(begin, end);
+
+	if (flags & eNvFlexExtParticleDataVelocities)
+		c->mDirtyVelocities.Add(begin, end);
+
+	if (flags & eNvFlexExtParticleDataPhases)
+		c->mDirtyPhases.Add(begin, end);
+
+	if (flags & eNvFlexExtParticleDataNormals)
+		c->mDirtyNormals.Add(begin, end);
+}
+
+typedef void (*SetParticleDataFunc)(NvFlexSolver* solver, NvFlexBuffer* buffer, const NvFlexCopyDesc* desc);
+
+// issues one copy per merged dirty range and returns the number of bytes sent
+template <typename T>
+size_t PushDirtyRanges(NvFlexExtContainer* c, NvFlexVector<T>& v, DirtyRanges& dirty, SetParticleDataFunc set)
+{
+	if (dirty.Empty())
+		return 0;
+
+	const std::vector<std::pair<int, int> >& ranges = dirty.Merge();
+
+	size_t bytes = 0;
+
+	for (size_t i=0; i < ranges.size(); ++i)
+	{
+		NvFlexCopyDesc desc;
+		desc.srcOffset = ranges[i].first;
+		desc.dstOffset = ranges[i].first;
+		desc.elementCount = ranges[i].second - ranges[i].first;
+
+		set(c->mSolver, v.buffer, &desc);
+
+		bytes += desc.elementCount*sizeof(T);
+		c->mPushStats.numCopies++;
+	}
+
+	dirty.Clear();
+
+	return bytes;
 }
 
 } // anonymous namespace
@@ -509,10 +911,14 @@ NvFlexExtContainer* NvFlexExtCreateContainer(NvFlexLibrary* flexLib, NvFlexSolve
 	c->mFlexLib = flexLib;
 	c->mMaxParticles = maxParticles;
 
-	// initialize free list
+	// fill the free list in descending order so that a new container allocates low indices first,
+	// once particles are freed the list is no longer ordered and the most recently freed particles are reused first
 	c->mFreeList.resize(maxParticles);
 	for (int i=0; i < maxParticles; ++i)
-		c->mFreeList[i] = i;
+		c->mFreeList[i] = maxParticles-1-i;
+
+	c->mActiveIndices.reserve(maxParticles);
+	c->mActivePositions.assign(maxParticles, -1);
 
 	c->mActiveList.init(maxParticles);
 	c->mParticles.init(maxParticles);
@@ -532,6 +938,9 @@ NvFlexExtContainer* NvFlexExtCreateContainer(NvFlexLibrary* flexLib, NvFlexSolve
 
 	c->mNeedsCompact = false;
 
+	// device buffers are uninitialized so the first push sends everything
+	MarkParticlesDirty(c, eNvFlexExtParticleDataAll, 0, maxParticles);
+
 	return c;
 }
 
@@ -553,12 +962,25 @@ int NvFlexExtAllocParticles(NvFlexExtContainer* c, int n, int* indices)
 	const int numToAlloc = Min(int(c->mFreeList.size()), n);
 	const int start = int(c->mFreeList.size())-numToAlloc;
 
-	if (numToAlloc)
+	if (numToAlloc == 0)
+		return 0;
+
+	const int activeStart = int(c->mActiveIndices.size());
+
+	for (int i=0; i < numToAlloc; ++i)
 	{
-		memcpy(indices, &c->mFreeList[start], numToAlloc*sizeof(int));
-		c->mFreeList.resize(start);
+		const int index = c->mFreeList[c->mFreeList.size()-1-i];
+
+		indices[i] = index;
+
+		// append to the active list
+		c->mActivePositions[index] = int(c->mActiveIndices.size());
+		c->mActiveIndices.push_back(index);
 	}
 
+	c->mFreeList.resize(start);
+
+	c->mDirtyActive.Add(activeStart, activeStart + numToAlloc);
 	c->mNeedsActiveListRebuild = true;
 
 	return numToAlloc;
@@ -566,49 +988,58 @@ int NvFlexExtAllocParticles(NvFlexExtContainer* c, int n, int* indices)
 
 void NvFlexExtFreeParticles(NvFlexExtContainer* c, int n, const int* indices)
 {
-#if _DEBUG
 	for (int i=0; i < n; ++i)
 	{
+		const int index = indices[i];
+
 		// check valid values
-		assert(indices[i] >= 0 && indices[i] < int(c->mFreeList.capacity()));
+		assert(index >= 0 && index < c->mMaxParticles);
 
-		// check for double delete
-		assert(std::find(c->mFreeList.begin(), c->mFreeList.end(), indices[i]) == c->mFreeList.end());
-	}
-#endif
+		const int position = c->mActivePositions[index];
 
-	c->mFreeList.insert(c->mFreeList.end(), indices, indices+n);
+		// skip particles that are already free so a double delete can't corrupt the active or free lists
+		if (position == -1)
+			continue;
 
-	c->mNeedsActiveListRebuild = true;
-}
+		// swap-remove from the active list, the last entry moves into the freed slot
+		const int last = c->mActiveIndices.back();
 
-int NvFlexExtGetActiveList(NvFlexExtContainer* c, int* indices)
-{
-	int count = 0;
+		c->mActiveIndices[position] = last;
+		c->mActivePositions[last] = position;
 
-	Bitmap inactive(c->mMaxParticles);
+		c->mActiveIndices.pop_back();
+		c->mActivePositions[index] = -1;
 
-	// create bitmap
-	for (size_t i=0; i < c->mFreeList.size(); ++i)
-	{
-		// if this fires then somehow a duplicate has ended up in the free list (double delete)
-		assert(!inactive.IsSet(c->mFreeList[i]));
+		c->mDirtyActive.Add(position, position+1);
 
-		inactive.Set(c->mFreeList[i]);
+		c->mFreeList.push_back(index);
 	}
 
-	// iterate bitmap to find active elements
-	for (int i=0; i < c->mMaxParticles; ++i)
-		if (inactive.IsSet(i) == false)
-			indices[count++] = i;
+	c->mNeedsActiveListRebuild = true;
+}
+
+int NvFlexExtGetActiveList(NvFlexExtContainer* c, int* indices)
+{
+	const int count = int(c->mActiveIndices.size());
+
+	if (count)
+		memcpy(indices, &c->mActiveIndices[0], count*sizeof(int));
 
 	return count;
 }
 
 NvFlexExtParticleData NvFlexExtMapParticleData(NvFlexExtContainer* c)
+{
+	return NvFlexExtMapParticleDataWithFlags(c, eNvFlexExtParticleDataAll);
+}
+
+NvFlexExtParticleData NvFlexExtMapParticleDataWithFlags(NvFlexExtContainer* c, int dirtyFlags)
 {
 	NvFlexExtParticleData data;
 
+	// the caller may write anywhere in these buffers
+	MarkParticlesDirty(c, dirtyFlags, 0, c->mMaxParticles);
+
 	c->mParticles.map();
 	c->mParticlesRest.map();
 	c->mVelocities.map();
@@ -639,6 +1070,21 @@ NvFlexExtParticleData NvFlexExtMapParticleData(NvFlexExtContainer* c)
 	return data;
 }
 
+void NvFlexExtMarkParticleDataDirty(NvFlexExtContainer* c, const int* indices, int n, int dirtyFlags)
+{
+	for (int i=0; i < n; ++i)
+	{
+		assert(indices[i] >= 0 && indices[i] < c->mMaxParticles);
+
+		MarkParticlesDirty(c, dirtyFlags, indices[i], indices[i]+1);
+	}
+}
+
+void NvFlexExtGetPushStats(NvFlexExtContainer* c, NvFlexExtPushStats* stats)
+{
+	*stats = c->mPushStats;
+}
+
 void NvFlexExtUnmapParticleData(NvFlexExtContainer*c)
 {
 	c->mParticles.unmap();
@@ -737,6 +1183,8 @@ NvFlexExtInstance* NvFlexExtCreateInstance(NvFlexExtContainer* c, NvFlexExtParti
 		((Vec3*)(particleData->velocities))[index] = Vec3(vx, vy, vz);
 		((int*)(particleData->phases))[index] = phase;
 		((Vec4*)(particleData->normals))[index] = Vec4(0.0f);
+
+		MarkParticlesDirty(c, eNvFlexExtParticleDataAll, index, index+1);
 	}
 
 	const int numShapes = asset->numShapes;
@@ -756,8 +1204,9 @@ NvFlexExtInstance* NvFlexExtCreateInstance(NvFlexExtContainer* c, NvFlexExtParti
 	inst->shapeTranslations = (float*)shapeTranslations;
 	inst->shapeRotations = (float*)shapeRotations;
 
-	// mark container as dirty
-	c->mNeedsCompact = true;
+	// constraints are appended on the next push to the device
+	AddBlock(c, inst, NULL);
+
 	c->mNeedsActiveListRebuild = true;
 
 	return inst;
@@ -776,7 +1225,8 @@ void NvFlexExtDestroyInstance(NvFlexExtContainer* c, const NvFlexExtInstance* in
 	assert(iter != c->mInstances.end());
 	c->mInstances.erase(iter);
 
-	c->mNeedsCompact = true;
+	RemoveBlock(c, inst, NULL);
+
 	c->mNeedsActiveListRebuild = true;
 
 	delete inst;
@@ -801,29 +1251,44 @@ void NvFlexExtNotifyAssetChanged(NvFlexExtContainer* c, const NvFlexExtAsset* as
 
 void NvFlexExtPushToDevice(NvFlexExtContainer* c)
 {
+	memset(&c->mPushStats, 0, sizeof(c->mPushStats));
+
 	if (c->mNeedsActiveListRebuild)
 	{
-		// update active list
+		const int n = int(c->mActiveIndices.size());
+
+		// entries beyond the active count are not read by the solver
+		c->mDirtyActive.Clamp(n);
+
+		const std::vector<std::pair<int, int> >& ranges = c->mDirtyActive.Merge();
+
+		// update modified entries of the active list
 		c->mActiveList.map();
-		int n = NvFlexExtGetActiveList(c, &c->mActiveList[0]);		
+
+		for (size_t i=0; i < ranges.size(); ++i)
+			memcpy(&c->mActiveList[ranges[i].first], &c->mActiveIndices[ranges[i].first], (ranges[i].second - ranges[i].first)*sizeof(int));
+
 		c->mActiveList.unmap();
 
-		NvFlexSetActive(c->mSolver, c->mActiveList.buffer, NULL);
+		c->mPushStats.activeBytes = PushDirtyRanges(c, c->mActiveList, c->mDirtyActive, NvFlexSetActive);
+
 		NvFlexSetActiveCount(c->mSolver, n);
 
 		c->mNeedsActiveListRebuild = false;
 	}
 
-	// push any changes to solver
-	NvFlexSetParticles(c->mSolver, c->mParticles.buffer, NULL);
-	NvFlexSetRestParticles(c->mSolver, c->mParticlesRest.buffer, NULL);
+	// push ranges modified on the host since the last push, the rest of the device data is newer or identical
+	c->mPushStats.particleBytes = PushDirtyRanges(c, c->mParticles, c->mDirtyParticles, NvFlexSetParticles);
+	c->mPushStats.restParticleBytes = PushDirtyRanges(c, c->mParticlesRest, c->mDirtyRestParticles, NvFlexSetRestParticles);
 
-	NvFlexSetVelocities(c->mSolver, c->mVelocities.buffer, NULL);
-	NvFlexSetPhases(c->mSolver, c->mPhases.buffer, NULL);
-	NvFlexSetNormals(c->mSolver, c->mNormals.buffer, NULL);
+	c->mPushStats.velocityBytes = PushDirtyRanges(c, c->mVelocities, c->mDirtyVelocities, NvFlexSetVelocities);
+	c->mPushStats.phaseBytes = PushDirtyRanges(c, c->mPhases, c->mDirtyPhases, NvFlexSetPhases);
+	c->mPushStats.normalBytes = PushDirtyRanges(c, c->mNormals, c->mDirtyNormals, NvFlexSetNormals);
 	
 	if (c->mNeedsCompact)
 		CompactObjects(c);
+	else if (c->mFirstDirtyBlock != INT_MAX)
+		UpdateConstraints(c);
 }
 
 void NvFlexExtPullFromDevice(NvFlexExtContainer* c)
@@ -840,87 +1305,138 @@ void NvFlexExtPullFromDevice(NvFlexExtContainer* c)
 		NvFlexGetRigids(c->mSolver, NULL, NULL, NULL, NULL, NULL, NULL, NULL, c->mShapeRotations.buffer, c->mShapeTranslations.buffer);
 }
 
-void NvFlexExtUpdateInstances(NvFlexExtContainer* c)
+void UpdateInstances(NvFlexExtContainer* c, bool copyToInstances)
 {
 	c->mShapeTranslations.map();
 	c->mShapeRotations.map();
 
-	for (int i=0; i < int(c->mInstances.size()); ++i)
+	const int numShapes = c->mShapeTranslations.size();
+
+	const Vec3* translations = numShapes ? &c->mShapeTranslations[0] : NULL;
+	const Quat* rotations = numShapes ? &c->mShapeRotations[0] : NULL;
+
+	if (copyToInstances)
 	{
-		NvFlexExtInstance* inst = c->mInstances[i];
+		// each instance owns its transform arrays so instances can be written in parallel
+		GetDefaultThreadPool().ParallelFor(0, int(c->mInstances.size()), [&](int begin, int end)
+		{
+			for (int i=begin; i < end; ++i)
+			{
+				NvFlexExtInstance* inst = c->mInstances[i];
 
-		// copy data back to per-instance memory from the container's memory
-		const int numShapes = inst->asset->numShapes;
-		const int shapeStart = inst->shapeIndex;
+				// copy data back to per-instance memory from the container's memory
+				const int numShapes = inst->asset->numShapes;
+				const int shapeStart = inst->shapeIndex;
 
-		if (shapeStart == -1)
-			continue;
+				if (shapeStart == -1)
+					continue;
 
-		for (int s=0; s < numShapes; ++s)
+				for (int s=0; s < numShapes; ++s)
+				{
+					((Vec3*)inst->shapeTranslations)[s] = translations[shapeStart + s];
+					((Quat*)inst->shapeRotations)[s] = rotations[shapeStart + s];
+				}
+			}
+		}, 0, 1024);
+	}
+	else
+	{
+		c->mHostShapeTranslations.resize(numShapes);
+		c->mHostShapeRotations.resize(numShapes);
+
+		// copy the transforms of all shapes in large contiguous blocks, see NvFlexExtGetShapeTransforms()
+		GetDefaultThreadPool().ParallelFor(0, numShapes, [&](int begin, int end)
 		{
-			((Vec3*)inst->shapeTranslations)[s] = c->mShapeTranslations[shapeStart + s];
-			((Quat*)inst->shapeRotations)[s] = c->mShapeRotations[shapeStart + s];
-		}		
+			memcpy(&c->mHostShapeTranslations[begin], &translations[begin], (end-begin)*sizeof(Vec3));
+			memcpy(&c->mHostShapeRotations[begin], &rotations[begin], (end-begin)*sizeof(Quat));
+		}, 0, 16*1024);
 	}
 
-	for (int i = 0; i < int(c->mSoftJoints.size()); ++i)
+	// joints are independent, the first update of a joint also reads its particles to find the center of mass
+	GetDefaultThreadPool().ParallelFor(0, int(c->mSoftJoints.size()), [&](int begin, int end)
 	{
-		NvFlexExtSoftJoint* joint = c->mSoftJoints[i];
+		for (int j=begin; j < end; ++j)
+		{
+			NvFlexExtSoftJoint* joint = c->mSoftJoints[j];
 
-		const int shapeStart = joint->shapeIndex;
+			const int shapeStart = joint->shapeIndex;
 
-		// Here we compute the COM only once instead of in NvFlexExtCreateSoftJoint() to avoid buffer mapping issue
-		if (!joint->initialized)
-		{
-			// Calculate the center of mass of the new shape matching constraint given a set of joint particles and its indices
-			// To improve the accuracy of the result, first transform the particlePosition to relative coordinates (by finding the mean and subtracting that from all positions)
-			// Note: If this is not done, one might see ghost forces if the mean of the particlePosition is far from the origin.
-			Vec3 shapeOffset(0.0f);
-			for (int i = 0; i < joint->numParticles; ++i)
+			// Here we compute the COM only once instead of in NvFlexExtCreateSoftJoint() to avoid buffer mapping issue
+			if (!joint->initialized)
 			{
-				const Vec4 particlePosition = c->mParticles[joint->particleIndices[i]];
-				shapeOffset += Vec3(particlePosition);
-			}
-			shapeOffset /= float(joint->numParticles);
+				// Calculate the center of mass of the new shape matching constraint given a set of joint particles and its indices
+				// To improve the accuracy of the result, first transform the particlePosition to relative coordinates (by finding the mean and subtracting that from all positions)
+				// Note: If this is not done, one might see ghost forces if the mean of the particlePosition is far from the origin.
+				Vec3 shapeOffset(0.0f);
+				for (int i = 0; i < joint->numParticles; ++i)
+				{
+					const Vec4 particlePosition = c->mParticles[joint->particleIndices[i]];
+					shapeOffset += Vec3(particlePosition);
+				}
+				shapeOffset /= float(joint->numParticles);
 
-			Vec3 com;
-			for (int i = 0; i < joint->numParticles; ++i)
-			{
-				const Vec4 particlePosition = c->mParticles[joint->particleIndices[i]];
+				Vec3 com;
+				for (int i = 0; i < joint->numParticles; ++i)
+				{
+					const Vec4 particlePosition = c->mParticles[joint->particleIndices[i]];
 
-				// By subtracting shapeOffset the calculation is done in relative coordinates
-				com += Vec3(particlePosition) - shapeOffset;
-			}
-			com /= float(joint->numParticles);
+					// By subtracting shapeOffset the calculation is done in relative coordinates
+					com += Vec3(particlePosition) - shapeOffset;
+				}
+				com /= float(joint->numParticles);
 
-			// Add the shapeOffset to switch back to absolute coordinates
-			com += shapeOffset;
+				// Add the shapeOffset to switch back to absolute coordinates
+				com += shapeOffset;
 
-			// update per-joint shapeTranslations and copy to the container's memory
-			joint->shapeTranslations[0] = com.x;
-			joint->shapeTranslations[1] = com.y;
-			joint->shapeTranslations[2] = com.z;
+				// update per-joint shapeTranslations and copy to the container's memory
+				joint->shapeTranslations[0] = com.x;
+				joint->shapeTranslations[1] = com.y;
+				joint->shapeTranslations[2] = com.z;
 
-			joint->initialized = true;		// Complete joint initilization process 
-		}
-		else
-		{
-			joint->shapeTranslations[0] = c->mShapeTranslations[shapeStart].x;
-			joint->shapeTranslations[1] = c->mShapeTranslations[shapeStart].y;
-			joint->shapeTranslations[2] = c->mShapeTranslations[shapeStart].z;
-		}
+				joint->initialized = true;		// Complete joint initilization process 
+			}
+			else if (shapeStart != -1)
+			{
+				joint->shapeTranslations[0] = translations[shapeStart].x;
+				joint->shapeTranslations[1] = translations[shapeStart].y;
+				joint->shapeTranslations[2] = translations[shapeStart].z;
+			}
 
-		// copy data back to per-joint memory from the container's memory
-		joint->shapeRotations[0] = c->mShapeRotations[shapeStart].x;
-		joint->shapeRotations[1] = c->mShapeRotations[shapeStart].y;
-		joint->shapeRotations[2] = c->mShapeRotations[shapeStart].z;
-		joint->shapeRotations[3] = c->mShapeRotations[shapeStart].w;
-	}
+			// joint constraints are not in the container until the next push to the device
+			if (shapeStart == -1)
+				continue;
+
+			// copy data back to per-joint memory from the container's memory
+			joint->shapeRotations[0] = rotations[shapeStart].x;
+			joint->shapeRotations[1] = rotations[shapeStart].y;
+			joint->shapeRotations[2] = rotations[shapeStart].z;
+			joint->shapeRotations[3] = rotations[shapeStart].w;
+		}
+	}, 0, 64);
 
 	c->mShapeTranslations.unmap();
 	c->mShapeRotations.unmap();
 }
 
+void NvFlexExtUpdateInstances(NvFlexExtContainer* c)
+{
+	UpdateInstances(c, true);
+}
+
+void NvFlexExtUpdateInstancesNoCopy(NvFlexExtContainer* c)
+{
+	UpdateInstances(c, false);
+}
+
+void NvFlexExtGetShapeTransforms(NvFlexExtContainer* c, NvFlexExtShapeTransforms* transforms)
+{
+	const int numShapes = int(c->mHostShapeTranslations.size());
+
+	transforms->translations = numShapes ? (const float*)&c->mHostShapeTranslations[0] : NULL;
+	transforms->rotations = numShapes ? (const float*)&c->mHostShapeRotations[0] : NULL;
+	transforms->numShapes = numShapes;
+}
+
 void NvFlexExtDestroyAsset(NvFlexExtAsset* asset)
 {
 	delete[] asset->particles;
@@ -957,11 +1473,12 @@ NvFlexExtSoftJoint* NvFlexExtCreateSoftJoint(NvFlexExtContainer* c, const int* p
 	joint->numParticles = numJointParticles;
 	joint->stiffness = stiffness;
 	joint->initialized = false;		// Initialization will be fully completed in NvFlexExtUpdateInstances()
+	joint->shapeIndex = -1;
 
 	c->mSoftJoints.push_back(joint);
 
-	// mark container as dirty
-	c->mNeedsCompact = true;
+	// constraints are appended on the next push to the device
+	AddBlock(c, NULL, joint);
 
 	return joint;
 }
@@ -976,7 +1493,7 @@ void NvFlexExtDestroySoftJoint(NvFlexExtContainer* c, NvFlexExtSoftJoint* joint)
 	assert(iter != c->mSoftJoints.end());
 	c->mSoftJoints.erase(iter);
 
-	c->mNeedsCompact = true;
+	RemoveBlock(c, NULL, joint);
 
 	delete joint;
 }
@@ -1003,6 +1520,8 @@ void NvFlexExtSoftJointSetTransform(NvFlexExtContainer* c, NvFlexExtSoftJoint* j
 		c->mParticles[joint->particleIndices[i]].x = particleNewPostion.x;
 		c->mParticles[joint->particleIndices[i]].y = particleNewPostion.y;
 		c->mParticles[joint->particleIndices[i]].z = particleNewPostion.z;
+
+		c->mDirtyParticles.Add(joint->particleIndices[i], joint->particleIndices[i]+1);
 	}
 
 	joint->shapeTranslations[0] = newPosition[0];
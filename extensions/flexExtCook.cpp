@@ -0,0 +1,556 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#include "../include/NvFlexExt.h"
+#include "flexExtCache.h"
+
+#include "../core/maths.h"
+#include "../core/parallel.h"
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#if defined(WIN32) || defined(WIN64)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+struct NvFlexExtCookJob
+{
+	NvFlexExtCookJobDesc desc;
+
+	// private copies of the caller's mesh data
+	std::vector<float> vertices;
+	std::vector<int> indices;
+
+	NvFlexExtAsset* asset;
+	bool complete;
+
+	std::mutex mutex;
+	std::condition_variable done;
+
+	// shared between the caller's handle and the queued task so that either may be released first
+	std::shared_ptr<NvFlexExtCookJob> self;
+};
+
+struct NvFlexExtCookQueue
+{
+	// the pool counts the thread calling ParallelFor(), which the queue never does, so request one extra
+	NvFlexExtCookQueue(int numThreads) : pool(numThreads + 1) {}
+
+	ThreadPool pool;
+};
+
+namespace
+{
+
+NvFlexExtAsset* CookAsset(const NvFlexExtCookJob& job)
+{
+	const NvFlexExtCookJobDesc& desc = job.desc;
+
+	const float* vertices = job.vertices.empty() ? NULL : &job.vertices[0];
+	const int* indices = job.indices.empty() ? NULL : &job.indices[0];
+
+	switch (desc.type)
+	{
+		case eNvFlexExtCookRigid:
+		{
+			const NvFlexExtRigidCookParams& p = desc.rigid;
+			return NvFlexExtCreateRigidFromMesh(vertices, desc.numVertices, indices, desc.numIndices, p.radius, p.expand);
+		}
+		case eNvFlexExtCookSoft:
+		{
+			const NvFlexExtSoftCookParams& p = desc.soft;
+			return NvFlexExtCreateSoftFromMeshWithDesc(vertices, desc.numVertices, indices, desc.numIndices, p.particleSpacing, p.volumeSampling, p.surfaceSampling, 
+				p.clusterSpacing, p.clusterRadius, p.clusterStiffness, p.linkRadius, p.linkStiffness, p.globalStiffness, p.clusterPlasticThreshold, p.clusterPlasticCreep, &p.desc);
+		}
+		case eNvFlexExtCookCloth:
+		{
+			const NvFlexExtClothCookParams& p = desc.cloth;
+			if (p.geodesicTethers)
+				return NvFlexExtCreateClothFromMeshWithGeodesicTethers(vertices, desc.numVertices, indices, desc.numIndices/3, p.stretchStiffness, p.bendStiffness, p.tetherStiffness, p.tetherGive, p.pressure);
+
+			return NvFlexExtCreateClothFromMesh(vertices, desc.numVertices, indices, desc.numIndices/3, p.stretchStiffness, p.bendStiffness, p.tetherStiffness, p.tetherGive, p.pressure);
+		}
+	}
+
+	return NULL;
+}
+
+void RunCookJob(const std::shared_ptr<NvFlexExtCookJob>& job)
+{
+	NvFlexExtAsset* asset = CookAsset(*job);
+
+	// the input copies are no longer needed, free them before the caller collects the result
+	std::vector<float>().swap(job->vertices);
+	std::vector<int>().swap(job->indices);
+
+	std::lock_guard<std::mutex> lock(job->mutex);
+
+	job->asset = asset;
+	job->complete = true;
+	job->done.notify_all();
+}
+
+void WaitCookJob(NvFlexExtCookJob* job)
+{
+	std::unique_lock<std::mutex> lock(job->mutex);
+
+	while (!job->complete)
+		job->done.wait(lock);
+}
+
+} // anonymous namespace
+
+NvFlexExtCookQueue* NvFlexExtCreateCookQueue(int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = GetNumHardwareThreads();
+
+	return new NvFlexExtCookQueue(numThreads);
+}
+
+void NvFlexExtDestroyCookQueue(NvFlexExtCookQueue* queue)
+{
+	// pool destructor runs any jobs still queued before joining its workers
+	delete queue;
+}
+
+void NvFlexExtSubmitCookJobs(NvFlexExtCookQueue* queue, const NvFlexExtCookJobDesc* jobs, int numJobs, NvFlexExtCookJob** outJobs)
+{
+	for (int i=0; i < numJobs; ++i)
+	{
+		const NvFlexExtCookJobDesc& desc = jobs[i];
+
+		std::shared_ptr<NvFlexExtCookJob> job = std::make_shared<NvFlexExtCookJob>();
+		job->desc = desc;
+		job->asset = NULL;
+		job->complete = false;
+		job->self = job;
+
+		// cloth particles are float4, rigid and soft vertices are float3
+		const int vertexStride = desc.type == eNvFlexExtCookCloth ? 4 : 3;
+
+		if (desc.vertices)
+			job->vertices.assign(desc.vertices, desc.vertices + desc.numVertices*vertexStride);
+
+		if (desc.indices)
+			job->indices.assign(desc.indices, desc.indices + desc.numIndices);
+
+		// the queued task holds its own reference so that releasing the handle cannot free a running job
+		queue->pool.Submit([job]() { RunCookJob(job); });
+
+		outJobs[i] = job.get();
+	}
+}
+
+bool NvFlexExtIsCookJobComplete(NvFlexExtCookJob* job)
+{
+	std::lock_guard<std::mutex> lock(job->mutex);
+	return job->complete;
+}
+
+void NvFlexExtWaitCookJobs(NvFlexExtCookJob* const* jobs, int numJobs)
+{
+	for (int i=0; i < numJobs; ++i)
+		WaitCookJob(jobs[i]);
+}
+
+NvFlexExtAsset* NvFlexExtReleaseCookJob(NvFlexExtCookJob* job)
+{
+	WaitCookJob(job);
+
+	NvFlexExtAsset* asset = job->asset;
+
+	// drop the handle's reference, the job is freed here or when the task releases its own reference
+	std::shared_ptr<NvFlexExtCookJob> self;
+	self.swap(job->self);
+
+	return asset;
+}
+
+//-----------------------------------------------------------------------------
+// Asset files, a fixed size header followed by the asset arrays at 16 byte aligned offsets so
+// a file that has been read or memory mapped can be used in place by NvFlexExtMapAsset()
+
+namespace
+{
+
+const uint32_t kAssetFileMagic = 0x41584c46;	// 'FLXA'
+const uint32_t kAssetFileVersion = 1;
+const uint64_t kAssetFileAlignment = 16;
+
+enum AssetFileArray
+{
+	eAssetParticles,
+	eAssetSpringIndices,
+	eAssetSpringCoefficients,
+	eAssetSpringRestLengths,
+	eAssetShapeIndices,
+	eAssetShapeOffsets,
+	eAssetShapeCoefficients,
+	eAssetShapeCenters,
+	eAssetShapePlasticThresholds,
+	eAssetShapePlasticCreeps,
+	eAssetTriangleIndices,
+
+	eAssetNumArrays
+};
+
+struct AssetFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fileSize;
+	uint64_t key;				// content hash of the cook inputs for cache entries, 0 otherwise
+
+	int32_t numParticles;
+	int32_t maxParticles;
+	int32_t numSprings;
+	int32_t numShapeIndices;
+	int32_t numShapes;
+	int32_t numTriangles;
+
+	uint32_t inflatable;
+	float inflatableVolume;
+	float inflatablePressure;
+	float inflatableStiffness;
+
+	uint64_t offsets[eAssetNumArrays];	// byte offset of each array from the start of the file, 0 if the array is not present
+};
+
+// all asset arrays hold 32-bit elements (int or float)
+void GetAssetArrays(NvFlexExtAsset& asset, void** arrays[eAssetNumArrays])
+{
+	arrays[eAssetParticles] = (void**)&asset.particles;
+	arrays[eAssetSpringIndices] = (void**)&asset.springIndices;
+	arrays[eAssetSpringCoefficients] = (void**)&asset.springCoefficients;
+	arrays[eAssetSpringRestLengths] = (void**)&asset.springRestLengths;
+	arrays[eAssetShapeIndices] = (void**)&asset.shapeIndices;
+	arrays[eAssetShapeOffsets] = (void**)&asset.shapeOffsets;
+	arrays[eAssetShapeCoefficients] = (void**)&asset.shapeCoefficients;
+	arrays[eAssetShapeCenters] = (void**)&asset.shapeCenters;
+	arrays[eAssetShapePlasticThresholds] = (void**)&asset.shapePlasticThresholds;
+	arrays[eAssetShapePlasticCreeps] = (void**)&asset.shapePlasticCreeps;
+	arrays[eAssetTriangleIndices] = (void**)&asset.triangleIndices;
+}
+
+// number of 32-bit elements stored for each array
+void GetAssetArrayCounts(const AssetFileHeader& header, uint64_t counts[eAssetNumArrays])
+{
+	counts[eAssetParticles] = uint64_t(header.numParticles)*4;
+	counts[eAssetSpringIndices] = uint64_t(header.numSprings)*2;
+	counts[eAssetSpringCoefficients] = uint64_t(header.numSprings);
+	counts[eAssetSpringRestLengths] = uint64_t(header.numSprings);
+	counts[eAssetShapeIndices] = uint64_t(header.numShapeIndices);
+	counts[eAssetShapeOffsets] = uint64_t(header.numShapes);
+	counts[eAssetShapeCoefficients] = uint64_t(header.numShapes);
+	counts[eAssetShapeCenters] = uint64_t(header.numShapes)*3;
+	counts[eAssetShapePlasticThresholds] = uint64_t(header.numShapes);
+	counts[eAssetShapePlasticCreeps] = uint64_t(header.numShapes);
+	counts[eAssetTriangleIndices] = uint64_t(header.numTriangles)*3;
+}
+
+void WriteAssetFile(const NvFlexExtAsset* asset, uint64_t key, std::vector<uint8_t>& out)
+{
+	AssetFileHeader header;
+	memset(&header, 0, sizeof(header));
+
+	header.magic = kAssetFileMagic;
+	header.version = kAssetFileVersion;
+	header.key = key;
+	header.numParticles = asset->numParticles;
+	header.maxParticles = asset->maxParticles;
+	header.numSprings = asset->numSprings;
+	header.numShapeIndices = asset->numShapeIndices;
+	header.numShapes = asset->numShapes;
+	header.numTriangles = asset->numTriangles;
+	header.inflatable = asset->inflatable;
+	header.inflatableVolume = asset->inflatableVolume;
+	header.inflatablePressure = asset->inflatablePressure;
+	header.inflatableStiffness = asset->inflatableStiffness;
+
+	void** arrays[eAssetNumArrays];
+	GetAssetArrays(const_cast<NvFlexExtAsset&>(*asset), arrays);
+
+	uint64_t counts[eAssetNumArrays];
+	GetAssetArrayCounts(header, counts);
+
+	// lay out arrays
+	uint64_t offset = sizeof(AssetFileHeader);
+
+	for (int i=0; i < eAssetNumArrays; ++i)
+	{
+		if (*arrays[i] && counts[i])
+		{
+			offset = (offset + kAssetFileAlignment - 1)&~(kAssetFileAlignment - 1);
+
+			header.offsets[i] = offset;
+			offset += counts[i]*4;
+		}
+	}
+
+	header.fileSize = offset;
+
+	out.assign(size_t(header.fileSize), 0);
+	memcpy(&out[0], &header, sizeof(header));
+
+	for (int i=0; i < eAssetNumArrays; ++i)
+		if (header.offsets[i])
+			memcpy(&out[size_t(header.offsets[i])], *arrays[i], size_t(counts[i]*4));
+}
+
+bool MapAssetFile(const void* data, size_t size, NvFlexExtAsset* asset, uint64_t* key)
+{
+	if (!data || size < sizeof(AssetFileHeader) || (uintptr_t(data)&3))
+		return false;
+
+	const AssetFileHeader& header = *(const AssetFileHeader*)data;
+
+	if (header.magic != kAssetFileMagic || header.version != kAssetFileVersion || header.fileSize != size)
+		return false;
+
+	if (header.numParticles < 0 || header.maxParticles < header.numParticles || header.numSprings < 0 || 
+		header.numShapeIndices < 0 || header.numShapes < 0 || header.numTriangles < 0)
+		return false;
+
+	uint64_t counts[eAssetNumArrays];
+	GetAssetArrayCounts(header, counts);
+
+	memset(asset, 0, sizeof(NvFlexExtAsset));
+
+	void** arrays[eAssetNumArrays];
+	GetAssetArrays(*asset, arrays);
+
+	for (int i=0; i < eAssetNumArrays; ++i)
+	{
+		const uint64_t offset = header.offsets[i];
+
+		if (!offset)
+			continue;
+
+		if (offset < sizeof(AssetFileHeader) || (offset&3) || offset + counts[i]*4 > size)
+			return false;
+
+		*arrays[i] = (uint8_t*)data + offset;
+	}
+
+	// arrays the counts require must be present
+	if ((header.numParticles && !asset->particles) || (header.numSprings && !(asset->springIndices && asset->springRestLengths && asset->springCoefficients)) ||
+		(header.numShapes && !(asset->shapeOffsets && asset->shapeCenters && asset->shapeCoefficients)) || (header.numShapeIndices && !asset->shapeIndices) ||
+		(header.numTriangles && !asset->triangleIndices))
+		return false;
+
+	asset->numParticles = header.numParticles;
+	asset->maxParticles = header.maxParticles;
+	asset->numSprings = header.numSprings;
+	asset->numShapeIndices = header.numShapeIndices;
+	asset->numShapes = header.numShapes;
+	asset->numTriangles = header.numTriangles;
+	asset->inflatable = header.inflatable != 0;
+	asset->inflatableVolume = header.inflatableVolume;
+	asset->inflatablePressure = header.inflatablePressure;
+	asset->inflatableStiffness = header.inflatableStiffness;
+
+	if (key)
+		*key = header.key;
+
+	return true;
+}
+
+// copies a mapped asset into allocations owned by the asset so it can be freed with NvFlexExtDestroyAsset()
+NvFlexExtAsset* CopyMappedAsset(const NvFlexExtAsset& mapped)
+{
+	NvFlexExtAsset* asset = new NvFlexExtAsset(mapped);
+
+	AssetFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.numSprings = mapped.numSprings;
+	header.numShapeIndices = mapped.numShapeIndices;
+	header.numShapes = mapped.numShapes;
+	header.numTriangles = mapped.numTriangles;
+
+	// particles have room for maxParticles, as created by the tearing cloth functions
+	header.numParticles = mapped.maxParticles;
+
+	uint64_t counts[eAssetNumArrays];
+	GetAssetArrayCounts(header, counts);
+
+	void** arrays[eAssetNumArrays];
+	GetAssetArrays(*asset, arrays);
+
+	for (int i=0; i < eAssetNumArrays; ++i)
+	{
+		if (*arrays[i])
+		{
+			float* copy = new float[size_t(counts[i])];
+			memset(copy, 0, size_t(counts[i]*4));
+
+			const uint64_t bytes = i == eAssetParticles ? uint64_t(mapped.numParticles)*16 : counts[i]*4;
+			memcpy(copy, *arrays[i], size_t(bytes));
+
+			*arrays[i] = copy;
+		}
+	}
+
+	return asset;
+}
+
+bool SaveAssetFile(const NvFlexExtAsset* asset, uint64_t key, const char* path)
+{
+	std::vector<uint8_t> data;
+	WriteAssetFile(asset, key, data);
+
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+
+	const bool written = fwrite(&data[0], 1, data.size(), f) == data.size();
+	fclose(f);
+
+	if (!written)
+		remove(path);
+
+	return written;
+}
+
+NvFlexExtAsset* LoadAssetFile(const char* path, uint64_t* key)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	const long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	// read into 16 byte aligned storage
+	std::vector<Vec4> storage(size > 0 ? (size_t(size) + 15)/16 : 0);
+
+	const bool read = size > 0 && fread(&storage[0], 1, size_t(size), f) == size_t(size);
+	fclose(f);
+
+	if (!read)
+		return NULL;
+
+	NvFlexExtAsset mapped;
+	if (!MapAssetFile(&storage[0], size_t(size), &mapped, key))
+		return NULL;
+
+	return CopyMappedAsset(mapped);
+}
+
+// asset cache state, the directory is shared by all threads creating assets
+std::mutex g_assetCacheMutex;
+std::string g_assetCacheDirectory;
+std::atomic<int> g_assetCacheEnabled(0);
+std::atomic<uint32_t> g_assetCacheTempCounter(0);
+
+std::string GetAssetCachePath(uint64_t key)
+{
+	char name[32];
+	sprintf(name, "%016llx.flexasset", (unsigned long long)key);
+
+	std::lock_guard<std::mutex> lock(g_assetCacheMutex);
+	return g_assetCacheDirectory + "/" + name;
+}
+
+} // anonymous namespace
+
+bool IsAssetCacheEnabled()
+{
+	return g_assetCacheEnabled != 0;
+}
+
+NvFlexExtAsset* LoadCachedAsset(const AssetCacheKey& key)
+{
+	if (!IsAssetCacheEnabled())
+		return NULL;
+
+	uint64_t fileKey;
+	NvFlexExtAsset* asset = LoadAssetFile(GetAssetCachePath(key.hash).c_str(), &fileKey);
+
+	// guard against files that were copied or renamed
+	if (asset && fileKey != key.hash)
+	{
+		NvFlexExtDestroyAsset(asset);
+		return NULL;
+	}
+
+	return asset;
+}
+
+void StoreCachedAsset(const AssetCacheKey& key, const NvFlexExtAsset* asset)
+{
+	if (!asset || !IsAssetCacheEnabled())
+		return;
+
+	const std::string path = GetAssetCachePath(key.hash);
+
+	// write to a temporary name that is unique across threads and processes then rename, so that concurrent
+	// cooks of the same asset (or a reader in another process) never observe a partially written entry
+	char suffix[48];
+	sprintf(suffix, ".%u.%u.tmp", unsigned(getpid()), unsigned(g_assetCacheTempCounter++));
+
+	const std::string tempPath = path + suffix;
+
+	if (SaveAssetFile(asset, key.hash, tempPath.c_str()))
+	{
+		if (rename(tempPath.c_str(), path.c_str()) != 0)
+			remove(tempPath.c_str());
+	}
+}
+
+bool NvFlexExtSaveAsset(const NvFlexExtAsset* asset, const char* path)
+{
+	return SaveAssetFile(asset, 0, path);
+}
+
+NvFlexExtAsset* NvFlexExtLoadAsset(const char* path)
+{
+	return LoadAssetFile(path, NULL);
+}
+
+bool NvFlexExtMapAsset(const void* data, size_t size, NvFlexExtAsset* asset)
+{
+	return MapAssetFile(data, size, asset, NULL);
+}
+
+void NvFlexExtSetAssetCacheDirectory(const char* path)
+{
+	std::lock_guard<std::mutex> lock(g_assetCacheMutex);
+
+	g_assetCacheDirectory = path ? path : "";
+	g_assetCacheEnabled = path && path[0];
+}
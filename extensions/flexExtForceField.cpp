@@ -0,0 +1,197 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#include "../include/NvFlexExt.h"
+
+#include "../core/maths.h"
+#include "../core/parallel.h"
+
+#include "flexExtForceField.h"
+
+#include <cfloat>
+
+namespace
+{
+
+// upper bound on the number of cells along each axis, and on the total number of 
+// cells per field, this keeps the grid small when a few fields are spread far apart
+const int kMaxGridDim = 128;
+const int kMaxCellsPerField = 64;
+
+inline int CellCoord(float x, float lower, float invCellSize, int dim)
+{
+	return Clamp(int(floorf((x-lower)*invCellSize)), 0, dim-1);
+}
+
+} // anonymous namespace
+
+void BuildForceFieldGrid(ForceFieldGrid& grid, const NvFlexExtForceField* forceFields, int numForceFields)
+{
+	Vec3 lower(FLT_MAX);
+	Vec3 upper(-FLT_MAX);
+
+	float sumDiameter = 0.0f;
+	int numBinned = 0;
+
+	for (int i=0; i < numForceFields; ++i)
+	{
+		const NvFlexExtForceField& f = forceFields[i];
+		if (f.mRadius <= 0.0f)
+			continue;
+
+		lower = Min(lower, Vec3(f.mPosition) - Vec3(f.mRadius));
+		upper = Max(upper, Vec3(f.mPosition) + Vec3(f.mRadius));
+
+		sumDiameter += 2.0f*f.mRadius;
+		numBinned++;
+	}
+
+	ForceFieldGridParams& params = grid.mParams;
+
+	grid.mCellFields.resize(0);
+
+	if (numBinned == 0)
+	{
+		params.mDim[0] = params.mDim[1] = params.mDim[2] = 0;
+		params.mNumCells = 0;
+
+		grid.mCellStarts.assign(1, 0);
+		return;
+	}
+
+	// cells about the size of an average field so each particle tests roughly the fields that 
+	// actually overlap it, grown if needed to respect the cell budget
+	const Vec3 edges = upper-lower;
+	const float volume = Max(edges.x, 1.e-6f)*Max(edges.y, 1.e-6f)*Max(edges.z, 1.e-6f);
+	const float maxCells = float(Min(numBinned*kMaxCellsPerField, kMaxGridDim*kMaxGridDim*kMaxGridDim));
+
+	float cellSize = Max(sumDiameter/numBinned, powf(volume/maxCells, 1.0f/3.0f));
+	cellSize = Max(cellSize, Max(edges.x, Max(edges.y, edges.z))/kMaxGridDim);
+
+	for (int a=0; a < 3; ++a)
+	{
+		params.mDim[a] = Clamp(int(ceilf(edges[a]/cellSize)), 1, kMaxGridDim);
+		params.mLower[a] = lower[a];
+	}
+
+	params.mInvCellSize = 1.0f/cellSize;
+	params.mNumCells = params.mDim[0]*params.mDim[1]*params.mDim[2];
+
+	const int numCells = params.mNumCells;
+
+	// count then fill (counting sort), iterating fields in order keeps each cell's list sorted
+	grid.mCellStarts.assign(numCells+1, 0);
+
+	for (int pass=0; pass < 2; ++pass)
+	{
+		for (int i=0; i < numForceFields; ++i)
+		{
+			const NvFlexExtForceField& f = forceFields[i];
+			if (f.mRadius <= 0.0f)
+				continue;
+
+			int cellLower[3];
+			int cellUpper[3];
+
+			for (int a=0; a < 3; ++a)
+			{
+				cellLower[a] = CellCoord(f.mPosition[a]-f.mRadius, params.mLower[a], params.mInvCellSize, params.mDim[a]);
+				cellUpper[a] = CellCoord(f.mPosition[a]+f.mRadius, params.mLower[a], params.mInvCellSize, params.mDim[a]);
+			}
+
+			for (int z=cellLower[2]; z <= cellUpper[2]; ++z)
+			{
+				for (int y=cellLower[1]; y <= cellUpper[1]; ++y)
+				{
+					for (int x=cellLower[0]; x <= cellUpper[0]; ++x)
+					{
+						const int cell = (z*params.mDim[1] + y)*params.mDim[0] + x;
+
+						if (pass == 0)
+							grid.mCellStarts[cell+1]++;
+						else
+							grid.mCellFields[grid.mCellStarts[cell]++] = i;
+					}
+				}
+			}
+		}
+
+		if (pass == 0)
+		{
+			// prefix sum, mCellStarts[cell] is then used as the write cursor for the cell
+			for (int c=0; c < numCells; ++c)
+				grid.mCellStarts[c+1] += grid.mCellStarts[c];
+
+			grid.mCellFields.resize(grid.mCellStarts[numCells]);
+		}
+		else
+		{
+			// cursors have advanced to the end of each cell, shift back to the start offsets
+			for (int c=numCells; c > 0; --c)
+				grid.mCellStarts[c] = grid.mCellStarts[c-1];
+
+			grid.mCellStarts[0] = 0;
+		}
+	}
+}
+
+void ApplyForceFields(const ForceFieldGrid& grid, const NvFlexExtForceField* forceFields, const float* positions, float* velocities, int numParticles, float dt, int numThreads)
+{
+	if (grid.GetNumCells() == 0)
+		return;
+
+	// local copy, the compiler can't otherwise assume velocity writes leave the grid unchanged
+	const ForceFieldGridParams params = grid.mParams;
+
+	GetDefaultThreadPool().ParallelFor(0, numParticles, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const Vec4 p(&positions[i*4]);
+
+			const int c = GetForceFieldCell(params, Vec3(p));
+			if (c < 0)
+				continue;
+
+			const int start = grid.mCellStarts[c];
+			const int count = grid.mCellStarts[c+1]-start;
+
+			if (count == 0)
+				continue;
+
+			Vec3 v(&velocities[i*4]);
+
+			for (int f=0; f < count; ++f)
+				v += EvaluateForceField(forceFields[grid.mCellFields[start+f]], Vec3(p), p.w, dt);
+
+			velocities[i*4+0] = v.x;
+			velocities[i*4+1] = v.y;
+			velocities[i*4+2] = v.z;
+		}
+
+	}, numThreads, 1024);
+}
@@ -0,0 +1,122 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#pragma once
+
+// internal interface to the force field broadphase (implemented in flexExtForceField.cpp), the grid is built 
+// on the host by NvFlexExtSetForceFields() for every backend, the lookup and evaluation below are shared by
+// the host side solver callback and the CUDA kernel
+
+#include "../include/NvFlexExt.h"
+
+#include "../core/maths.h"
+
+#include <vector>
+
+// grid placement, small enough to pass to kernels by value
+struct ForceFieldGridParams
+{
+	float mLower[3];
+	float mInvCellSize;
+	int mDim[3];
+	int mNumCells;
+};
+
+// uniform grid over the force field spheres, each cell lists the fields whose bounds overlap it
+// in the order they were passed to NvFlexExtSetForceFields() so the binned evaluation applies 
+// fields in the same order as a loop over every field
+struct ForceFieldGrid
+{
+	ForceFieldGrid()
+	{
+		mParams.mLower[0] = mParams.mLower[1] = mParams.mLower[2] = 0.0f;
+		mParams.mInvCellSize = 0.0f;
+		mParams.mDim[0] = mParams.mDim[1] = mParams.mDim[2] = 0;
+		mParams.mNumCells = 0;
+	}
+
+	ForceFieldGridParams mParams;
+
+	std::vector<int> mCellStarts;	// numCells+1 offsets into mCellFields
+	std::vector<int> mCellFields;	// field indices for each cell
+
+	int GetNumCells() const { return mParams.mNumCells; }
+};
+
+// returns the cell containing p, or -1 if p lies outside the grid (and so outside every field)
+CUDA_CALLABLE inline int GetForceFieldCell(const ForceFieldGridParams& grid, const Vec3& p)
+{
+	int cell[3];
+	bool outside = false;
+
+	for (int a=0; a < 3; ++a)
+	{
+		// truncation matches floor() once negative offsets are rejected, and avoids a libm call per axis,
+		// the bitwise or keeps the test branch free as particles are often randomly inside or out
+		const float t = (p[a]-grid.mLower[a])*grid.mInvCellSize;
+
+		cell[a] = int(t);
+		outside |= (t < 0.0f) | (cell[a] >= grid.mDim[a]);
+	}
+
+	if (outside)
+		return -1;
+
+	return (cell[2]*grid.mDim[1] + cell[1])*grid.mDim[0] + cell[0];
+}
+
+// velocity change due to a single field, zero outside the field's radius
+CUDA_CALLABLE inline Vec3 EvaluateForceField(const NvFlexExtForceField& forceField, const Vec3& p, float invMass, float dt)
+{
+	const Vec3 localPos = p - Vec3(forceField.mPosition[0], forceField.mPosition[1], forceField.mPosition[2]);
+
+	const float length = Length(localPos);
+	if (length >= forceField.mRadius)
+		return Vec3(0.0f);
+
+	const Vec3 fieldDir = length > 0.0f ? localPos/length : localPos;
+
+	// if using linear falloff, scale with distance
+	float fieldStrength = forceField.mStrength;
+	if (forceField.mLinearFalloff)
+		fieldStrength *= (1.0f - (length/forceField.mRadius));
+
+	float unitMultiplier = 1.0f;
+	if (forceField.mMode == eNvFlexExtModeForce)
+		unitMultiplier = dt*invMass;	// time/mass
+	else if (forceField.mMode == eNvFlexExtModeImpulse)
+		unitMultiplier = invMass;		// 1/mass
+
+	return fieldDir*fieldStrength*unitMultiplier;
+}
+
+// rebuilds the grid for a new set of fields, fields with a non-positive radius are not binned
+void BuildForceFieldGrid(ForceFieldGrid& grid, const NvFlexExtForceField* forceFields, int numForceFields);
+
+// adds the velocity change from each field overlapping the particle, positions and velocities are float4,
+// particles are split across the shared thread pool (0 = every thread, 1 = calling thread)
+void ApplyForceFields(const ForceFieldGrid& grid, const NvFlexExtForceField* forceFields, const float* positions, float* velocities, int numParticles, float dt, int numThreads);
@@ -1,6 +1,10 @@
 #include "../include/NvFlexExt.h"
 
 #include "../core/maths.h"
+#include "../core/simd.h"
+#include "../core/parallel.h"
+
+#include "flexExtMovingFrame.h"
 
 namespace 
 {
@@ -95,17 +99,44 @@ void NvFlexExtMovingFrameUpdate(NvFlexExtMovingFrame* frame, const float* worldT
 	((MovingFrame&)(*frame)).Move(Vec3(worldTranslation), Quat(worldRotation), dt);
 }
 
-void NvFlexExtMovingFrameApply(NvFlexExtMovingFrame* frame, float* positions, float* velocities, int numParticles, float linearScale, float angularScale, float dt)
+namespace
 {
-	const MovingFrame& f = (MovingFrame&)(*frame);
 
+// applies the frame to particles [begin, end), velocities are spaced velocityStride floats apart
+void ApplyMovingFrameRange(const MovingFrame& f, float* positions, float* velocities, int velocityStride, int begin, int end, float linearScale, float angularScale, float dt)
+{
 	// linear force constant for all particles
 	Vec3 linearForce = f.GetLinearForce()*linearScale;
 
-	for (int i=0; i < numParticles; ++i)
+	// process kSimdWidth particles at a time, the same steps as the scalar loop below (which handles everything in scalar builds)
+	const int simdEnd = kSimdWidth > 1 ? end - (end-begin)%kSimdWidth : begin;
+
+	const SimdVec3 framePosition = SimdSplat(f.position);
+	const SimdVec3 omega = SimdSplat(f.omega);
+	const SimdVec3 tau = SimdSplat(f.tau);
+	const SimdVec3 linear = SimdSplat(linearForce);
+
+	for (int i=begin; i < simdEnd; i += kSimdWidth)
+	{
+		SimdVec3 particlePos = SimdLoadVec3(&positions[i*4], 4);
+		SimdVec3 particleVel = SimdLoadVec3(&velocities[i*velocityStride], velocityStride);
+
+		// centrifugal and Euler forces, see MovingFrame::GetAngularForce()
+		const SimdVec3 d = SimdSub(particlePos, framePosition);
+		const SimdVec3 angularForce = SimdAdd(SimdCross(omega, SimdCross(omega, d)), SimdCross(tau, d));
+
+		particlePos = SimdTransformPoint(f.delta, particlePos);
+		particleVel = SimdAdd(particleVel, SimdMul(SimdSub(linear, SimdMul(angularForce, SimdSplat(angularScale))), SimdSplat(dt)));
+
+		// w (inverse mass) is left untouched
+		SimdStoreVec3(&positions[i*4], 4, particlePos);
+		SimdStoreVec3(&velocities[i*velocityStride], velocityStride, particleVel);
+	}
+
+	for (int i=simdEnd; i < end; ++i)
 	{
 		Vec3 particlePos = Vec3(&positions[i*4]);
-		Vec3 particleVel = Vec3(&velocities[i*3]);
+		Vec3 particleVel = Vec3(&velocities[i*velocityStride]);
 
 		// angular force depends on particles position
 		Vec3 angularForce = f.GetAngularForce(particlePos)*angularScale;
@@ -119,9 +150,32 @@ void NvFlexExtMovingFrameApply(NvFlexExtMovingFrame* frame, float* positions, fl
 		positions[i*4+1] = particlePos.y;
 		positions[i*4+2] = particlePos.z;
 
-		velocities[i*3+0] = particleVel.x;
-		velocities[i*3+1] = particleVel.y;
-		velocities[i*3+2] = particleVel.z;
-		
+		velocities[i*velocityStride+0] = particleVel.x;
+		velocities[i*velocityStride+1] = particleVel.y;
+		velocities[i*velocityStride+2] = particleVel.z;
 	}
 }
+
+} // anonymous namespace
+
+void ApplyMovingFrame(const NvFlexExtMovingFrame* frame, float* positions, float* velocities, int velocityStride, int numParticles, float linearScale, float angularScale, float dt, int numThreads)
+{
+	const MovingFrame& f = (const MovingFrame&)(*frame);
+
+	// particles are independent, chunks are large enough to amortize the dispatch and keep the SIMD tails short
+	GetDefaultThreadPool().ParallelFor(0, numParticles, [&](int begin, int end)
+	{
+		ApplyMovingFrameRange(f, positions, velocities, velocityStride, begin, end, linearScale, angularScale, dt);
+
+	}, numThreads, 16384);
+}
+
+void NvFlexExtMovingFrameApply(NvFlexExtMovingFrame* frame, float* positions, float* velocities, int numParticles, float linearScale, float angularScale, float dt)
+{
+	ApplyMovingFrame(frame, positions, velocities, 3, numParticles, linearScale, angularScale, dt, 1);
+}
+
+void NvFlexExtMovingFrameApplyThreaded(NvFlexExtMovingFrame* frame, float* positions, float* velocities, int numParticles, float linearScale, float angularScale, float dt, int numThreads)
+{
+	ApplyMovingFrame(frame, positions, velocities, 3, numParticles, linearScale, angularScale, dt, numThreads);
+}
@@ -26,27 +26,35 @@
 // Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
 
 #include "../include/NvFlexExt.h"
+#include "flexExtCache.h"
 
 #include "../core/maths.h"
 #include "../core/voxelize.h"
 #include "../core/sdf.h"
+#include "../core/simd.h"
 
 #include <vector>
+#include <climits>
 
 namespace
 {
 
-float SampleSDF(const float* sdf, int dim, int x, int y, int z)
+float SampleSDF(const VoxelBricks& bricks, const float* sdf, int dim, int x, int y, int z)
 {
 	assert(x < dim && x >= 0);
 	assert(y < dim && y >= 0);
 	assert(z < dim && z >= 0);
 
-	return sdf[z*dim*dim + y*dim + x];
+	const int brick = bricks.FindBrick(x/VoxelBricks::kBrickDim, y/VoxelBricks::kBrickDim, z/VoxelBricks::kBrickDim);
+	assert(brick >= 0);
+
+	const int local = ((z%VoxelBricks::kBrickDim)*VoxelBricks::kBrickDim + (y%VoxelBricks::kBrickDim))*VoxelBricks::kBrickDim + (x%VoxelBricks::kBrickDim);
+
+	return sdf[brick*VoxelBricks::kBrickVoxels + local];
 }
 
-// return normal of signed distance field
-Vec3 SampleSDFGrad(const float* sdf, int dim, int x, int y, int z)
+// return normal of signed distance field, only valid for occupied voxels whose neighbors are always allocated
+Vec3 SampleSDFGrad(const VoxelBricks& bricks, const float* sdf, int dim, int x, int y, int z)
 {
 	int x0 = std::max(x-1, 0);
 	int x1 = std::min(x+1, dim-1);
@@ -57,16 +65,19 @@ Vec3 SampleSDFGrad(const float* sdf, int dim, int x, int y, int z)
 	int z0 = std::max(z-1, 0);
 	int z1 = std::min(z+1, dim-1);
 
-	float dx = (SampleSDF(sdf, dim, x1, y, z) - SampleSDF(sdf, dim, x0, y, z))*(dim*0.5f);
-	float dy = (SampleSDF(sdf, dim, x, y1, z) - SampleSDF(sdf, dim, x, y0, z))*(dim*0.5f);
-	float dz = (SampleSDF(sdf, dim, x, y, z1) - SampleSDF(sdf, dim, x, y, z0))*(dim*0.5f);
+	float dx = (SampleSDF(bricks, sdf, dim, x1, y, z) - SampleSDF(bricks, sdf, dim, x0, y, z))*(dim*0.5f);
+	float dy = (SampleSDF(bricks, sdf, dim, x, y1, z) - SampleSDF(bricks, sdf, dim, x, y0, z))*(dim*0.5f);
+	float dz = (SampleSDF(bricks, sdf, dim, x, y, z1) - SampleSDF(bricks, sdf, dim, x, y, z0))*(dim*0.5f);
 
 	return Vec3(dx, dy, dz);
 }
 
 } // anonymous namespace
 
-NvFlexExtAsset* NvFlexExtCreateRigidFromMesh(const float* vertices, int numVertices, const int* indices, int numTriangleIndices, float spacing, float expand)
+namespace
+{
+
+NvFlexExtAsset* CookRigidFromMesh(const float* vertices, int numVertices, const int* indices, int numTriangleIndices, float spacing, float expand)
 {
 	// Switch to relative coordinates by computing the mean position of the vertices and subtracting the result from every vertex position
 	// The increased precision will prevent ghost forces caused by inaccurate center of mass computations
@@ -89,12 +100,8 @@ NvFlexExtAsset* NvFlexExtCreateRigidFromMesh(const float* vertices, int numVerti
 
 	const Vec3* positions = relativeVertices;
 
-	Vec3 meshLower(FLT_MAX), meshUpper(-FLT_MAX);
-	for (int i=0; i < numVertices; ++i)
-	{
-		meshLower = Min(meshLower, positions[i]);
-		meshUpper = Max(meshUpper, positions[i]);
-	}
+	Vec3 meshLower, meshUpper;
+	SimdBounds(positions, numVertices, meshLower, meshUpper);
 
 	Vec3 edges = meshUpper-meshLower;
 	float maxEdge = std::max(std::max(edges.x, edges.y), edges.z);
@@ -126,50 +133,70 @@ NvFlexExtAsset* NvFlexExtCreateRigidFromMesh(const float* vertices, int numVerti
 	meshShift.z = 0.5f * (spacing - (edges.z - (dz-1)*spacing));
 	meshLower -= meshShift;
 
-	// don't allow samplings with > 64 per-side	
-	if (maxDim > 64)
+	// don't allow samplings with > 1024 per-side, beyond this the brick table alone is several megabytes,
+	// the grid can still hold more particles than an asset can index, these are rejected once the particles are known
+	if (maxDim > 1024)
+	{
+		delete[] relativeVertices;
 		return NULL;
+	}
 
-	std::vector<uint32_t> voxels(maxDim*maxDim*maxDim);
-
-	Voxelize(relativeVertices, numVertices, indices, numTriangleIndices, maxDim, maxDim, maxDim, &voxels[0], meshLower, meshLower + Vec3(maxDim*spacing));
+	// sparse voxels and distance field, memory is proportional to the bricks the mesh occupies rather than maxDim^3
+	VoxelBricks voxels;
+	VoxelizeBricks(relativeVertices, numVertices, indices, numTriangleIndices, maxDim, maxDim, maxDim, voxels, meshLower, meshLower + Vec3(maxDim*spacing));
 
 	delete[] relativeVertices;
 
-	std::vector<float> sdf(maxDim*maxDim*maxDim);
-	MakeSDF(&voxels[0], maxDim, maxDim, maxDim, &sdf[0]);
+	std::vector<float> sdf(voxels.GetNumBricks()*VoxelBricks::kBrickVoxels);
+
+	if (sdf.size())
+		MakeSDFBricks(voxels, &sdf[0]);
 
 	Vec3 center;
 
+	const int kBrickDim = VoxelBricks::kBrickDim;
+
+	// visit voxels in x, y, z order, skipping unallocated bricks along each column
 	for (int x=0; x < maxDim; ++x)
 	{
 		for (int y=0; y < maxDim; ++y)
 		{
-			for (int z=0; z < maxDim; ++z)
+			for (int bz=0; bz < int(voxels.bricksZ); ++bz)
 			{
-				const int index = z*maxDim*maxDim + y*maxDim + x;
+				if (voxels.FindBrick(x/kBrickDim, y/kBrickDim, bz) < 0)
+					continue;
+
+				const int zEnd = std::min((bz+1)*kBrickDim, maxDim);
 
-				// if voxel is marked as occupied the add a particle
-				if (voxels[index])
+				for (int z=bz*kBrickDim; z < zEnd; ++z)
 				{
-					Vec3 position = meshLower + spacing*Vec3(float(x) + 0.5f, float(y) + 0.5f, float(z) + 0.5f);
+					// if voxel is marked as occupied the add a particle
+					if (voxels.GetVoxel(x, y, z))
+					{
+						Vec3 position = meshLower + spacing*Vec3(float(x) + 0.5f, float(y) + 0.5f, float(z) + 0.5f);
 
-					// normalize the sdf value and transform to world scale
-					Vec3 n = SafeNormalize(SampleSDFGrad(&sdf[0], maxDim, x, y, z));
-					float d = sdf[index]*maxEdge;
+						// normalize the sdf value and transform to world scale
+						Vec3 n = SafeNormalize(SampleSDFGrad(voxels, &sdf[0], maxDim, x, y, z));
+						float d = SampleSDF(voxels, &sdf[0], maxDim, x, y, z)*maxEdge;
 
-					// move particles inside or outside shape
-					position += n*expand;
+						// move particles inside or outside shape
+						position += n*expand;
 
-					normals.push_back(Vec4(n, d));
-					particles.push_back(Vec4(position.x, position.y, position.z, 1.0f));						
-					phases.push_back(0);
+						normals.push_back(Vec4(n, d));
+						particles.push_back(Vec4(position.x, position.y, position.z, 1.0f));						
+						phases.push_back(0);
 
-					center += position;
+						center += position;
+					}
 				}
 			}
 		}
 	}
+
+	// asset counts are int and the particle array holds numParticles*4 floats, reject samplings that would overflow either
+	if (particles.size() > size_t(INT_MAX/4))
+		return NULL;
+
 	const int numParticles = int(particles.size());
 
 	// Switch back to absolute coordinates by adding meshOffset to the center of mass and to each particle positions
@@ -188,7 +215,7 @@ NvFlexExtAsset* NvFlexExtCreateRigidFromMesh(const float* vertices, int numVerti
 		asset->numParticles = numParticles;
 		asset->maxParticles = numParticles;
 
-		asset->particles = new float[numParticles*4];
+		asset->particles = new float[size_t(numParticles)*4];
 		memcpy(asset->particles, &particles[0], sizeof(Vec4)*numParticles);
 
 		asset->numShapes = 1;
@@ -218,3 +245,27 @@ NvFlexExtAsset* NvFlexExtCreateRigidFromMesh(const float* vertices, int numVerti
 
 	return asset;
 }
+
+} // anonymous namespace
+
+NvFlexExtAsset* NvFlexExtCreateRigidFromMesh(const float* vertices, int numVertices, const int* indices, int numTriangleIndices, float spacing, float expand)
+{
+	if (!IsAssetCacheEnabled())
+		return CookRigidFromMesh(vertices, numVertices, indices, numTriangleIndices, spacing, expand);
+
+	AssetCacheKey key(eAssetCacheRigid);
+	key.Add(vertices, sizeof(float)*3*numVertices);
+	key.Add(indices, sizeof(int)*numTriangleIndices);
+	key.Add(spacing);
+	key.Add(expand);
+
+	NvFlexExtAsset* asset = LoadCachedAsset(key);
+
+	if (!asset)
+	{
+		asset = CookRigidFromMesh(vertices, numVertices, indices, numTriangleIndices, spacing, expand);
+		StoreCachedAsset(key, asset);
+	}
+
+	return asset;
+}
@@ -26,10 +26,13 @@
 // Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
 
 #include "../include/NvFlexExt.h"
+#include "flexExtCache.h"
 
 #include "../core/core.h"
 #include "../core/maths.h"
 #include "../core/voxelize.h"
+#include "../core/parallel.h"
+#include "../core/simd.h"
 
 #include <vector>
 #include <algorithm>
@@ -43,29 +46,12 @@ namespace
 
 Vec3 CalculateMean(const Vec3* particles, const int* indices, int numIndices)
 {
-	Vec3 sum;
-
-	for (int i = 0; i < numIndices; ++i)
-		sum += Vec3(particles[indices[i]]);
-
-	if (numIndices)
-		return sum / float(numIndices);
-	else
-		return sum;
+	return SimdMean(particles, indices, numIndices);
 }
 
 float CalculateRadius(const Vec3* particles, Vec3 center, const int* indices, int numIndices)
 {
-	float radiusSq = 0.0f;
-
-	for (int i = 0; i < numIndices; ++i)
-	{
-		float dSq = LengthSq(Vec3(particles[indices[i]]) - center);
-		if (dSq > radiusSq)
-			radiusSq = dSq;
-	}
-
-	return sqrtf(radiusSq);
+	return SimdRadius(particles, center, indices, numIndices);
 }
 
 struct Cluster
@@ -99,7 +85,8 @@ struct SweepAndPrune
 		int index;
 	};
 
-	SweepAndPrune(const Vec3* points, int n)
+	// radius is the expected query radius, unused by this structure
+	SweepAndPrune(const Vec3* points, int n, float radius)
 	{
 		entries.reserve(n);		
 		for (int i=0; i < n; ++i)
@@ -118,12 +105,8 @@ struct SweepAndPrune
 		};
 
 		// calculate particle bounds and longest axis
-		Vec3 lower(FLT_MAX), upper(-FLT_MAX);
-		for (int i=0; i < n; ++i)
-		{
-			lower = Min(points[i], lower);
-			upper = Max(points[i], upper);
-		}
+		Vec3 lower, upper;
+		SimdBounds(points, n, lower, upper);
 
 		Vec3 edges = upper-lower;
 		
@@ -137,7 +120,7 @@ struct SweepAndPrune
 		std::sort(entries.begin(), entries.end(), SortOnAxis(longestAxis));
 	}
 
-	void QuerySphere(Vec3 center, float radius, std::vector<int>& indices)
+	void QuerySphere(Vec3 center, float radius, std::vector<int>& indices) const
 	{
 		// find start point in the array
 		int low = 0;
@@ -176,13 +159,178 @@ struct SweepAndPrune
 			}
 		}
 	}
+
+	// batched queries with the same radius, the neighbors of query i are outIndices[outStarts[i]..outStarts[i]+outCounts[i])
+	void QuerySpheres(const Vec3* centers, int numCenters, float radius, std::vector<int>& outStarts, std::vector<int>& outCounts, std::vector<int>& outIndices) const
+	{
+		outStarts.resize(numCenters);
+		outCounts.resize(numCenters);
+
+		for (int i=0; i < numCenters; ++i)
+		{
+			outStarts[i] = int(outIndices.size());
+			QuerySphere(centers[i], radius, outIndices);
+			outCounts[i] = int(outIndices.size()) - outStarts[i];
+		}
+	}
 	
 	int longestAxis;	// [0,2] -> x,y,z
 
 	std::vector<Entry> entries;
 };
 
-int CreateClusters(Vec3* particles, const float* priority, int numParticles, std::vector<int>& outClusterOffsets, std::vector<int>& outClusterIndices, std::vector<Vec3>& outClusterPositions, float radius, float smoothing = 0.0f)
+// uniform grid acceleration structure for point cloud queries, cells are hashed into a table 
+// proportional to the number of points so memory does not depend on the extents of the point set
+struct HashGrid
+{
+	struct Entry
+	{
+		Vec3 point;
+		int index;
+		int cell[3];
+	};
+
+	// radius is the expected query radius and is used as the cell size
+	HashGrid(const Vec3* points, int n, float radius)
+	{
+		Vec3 upper;
+		SimdBounds(points, n, lower, upper);
+
+		// guard against degenerate radii producing an excessive number of cells
+		const Vec3 edges = upper-lower;
+		const float maxEdge = n ? Max(Max(edges.x, edges.y), edges.z) : 0.0f;
+
+		cellSize = Max(Max(radius, maxEdge*1.e-5f), FLT_MIN);
+		invCellSize = 1.0f/cellSize;
+
+		// power of two table with at least twice as many buckets as points
+		tableMask = 1;
+		while (tableMask < 2*n)
+			tableMask *= 2;
+
+		tableMask -= 1;
+
+		// counting sort points into buckets
+		std::vector<Entry> unsorted(n);
+		bucketStarts.assign(tableMask+2, 0);
+
+		for (int i=0; i < n; ++i)
+		{
+			Entry& e = unsorted[i];
+			e.point = points[i];
+			e.index = i;
+			GetCell(points[i], e.cell);
+
+			++bucketStarts[Hash(e.cell[0], e.cell[1], e.cell[2]) + 1];
+		}
+
+		for (int b=0; b <= tableMask; ++b)
+			bucketStarts[b+1] += bucketStarts[b];
+
+		std::vector<int> offsets(bucketStarts.begin(), bucketStarts.end()-1);
+		entries.resize(n);
+
+		for (int i=0; i < n; ++i)
+		{
+			const Entry& e = unsorted[i];
+			entries[offsets[Hash(e.cell[0], e.cell[1], e.cell[2])]++] = e;
+		}
+	}
+
+	inline void GetCell(Vec3 p, int* cell) const
+	{
+		cell[0] = int(floorf((p.x-lower.x)*invCellSize));
+		cell[1] = int(floorf((p.y-lower.y)*invCellSize));
+		cell[2] = int(floorf((p.z-lower.z)*invCellSize));
+	}
+
+	inline int Hash(int x, int y, int z) const
+	{
+		return int((uint32_t(x)*73856093U ^ uint32_t(y)*19349663U ^ uint32_t(z)*83492791U) & uint32_t(tableMask));
+	}
+
+	void QuerySphere(Vec3 center, float radius, std::vector<int>& indices) const
+	{
+		int cellLower[3];
+		int cellUpper[3];
+
+		GetCell(center-Vec3(radius), cellLower);
+		GetCell(center+Vec3(radius), cellUpper);
+
+		const float radiusSq = radius*radius;
+
+		for (int z=cellLower[2]; z <= cellUpper[2]; ++z)
+		{
+			for (int y=cellLower[1]; y <= cellUpper[1]; ++y)
+			{
+				for (int x=cellLower[0]; x <= cellUpper[0]; ++x)
+				{
+					const int bucket = Hash(x, y, z);
+
+					for (int i=bucketStarts[bucket]; i < bucketStarts[bucket+1]; ++i)
+					{
+						const Entry& e = entries[i];
+
+						// skip points from other cells that hash to the same bucket
+						if (e.cell[0] != x || e.cell[1] != y || e.cell[2] != z)
+							continue;
+
+						if (LengthSq(e.point-center) < radiusSq)
+							indices.push_back(e.index);
+					}
+				}
+			}
+		}
+	}
+
+	// batched queries with the same radius, the neighbors of query i are outIndices[outStarts[i]..outStarts[i]+outCounts[i]), 
+	// queries are processed in bucket order so that consecutive queries touch the same cells
+	void QuerySpheres(const Vec3* centers, int numCenters, float radius, std::vector<int>& outStarts, std::vector<int>& outCounts, std::vector<int>& outIndices) const
+	{
+		outStarts.resize(numCenters);
+		outCounts.resize(numCenters);
+
+		// counting sort queries on the bucket of their center
+		std::vector<int> queryBuckets(numCenters);
+		std::vector<int> queryStarts(tableMask+2, 0);
+
+		for (int i=0; i < numCenters; ++i)
+		{
+			int cell[3];
+			GetCell(centers[i], cell);
+
+			queryBuckets[i] = Hash(cell[0], cell[1], cell[2]);
+			++queryStarts[queryBuckets[i] + 1];
+		}
+
+		for (int b=0; b <= tableMask; ++b)
+			queryStarts[b+1] += queryStarts[b];
+
+		std::vector<int> order(numCenters);
+		for (int i=0; i < numCenters; ++i)
+			order[queryStarts[queryBuckets[i]]++] = i;
+
+		for (int i=0; i < numCenters; ++i)
+		{
+			const int q = order[i];
+
+			outStarts[q] = int(outIndices.size());
+			QuerySphere(centers[q], radius, outIndices);
+			outCounts[q] = int(outIndices.size()) - outStarts[q];
+		}
+	}
+
+	Vec3 lower;
+	float cellSize;
+	float invCellSize;
+	int tableMask;
+
+	std::vector<int> bucketStarts;
+	std::vector<Entry> entries;
+};
+
+template <typename NeighborQuery>
+int CreateClusters(Vec3* particles, const float* priority, int numParticles, std::vector<int>& outClusterOffsets, std::vector<int>& outClusterIndices, std::vector<Vec3>& outClusterPositions, float radius, float smoothing = 0.0f, int numThreads = 1)
 {
 	std::vector<Seed> seeds;
 	std::vector<Cluster> clusters;
@@ -203,7 +351,7 @@ int CreateClusters(Vec3* particles, const float* priority, int numParticles, std
 	// sort seeds on priority
 	std::stable_sort(seeds.begin(), seeds.end());
 
-	SweepAndPrune sap(particles, numParticles);
+	NeighborQuery sap(particles, numParticles, radius);
 
 	while (seeds.size())
 	{
@@ -216,6 +364,9 @@ int CreateClusters(Vec3* particles, const float* priority, int numParticles, std
 			Cluster c;
 
 			sap.QuerySphere(Vec3(particles[seed.index]), radius, c.indices);
+
+			// neighbor order depends on the query structure, sort so the cluster means are the same for all structures
+			std::sort(c.indices.begin(), c.indices.end());
 			
 			// mark overlapping particles as used so they are removed from the list of potential cluster seeds
 			for (int i=0; i < int(c.indices.size()); ++i)
@@ -229,18 +380,23 @@ int CreateClusters(Vec3* particles, const float* priority, int numParticles, std
 
 	if (smoothing > 0.0f)
 	{
-		for (int i = 0; i < int(clusters.size()); ++i)
+		// clusters are independent once seeded, each only writes to its own indices and mean
+		GetDefaultThreadPool().ParallelFor(0, int(clusters.size()), [&](int begin, int end)
 		{
-			Cluster& c = clusters[i];
+			for (int i = begin; i < end; ++i)
+			{
+				Cluster& c = clusters[i];
 
-			// clear cluster indices
-			c.indices.resize(0);
+				// clear cluster indices
+				c.indices.resize(0);
 
-			// calculate cluster particles using cluster mean and smoothing radius
-			sap.QuerySphere(c.mean, smoothing, c.indices);
+				// calculate cluster particles using cluster mean and smoothing radius
+				sap.QuerySphere(c.mean, smoothing, c.indices);
+				std::sort(c.indices.begin(), c.indices.end());
 
-			c.mean = CalculateMean(particles, &c.indices[0], int(c.indices.size()));
-		}
+				c.mean = CalculateMean(particles, &c.indices[0], int(c.indices.size()));
+			}
+		}, numThreads, 16);
 	}
 
 	// write out cluster indices
@@ -272,23 +428,61 @@ int CreateClusters(Vec3* particles, const float* priority, int numParticles, std
 	return count;
 }
 
+int CreateClusters(Vec3* particles, const float* priority, int numParticles, std::vector<int>& outClusterOffsets, std::vector<int>& outClusterIndices, std::vector<Vec3>& outClusterPositions, float radius, float smoothing, NvFlexExtNeighborQuery query, int numThreads)
+{
+	if (query == eNvFlexExtNeighborQueryHashGrid)
+		return CreateClusters<HashGrid>(particles, priority, numParticles, outClusterOffsets, outClusterIndices, outClusterPositions, radius, smoothing, numThreads);
+	else
+		return CreateClusters<SweepAndPrune>(particles, priority, numParticles, outClusterOffsets, outClusterIndices, outClusterPositions, radius, smoothing, numThreads);
+}
+
 // creates distance constraints between particles within some radius
-int CreateLinks(const Vec3* particles, int numParticles, std::vector<int>& outSpringIndices, std::vector<float>& outSpringLengths, std::vector<float>& outSpringStiffness, float radius, float stiffness = 1.0f)
+template <typename NeighborQuery>
+int CreateLinks(const Vec3* particles, int numParticles, std::vector<int>& outSpringIndices, std::vector<float>& outSpringLengths, std::vector<float>& outSpringStiffness, float radius, float stiffness = 1.0f, int numThreads = 1)
 {
 	int count = 0;
 
-	std::vector<int> neighbors;
-	SweepAndPrune sap(particles, numParticles);
+	NeighborQuery sap(particles, numParticles, radius);
 
-	for (int i = 0; i < numParticles; ++i)
+	// particles are queried in fixed size blocks, each block writes to its own neighbor lists
+	// so the result does not depend on how blocks are distributed between threads
+	const int blockSize = 256;
+	const int numBlocks = (numParticles + blockSize - 1)/blockSize;
+
+	struct Block
+	{
+		std::vector<int> neighborStarts;
+		std::vector<int> neighborCounts;
+		std::vector<int> neighbors;
+	};
+
+	std::vector<Block> blocks(numBlocks);
+
+	GetDefaultThreadPool().ParallelFor(0, numBlocks, [&](int blockBegin, int blockEnd)
 	{
-		neighbors.resize(0);
+		for (int b = blockBegin; b < blockEnd; ++b)
+		{
+			Block& block = blocks[b];
+
+			const int begin = b*blockSize;
+			const int end = Min(begin + blockSize, numParticles);
+
+			sap.QuerySpheres(particles + begin, end - begin, radius, block.neighborStarts, block.neighborCounts, block.neighbors);
 
-		sap.QuerySphere(Vec3(particles[i]), radius, neighbors);
+			// output links in index order independent of the query structure
+			for (int i = 0; i < end - begin; ++i)
+				std::sort(block.neighbors.begin() + block.neighborStarts[i], block.neighbors.begin() + block.neighborStarts[i] + block.neighborCounts[i]);
+		}
+	}, numThreads);
 
-		for (int j = 0; j < int(neighbors.size()); ++j)
+	for (int i = 0; i < numParticles; ++i)
+	{
+		const Block& block = blocks[i/blockSize];
+		const int q = i%blockSize;
+
+		for (int j = block.neighborStarts[q]; j < block.neighborStarts[q] + block.neighborCounts[q]; ++j)
 		{
-			const int nj = neighbors[j];
+			const int nj = block.neighbors[j];
 
 			if (nj != i)
 			{
@@ -305,102 +499,103 @@ int CreateLinks(const Vec3* particles, int numParticles, std::vector<int>& outSp
 	return count;
 }
 
-void CreateSkinning(const Vec3* vertices, int numVertices, const Vec3* clusters, int numClusters, float* outWeights, int* outIndices, float falloff, float maxdist)
+int CreateLinks(const Vec3* particles, int numParticles, std::vector<int>& outSpringIndices, std::vector<float>& outSpringLengths, std::vector<float>& outSpringStiffness, float radius, float stiffness, NvFlexExtNeighborQuery query, int numThreads)
 {
-	const int maxBones = 4;
+	if (query == eNvFlexExtNeighborQueryHashGrid)
+		return CreateLinks<HashGrid>(particles, numParticles, outSpringIndices, outSpringLengths, outSpringStiffness, radius, stiffness, numThreads);
+	else
+		return CreateLinks<SweepAndPrune>(particles, numParticles, outSpringIndices, outSpringLengths, outSpringStiffness, radius, stiffness, numThreads);
+}
 
-	SweepAndPrune sap(clusters, numClusters);
+void CreateSkinning(const Vec3* vertices, int numVertices, const Vec3* clusters, int numClusters, float* outWeights, int* outIndices, float falloff, float maxdist, int numThreads = 1)
+{
+	const int maxBones = 4;
 
-	std::vector<int> influences;
+	SweepAndPrune sap(clusters, numClusters, maxdist);
 
-	// for each vertex, find the closest n clusters
-	for (int i = 0; i < numVertices; ++i)
+	// vertices are independent, each writes only its own weights and indices
+	GetDefaultThreadPool().ParallelFor(0, numVertices, [&](int begin, int end)
 	{
-		int indices[4] = { -1, -1, -1, -1 };
-		float distances[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
-		float weights[maxBones];
+		std::vector<int> influences;
 
-		influences.resize(0);
-		sap.QuerySphere(vertices[i], maxdist, influences);
+		// squared distances to each vertex's bones, weighted as a batch once the chunk's bones are known
+		std::vector<float> chunkDistances((end - begin)*maxBones);
 
-		for (int c = 0; c < int(influences.size()); ++c)			
+		// for each vertex, find the closest n clusters
+		for (int i = begin; i < end; ++i)
 		{
-			float dSq = LengthSq(vertices[i] - clusters[influences[c]]);
+			int indices[4] = { -1, -1, -1, -1 };
+			float distances[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
 
-			// insertion sort
-			int w = 0;
-			for (; w < maxBones; ++w)
-				if (dSq < distances[w])
-					break;
+			influences.resize(0);
+			sap.QuerySphere(vertices[i], maxdist, influences);
 
-			if (w < maxBones)
+			for (int c = 0; c < int(influences.size()); ++c)			
 			{
-				// shuffle down
-				for (int s = maxBones - 1; s > w; --s)
+				float dSq = LengthSq(vertices[i] - clusters[influences[c]]);
+
+				// insertion sort
+				int w = 0;
+				for (; w < maxBones; ++w)
+					if (dSq < distances[w])
+						break;
+
+				if (w < maxBones)
 				{
-					indices[s] = indices[s - 1];
-					distances[s] = distances[s - 1];
+					// shuffle down
+					for (int s = maxBones - 1; s > w; --s)
+					{
+						indices[s] = indices[s - 1];
+						distances[s] = distances[s - 1];
+					}
+
+					distances[w] = dSq;
+					indices[w] = influences[c];
 				}
+			}
 
-				distances[w] = dSq;
-				indices[w] = influences[c];
+			for (int j = 0; j < maxBones; ++j)
+			{
+				chunkDistances[(i - begin)*maxBones + j] = distances[j];
+				outIndices[i*maxBones + j] = indices[j];
 			}
 		}
 
-		// weight particles according to distance
-		float wSum = 0.0f;
+		// weight falls off inversely with distance, bones over a given distance are clamped to zero
+		SimdInverseDistanceWeights(&chunkDistances[0], int(chunkDistances.size()), falloff, Sqr(maxdist), &outWeights[begin*maxBones]);
 
-		for (int w = 0; w < maxBones; ++w)
+		for (int i = begin; i < end; ++i)
 		{
-			if (distances[w] > Sqr(maxdist))
-			{
-				// clamp bones over a given distance to zero
-				weights[w] = 0.0f;
-			}
-			else
-			{
-				// weight falls off inversely with distance
-				weights[w] = 1.0f / (powf(distances[w], falloff) + 0.0001f);
-			}
+			float* weights = &outWeights[i*maxBones];
 
-			wSum += weights[w];
-		}
+			float wSum = 0.0f;
 
-		if (wSum == 0.0f)
-		{
-			// if all weights are zero then just 
-			// rigidly skin to the closest bone
-			weights[0] = 1.0f;
-		}
-		else
-		{
-			// normalize weights
 			for (int w = 0; w < maxBones; ++w)
+				wSum += weights[w];
+
+			if (wSum == 0.0f)
 			{
-				weights[w] = weights[w] / wSum;
+				// if all weights are zero then just 
+				// rigidly skin to the closest bone
+				weights[0] = 1.0f;
+			}
+			else
+			{
+				// normalize weights
+				for (int w = 0; w < maxBones; ++w)
+				{
+					weights[w] = weights[w] / wSum;
+				}
 			}
 		}
-
-		// output
-		for (int j = 0; j < maxBones; ++j)
-		{
-			outWeights[i*maxBones + j] = weights[j];
-			outIndices[i*maxBones + j] = indices[j];
-		}
-	}
+	}, numThreads, 256);
 }
 
 // creates mesh interior and surface sample points and clusters them into particles
-void SampleMesh(const Vec3* vertices, int numVertices, const int* indices, int numIndices, float radius, float volumeSampling, float surfaceSampling, std::vector<Vec3>& outPositions)
+void SampleMesh(const Vec3* vertices, int numVertices, const int* indices, int numIndices, float radius, float volumeSampling, float surfaceSampling, NvFlexExtNeighborQuery query, int numThreads, std::vector<Vec3>& outPositions)
 {
-	Vec3 meshLower(FLT_MAX);
-	Vec3 meshUpper(-FLT_MAX);
-
-	for (int i = 0; i < numVertices; ++i)
-	{
-		meshLower = Min(meshLower, vertices[i]);
-		meshUpper = Max(meshUpper, vertices[i]);
-	}
+	Vec3 meshLower, meshUpper;
+	SimdBounds(vertices, numVertices, meshLower, meshUpper);
 
 	std::vector<Vec3> samples;
 
@@ -429,7 +624,7 @@ void SampleMesh(const Vec3* vertices, int numVertices, const int* indices, int n
 		meshUpper += 2.0f*Vec3(spacing);
 		maxDim += 4;
 
-		vector<uint32_t> voxels(maxDim*maxDim*maxDim);
+		vector<uint32_t> voxels(GetVoxelWordCount(maxDim, maxDim, maxDim));
 
 		// we shift the voxelization bounds so that the voxel centers
 		// lie symmetrically to the center of the object. this reduces the 
@@ -441,7 +636,7 @@ void SampleMesh(const Vec3* vertices, int numVertices, const int* indices, int n
 		meshOffset.z = 0.5f * (spacing - (edges.z - (dz - 1)*spacing));
 		meshLower -= meshOffset;
 
-		Voxelize(vertices, numVertices, indices, numIndices, maxDim, maxDim, maxDim, &voxels[0], meshLower, meshLower + Vec3(maxDim*spacing));
+		VoxelizeBits(vertices, numVertices, indices, numIndices, maxDim, maxDim, maxDim, &voxels[0], meshLower, meshLower + Vec3(maxDim*spacing), numThreads);
 
 		// sample interior
 		for (int x = 0; x < maxDim; ++x)
@@ -450,10 +645,8 @@ void SampleMesh(const Vec3* vertices, int numVertices, const int* indices, int n
 			{
 				for (int z = 0; z < maxDim; ++z)
 				{
-					const int index = z*maxDim*maxDim + y*maxDim + x;
-
 					// if voxel is marked as occupied the add a particle
-					if (voxels[index])
+					if (GetVoxel(&voxels[0], maxDim, maxDim, x, y, z))
 					{
 						Vec3 position = meshLower + spacing*Vec3(float(x) + 0.5f, float(y) + 0.5f, float(z) + 0.5f);
 
@@ -500,15 +693,37 @@ void SampleMesh(const Vec3* vertices, int numVertices, const int* indices, int n
 	std::vector<float> priority(samples.size());
 
 	// cluster mesh sample points into actual particles
-	CreateClusters(&samples[0], &priority[0], int(samples.size()), clusterOffsets, clusterIndices, outPositions, radius);
+	CreateClusters(&samples[0], &priority[0], int(samples.size()), clusterOffsets, clusterIndices, outPositions, radius, 0.0f, query, numThreads);
 }
 
 } // anonymous namespace
 
 // API methods
 
+void NvFlexExtSetSoftCookDescDefaults(NvFlexExtSoftCookDesc* desc)
+{
+	desc->samplingQuery = eNvFlexExtNeighborQueryHashGrid;
+	desc->clusterQuery = eNvFlexExtNeighborQueryHashGrid;
+	desc->linkQuery = eNvFlexExtNeighborQueryHashGrid;
+	desc->numThreads = 0;
+}
+
 NvFlexExtAsset* NvFlexExtCreateSoftFromMesh(const float* vertices, int numVertices, const int* indices, int numIndices, float particleSpacing, float volumeSampling, float surfaceSampling, float clusterSpacing, float clusterRadius, float clusterStiffness, float linkRadius, float linkStiffness, float globalStiffness, float clusterPlasticThreshold, float clusterPlasticCreep)
 {
+	return NvFlexExtCreateSoftFromMeshWithDesc(vertices, numVertices, indices, numIndices, particleSpacing, volumeSampling, surfaceSampling, clusterSpacing, clusterRadius, clusterStiffness, linkRadius, linkStiffness, globalStiffness, clusterPlasticThreshold, clusterPlasticCreep, NULL);
+}
+
+namespace
+{
+
+NvFlexExtAsset* CookSoftFromMesh(const float* vertices, int numVertices, const int* indices, int numIndices, float particleSpacing, float volumeSampling, float surfaceSampling, float clusterSpacing, float clusterRadius, float clusterStiffness, float linkRadius, float linkStiffness, float globalStiffness, float clusterPlasticThreshold, float clusterPlasticCreep, const NvFlexExtSoftCookDesc* cookDesc)
+{
+	NvFlexExtSoftCookDesc desc;
+	NvFlexExtSetSoftCookDescDefaults(&desc);
+
+	if (cookDesc)
+		desc = *cookDesc;
+
 	// Switch to relative coordinates by computing the mean position of the vertices and subtracting the result from every vertex position
 	// The increased precision will prevent ghost forces caused by inaccurate center of mass computations
 	Vec3 meshOffset(0.0f);
@@ -529,7 +744,7 @@ NvFlexExtAsset* NvFlexExtCreateSoftFromMesh(const float* vertices, int numVertic
 
 	// create particle sampling
 	std::vector<Vec3> samples;
-	SampleMesh(relativeVertices, numVertices, indices, numIndices, particleSpacing, volumeSampling, surfaceSampling, samples);
+	SampleMesh(relativeVertices, numVertices, indices, numIndices, particleSpacing, volumeSampling, surfaceSampling, desc.samplingQuery, desc.numThreads, samples);
 
 	delete[] relativeVertices;
 
@@ -548,7 +763,7 @@ NvFlexExtAsset* NvFlexExtCreateSoftFromMesh(const float* vertices, int numVertic
 		priority[i] = 0.0f;
 
 	// cluster particles into shape matching groups
-	int numClusters = CreateClusters(&samples[0], &priority[0], int(samples.size()), clusterOffsets, clusterIndices, clusterPositions, clusterSpacing, clusterRadius);
+	int numClusters = CreateClusters(&samples[0], &priority[0], int(samples.size()), clusterOffsets, clusterIndices, clusterPositions, clusterSpacing, clusterRadius, desc.clusterQuery, desc.numThreads);
 	
 	// assign all clusters the same stiffness 
 	clusterCoefficients.resize(numClusters, clusterStiffness);
@@ -570,7 +785,7 @@ NvFlexExtAsset* NvFlexExtCreateSoftFromMesh(const float* vertices, int numVertic
 		std::vector<float> springStiffness;
 
 		// create links between particles
-		int numLinks = CreateLinks(&samples[0], int(samples.size()), springIndices, springLengths, springStiffness, linkRadius, linkStiffness);
+		int numLinks = CreateLinks(&samples[0], int(samples.size()), springIndices, springLengths, springStiffness, linkRadius, linkStiffness, desc.linkQuery, desc.numThreads);
 
 		// assign links
 		if (numLinks)
@@ -671,7 +886,43 @@ NvFlexExtAsset* NvFlexExtCreateSoftFromMesh(const float* vertices, int numVertic
 	return asset;
 }
 
+} // anonymous namespace
+
+NvFlexExtAsset* NvFlexExtCreateSoftFromMeshWithDesc(const float* vertices, int numVertices, const int* indices, int numIndices, float particleSpacing, float volumeSampling, float surfaceSampling, float clusterSpacing, float clusterRadius, float clusterStiffness, float linkRadius, float linkStiffness, float globalStiffness, float clusterPlasticThreshold, float clusterPlasticCreep, const NvFlexExtSoftCookDesc* cookDesc)
+{
+	if (!IsAssetCacheEnabled())
+		return CookSoftFromMesh(vertices, numVertices, indices, numIndices, particleSpacing, volumeSampling, surfaceSampling, clusterSpacing, clusterRadius, clusterStiffness, linkRadius, linkStiffness, globalStiffness, clusterPlasticThreshold, clusterPlasticCreep, cookDesc);
+
+	// the cook descriptor only selects how the asset is computed, not the result, so it is not part of the key
+	AssetCacheKey key(eAssetCacheSoft);
+	key.Add(vertices, sizeof(float)*3*numVertices);
+	key.Add(indices, sizeof(int)*numIndices);
+	key.Add(particleSpacing);
+	key.Add(volumeSampling);
+	key.Add(surfaceSampling);
+	key.Add(clusterSpacing);
+	key.Add(clusterRadius);
+	key.Add(clusterStiffness);
+	key.Add(linkRadius);
+	key.Add(linkStiffness);
+	key.Add(globalStiffness);
+	key.Add(clusterPlasticThreshold);
+	key.Add(clusterPlasticCreep);
+	// SIMD builds weight the skinning with an approximate pow(), keep their assets apart from scalar builds
+	key.Add(kSimdWidth);
+
+	NvFlexExtAsset* asset = LoadCachedAsset(key);
+
+	if (!asset)
+	{
+		asset = CookSoftFromMesh(vertices, numVertices, indices, numIndices, particleSpacing, volumeSampling, surfaceSampling, clusterSpacing, clusterRadius, clusterStiffness, linkRadius, linkStiffness, globalStiffness, clusterPlasticThreshold, clusterPlasticCreep, cookDesc);
+		StoreCachedAsset(key, asset);
+	}
+
+	return asset;
+}
+
 void NvFlexExtCreateSoftMeshSkinning(const float* vertices, int numVertices, const float* bones, int numBones, float falloff, float maxDistance, float* skinningWeights, int* skinningIndices)
 {
-	CreateSkinning((Vec3*)vertices, numVertices, (Vec3*)bones, numBones, skinningWeights, skinningIndices, falloff, maxDistance);
+	CreateSkinning((Vec3*)vertices, numVertices, (Vec3*)bones, numBones, skinningWeights, skinningIndices, falloff, maxDistance, 0);
 }
@@ -38,13 +38,120 @@
 #include <cassert>
 #include <cstddef>
 
+extern "C" {
+
+/**
+ * Opaque type representing a pool of host NvFlexBuffers, see NvFlexExtCreateBufferPool()
+ */
+typedef struct NvFlexExtBufferPool NvFlexExtBufferPool;
+
+/**
+ * Allocation counters for a buffer pool, see NvFlexExtGetBufferPoolStats()
+ */
+struct NvFlexExtBufferPoolStats
+{
+	size_t requestedBytes;		//!< Bytes requested by the buffers currently allocated from the pool
+	size_t allocatedBytes;		//!< Bytes of size class storage backing the buffers currently allocated from the pool
+	size_t retainedBytes;		//!< Bytes held in free lists waiting to be recycled
+	size_t peakRequestedBytes;	//!< Largest value of requestedBytes since the pool was created
+	size_t peakReservedBytes;	//!< Largest value of allocatedBytes + retainedBytes since the pool was created
+	int numAllocs;				//!< Number of NvFlexExtPoolAllocBuffer() calls
+	int numRecycled;			//!< Number of allocations served from a free list instead of NvFlexAllocBuffer()
+	int numBuffers;				//!< Number of buffers currently allocated from the pool
+	float fragmentation;		//!< Fraction of reserved storage not holding requested data, 1 - requestedBytes/(allocatedBytes + retainedBytes)
+};
+
+/**
+ * Create a pool that recycles buffers between allocations. Requests are rounded up to size classes
+ * that are multiples of 64 bytes, spaced four per power of two above 256 bytes so that a large request
+ * wastes at most 25%. Freed buffers are kept on a free list per-size class, stride and type instead of
+ * being released to the library.
+ *
+ * @param[in] lib The library used to allocate the underlying buffers
+ * @param[in] maxRetainedBytes Freed buffers that would take the free lists over this many bytes are released immediately, 0 for no limit
+ * @return A pointer to the pool
+ */
+NV_FLEX_API NvFlexExtBufferPool* NvFlexExtCreateBufferPool(NvFlexLibrary* lib, size_t maxRetainedBytes);
+
+/**
+ * Destroy a pool and release the buffers on its free lists. All buffers should be returned to the pool first, any that are not are released as well,
+ * their owners set with NvFlexExtPoolSetBufferOwner() are detached first so that they do not return the buffers afterwards. Debug builds report buffers that were not returned.
+ *
+ * @param[in] pool The pool
+ */
+NV_FLEX_API void NvFlexExtDestroyBufferPool(NvFlexExtBufferPool* pool);
+
+/**
+ * Returns the library the pool allocates from
+ *
+ * @param[in] pool The pool
+ */
+NV_FLEX_API NvFlexLibrary* NvFlexExtGetBufferPoolLibrary(NvFlexExtBufferPool* pool);
+
+/**
+ * Allocate a buffer of at least elementCount elements, the buffer is unmapped on return.
+ *
+ * @param[in] pool The pool
+ * @param[in] elementCount The minimum number of elements in the buffer
+ * @param[in] elementByteStride The size of each element in bytes
+ * @param[in] type The type of buffer to allocate
+ * @param[out] capacity Optional, receives the number of elements that fit in the size class, which is >= elementCount
+ * @return A pointer to a NvFlexBuffer, must be returned using NvFlexExtPoolFreeBuffer()
+ */
+NV_FLEX_API NvFlexBuffer* NvFlexExtPoolAllocBuffer(NvFlexExtBufferPool* pool, int elementCount, int elementByteStride, NvFlexBufferType type, int* capacity);
+
+/**
+ * Return a buffer to the pool's free list, the buffer must be unmapped
+ *
+ * @param[in] pool The pool
+ * @param[in] buf A buffer allocated with NvFlexExtPoolAllocBuffer() on the same pool
+ */
+NV_FLEX_API void NvFlexExtPoolFreeBuffer(NvFlexExtBufferPool* pool, NvFlexBuffer* buf);
+
+/**
+ * Called by NvFlexExtDestroyBufferPool() for each buffer that was not returned to the pool, the owner should drop its reference to the buffer
+ * and unmap it if necessary, the pool releases the buffer once this returns
+ */
+typedef void (*NvFlexExtPoolDetachCallback)(void* owner, NvFlexBuffer* buf);
+
+/**
+ * Set the owner of a buffer allocated from the pool, the owner is detached if the pool is destroyed before the buffer is returned
+ *
+ * @param[in] pool The pool
+ * @param[in] buf A buffer allocated with NvFlexExtPoolAllocBuffer() on the same pool
+ * @param[in] owner Passed to the detach callback
+ * @param[in] detach The callback to detach the owner, may be NULL
+ */
+NV_FLEX_API void NvFlexExtPoolSetBufferOwner(NvFlexExtBufferPool* pool, NvFlexBuffer* buf, void* owner, NvFlexExtPoolDetachCallback detach);
+
+/**
+ * Release all buffers on the pool's free lists back to the library
+ *
+ * @param[in] pool The pool
+ */
+NV_FLEX_API void NvFlexExtTrimBufferPool(NvFlexExtBufferPool* pool);
+
+/**
+ * Returns the pool's allocation counters
+ *
+ * @param[in] pool The pool
+ * @param[out] stats Receives the counters
+ */
+NV_FLEX_API void NvFlexExtGetBufferPoolStats(NvFlexExtBufferPool* pool, NvFlexExtBufferPoolStats* stats);
+
+} // extern "C"
+
 // A vector type that wraps a NvFlexBuffer, behaves like a standard vector for POD types (no construction)
 // The vector must be mapped using map() before any read/write access to elements or resize operation
+// Vectors constructed from a NvFlexExtBufferPool take their storage from the pool, so growth recycles freed buffers
+
+// selects the NvFlexVector constructor that takes its storage from a NvFlexExtBufferPool, e.g.: NvFlexVector<float> v(NvFlexVectorPool(), pool)
+struct NvFlexVectorPool {};
 
 template <typename T>
 struct NvFlexVector
 {
-	NvFlexVector(NvFlexLibrary* l, int size = 0, NvFlexBufferType type = eNvFlexBufferHost) : lib(l), buffer(NULL), mappedPtr(NULL), count(0), capacity(0), type(type)
+	NvFlexVector(NvFlexLibrary* l, int size = 0, NvFlexBufferType type = eNvFlexBufferHost) : lib(l), pool(NULL), buffer(NULL), mappedPtr(NULL), count(0), capacity(0), type(type)
 	{
 		if (size)
 		{
@@ -55,11 +162,20 @@ struct NvFlexVector
 		}		
 	}
 	
-	NvFlexVector(NvFlexLibrary* l, const T* ptr, int size, NvFlexBufferType type = eNvFlexBufferHost) : lib(l), buffer(NULL), mappedPtr(NULL), count(0), capacity(0), type(type)
+	NvFlexVector(NvFlexLibrary* l, const T* ptr, int size, NvFlexBufferType type = eNvFlexBufferHost) : lib(l), pool(NULL), buffer(NULL), mappedPtr(NULL), count(0), capacity(0), type(type)
 	{
 		assign(ptr, size);
 		unmap();
 	}
+
+	NvFlexVector(NvFlexVectorPool, NvFlexExtBufferPool* p, int size = 0, NvFlexBufferType type = eNvFlexBufferHost) : lib(NvFlexExtGetBufferPoolLibrary(p)), pool(p), buffer(NULL), mappedPtr(NULL), count(0), capacity(0), type(type)
+	{
+		if (size)
+		{
+			resize(size);
+			unmap();
+		}
+	}
 	
 
 	~NvFlexVector()	
@@ -68,6 +184,7 @@ struct NvFlexVector
 	}
 
 	NvFlexLibrary* lib;
+	NvFlexExtBufferPool* pool;
 	NvFlexBuffer* buffer;
 
 	T* mappedPtr;
@@ -89,7 +206,7 @@ struct NvFlexVector
 			NvFlexUnmap(buffer);
 
 		if (buffer)
-			NvFlexFreeBuffer(buffer);
+			release(buffer);
 
 		mappedPtr = NULL;
 		buffer = NULL;
@@ -176,9 +293,16 @@ struct NvFlexVector
 		if (minCapacity > capacity)
 		{
 			// growth factor of 1.5
-			const int newCapacity = minCapacity*3/2;
+			int newCapacity = minCapacity*3/2;
 
-			NvFlexBuffer* newBuf = NvFlexAllocBuffer(lib, newCapacity, sizeof(T), type);
+			NvFlexBuffer* newBuf;
+			if (pool)
+			{
+				newBuf = NvFlexExtPoolAllocBuffer(pool, newCapacity, sizeof(T), type, &newCapacity);
+				NvFlexExtPoolSetBufferOwner(pool, newBuf, this, detach);
+			}
+			else
+				newBuf = NvFlexAllocBuffer(lib, newCapacity, sizeof(T), type);
 
 			// copy contents to new buffer			
 			void* newPtr = NvFlexMap(newBuf, eNvFlexMapWait);
@@ -188,7 +312,7 @@ struct NvFlexVector
 			unmap();
 			
 			if (buffer)
-				NvFlexFreeBuffer(buffer);
+				release(buffer);
 
 			// swap
 			buffer = newBuf;
@@ -221,6 +345,34 @@ struct NvFlexVector
 		for (int i=startInit; i < endInit; ++i)
 			mappedPtr[i] = val;
 	}
+
+private:
+
+	void release(NvFlexBuffer* buf)
+	{
+		if (pool)
+			NvFlexExtPoolFreeBuffer(pool, buf);
+		else
+			NvFlexFreeBuffer(buf);
+	}
+
+	// the pool is being destroyed and releases the buffer itself, later growth allocates from the library
+	static void detach(void* owner, NvFlexBuffer* buf)
+	{
+		NvFlexVector* v = (NvFlexVector*)owner;
+
+		if (v->buffer != buf)
+			return;
+
+		if (v->mappedPtr)
+			NvFlexUnmap(v->buffer);
+
+		v->pool = NULL;
+		v->buffer = NULL;
+		v->mappedPtr = NULL;
+		v->capacity = 0;
+		v->count = 0;
+	}
 };
 
 extern "C" {
@@ -303,6 +455,56 @@ NV_FLEX_API void NvFlexExtMovingFrameUpdate(NvFlexExtMovingFrame* frame, const f
  */
 NV_FLEX_API void NvFlexExtMovingFrameApply(NvFlexExtMovingFrame* frame, float* positions, float* velocities, int numParticles, float linearScale, float angularScale, float dt);
 
+/* Teleport particles to the frame's new position and apply the inertial forces in the same way as NvFlexExtMovingFrameApply(), splitting
+ * the particles across the extension's shared thread pool. The result is identical to NvFlexExtMovingFrameApply().
+ *
+ * @param[in] frame A pointer to a user-allocated NvFlexExtMovingFrame struct
+ * @param[in] positions A pointer to an array of particle positions in (x, y, z, 1/m) format
+ * @param[in] velocities A pointer to an array of particle velocities in (vx, vy, vz) format
+ * @param[in] numParticles The number of particles to update
+ * @param[in] linearScale How strongly the translational inertial forces should be applied, see NvFlexExtMovingFrameApply()
+ * @param[in] angularScale How strongly the angular inertial forces should be applied, see NvFlexExtMovingFrameApply()
+ * @param[in] dt The time that elapsed since the last call to the frame update, should match the value passed to NvFlexExtMovingFrameUpdate()
+ * @param[in] numThreads Maximum number of threads to split the particles across, 0 uses every thread of the pool and 1 runs on the calling thread only
+ */
+NV_FLEX_API void NvFlexExtMovingFrameApplyThreaded(NvFlexExtMovingFrame* frame, float* positions, float* velocities, int numParticles, float linearScale, float angularScale, float dt, int numThreads);
+
+/**
+ * Opaque type representing a solver callback that applies a moving frame to the solver's particles, see NvFlexExtCreateMovingFrameCallback()
+ */
+typedef struct NvFlexExtMovingFrameCallback NvFlexExtMovingFrameCallback;
+
+/**
+ * Create a callback that applies a moving frame to all active particles at the end of the solver update (eNvFlexStageUpdateEnd), 
+ * this performs the same work as NvFlexExtMovingFrameApply() on the solver's own particle data so positions and velocities
+ * do not need to be read back and sent again each frame. The callback is registered with the solver by the first NvFlexExtSetMovingFrame(),
+ * any callback already registered for the stage, e.g.: a force field callback, is still called before the frame is applied.
+ *
+ * @param[in] solver A valid solver created with NvFlexCreateSolver()
+ * @return A pointer to a callback structure
+ */
+NV_FLEX_API NvFlexExtMovingFrameCallback* NvFlexExtCreateMovingFrameCallback(NvFlexSolver* solver);
+
+/**
+ * Destroy the moving frame callback, the callback it replaced on the solver's eNvFlexStageUpdateEnd stage is registered again.
+ * Callbacks sharing a stage should be destroyed in the reverse order that they were first set.
+ *
+ * @param[in] callback A valid callback created with NvFlexExtCreateMovingFrameCallback()
+ */
+NV_FLEX_API void NvFlexExtDestroyMovingFrameCallback(NvFlexExtMovingFrameCallback* callback);
+
+/**
+ * Set the frame to apply at the end of the next NvFlexUpdateSolver(), the frame is applied once per-call to this method, so this
+ * should be called after each NvFlexExtMovingFrameUpdate(). Inertial forces are integrated using the time-step passed to NvFlexUpdateSolver(),
+ * which should match the value passed to NvFlexExtMovingFrameUpdate().
+ *
+ * @param[in] callback The callback to update
+ * @param[in] frame The frame to apply, the frame is copied so it may be updated again once this method returns
+ * @param[in] linearScale How strongly the translational inertial forces should be applied, see NvFlexExtMovingFrameApply()
+ * @param[in] angularScale How strongly the angular inertial forces should be applied, see NvFlexExtMovingFrameApply()
+ */
+NV_FLEX_API void NvFlexExtSetMovingFrame(NvFlexExtMovingFrameCallback* callback, const NvFlexExtMovingFrame* frame, float linearScale, float angularScale);
+
 
 /** 
  * Represents a group of particles and constraints, each asset 
@@ -391,6 +593,8 @@ typedef struct NvFlexExtContainer NvFlexExtContainer;
 /**
  * Create an index buffer of unique vertices in the mesh (collapses vertices in the same position even if they have different normals / texcoords).
  * This can be used to create simulation meshes from render meshes, and is typically done as a pre-pass before calling NvFlexExtCreateClothFromMesh().
+ * Vertices are binned in a spatial hash so the cost is linear in the number of vertices, and large meshes are processed on multiple threads. Each vertex 
+ * is welded to the closest unique vertex within the threshold, unique vertices are listed in increasing index order and the result does not depend on the thread count.
  *
  * @param[in] vertices A pointer to an array of float3 positions
  * @param[in] numVertices The number of vertices in the mesh
@@ -418,6 +622,24 @@ NV_FLEX_API int NvFlexExtCreateWeldedMeshIndices(const float* vertices, int numV
  */
 NV_FLEX_API NvFlexExtAsset* NvFlexExtCreateClothFromMesh(const float* particles, int numParticles, const int* indices, int numTriangles, float stretchStiffness, float bendStiffness, float tetherStiffness, float tetherGive, float pressure);
 
+/**
+ * Create a cloth asset in the same way as NvFlexExtCreateClothFromMesh(), except that each particle is tethered to the anchor with the shortest path
+ * along the mesh edges rather than the closest anchor in a straight line, and the tether length is that path's length. This keeps tethers from cutting
+ * across folds in the rest pose. Particles that are not connected to an anchor through the mesh get no tether.
+ *
+ * @param[in] particles Positions and masses of the particles in the format [x, y, z, 1/m]
+ * @param[in] numParticles The number of particles
+ * @param[in] indices The triangle indices, these should be 'welded' using NvFlexExtCreateWeldedMeshIndices() first
+ * @param[in] numTriangles The number of triangles
+ * @param[in] stretchStiffness The stiffness coefficient for stretch constraints
+ * @param[in] bendStiffness The stiffness coefficient used for bending constraints
+ * @param[in] tetherStiffness If > 0.0f then the function will create tethers attached to particles with zero inverse mass
+ * @param[in] tetherGive The amount of extension allowed before a tether activates, see NvFlexExtCreateClothFromMesh()
+ * @param[in] pressure If > 0.0f then a volume (pressure) constraint will also be added to the asset
+ * @return A pointer to an asset structure holding the particles and constraints
+ */
+NV_FLEX_API NvFlexExtAsset* NvFlexExtCreateClothFromMeshWithGeodesicTethers(const float* particles, int numParticles, const int* indices, int numTriangles, float stretchStiffness, float bendStiffness, float tetherStiffness, float tetherGive, float pressure);
+
 /**
  * Create a cloth asset consisting of stretch and bend distance constraints given an indexed triangle mesh. This creates an asset with the same
  * structure as NvFlexExtCreateClothFromMesh(), however tether constraints are not supported, and additional information regarding mesh topology
@@ -491,9 +713,9 @@ NV_FLEX_API void NvFlexExtTearClothMesh(NvFlexExtAsset* asset, float maxStrain,
  * @param[in] numVertices The number of vertices
  * @param[in] indices The triangle indices
  * @param[in] numTriangleIndices The number of triangles indices (triangles*3)
- * @param[in] radius The spacing used for voxelization, note that the number of voxels grows proportional to the inverse cube of radius, currently this method limits construction to resolutions < 64^3
+ * @param[in] radius The spacing used for voxelization, note that the number of voxels grows proportional to the inverse cube of radius, currently this method limits construction to resolutions <= 1024 voxels per-side. Voxels and the signed distance field are stored in sparse 8^3 bricks so intermediate memory grows with the space the mesh occupies rather than the cube of the resolution
  * @param[in] expand Particles will be moved inwards (if negative) or outwards (if positive) from the surface of the mesh according to this factor
- * @return A pointer to an asset structure holding the particles and constraints
+ * @return A pointer to an asset structure holding the particles and constraints, NULL if the resolution limit is exceeded or the mesh would produce more than INT_MAX/4 particles
  */
 NV_FLEX_API NvFlexExtAsset* NvFlexExtCreateRigidFromMesh(const float* vertices, int numVertices, const int* indices, int numTriangleIndices, float radius, float expand);
 
@@ -519,12 +741,85 @@ NV_FLEX_API NvFlexExtAsset* NvFlexExtCreateRigidFromMesh(const float* vertices,
 */
 NV_FLEX_API NvFlexExtAsset* NvFlexExtCreateSoftFromMesh(const float* vertices, int numVertices, const int* indices, int numTriangleIndices, float particleSpacing, float volumeSampling, float surfaceSampling, float clusterSpacing, float clusterRadius, float clusterStiffness, float linkRadius, float linkStiffness, float globalStiffness, float clusterPlasticThreshold, float clusterPlasticCreep);
 
+/**
+ * Spatial structures available for the neighbor queries performed while cooking soft bodies
+ */
+enum NvFlexExtNeighborQuery
+{
+	eNvFlexExtNeighborQuerySweepAndPrune = 0,	//!< Points sorted along their longest axis, queries binary search and scan the overlapping range, cost grows with the extent of the body along the other two axes
+	eNvFlexExtNeighborQueryHashGrid = 1,		//!< Uniform grid with cell size equal to the query radius, hashed into a table proportional to the number of points, queries visit only adjacent cells
+};
+
+/**
+ * Controls how the stages of NvFlexExtCreateSoftFromMeshWithDesc() find neighboring points, all structures return the same neighbor sets
+ */
+struct NvFlexExtSoftCookDesc
+{
+	NvFlexExtNeighborQuery samplingQuery;	//!< Structure used to merge surface and volume samples into particles
+	NvFlexExtNeighborQuery clusterQuery;	//!< Structure used to gather particles into shape-matching clusters
+	NvFlexExtNeighborQuery linkQuery;		//!< Structure used to find particle pairs for distance links
+	int numThreads;							//!< Maximum number of threads used by the voxelization, cluster smoothing and link stages, 0 uses every thread of the extension's shared pool and 1 cooks on the calling thread only. Work is merged in a fixed order so the asset is identical for any thread count
+};
+
+/**
+ * Initialize the soft body cook descriptor to its default values
+ *
+ * @param[in] desc Pointer to a descriptor structure that will be initialized with default values
+ */
+NV_FLEX_API void NvFlexExtSetSoftCookDescDefaults(NvFlexExtSoftCookDesc* desc);
+
+/**
+ * Create a soft body asset from a triangle mesh, see NvFlexExtCreateSoftFromMesh() for a description of the parameters
+ *
+ * @param[in] desc Controls the neighbor query structure used by each cooking stage, if NULL the defaults from NvFlexExtSetSoftCookDescDefaults() are used
+ * @return A pointer to an asset structure holding the particles and constraints
+ */
+NV_FLEX_API NvFlexExtAsset* NvFlexExtCreateSoftFromMeshWithDesc(const float* vertices, int numVertices, const int* indices, int numTriangleIndices, float particleSpacing, float volumeSampling, float surfaceSampling, float clusterSpacing, float clusterRadius, float clusterStiffness, float linkRadius, float linkStiffness, float globalStiffness, float clusterPlasticThreshold, float clusterPlasticCreep, const NvFlexExtSoftCookDesc* desc);
+
 /**
  * Frees all memory associated with an asset created by one of the creation methods
  * param[in] asset The asset to destroy.
  */
 NV_FLEX_API void NvFlexExtDestroyAsset(NvFlexExtAsset* asset);
 
+/**
+ * Write an asset to a binary file. The file starts with a versioned header and stores every asset array at a 16 byte aligned offset,
+ * so a file that has been read or memory mapped may be used in place through NvFlexExtMapAsset(). Files use the host byte order.
+ *
+ * @param[in] asset The asset to save
+ * @param[in] path The file to write
+ * @return True if the file was written successfully
+ */
+NV_FLEX_API bool NvFlexExtSaveAsset(const NvFlexExtAsset* asset, const char* path);
+
+/**
+ * Load an asset written by NvFlexExtSaveAsset()
+ *
+ * @param[in] path The file to read
+ * @return A new asset that should be destroyed with NvFlexExtDestroyAsset(), or NULL if the file could not be read or has an unsupported version
+ */
+NV_FLEX_API NvFlexExtAsset* NvFlexExtLoadAsset(const char* path);
+
+/**
+ * Initialize an asset structure to reference the contents of an asset file already in memory (e.g.: memory mapped), no data is copied.
+ * The asset is only valid while data is and must not be passed to NvFlexExtDestroyAsset()
+ *
+ * @param[in] data Pointer to the file contents, must be at least 4 byte aligned
+ * @param[in] size The size of the file in bytes
+ * @param[out] asset The asset structure to initialize
+ * @return True if data holds a valid asset file
+ */
+NV_FLEX_API bool NvFlexExtMapAsset(const void* data, size_t size, NvFlexExtAsset* asset);
+
+/**
+ * Enable the on-disk asset cache. NvFlexExtCreateRigidFromMesh(), NvFlexExtCreateSoftFromMesh() and the cloth creation functions hash their inputs
+ * and return the cached asset when an entry exists, otherwise the cooked asset is written to the cache. The soft body cook descriptor
+ * is not part of the key since it does not change the result.
+ *
+ * @param[in] path An existing directory to store cached assets in, NULL or an empty string disables the cache (the default)
+ */
+NV_FLEX_API void NvFlexExtSetAssetCacheDirectory(const char* path);
+
 /**
 * Creates information for linear blend skining a graphics mesh to a set of transforms (bones)
 *
@@ -536,9 +831,139 @@ NV_FLEX_API void NvFlexExtDestroyAsset(NvFlexExtAsset* asset);
 * @param[in] maxDistance The maximum distance a bone can be from a vertex before it will not influence it any more
 * @param[out] skinningWeights The normalized weights for each bone, there are up to 4 weights per-vertex so this should be numVertices*4 in length
 * @param[out] skinningIndices The indices of each bone corresponding to the skinning weight, will be -1 if this weight is not used
+*
+* Vertices are processed in parallel on the extension's shared thread pool, the output is identical to a serial evaluation
 */
 NV_FLEX_API void NvFlexExtCreateSoftMeshSkinning(const float* vertices, int numVertices, const float* bones, int numBones, float falloff, float maxDistance, float* skinningWeights, int* skinningIndices);
 
+/**
+ * Opaque type representing a set of worker threads that cook assets in the background
+ */
+typedef struct NvFlexExtCookQueue NvFlexExtCookQueue;
+
+/**
+ * Opaque handle to an asset being cooked by a NvFlexExtCookQueue
+ */
+typedef struct NvFlexExtCookJob NvFlexExtCookJob;
+
+/**
+ * The asset creation function a cook job runs
+ */
+enum NvFlexExtCookJobType
+{
+	eNvFlexExtCookRigid = 0,	//!< NvFlexExtCreateRigidFromMesh()
+	eNvFlexExtCookSoft = 1,		//!< NvFlexExtCreateSoftFromMeshWithDesc()
+	eNvFlexExtCookCloth = 2,	//!< NvFlexExtCreateClothFromMesh()
+};
+
+/**
+ * Parameters of a rigid cook job, see NvFlexExtCreateRigidFromMesh()
+ */
+struct NvFlexExtRigidCookParams
+{
+	float radius;
+	float expand;
+};
+
+/**
+ * Parameters of a soft cook job, see NvFlexExtCreateSoftFromMeshWithDesc()
+ */
+struct NvFlexExtSoftCookParams
+{
+	float particleSpacing;
+	float volumeSampling;
+	float surfaceSampling;
+	float clusterSpacing;
+	float clusterRadius;
+	float clusterStiffness;
+	float linkRadius;
+	float linkStiffness;
+	float globalStiffness;
+	float clusterPlasticThreshold;
+	float clusterPlasticCreep;
+
+	NvFlexExtSoftCookDesc desc;
+};
+
+/**
+ * Parameters of a cloth cook job, see NvFlexExtCreateClothFromMesh()
+ */
+struct NvFlexExtClothCookParams
+{
+	float stretchStiffness;
+	float bendStiffness;
+	float tetherStiffness;
+	float tetherGive;
+	float pressure;
+	bool geodesicTethers;	//!< Selects NvFlexExtCreateClothFromMeshWithGeodesicTethers() instead of NvFlexExtCreateClothFromMesh()
+};
+
+/**
+ * Describes one asset to cook, the mesh arrays are copied when the job is submitted so they may be freed as soon as NvFlexExtSubmitCookJobs() returns
+ */
+struct NvFlexExtCookJobDesc
+{
+	NvFlexExtCookJobType type;		//!< Selects which of the parameter structures below is used
+
+	const float* vertices;			//!< Mesh vertices as float3, for cloth jobs these are the particles as float4 (x, y, z, 1/m)
+	int numVertices;				//!< Number of vertices (or particles)
+	const int* indices;				//!< Triangle indices
+	int numIndices;					//!< Number of triangle indices (triangles*3)
+
+	NvFlexExtRigidCookParams rigid;	//!< Used when type is eNvFlexExtCookRigid
+	NvFlexExtSoftCookParams soft;	//!< Used when type is eNvFlexExtCookSoft
+	NvFlexExtClothCookParams cloth;	//!< Used when type is eNvFlexExtCookCloth
+};
+
+/**
+ * Create a cook queue with its own worker threads, jobs are started in submission order
+ *
+ * @param[in] numThreads The number of worker threads, 0 creates one per hardware thread. Soft jobs may additionally use the extension's shared pool according to NvFlexExtSoftCookDesc::numThreads
+ * @return A pointer to a cook queue
+ */
+NV_FLEX_API NvFlexExtCookQueue* NvFlexExtCreateCookQueue(int numThreads);
+
+/**
+ * Destroy a cook queue, blocks until every submitted job has finished. Job handles remain valid and must still be released with NvFlexExtReleaseCookJob()
+ *
+ * @param[in] queue The queue to destroy
+ */
+NV_FLEX_API void NvFlexExtDestroyCookQueue(NvFlexExtCookQueue* queue);
+
+/**
+ * Queue a batch of cook jobs and return immediately
+ *
+ * @param[in] queue The queue to run the jobs on
+ * @param[in] jobs Pointer to an array of job descriptions
+ * @param[in] numJobs The number of jobs
+ * @param[out] outJobs Pointer to an array of numJobs handles that will be filled with one handle per-job
+ */
+NV_FLEX_API void NvFlexExtSubmitCookJobs(NvFlexExtCookQueue* queue, const NvFlexExtCookJobDesc* jobs, int numJobs, NvFlexExtCookJob** outJobs);
+
+/**
+ * Poll a cook job without blocking
+ *
+ * @param[in] job The job to query
+ * @return True if the job has finished and NvFlexExtReleaseCookJob() will not block
+ */
+NV_FLEX_API bool NvFlexExtIsCookJobComplete(NvFlexExtCookJob* job);
+
+/**
+ * Block until all of the given jobs have finished
+ *
+ * @param[in] jobs Pointer to an array of job handles
+ * @param[in] numJobs The number of jobs
+ */
+NV_FLEX_API void NvFlexExtWaitCookJobs(NvFlexExtCookJob* const* jobs, int numJobs);
+
+/**
+ * Wait for a job to finish, release its handle and take ownership of the cooked asset
+ *
+ * @param[in] job The job to release, the handle is invalid after this call
+ * @return The asset, or NULL if cooking failed, the caller is responsible for destroying it with NvFlexExtDestroyAsset()
+ */
+NV_FLEX_API NvFlexExtAsset* NvFlexExtReleaseCookJob(NvFlexExtCookJob* job);
+
 /**
  * Creates a wrapper object around a Flex solver that can hold assets / instances, the container manages sending and retrieving partical data from the solver
  *
@@ -566,7 +991,8 @@ NV_FLEX_API void NvFlexExtDestroyContainer(NvFlexExtContainer* container);
 NV_FLEX_API int  NvFlexExtAllocParticles(NvFlexExtContainer* container, int n, int* indices);
 
 /**
- * Free allocated particles
+ * Free allocated particles, each freed particle is swap-removed from the active list, i.e.: the last active particle
+ * moves into its slot. Particles that are already free are ignored. Freed particles are reused most recently freed first.
  *
  * @param[in] container The container to free from
  * @param[in] n The number of particles to free
@@ -576,7 +1002,8 @@ NV_FLEX_API void NvFlexExtFreeParticles(NvFlexExtContainer* container, int n, co
 
 
 /**
- * Retrives the indices of all active particles
+ * Retrives the indices of all active particles. The list is not sorted, newly allocated particles are appended
+ * and freed particles are swap-removed so the order depends on the allocation history.
  *
  * @param[in] container The container to free from
  * @param[out] indices Returns the number of active particles
@@ -597,15 +1024,79 @@ struct NvFlexExtParticleData
 	const float* upper;		//!< Receive a pointer to the particle upper bounds [x, y, z]
 };
 
+/**
+ * Selects particle data buffers for NvFlexExtMapParticleDataWithFlags() and NvFlexExtMarkParticleDataDirty()
+ */
+enum NvFlexExtParticleDataFlags
+{
+	eNvFlexExtParticleDataPositions		= 1 << 0,	//!< Particle positions and inverse masses
+	eNvFlexExtParticleDataRestPositions	= 1 << 1,	//!< Particle rest positions
+	eNvFlexExtParticleDataVelocities	= 1 << 2,	//!< Particle velocities
+	eNvFlexExtParticleDataPhases		= 1 << 3,	//!< Particle phases
+	eNvFlexExtParticleDataNormals		= 1 << 4,	//!< Particle normals
+
+	eNvFlexExtParticleDataAll			= 0x1f		//!< All particle data buffers
+};
+
 /** 
  * Returns pointers to the internal data stored by the container. These are host-memory pointers, and will 
  * remain valid NvFlexExtUnmapParticleData() is called.
+ *
+ * All particle data buffers are sent in full by the next NvFlexExtPushToDevice(), see NvFlexExtMapParticleDataWithFlags()
+ * to only send the data that has been modified.
  *
   @param container The container whose data should be accessed
  */
 NV_FLEX_API NvFlexExtParticleData NvFlexExtMapParticleData(NvFlexExtContainer* container);
+
+/** 
+ * Returns pointers to the internal data stored by the container in the same way as NvFlexExtMapParticleData().
+ *
+ * NvFlexExtPushToDevice() only sends particle data that has been modified on the host. The buffers selected by dirtyFlags
+ * are sent in full, callers that only read the data, or write a known set of particles, should pass 0 and use 
+ * NvFlexExtMarkParticleDataDirty() for the particles they write. NvFlexExtCreateInstance() marks its own particles.
+ *
+  @param container The container whose data should be accessed
+  @param dirtyFlags Combination of NvFlexExtParticleDataFlags for the buffers that may be written while mapped
+ */
+NV_FLEX_API NvFlexExtParticleData NvFlexExtMapParticleDataWithFlags(NvFlexExtContainer* container, int dirtyFlags);
+
 NV_FLEX_API void NvFlexExtUnmapParticleData(NvFlexExtContainer* container);
 
+/**
+ * Marks particles written through NvFlexExtMapParticleData() to be sent to the solver by the next NvFlexExtPushToDevice(),
+ * nearby particles are merged into a small number of copies
+ *
+ * @param[in] container The container the particles belong to
+ * @param[in] indices The particle indices that were modified
+ * @param[in] n The number of indices
+ * @param[in] dirtyFlags Combination of NvFlexExtParticleDataFlags for the buffers that were modified
+ */
+NV_FLEX_API void NvFlexExtMarkParticleDataDirty(NvFlexExtContainer* container, const int* indices, int n, int dirtyFlags=eNvFlexExtParticleDataAll);
+
+/**
+ * Data sent to the solver by the most recent NvFlexExtPushToDevice(), see NvFlexExtGetPushStats()
+ */
+struct NvFlexExtPushStats
+{
+	size_t particleBytes;		//!< Bytes of particle positions and inverse masses
+	size_t restParticleBytes;	//!< Bytes of particle rest positions
+	size_t velocityBytes;		//!< Bytes of particle velocities
+	size_t phaseBytes;			//!< Bytes of particle phases
+	size_t normalBytes;			//!< Bytes of particle normals
+	size_t activeBytes;			//!< Bytes of active particle indices
+	size_t constraintBytes;		//!< Bytes of spring, shape, triangle and inflatable constraint data
+	int numCopies;				//!< Number of particle data and active list copies issued, one per-merged range of each buffer
+};
+
+/**
+ * Returns the amount of data sent to the solver by the most recent NvFlexExtPushToDevice()
+ *
+ * @param[in] container The container
+ * @param[out] stats Receives the transfer counters
+ */
+NV_FLEX_API void NvFlexExtGetPushStats(NvFlexExtContainer* container, NvFlexExtPushStats* stats);
+
 struct NvFlexExtTriangleData
 {
 	int* indices;		//!< Receives a pointer to the array of triangle index data
@@ -660,7 +1151,7 @@ NV_FLEX_API void NvFlexExtUnmapShapeData(NvFlexExtContainer* container);
  */
 NV_FLEX_API NvFlexExtInstance* NvFlexExtCreateInstance(NvFlexExtContainer* container,  NvFlexExtParticleData* particleData, const NvFlexExtAsset* asset, const float* transform, float vx, float vy, float vz, int phase, float invMassScale);
 
-/** Destoy an instance of an asset
+/** Destoy an instance of an asset, its constraints are removed from the container on the next NvFlexExtPushToDevice()
  *
  * @param[in] container The container the instance belongs to
  * @param[in] instance The instance to destroy
@@ -709,6 +1200,10 @@ NV_FLEX_API void NvFlexExtTickContainer(NvFlexExtContainer* container, float dt,
 /**
  * Updates the device asynchronously, transfers any particle and constraint changes to the flex solver, 
  * expected to be called in the following sequence: NvFlexExtPushToDevice, NvFlexUpdateSolver, NvFlexExtPullFromDevice, flexSynchronize
+ * Only particle data modified on the host since the last push is sent, see NvFlexExtMapParticleDataWithFlags() and NvFlexExtGetPushStats().
+ * Constraints of instances created since the last push are appended, and holes left by destroyed instances are filled by moving
+ * later instances' constraints, so the cost depends on how many constraints change rather than how many the container holds.
+ * Only constraint types that changed are sent to the solver.
  * @param[in] container The container to update
  */
 NV_FLEX_API void NvFlexExtPushToDevice(NvFlexExtContainer* container);
@@ -721,12 +1216,44 @@ NV_FLEX_API void NvFlexExtPushToDevice(NvFlexExtContainer* container);
 NV_FLEX_API void NvFlexExtPullFromDevice(NvFlexExtContainer* container);
 
 /**
- * Synchronizes the per-instance data with the container's data, should be called after the synchronization with the solver read backs are complete
+ * Synchronizes the per-instance data with the container's data, should be called after the synchronization with the solver read backs are complete.
+ * Instances and soft joints are updated in parallel.
  *
  * @param[in] container The instances belonging to this container will be updated
  */ 
 NV_FLEX_API void NvFlexExtUpdateInstances(NvFlexExtContainer* container);
 
+/**
+ * Synchronizes the container's shape transforms with the host in the same way as NvFlexExtUpdateInstances(), except that each instance's
+ * shapeTranslations and shapeRotations are not updated. The transforms of all shapes are instead copied to contiguous arrays that can be
+ * read through NvFlexExtGetShapeTransforms(), which avoids per-instance copies when there are many instances. Soft joints are always updated.
+ * Instances keep their current transforms when constraints are rebuilt after NvFlexExtNotifyAssetChanged().
+ *
+ * @param[in] container The instances belonging to this container will be updated
+ */ 
+NV_FLEX_API void NvFlexExtUpdateInstancesNoCopy(NvFlexExtContainer* container);
+
+/**
+ * Shape transforms of all instances and soft joints in a container, see NvFlexExtGetShapeTransforms()
+ */
+struct NvFlexExtShapeTransforms
+{
+	const float* translations;	//!< Shape translations in [x, y, z] format, numShapes in length
+	const float* rotations;		//!< Shape rotations as quaternions in [x, y, z, w] format, numShapes in length
+	int numShapes;				//!< Number of shapes
+};
+
+/**
+ * Returns the shape transforms copied by the last call to NvFlexExtUpdateInstancesNoCopy(), stored as contiguous 
+ * translation and rotation arrays in host memory that does not need to be mapped. The transforms of an instance start at NvFlexExtInstance::shapeIndex
+ * (NvFlexExtSoftJoint::shapeIndex for joints), shape indices may change during NvFlexExtPushToDevice() so the arrays should be read before the next push.
+ * The arrays remain owned by the container and are overwritten by the next call to NvFlexExtUpdateInstancesNoCopy()
+ *
+ * @param[in] container The container to retrieve from
+ * @param[out] transforms Receives pointers to the transform arrays
+ */
+NV_FLEX_API void NvFlexExtGetShapeTransforms(NvFlexExtContainer* container, NvFlexExtShapeTransforms* transforms);
+
 
 /** 
  * Controls the way that force fields affect particles
@@ -763,7 +1290,8 @@ typedef struct NvFlexExtForceFieldCallback NvFlexExtForceFieldCallback;
 
 /**
  * Create a NvFlexExtForceFieldCallback structure, each callback is associated with the
- * passed in solver once the NvFlexExtSetForceFields() is called.
+ * passed in solver once the NvFlexExtSetForceFields() is called. Any callback already registered
+ * for the stage, e.g.: a moving frame callback, is still called before the force fields are applied.
  *
  * @param[in] solver A valid solver created with NvFlexCreateSolver()
  * @return A pointer to a callback structure
@@ -771,14 +1299,17 @@ typedef struct NvFlexExtForceFieldCallback NvFlexExtForceFieldCallback;
 NV_FLEX_API NvFlexExtForceFieldCallback* NvFlexExtCreateForceFieldCallback(NvFlexSolver* solver);
 
 /**
- * Destroy the force field callback
+ * Destroy the force field callback, the callback it replaced on the solver's eNvFlexStageUpdateEnd stage is registered again.
+ * Callbacks sharing a stage should be destroyed in the reverse order that they were first set.
  *
  * @param[in] callback A valid solver created with NvFlexExtCreateForceFieldCallback()
  */
 NV_FLEX_API void NvFlexExtDestroyForceFieldCallback(NvFlexExtForceFieldCallback* callback);
 
 /**
- * Set force fields on the container, these will be applied during the Flex update
+ * Set force fields on the container, these will be applied during the Flex update. The fields are binned 
+ * into a uniform grid over their bounds so each particle only evaluates the fields that may overlap it. The grid is built on the host,
+ * so fields passed in CUDA device memory are first copied back to the host, which waits for the device.
  *
  * @param[in] callback The callback to update
  * @param[in] forceFields A pointer to an array of force field data, may be host or GPU memory
@@ -0,0 +1,900 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#include "flexCPU.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cfloat>
+
+void CPUReportError(NvFlexLibrary* lib, NvFlexErrorSeverity severity, const char* msg, const char* file, int line)
+{
+	if (lib && lib->errorFunc)
+		lib->errorFunc(severity, msg, file, line);
+}
+
+#define CPU_ERROR(lib, msg) CPUReportError(lib, eNvFlexLogError, msg, __FILE__, __LINE__)
+
+namespace
+{
+
+// resolves a copy descriptor against the solver arrays, a NULL desc copies the whole maxParticles range
+bool ResolveCopy(const NvFlexSolver* s, const NvFlexBuffer* buf, size_t elementSize, const NvFlexCopyDesc* desc, bool toSolver, int& srcOffset, int& dstOffset, int& count)
+{
+	if (!buf)
+		return false;
+
+	srcOffset = desc ? desc->srcOffset : 0;
+	dstOffset = desc ? desc->dstOffset : 0;
+	count = desc ? desc->elementCount : s->desc.maxParticles;
+
+	// clamp to the buffer and solver sizes rather than reading or writing out of bounds
+	const int bufferCount = int(buf->memory.size()/elementSize);
+	const int bufferOffset = toSolver ? srcOffset : dstOffset;
+	const int solverOffset = toSolver ? dstOffset : srcOffset;
+
+	count = std::min(count, std::min(bufferCount - bufferOffset, s->desc.maxParticles - solverOffset));
+
+	return count > 0 && srcOffset >= 0 && dstOffset >= 0;
+}
+
+// copy per-particle data into the solver, src and dst offsets follow the convention of NvFlexCopyDesc
+template <typename T>
+void SetParticleData(NvFlexSolver* s, std::vector<T>& dst, const NvFlexBuffer* buf, const NvFlexCopyDesc* desc)
+{
+	int srcOffset, dstOffset, count;
+	if (ResolveCopy(s, buf, sizeof(T), desc, true, srcOffset, dstOffset, count))
+		memcpy(&dst[dstOffset], &buf->memory[0] + srcOffset*sizeof(T), count*sizeof(T));
+}
+
+// copy per-particle data out of the solver, the descriptor's srcOffset refers to the solver array
+template <typename T>
+void GetParticleData(NvFlexSolver* s, const std::vector<T>& src, NvFlexBuffer* buf, const NvFlexCopyDesc* desc)
+{
+	int srcOffset, dstOffset, count;
+	if (ResolveCopy(s, buf, sizeof(T), desc, false, srcOffset, dstOffset, count))
+		memcpy(&buf->memory[0] + dstOffset*sizeof(T), &src[srcOffset], count*sizeof(T));
+}
+
+// read the first count elements of a buffer, a NULL buffer fills with the given value
+template <typename T>
+void ReadBuffer(std::vector<T>& dst, const NvFlexBuffer* buf, int count, const T& fill=T())
+{
+	dst.assign(count, fill);
+
+	if (buf && count)
+		memcpy(&dst[0], &buf->memory[0], std::min(size_t(count)*sizeof(T), buf->memory.size()));
+}
+
+template <typename T>
+void WriteBuffer(NvFlexBuffer* buf, const std::vector<T>& src, int count)
+{
+	count = std::min(count, int(src.size()));
+
+	if (buf && count > 0)
+		memcpy(&buf->memory[0], &src[0], std::min(size_t(count)*sizeof(T), buf->memory.size()));
+}
+
+template <typename T>
+T* GetGeometry(std::vector<T*>& entries, unsigned int id)
+{
+	if (id == 0 || id > entries.size())
+		return NULL;
+
+	return entries[id-1];
+}
+
+// geometry ids are 1-based so that 0 can represent an invalid id, freed slots are reused
+template <typename T>
+unsigned int CreateGeometry(std::vector<T*>& entries)
+{
+	for (size_t i=0; i < entries.size(); ++i)
+	{
+		if (!entries[i])
+		{
+			entries[i] = new T();
+			return (unsigned int)(i+1);
+		}
+	}
+
+	entries.push_back(new T());
+	return (unsigned int)entries.size();
+}
+
+template <typename T>
+void DestroyGeometry(std::vector<T*>& entries, unsigned int id)
+{
+	if (id && id <= entries.size())
+	{
+		delete entries[id-1];
+		entries[id-1] = NULL;
+	}
+}
+
+template <typename T>
+int GetGeometryIds(const std::vector<T*>& entries, unsigned int* ids, int n)
+{
+	int count = 0;
+
+	for (size_t i=0; i < entries.size(); ++i)
+	{
+		if (entries[i])
+		{
+			if (ids && count < n)
+				ids[count] = (unsigned int)(i+1);
+
+			++count;
+		}
+	}
+
+	return count;
+}
+
+} // anonymous namespace
+
+NvFlexLibrary* NvFlexInit(int version, NvFlexErrorCallback errorFunc, NvFlexInitDesc* desc)
+{
+	if (version != NV_FLEX_VERSION)
+	{
+		if (errorFunc)
+			errorFunc(eNvFlexLogError, "NvFlexInit() called with a mismatched version number", __FILE__, __LINE__);
+
+		return NULL;
+	}
+
+	NvFlexLibrary* lib = new NvFlexLibrary();
+	lib->errorFunc = errorFunc;
+
+	snprintf(lib->deviceName, sizeof(lib->deviceName), "CPU (%d threads)", GetDefaultThreadPool().GetNumThreads());
+
+	return lib;
+}
+
+void NvFlexShutdown(NvFlexLibrary* lib)
+{
+	if (!lib)
+		return;
+
+	while (!lib->solvers.empty())
+		NvFlexDestroySolver(lib->solvers.back());
+
+	for (size_t i=0; i < lib->triangleMeshes.size(); ++i)
+		delete lib->triangleMeshes[i];
+
+	for (size_t i=0; i < lib->distanceFields.size(); ++i)
+		delete lib->distanceFields[i];
+
+	for (size_t i=0; i < lib->convexMeshes.size(); ++i)
+		delete lib->convexMeshes[i];
+
+	delete lib;
+}
+
+int NvFlexGetVersion()
+{
+	return NV_FLEX_VERSION;
+}
+
+void NvFlexSetSolverDescDefaults(NvFlexSolverDesc* desc)
+{
+	desc->featureMode = eNvFlexFeatureModeDefault;
+	desc->maxParticles = 0;
+	desc->maxDiffuseParticles = 0;
+	desc->maxNeighborsPerParticle = 96;
+	desc->maxContactsPerParticle = 6;
+}
+
+NvFlexSolver* NvFlexCreateSolver(NvFlexLibrary* lib, const NvFlexSolverDesc* desc)
+{
+	if (!lib || !desc || desc->maxParticles < 0 || desc->maxDiffuseParticles < 0)
+	{
+		CPU_ERROR(lib, "NvFlexCreateSolver() called with an invalid solver description");
+		return NULL;
+	}
+
+	NvFlexSolver* s = new NvFlexSolver();
+	s->lib = lib;
+	s->desc = *desc;
+	s->desc.maxNeighborsPerParticle = std::max(desc->maxNeighborsPerParticle, 1);
+	s->desc.maxContactsPerParticle = std::max(desc->maxContactsPerParticle, 1);
+
+	memset(s->callbacks, 0, sizeof(s->callbacks));
+
+	// reasonable defaults so that an update before NvFlexSetParams() is well defined
+	memset(&s->params, 0, sizeof(s->params));
+	s->params.numIterations = 3;
+	s->params.gravity[1] = -9.8f;
+	s->params.radius = 0.1f;
+	s->params.solidRestDistance = 0.1f;
+	s->params.fluidRestDistance = 0.1f;
+	s->params.maxSpeed = FLT_MAX;
+	s->params.maxAcceleration = FLT_MAX;
+	s->params.relaxationMode = eNvFlexRelaxationLocal;
+	s->params.relaxationFactor = 1.0f;
+	s->restDensity = CPUCalculateRestDensity(s->params);
+
+	const int n = desc->maxParticles;
+
+	s->particles.resize(n);
+	s->restParticles.resize(n);
+	s->velocities.resize(n);
+	s->phases.resize(n);
+	s->normals.resize(n);
+	s->smoothParticles.resize(n);
+	s->densities.resize(n);
+	s->anisotropy1.resize(n);
+	s->anisotropy2.resize(n);
+	s->anisotropy3.resize(n);
+
+	s->active.resize(n);
+	for (int i=0; i < n; ++i)
+		s->active[i] = i;
+
+	s->activeCount = 0;
+
+	s->diffuseParticles.resize(desc->maxDiffuseParticles);
+	s->diffuseVelocities.resize(desc->maxDiffuseParticles);
+	s->diffuseCount = 0;
+
+	// solver order is a permutation of all particles, active particles first, so that the API<->internal maps are total
+	s->numSorted = 0;
+	s->sortedToApi.resize(n);
+	s->apiToSorted.resize(n);
+
+	for (int i=0; i < n; ++i)
+	{
+		s->sortedToApi[i] = i;
+		s->apiToSorted[i] = i;
+	}
+
+	s->neighbors.resize(size_t(n)*s->desc.maxNeighborsPerParticle);
+	s->neighborCounts.resize(n);
+	s->contacts.resize(size_t(n)*s->desc.maxContactsPerParticle);
+	s->contactCounts.resize(n);
+
+	s->boundsLower = Vec3(0.0f);
+	s->boundsUpper = Vec3(0.0f);
+
+	memset(&s->timers, 0, sizeof(s->timers));
+	s->lastUpdateTime = 0.0f;
+
+	lib->solvers.push_back(s);
+
+	return s;
+}
+
+void NvFlexDestroySolver(NvFlexSolver* s)
+{
+	if (!s)
+		return;
+
+	std::vector<NvFlexSolver*>& solvers = s->lib->solvers;
+	solvers.erase(std::remove(solvers.begin(), solvers.end(), s), solvers.end());
+
+	delete s;
+}
+
+int NvFlexGetSolvers(NvFlexLibrary* lib, NvFlexSolver** solvers, int n)
+{
+	const int count = int(lib->solvers.size());
+
+	for (int i=0; i < std::min(n, count); ++i)
+		solvers[i] = lib->solvers[i];
+
+	return count;
+}
+
+NvFlexLibrary* NvFlexGetSolverLibrary(NvFlexSolver* s)
+{
+	return s->lib;
+}
+
+void NvFlexGetSolverDesc(NvFlexSolver* s, NvFlexSolverDesc* desc)
+{
+	*desc = s->desc;
+}
+
+NvFlexSolverCallback NvFlexRegisterSolverCallback(NvFlexSolver* s, NvFlexSolverCallback function, NvFlexSolverCallbackStage stage)
+{
+	NvFlexSolverCallback prev = {};
+
+	if (stage >= 0 && stage < eNvFlexStageCount)
+	{
+		prev = s->callbacks[stage];
+		s->callbacks[stage] = function;
+	}
+
+	return prev;
+}
+
+void NvFlexUpdateSolver(NvFlexSolver* s, float dt, int substeps, bool enableTimers)
+{
+	if (dt <= 0.0f || substeps <= 0)
+		return;
+
+	CPUUpdateSolver(s, dt, substeps, enableTimers);
+}
+
+void NvFlexSetParams(NvFlexSolver* s, const NvFlexParams* params)
+{
+	if (params->radius <= 0.0f)
+	{
+		CPU_ERROR(s->lib, "NvFlexSetParams() called with a non-positive particle radius");
+		return;
+	}
+
+	const bool densityChanged = params->radius != s->params.radius || params->fluidRestDistance != s->params.fluidRestDistance;
+
+	s->params = *params;
+	s->params.numPlanes = Clamp(params->numPlanes, 0, 8);
+
+	if (densityChanged)
+		s->restDensity = CPUCalculateRestDensity(s->params);
+}
+
+void NvFlexGetParams(NvFlexSolver* s, NvFlexParams* params)
+{
+	*params = s->params;
+}
+
+void NvFlexSetActive(NvFlexSolver* s, NvFlexBuffer* indices, const NvFlexCopyDesc* desc)
+{
+	SetParticleData(s, s->active, indices, desc);
+}
+
+void NvFlexGetActive(NvFlexSolver* s, NvFlexBuffer* indices, const NvFlexCopyDesc* desc)
+{
+	GetParticleData(s, s->active, indices, desc);
+}
+
+void NvFlexSetActiveCount(NvFlexSolver* s, int n)
+{
+	s->activeCount = Clamp(n, 0, s->desc.maxParticles);
+}
+
+int NvFlexGetActiveCount(NvFlexSolver* s)
+{
+	return s->activeCount;
+}
+
+void NvFlexSetParticles(NvFlexSolver* s, NvFlexBuffer* p, const NvFlexCopyDesc* desc)
+{
+	SetParticleData(s, s->particles, p, desc);
+}
+
+void NvFlexGetParticles(NvFlexSolver* s, NvFlexBuffer* p, const NvFlexCopyDesc* desc)
+{
+	GetParticleData(s, s->particles, p, desc);
+}
+
+void NvFlexSetRestParticles(NvFlexSolver* s, NvFlexBuffer* p, const NvFlexCopyDesc* desc)
+{
+	SetParticleData(s, s->restParticles, p, desc);
+}
+
+void NvFlexGetRestParticles(NvFlexSolver* s, NvFlexBuffer* p, const NvFlexCopyDesc* desc)
+{
+	GetParticleData(s, s->restParticles, p, desc);
+}
+
+void NvFlexGetSmoothParticles(NvFlexSolver* s, NvFlexBuffer* p, const NvFlexCopyDesc* desc)
+{
+	GetParticleData(s, s->smoothParticles, p, desc);
+}
+
+void NvFlexSetVelocities(NvFlexSolver* s, NvFlexBuffer* v, const NvFlexCopyDesc* desc)
+{
+	SetParticleData(s, s->velocities, v, desc);
+}
+
+void NvFlexGetVelocities(NvFlexSolver* s, NvFlexBuffer* v, const NvFlexCopyDesc* desc)
+{
+	GetParticleData(s, s->velocities, v, desc);
+}
+
+void NvFlexSetPhases(NvFlexSolver* s, NvFlexBuffer* phases, const NvFlexCopyDesc* desc)
+{
+	SetParticleData(s, s->phases, phases, desc);
+}
+
+void NvFlexGetPhases(NvFlexSolver* s, NvFlexBuffer* phases, const NvFlexCopyDesc* desc)
+{
+	GetParticleData(s, s->phases, phases, desc);
+}
+
+void NvFlexSetNormals(NvFlexSolver* s, NvFlexBuffer* normals, const NvFlexCopyDesc* desc)
+{
+	SetParticleData(s, s->normals, normals, desc);
+}
+
+void NvFlexGetNormals(NvFlexSolver* s, NvFlexBuffer* normals, const NvFlexCopyDesc* desc)
+{
+	GetParticleData(s, s->normals, normals, desc);
+}
+
+void NvFlexGetDensities(NvFlexSolver* s, NvFlexBuffer* densities, const NvFlexCopyDesc* desc)
+{
+	GetParticleData(s, s->densities, densities, desc);
+}
+
+void NvFlexGetAnisotropy(NvFlexSolver* s, NvFlexBuffer* q1, NvFlexBuffer* q2, NvFlexBuffer* q3, const NvFlexCopyDesc* desc)
+{
+	GetParticleData(s, s->anisotropy1, q1, desc);
+	GetParticleData(s, s->anisotropy2, q2, desc);
+	GetParticleData(s, s->anisotropy3, q3, desc);
+}
+
+void NvFlexSetSprings(NvFlexSolver* s, NvFlexBuffer* indices, NvFlexBuffer* restLengths, NvFlexBuffer* stiffness, int numSprings)
+{
+	numSprings = std::max(numSprings, 0);
+
+	ReadBuffer(s->springIndices, indices, numSprings*2);
+	ReadBuffer(s->springLengths, restLengths, numSprings);
+	ReadBuffer(s->springStiffness, stiffness, numSprings, 1.0f);
+}
+
+void NvFlexGetSprings(NvFlexSolver* s, NvFlexBuffer* indices, NvFlexBuffer* restLengths, NvFlexBuffer* stiffness, int numSprings)
+{
+	WriteBuffer(indices, s->springIndices, numSprings*2);
+	WriteBuffer(restLengths, s->springLengths, numSprings);
+	WriteBuffer(stiffness, s->springStiffness, numSprings);
+}
+
+void NvFlexSetRigids(NvFlexSolver* s, NvFlexBuffer* offsets, NvFlexBuffer* indices, NvFlexBuffer* restPositions, NvFlexBuffer* restNormals, NvFlexBuffer* stiffness, NvFlexBuffer* thresholds, NvFlexBuffer* creeps, NvFlexBuffer* rotations, NvFlexBuffer* translations, int numRigids, int numIndices)
+{
+	numRigids = std::max(numRigids, 0);
+	numIndices = std::max(numIndices, 0);
+
+	ReadBuffer(s->rigidOffsets, offsets, numRigids ? numRigids+1 : 0);
+	ReadBuffer(s->rigidIndices, indices, numIndices);
+	ReadBuffer(s->rigidRestPositions, restPositions, numIndices);
+	ReadBuffer(s->rigidRestNormals, restNormals, numIndices);
+	ReadBuffer(s->rigidStiffness, stiffness, numRigids, 1.0f);
+	ReadBuffer(s->rigidThresholds, thresholds, numRigids);
+	ReadBuffer(s->rigidCreeps, creeps, numRigids);
+	ReadBuffer(s->rigidRotations, rotations, numRigids, Quat());
+	ReadBuffer(s->rigidTranslations, translations, numRigids);
+
+	// guard against offsets that run past the indices, the solver trusts these from here on
+	for (int r=0; r < int(s->rigidOffsets.size()); ++r)
+		s->rigidOffsets[r] = Clamp(s->rigidOffsets[r], 0, numIndices);
+}
+
+void NvFlexGetRigids(NvFlexSolver* s, NvFlexBuffer* offsets, NvFlexBuffer* indices, NvFlexBuffer* restPositions, NvFlexBuffer* restNormals, NvFlexBuffer* stiffness, NvFlexBuffer* thresholds, NvFlexBuffer* creeps, NvFlexBuffer* rotations, NvFlexBuffer* translations)
+{
+	const int numRigids = int(s->rigidStiffness.size());
+	const int numIndices = int(s->rigidIndices.size());
+
+	WriteBuffer(offsets, s->rigidOffsets, numRigids+1);
+	WriteBuffer(indices, s->rigidIndices, numIndices);
+	WriteBuffer(restPositions, s->rigidRestPositions, numIndices);
+	WriteBuffer(restNormals, s->rigidRestNormals, numIndices);
+	WriteBuffer(stiffness, s->rigidStiffness, numRigids);
+	WriteBuffer(thresholds, s->rigidThresholds, numRigids);
+	WriteBuffer(creeps, s->rigidCreeps, numRigids);
+	WriteBuffer(rotations, s->rigidRotations, numRigids);
+	WriteBuffer(translations, s->rigidTranslations, numRigids);
+}
+
+NvFlexTriangleMeshId NvFlexCreateTriangleMesh(NvFlexLibrary* lib)
+{
+	return CreateGeometry(lib->triangleMeshes);
+}
+
+void NvFlexDestroyTriangleMesh(NvFlexLibrary* lib, NvFlexTriangleMeshId mesh)
+{
+	DestroyGeometry(lib->triangleMeshes, mesh);
+}
+
+int NvFlexGetTriangleMeshes(NvFlexLibrary* lib, NvFlexTriangleMeshId* meshes, int n)
+{
+	return GetGeometryIds(lib->triangleMeshes, meshes, n);
+}
+
+void NvFlexUpdateTriangleMesh(NvFlexLibrary* lib, NvFlexTriangleMeshId id, NvFlexBuffer* vertices, NvFlexBuffer* indices, int numVertices, int numTriangles, const float* lower, const float* upper)
+{
+	CPUTriangleMesh* mesh = GetGeometry(lib->triangleMeshes, id);
+	if (!mesh)
+	{
+		CPU_ERROR(lib, "NvFlexUpdateTriangleMesh() called with an invalid mesh");
+		return;
+	}
+
+	std::vector<Vec4> points;
+	ReadBuffer(points, vertices, numVertices);
+
+	mesh->vertices.resize(numVertices);
+	for (int i=0; i < numVertices; ++i)
+		mesh->vertices[i] = Vec3(points[i]);
+
+	ReadBuffer(mesh->indices, indices, numTriangles*3);
+
+	for (int i=0; i < numTriangles*3; ++i)
+	{
+		if (mesh->indices[i] < 0 || mesh->indices[i] >= numVertices)
+		{
+			CPU_ERROR(lib, "NvFlexUpdateTriangleMesh() called with out of range vertex indices");
+			mesh->indices.clear();
+			break;
+		}
+	}
+
+	mesh->lower = Vec3(lower);
+	mesh->upper = Vec3(upper);
+
+	CPUBuildTriangleMeshGrid(mesh);
+}
+
+void NvFlexGetTriangleMeshBounds(NvFlexLibrary* lib, const NvFlexTriangleMeshId id, float* lower, float* upper)
+{
+	const CPUTriangleMesh* mesh = GetGeometry(lib->triangleMeshes, id);
+	if (mesh)
+	{
+		memcpy(lower, &mesh->lower, sizeof(Vec3));
+		memcpy(upper, &mesh->upper, sizeof(Vec3));
+	}
+}
+
+NvFlexDistanceFieldId NvFlexCreateDistanceField(NvFlexLibrary* lib)
+{
+	return CreateGeometry(lib->distanceFields);
+}
+
+void NvFlexDestroyDistanceField(NvFlexLibrary* lib, NvFlexDistanceFieldId sdf)
+{
+	DestroyGeometry(lib->distanceFields, sdf);
+}
+
+int NvFlexGetDistanceFields(NvFlexLibrary* lib, NvFlexDistanceFieldId* sdfs, int n)
+{
+	return GetGeometryIds(lib->distanceFields, sdfs, n);
+}
+
+void NvFlexUpdateDistanceField(NvFlexLibrary* lib, NvFlexDistanceFieldId id, int dimx, int dimy, int dimz, NvFlexBuffer* field)
+{
+	CPUDistanceField* sdf = GetGeometry(lib->distanceFields, id);
+	if (!sdf || dimx <= 0 || dimy <= 0 || dimz <= 0)
+	{
+		CPU_ERROR(lib, "NvFlexUpdateDistanceField() called with an invalid field");
+		return;
+	}
+
+	sdf->dim[0] = dimx;
+	sdf->dim[1] = dimy;
+	sdf->dim[2] = dimz;
+
+	ReadBuffer(sdf->field, field, dimx*dimy*dimz, FLT_MAX);
+}
+
+NvFlexConvexMeshId NvFlexCreateConvexMesh(NvFlexLibrary* lib)
+{
+	return CreateGeometry(lib->convexMeshes);
+}
+
+void NvFlexDestroyConvexMesh(NvFlexLibrary* lib, NvFlexConvexMeshId convex)
+{
+	DestroyGeometry(lib->convexMeshes, convex);
+}
+
+int NvFlexGetConvexMeshes(NvFlexLibrary* lib, NvFlexConvexMeshId* meshes, int n)
+{
+	return GetGeometryIds(lib->convexMeshes, meshes, n);
+}
+
+void NvFlexUpdateConvexMesh(NvFlexLibrary* lib, NvFlexConvexMeshId id, NvFlexBuffer* planes, int numPlanes, const float* lower, const float* upper)
+{
+	CPUConvexMesh* convex = GetGeometry(lib->convexMeshes, id);
+	if (!convex)
+	{
+		CPU_ERROR(lib, "NvFlexUpdateConvexMesh() called with an invalid mesh");
+		return;
+	}
+
+	ReadBuffer(convex->planes, planes, numPlanes);
+
+	convex->lower = Vec3(lower);
+	convex->upper = Vec3(upper);
+}
+
+void NvFlexGetConvexMeshBounds(NvFlexLibrary* lib, NvFlexConvexMeshId id, float* lower, float* upper)
+{
+	const CPUConvexMesh* convex = GetGeometry(lib->convexMeshes, id);
+	if (convex)
+	{
+		memcpy(lower, &convex->lower, sizeof(Vec3));
+		memcpy(upper, &convex->upper, sizeof(Vec3));
+	}
+}
+
+void NvFlexSetShapes(NvFlexSolver* s, NvFlexBuffer* geometry, NvFlexBuffer* shapePositions, NvFlexBuffer* shapeRotations, NvFlexBuffer* shapePrevPositions, NvFlexBuffer* shapePrevRotations, NvFlexBuffer* shapeFlags, int numShapes)
+{
+	numShapes = std::max(numShapes, 0);
+
+	ReadBuffer(s->shapeGeometry, geometry, numShapes);
+	ReadBuffer(s->shapePositions, shapePositions, numShapes);
+	ReadBuffer(s->shapeRotations, shapeRotations, numShapes, Quat());
+	ReadBuffer(s->shapeFlags, shapeFlags, numShapes);
+
+	// shapes without a previous transform are treated as stationary
+	if (shapePrevPositions)
+		ReadBuffer(s->shapePrevPositions, shapePrevPositions, numShapes);
+	else
+		s->shapePrevPositions = s->shapePositions;
+
+	if (shapePrevRotations)
+		ReadBuffer(s->shapePrevRotations, shapePrevRotations, numShapes, Quat());
+	else
+		s->shapePrevRotations = s->shapeRotations;
+}
+
+void NvFlexSetDynamicTriangles(NvFlexSolver* s, NvFlexBuffer* indices, NvFlexBuffer* normals, int numTris)
+{
+	numTris = std::max(numTris, 0);
+
+	ReadBuffer(s->triangleIndices, indices, numTris*3);
+	ReadBuffer(s->triangleNormals, normals, numTris);
+}
+
+void NvFlexGetDynamicTriangles(NvFlexSolver* s, NvFlexBuffer* indices, NvFlexBuffer* normals, int numTris)
+{
+	WriteBuffer(indices, s->triangleIndices, numTris*3);
+	WriteBuffer(normals, s->triangleNormals, numTris);
+}
+
+void NvFlexSetInflatables(NvFlexSolver* s, NvFlexBuffer* startTris, NvFlexBuffer* numTris, NvFlexBuffer* restVolumes, NvFlexBuffer* overPressures, NvFlexBuffer* constraintScales, int numInflatables)
+{
+	numInflatables = std::max(numInflatables, 0);
+
+	ReadBuffer(s->inflatableStarts, startTris, numInflatables);
+	ReadBuffer(s->inflatableCounts, numTris, numInflatables);
+	ReadBuffer(s->inflatableRestVolumes, restVolumes, numInflatables);
+	ReadBuffer(s->inflatableOverPressures, overPressures, numInflatables, 1.0f);
+	ReadBuffer(s->inflatableScales, constraintScales, numInflatables, 1.0f);
+}
+
+void NvFlexGetDiffuseParticles(NvFlexSolver* s, NvFlexBuffer* p, NvFlexBuffer* v, NvFlexBuffer* count)
+{
+	WriteBuffer(p, s->diffuseParticles, s->diffuseCount);
+	WriteBuffer(v, s->diffuseVelocities, s->diffuseCount);
+
+	if (count && count->memory.size() >= sizeof(int))
+		memcpy(&count->memory[0], &s->diffuseCount, sizeof(int));
+}
+
+void NvFlexSetDiffuseParticles(NvFlexSolver* s, NvFlexBuffer* p, NvFlexBuffer* v, int n)
+{
+	n = Clamp(n, 0, s->desc.maxDiffuseParticles);
+
+	ReadBuffer(s->diffuseParticles, p, n);
+	ReadBuffer(s->diffuseVelocities, v, n);
+
+	s->diffuseParticles.resize(s->desc.maxDiffuseParticles);
+	s->diffuseVelocities.resize(s->desc.maxDiffuseParticles);
+	s->diffuseCount = n;
+}
+
+void NvFlexGetContacts(NvFlexSolver* s, NvFlexBuffer* planes, NvFlexBuffer* velocities, NvFlexBuffer* indices, NvFlexBuffer* counts)
+{
+	const int maxParticles = s->desc.maxParticles;
+	const int maxContacts = s->desc.maxContactsPerParticle;
+
+	// contacts are stored per-particle in solver order, see NvFlexGetContacts()
+	std::vector<Vec4> outPlanes;
+	std::vector<Vec4> outVelocities;
+
+	if (planes || velocities)
+	{
+		outPlanes.resize(size_t(maxParticles)*maxContacts);
+		outVelocities.resize(size_t(maxParticles)*maxContacts);
+
+		for (int i=0; i < s->numSorted; ++i)
+		{
+			for (int c=0; c < s->contactCounts[i]; ++c)
+			{
+				const size_t index = size_t(i)*maxContacts + c;
+				const CPUContact& contact = s->contacts[index];
+
+				outPlanes[index] = Vec4(contact.normal, contact.offset);
+				outVelocities[index] = Vec4(contact.velocity, float(contact.shape));
+			}
+		}
+	}
+
+	WriteBuffer(planes, outPlanes, int(outPlanes.size()));
+	WriteBuffer(velocities, outVelocities, int(outVelocities.size()));
+	WriteBuffer(indices, s->apiToSorted, maxParticles);
+	WriteBuffer(counts, s->contactCounts, maxParticles);
+}
+
+void NvFlexGetNeighbors(NvFlexSolver* s, NvFlexBuffer* neighbors, NvFlexBuffer* counts, NvFlexBuffer* apiToInternal, NvFlexBuffer* internalToApi)
+{
+	const int maxParticles = s->desc.maxParticles;
+	const int maxNeighbors = s->desc.maxNeighborsPerParticle;
+
+	// the API layout is strided by maxParticles, see NvFlexGetNeighbors()
+	if (neighbors)
+	{
+		std::vector<int> strided(size_t(maxParticles)*maxNeighbors);
+
+		for (int i=0; i < s->numSorted; ++i)
+			for (int c=0; c < s->neighborCounts[i]; ++c)
+				strided[size_t(c)*maxParticles + i] = s->neighbors[size_t(i)*maxNeighbors + c];
+
+		WriteBuffer(neighbors, strided, int(strided.size()));
+	}
+
+	WriteBuffer(counts, s->neighborCounts, s->desc.maxParticles);
+	WriteBuffer(apiToInternal, s->apiToSorted, s->desc.maxParticles);
+	WriteBuffer(internalToApi, s->sortedToApi, s->desc.maxParticles);
+}
+
+void NvFlexGetBounds(NvFlexSolver* s, NvFlexBuffer* lower, NvFlexBuffer* upper)
+{
+	if (lower && lower->memory.size() >= sizeof(Vec3))
+		memcpy(&lower->memory[0], &s->boundsLower, sizeof(Vec3));
+
+	if (upper && upper->memory.size() >= sizeof(Vec3))
+		memcpy(&upper->memory[0], &s->boundsUpper, sizeof(Vec3));
+}
+
+float NvFlexGetDeviceLatency(NvFlexSolver* s, unsigned long long* begin, unsigned long long* end, unsigned long long* frequency)
+{
+	// work runs synchronously inside NvFlexUpdateSolver() so there is no separate device timeline
+	if (begin)
+		*begin = 0;
+	if (end)
+		*end = 0;
+	if (frequency)
+		*frequency = 1;
+
+	return s->lastUpdateTime;
+}
+
+void NvFlexGetTimers(NvFlexSolver* s, NvFlexTimers* timers)
+{
+	*timers = s->timers;
+}
+
+int NvFlexGetDetailTimers(NvFlexSolver* s, NvFlexDetailTimer** timers)
+{
+	return 0;
+}
+
+NvFlexBuffer* NvFlexAllocBuffer(NvFlexLibrary* lib, int elementCount, int elementByteStride, NvFlexBufferType type)
+{
+	NvFlexBuffer* buf = new NvFlexBuffer();
+	buf->lib = lib;
+	buf->memory.resize(size_t(std::max(elementCount, 0))*std::max(elementByteStride, 0));
+	buf->count = elementCount;
+	buf->stride = elementByteStride;
+	buf->type = type;
+	buf->mapped = false;
+
+	return buf;
+}
+
+void NvFlexFreeBuffer(NvFlexBuffer* buf)
+{
+	delete buf;
+}
+
+void* NvFlexMap(NvFlexBuffer* buf, int flags)
+{
+	buf->mapped = true;
+
+	return buf->memory.empty() ? NULL : &buf->memory[0];
+}
+
+void NvFlexUnmap(NvFlexBuffer* buf)
+{
+	buf->mapped = false;
+}
+
+NvFlexBuffer* NvFlexRegisterOGLBuffer(NvFlexLibrary* lib, int buf, int elementCount, int elementByteStride)
+{
+	CPU_ERROR(lib, "NvFlexRegisterOGLBuffer() is not supported by the CPU solver");
+	return NULL;
+}
+
+void NvFlexUnregisterOGLBuffer(NvFlexBuffer* buf)
+{
+}
+
+NvFlexBuffer* NvFlexRegisterD3DBuffer(NvFlexLibrary* lib, void* buffer, int elementCount, int elementByteStride)
+{
+	CPU_ERROR(lib, "NvFlexRegisterD3DBuffer() is not supported by the CPU solver");
+	return NULL;
+}
+
+void NvFlexUnregisterD3DBuffer(NvFlexBuffer* buf)
+{
+}
+
+void NvFlexAcquireContext(NvFlexLibrary* lib)
+{
+}
+
+void NvFlexRestoreContext(NvFlexLibrary* lib)
+{
+}
+
+const char* NvFlexGetDeviceName(NvFlexLibrary* lib)
+{
+	return lib->deviceName;
+}
+
+void NvFlexGetDeviceAndContext(NvFlexLibrary* lib, void** device, void** context)
+{
+	if (device)
+		*device = NULL;
+	if (context)
+		*context = NULL;
+}
+
+void NvFlexFlush(NvFlexLibrary* lib)
+{
+}
+
+void NvFlexWait(NvFlexLibrary* lib)
+{
+}
+
+void NvFlexSetDebug(NvFlexSolver* s, bool enable)
+{
+}
+
+void NvFlexGetShapeBVH(NvFlexSolver* s, void* bvh)
+{
+}
+
+void NvFlexCopySolver(NvFlexSolver* dst, NvFlexSolver* src)
+{
+	// library ownership and registered callbacks stay with the destination
+	NvFlexLibrary* lib = dst->lib;
+	NvFlexSolverCallback callbacks[eNvFlexStageCount];
+	memcpy(callbacks, dst->callbacks, sizeof(callbacks));
+
+	*dst = *src;
+
+	dst->lib = lib;
+	memcpy(dst->callbacks, callbacks, sizeof(callbacks));
+}
+
+void NvFlexCopyDeviceToHost(NvFlexSolver* s, NvFlexBuffer* pDevice, void* pHost, int size, int stride)
+{
+	if (pDevice && pHost && size > 0)
+		memcpy(pHost, &pDevice->memory[0], std::min(size_t(size), pDevice->memory.size()));
+}
+
+void NvFlexComputeWaitForGraphics(NvFlexLibrary* lib)
+{
+}
+
+void NvFlexGetDataAftermath(NvFlexLibrary* lib, void* pDataOut, void* pStatusOut)
+{
+}
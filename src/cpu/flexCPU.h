@@ -0,0 +1,284 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#pragma once
+
+// Reference CPU implementation of the Flex solver API (include/NvFlex.h), used to run simulations on 
+// machines without a CUDA or D3D capable device. Particle data is held in host memory, each update
+// gathers the active particles into a solver order sorted by grid cell, runs the substeps using
+// Jacobi style constraint projection parallelized over particles, then scatters back to API order.
+
+#include <vector>
+#include <cstdlib>
+#include <new>
+
+#include "../../core/maths.h"
+#include "../../core/parallel.h"
+
+#include "../../include/NvFlex.h"
+
+// buffer storage is aligned to a cache line so that mapped arrays can be processed with aligned vector loads
+template <typename T, size_t Alignment>
+struct CPUAlignedAllocator
+{
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind { typedef CPUAlignedAllocator<U, Alignment> other; };
+
+	CPUAlignedAllocator() {}
+
+	template <typename U>
+	CPUAlignedAllocator(const CPUAlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t n)
+	{
+		// over-allocate and store the original pointer in front of the aligned block
+		void* base = malloc(n*sizeof(T) + Alignment + sizeof(void*));
+		if (!base)
+			throw std::bad_alloc();
+
+		void** aligned = (void**)((uintptr_t((void**)base + 1) + Alignment - 1) & ~uintptr_t(Alignment - 1));
+		aligned[-1] = base;
+
+		return (T*)aligned;
+	}
+
+	void deallocate(T* p, size_t)
+	{
+		if (p)
+			free(((void**)p)[-1]);
+	}
+
+	template <typename U>
+	bool operator==(const CPUAlignedAllocator<U, Alignment>&) const { return true; }
+
+	template <typename U>
+	bool operator!=(const CPUAlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+struct NvFlexBuffer
+{
+	NvFlexLibrary* lib;
+
+	std::vector<unsigned char, CPUAlignedAllocator<unsigned char, 64> > memory;
+
+	int count;
+	int stride;
+	NvFlexBufferType type;
+
+	bool mapped;
+};
+
+// static triangle mesh with a uniform grid of triangle references in local space
+struct CPUTriangleMesh
+{
+	std::vector<Vec3> vertices;
+	std::vector<int> indices;
+
+	Vec3 lower;
+	Vec3 upper;
+
+	// grid over the mesh bounds, cellStarts has one more entry than there are cells
+	Vec3 gridOrigin;
+	float gridCellSize;
+	int gridDim[3];
+
+	std::vector<int> cellStarts;
+	std::vector<int> cellTriangles;
+};
+
+struct CPUDistanceField
+{
+	int dim[3];
+	std::vector<float> field;
+};
+
+struct CPUConvexMesh
+{
+	std::vector<Vec4> planes;
+
+	Vec3 lower;
+	Vec3 upper;
+};
+
+struct NvFlexLibrary
+{
+	NvFlexErrorCallback errorFunc;
+
+	std::vector<NvFlexSolver*> solvers;
+
+	// geometry is referenced by index + 1, destroyed entries are NULL
+	std::vector<CPUTriangleMesh*> triangleMeshes;
+	std::vector<CPUDistanceField*> distanceFields;
+	std::vector<CPUConvexMesh*> convexMeshes;
+
+	char deviceName[64];
+};
+
+// a contact plane against a collision shape, generated at the start of each substep
+struct CPUContact
+{
+	Vec3 normal;
+	float offset;		// signed distance of a point x from the shape surface is Dot(normal, x) + offset
+	Vec3 velocity;		// velocity of the shape at the contact
+	int shape;			// index of the shape, -1 for the collision planes in NvFlexParams
+	bool trigger;		// trigger shapes are reported but not solved
+};
+
+struct NvFlexSolver
+{
+	NvFlexLibrary* lib;
+	NvFlexSolverDesc desc;
+	NvFlexParams params;
+
+	NvFlexSolverCallback callbacks[eNvFlexStageCount];
+
+	// particle state in API order, maxParticles in length
+	std::vector<Vec4> particles;
+	std::vector<Vec4> restParticles;
+	std::vector<Vec3> velocities;
+	std::vector<int> phases;
+	std::vector<Vec4> normals;
+	std::vector<Vec4> smoothParticles;
+	std::vector<float> densities;
+	std::vector<Vec4> anisotropy1;
+	std::vector<Vec4> anisotropy2;
+	std::vector<Vec4> anisotropy3;
+
+	std::vector<int> active;
+	int activeCount;
+
+	// distance constraints
+	std::vector<int> springIndices;
+	std::vector<float> springLengths;
+	std::vector<float> springStiffness;
+
+	// shape matching constraints
+	std::vector<int> rigidOffsets;
+	std::vector<int> rigidIndices;
+	std::vector<Vec3> rigidRestPositions;
+	std::vector<Vec4> rigidRestNormals;
+	std::vector<float> rigidStiffness;
+	std::vector<float> rigidThresholds;
+	std::vector<float> rigidCreeps;
+	std::vector<Quat> rigidRotations;
+	std::vector<Vec3> rigidTranslations;
+
+	// dynamic triangles and inflatables
+	std::vector<int> triangleIndices;
+	std::vector<Vec3> triangleNormals;
+
+	std::vector<int> inflatableStarts;
+	std::vector<int> inflatableCounts;
+	std::vector<float> inflatableRestVolumes;
+	std::vector<float> inflatableOverPressures;
+	std::vector<float> inflatableScales;
+
+	// collision shapes
+	std::vector<NvFlexCollisionGeometry> shapeGeometry;
+	std::vector<Vec4> shapePositions;
+	std::vector<Quat> shapeRotations;
+	std::vector<Vec4> shapePrevPositions;
+	std::vector<Quat> shapePrevRotations;
+	std::vector<int> shapeFlags;
+
+	// diffuse particles
+	std::vector<Vec4> diffuseParticles;
+	std::vector<Vec4> diffuseVelocities;
+	int diffuseCount;
+
+	// fluid rest density for the current radius and fluidRestDistance, updated by NvFlexSetParams()
+	float restDensity;
+
+	// particle data in solver order, valid during and after an update
+	int numSorted;
+	std::vector<int> sortedToApi;
+	std::vector<int> apiToSorted;
+
+	std::vector<Vec4> sortedPositions;			// positions at the start of the substep, w = 1/m
+	std::vector<Vec4> sortedPredicted;			// predicted positions being solved for, w = 1/m
+	std::vector<Vec4> sortedVelocities;
+	std::vector<Vec3> sortedStartVelocities;
+	std::vector<int> sortedPhases;
+	std::vector<Vec4> sortedRest;
+
+	std::vector<Vec3> deltas;
+	std::vector<int> deltaCounts;
+
+	// hashed uniform grid over the predicted positions
+	std::vector<int> cellStarts;
+	std::vector<int> cellParticles;
+	std::vector<int> particleCells;
+
+	// neighbors and contacts from the last substep, stored contiguously with maxNeighborsPerParticle (maxContactsPerParticle) per-particle
+	std::vector<int> neighbors;
+	std::vector<int> neighborCounts;
+	std::vector<CPUContact> contacts;
+	std::vector<int> contactCounts;
+
+	std::vector<float> sortedDensities;
+	std::vector<float> lambdas;
+
+	// constraints remapped to solver order at the start of each update, and per-particle adjacency for gathers
+	std::vector<int> sortedSpringIndices;
+	std::vector<int> particleSpringStarts;
+	std::vector<int> particleSprings;
+
+	std::vector<int> sortedRigidIndices;
+	std::vector<int> particleRigidStarts;
+	std::vector<int> particleRigidEntries;		// index into rigidIndices
+	std::vector<int> rigidOfEntry;
+	std::vector<Vec3> rigidGoals;
+	std::vector<Vec3> rigidCenters;
+
+	std::vector<int> sortedTriangleIndices;
+	std::vector<int> particleTriangleStarts;
+	std::vector<int> particleTriangles;
+	std::vector<Vec3> inflatableGradients;
+
+	Vec3 boundsLower;
+	Vec3 boundsUpper;
+
+	NvFlexTimers timers;
+	float lastUpdateTime;
+};
+
+// reports an error through the library's error callback
+void CPUReportError(NvFlexLibrary* lib, NvFlexErrorSeverity severity, const char* msg, const char* file, int line);
+
+// calculates the rest density of a fluid sampled at params.fluidRestDistance with kernel radius params.radius
+float CPUCalculateRestDensity(const NvFlexParams& params);
+
+// builds the triangle grid used for contact queries
+void CPUBuildTriangleMeshGrid(CPUTriangleMesh* mesh);
+
+// generates contact planes for each particle in solver order against the collision planes and shapes
+void CPUCollideShapes(NvFlexSolver* s, float dt);
+
+// advances the solver by one NvFlexUpdateSolver() call
+void CPUUpdateSolver(NvFlexSolver* s, float dt, int substeps, bool enableTimers);
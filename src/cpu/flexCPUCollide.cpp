@@ -0,0 +1,627 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#include "flexCPU.h"
+
+#include <algorithm>
+#include <cfloat>
+
+void CPUBuildTriangleMeshGrid(CPUTriangleMesh* mesh)
+{
+	const int numTris = int(mesh->indices.size())/3;
+
+	Vec3 lower(FLT_MAX);
+	Vec3 upper(-FLT_MAX);
+
+	for (size_t i=0; i < mesh->vertices.size(); ++i)
+	{
+		lower = Min(lower, mesh->vertices[i]);
+		upper = Max(upper, mesh->vertices[i]);
+	}
+
+	if (numTris == 0 || mesh->vertices.empty())
+	{
+		mesh->gridOrigin = Vec3(0.0f);
+		mesh->gridCellSize = 1.0f;
+		mesh->gridDim[0] = mesh->gridDim[1] = mesh->gridDim[2] = 1;
+		mesh->cellStarts.assign(2, 0);
+		mesh->cellTriangles.clear();
+		return;
+	}
+
+	// aim for roughly one triangle per-cell, flat meshes fall back to an area based estimate
+	const Vec3 edges = upper-lower;
+	const float maxEdge = Max(Max(edges.x, edges.y), edges.z);
+	const float volume = edges.x*edges.y*edges.z;
+
+	const int maxDim = 128;
+	
+	float cellSize = volume > 0.0f ? powf(volume/numTris, 1.0f/3.0f) : maxEdge/sqrtf(float(numTris));
+	cellSize = Max(cellSize, Max(maxEdge/maxDim, 1.e-4f));
+
+	mesh->gridOrigin = lower;
+	mesh->gridCellSize = cellSize;
+
+	for (int a=0; a < 3; ++a)
+		mesh->gridDim[a] = Clamp(int(edges[a]/cellSize) + 1, 1, maxDim);
+
+	const int numCells = mesh->gridDim[0]*mesh->gridDim[1]*mesh->gridDim[2];
+
+	// count then fill so every cell's triangles are contiguous
+	std::vector<int> ranges(numTris*6);
+
+	mesh->cellStarts.assign(numCells+1, 0);
+
+	for (int t=0; t < numTris; ++t)
+	{
+		const Vec3 a = mesh->vertices[mesh->indices[t*3+0]];
+		const Vec3 b = mesh->vertices[mesh->indices[t*3+1]];
+		const Vec3 c = mesh->vertices[mesh->indices[t*3+2]];
+
+		const Vec3 triLower = Min(Min(a, b), c);
+		const Vec3 triUpper = Max(Max(a, b), c);
+
+		int* r = &ranges[t*6];
+		for (int k=0; k < 3; ++k)
+		{
+			r[k] = Clamp(int((triLower[k]-lower[k])/cellSize), 0, mesh->gridDim[k]-1);
+			r[k+3] = Clamp(int((triUpper[k]-lower[k])/cellSize), 0, mesh->gridDim[k]-1);
+		}
+
+		for (int z=r[2]; z <= r[5]; ++z)
+			for (int y=r[1]; y <= r[4]; ++y)
+				for (int x=r[0]; x <= r[3]; ++x)
+					mesh->cellStarts[(z*mesh->gridDim[1] + y)*mesh->gridDim[0] + x + 1]++;
+	}
+
+	for (int i=0; i < numCells; ++i)
+		mesh->cellStarts[i+1] += mesh->cellStarts[i];
+
+	mesh->cellTriangles.resize(mesh->cellStarts[numCells]);
+
+	std::vector<int> cursor(mesh->cellStarts.begin(), mesh->cellStarts.end()-1);
+
+	for (int t=0; t < numTris; ++t)
+	{
+		const int* r = &ranges[t*6];
+
+		for (int z=r[2]; z <= r[5]; ++z)
+			for (int y=r[1]; y <= r[4]; ++y)
+				for (int x=r[0]; x <= r[3]; ++x)
+					mesh->cellTriangles[cursor[(z*mesh->gridDim[1] + y)*mesh->gridDim[0] + x]++] = t;
+	}
+}
+
+namespace
+{
+
+// a shape resolved against the library for the duration of contact generation
+struct ShapeInstance
+{
+	int type;
+	int channels;
+	bool trigger;
+
+	Vec3 position;
+	Quat rotation;
+	Vec3 prevPosition;
+	Quat prevRotation;
+
+	Vec3 lower;
+	Vec3 upper;
+
+	const NvFlexCollisionGeometry* geometry;
+	const CPUTriangleMesh* mesh;
+	const CPUConvexMesh* convex;
+	const CPUDistanceField* field;
+};
+
+// per-particle list of the closest contacts, once full the furthest contact is replaced
+struct ContactList
+{
+	CPUContact* contacts;
+	int count;
+	int max;
+	Vec3 x;
+
+	void Add(const Vec3& normal, float distance, const Vec3& velocity, int shape, bool trigger)
+	{
+		CPUContact c;
+		c.normal = normal;
+		c.offset = distance - Dot(normal, x);
+		c.velocity = velocity;
+		c.shape = shape;
+		c.trigger = trigger;
+
+		if (count < max)
+		{
+			contacts[count++] = c;
+			return;
+		}
+
+		int furthest = 0;
+		float furthestDistance = -FLT_MAX;
+
+		for (int i=0; i < count; ++i)
+		{
+			const float d = Dot(contacts[i].normal, x) + contacts[i].offset;
+			if (d > furthestDistance)
+			{
+				furthestDistance = d;
+				furthest = i;
+			}
+		}
+
+		if (distance < furthestDistance)
+			contacts[furthest] = c;
+	}
+};
+
+// world space AABB of a local space box under a rigid transform
+void TransformBounds(const Vec3& localLower, const Vec3& localUpper, const Vec3& position, const Quat& rotation, Vec3& lower, Vec3& upper)
+{
+	const Matrix33 m(rotation);
+
+	const Vec3 center = position + m*(0.5f*(localLower + localUpper));
+	const Vec3 halfEdges = 0.5f*(localUpper - localLower);
+
+	Vec3 extents;
+	for (int a=0; a < 3; ++a)
+		extents[a] = fabsf(m.cols[0][a])*halfEdges.x + fabsf(m.cols[1][a])*halfEdges.y + fabsf(m.cols[2][a])*halfEdges.z;
+
+	lower = center - extents;
+	upper = center + extents;
+}
+
+// scaled local bounds are computed with Min/Max so that negative scales are handled
+void ScaleBounds(const Vec3& lower, const Vec3& upper, const Vec3& scale, Vec3& outLower, Vec3& outUpper)
+{
+	const Vec3 a = Vec3(lower.x*scale.x, lower.y*scale.y, lower.z*scale.z);
+	const Vec3 b = Vec3(upper.x*scale.x, upper.y*scale.y, upper.z*scale.z);
+
+	outLower = Min(a, b);
+	outUpper = Max(a, b);
+}
+
+float SampleField(const CPUDistanceField* f, int x, int y, int z)
+{
+	x = Clamp(x, 0, f->dim[0]-1);
+	y = Clamp(y, 0, f->dim[1]-1);
+	z = Clamp(z, 0, f->dim[2]-1);
+
+	return f->field[(z*f->dim[1] + y)*f->dim[0] + x];
+}
+
+// trilinear lookup, u is the field's local coordinate in [0, 1]^3 with samples at voxel centers
+float SampleField(const CPUDistanceField* f, const Vec3& u)
+{
+	const float fx = Clamp(u.x, 0.0f, 1.0f)*f->dim[0] - 0.5f;
+	const float fy = Clamp(u.y, 0.0f, 1.0f)*f->dim[1] - 0.5f;
+	const float fz = Clamp(u.z, 0.0f, 1.0f)*f->dim[2] - 0.5f;
+
+	const int x = int(floorf(fx));
+	const int y = int(floorf(fy));
+	const int z = int(floorf(fz));
+
+	const float tx = fx-x;
+	const float ty = fy-y;
+	const float tz = fz-z;
+
+	const float d00 = Lerp(SampleField(f, x, y, z), SampleField(f, x+1, y, z), tx);
+	const float d10 = Lerp(SampleField(f, x, y+1, z), SampleField(f, x+1, y+1, z), tx);
+	const float d01 = Lerp(SampleField(f, x, y, z+1), SampleField(f, x+1, y, z+1), tx);
+	const float d11 = Lerp(SampleField(f, x, y+1, z+1), SampleField(f, x+1, y+1, z+1), tx);
+
+	return Lerp(Lerp(d00, d10, ty), Lerp(d01, d11, ty), tz);
+}
+
+// shape velocity at a world space point, computed from the previous and current transforms
+Vec3 ShapeVelocity(const ShapeInstance& shape, const Vec3& p, float invDt)
+{
+	const Vec3 local = RotateInv(shape.rotation, p - shape.position);
+	const Vec3 prev = shape.prevPosition + Rotate(shape.prevRotation, local);
+
+	return (p - prev)*invDt;
+}
+
+// closest point queries in the shape's (unscaled) rotated local space, return false if there is no contact within maxDistance
+bool CollideSphere(const ShapeInstance& shape, const Vec3& x, float maxDistance, Vec3& n, float& d)
+{
+	const float l = Length(x);
+	d = l - shape.geometry->sphere.radius;
+	n = l > 0.0f ? x/l : Vec3(0.0f, 1.0f, 0.0f);
+
+	return d < maxDistance;
+}
+
+bool CollideCapsule(const ShapeInstance& shape, const Vec3& x, float maxDistance, Vec3& n, float& d)
+{
+	const float h = shape.geometry->capsule.halfHeight;
+	const Vec3 c(Clamp(x.x, -h, h), 0.0f, 0.0f);
+
+	const Vec3 delta = x-c;
+	const float l = Length(delta);
+
+	d = l - shape.geometry->capsule.radius;
+	n = l > 0.0f ? delta/l : Vec3(0.0f, 1.0f, 0.0f);
+
+	return d < maxDistance;
+}
+
+bool CollideBox(const ShapeInstance& shape, const Vec3& x, float maxDistance, Vec3& n, float& d)
+{
+	const Vec3 e(shape.geometry->box.halfExtents);
+	const Vec3 q = Vec3(fabsf(x.x), fabsf(x.y), fabsf(x.z)) - e;
+
+	if (q.x > 0.0f || q.y > 0.0f || q.z > 0.0f)
+	{
+		const Vec3 outside = Max(q, Vec3(0.0f));
+		d = Length(outside);
+		n = Vec3(outside.x*Sign(x.x), outside.y*Sign(x.y), outside.z*Sign(x.z))/d;
+	}
+	else
+	{
+		// inside, push out through the nearest face
+		int axis = 0;
+		if (q.y > q[axis]) axis = 1;
+		if (q.z > q[axis]) axis = 2;
+
+		d = q[axis];
+		n = Vec3(0.0f);
+		n[axis] = Sign(x[axis]);
+	}
+
+	return d < maxDistance;
+}
+
+bool CollideConvex(const ShapeInstance& shape, const Vec3& x, float maxDistance, Vec3& n, float& d)
+{
+	const Vec3 scale(shape.geometry->convexMesh.scale);
+	const std::vector<Vec4>& planes = shape.convex->planes;
+
+	d = -FLT_MAX;
+
+	for (size_t i=0; i < planes.size(); ++i)
+	{
+		// transform the local plane by the (non-uniform) scale and renormalize
+		const Vec3 scaledNormal(planes[i].x/scale.x, planes[i].y/scale.y, planes[i].z/scale.z);
+		const float l = Length(scaledNormal);
+
+		if (l == 0.0f)
+			continue;
+
+		const float pd = (Dot(scaledNormal, x) + planes[i].w)/l;
+		if (pd > d)
+		{
+			d = pd;
+			n = scaledNormal/l;
+		}
+	}
+
+	return !planes.empty() && d < maxDistance;
+}
+
+bool CollideSDF(const ShapeInstance& shape, const Vec3& x, float maxDistance, Vec3& n, float& d)
+{
+	const float scale = shape.geometry->sdf.scale;
+	if (scale <= 0.0f)
+		return false;
+
+	const Vec3 u = x/scale;
+
+	// outside of the field use the distance to the field bounds as a lower bound
+	const Vec3 clamped = Max(Min(u, Vec3(1.0f)), Vec3(0.0f));
+	const float outside = Length(u-clamped)*scale;
+
+	d = SampleField(shape.field, clamped)*scale + outside;
+	if (d >= maxDistance)
+		return false;
+
+	// central differences at half voxel spacing
+	const float eps = 0.5f/Max(Max(shape.field->dim[0], shape.field->dim[1]), shape.field->dim[2]);
+
+	const Vec3 grad(
+		SampleField(shape.field, clamped + Vec3(eps, 0.0f, 0.0f)) - SampleField(shape.field, clamped - Vec3(eps, 0.0f, 0.0f)),
+		SampleField(shape.field, clamped + Vec3(0.0f, eps, 0.0f)) - SampleField(shape.field, clamped - Vec3(0.0f, eps, 0.0f)),
+		SampleField(shape.field, clamped + Vec3(0.0f, 0.0f, eps)) - SampleField(shape.field, clamped - Vec3(0.0f, 0.0f, eps)));
+
+	n = SafeNormalize(grad, outside > 0.0f ? SafeNormalize(u-clamped, Vec3(0.0f, 1.0f, 0.0f)) : Vec3(0.0f, 1.0f, 0.0f));
+
+	return true;
+}
+
+// triangle meshes may produce a contact per nearby triangle, these are added directly to the particle's contact list
+void CollideTriangleMesh(const ShapeInstance& shape, int shapeIndex, const Vec3& x, const Vec3& localX, float maxDistance, float invDt, ContactList& list)
+{
+	const CPUTriangleMesh* mesh = shape.mesh;
+	if (mesh->cellTriangles.empty())
+		return;
+
+	const Vec3 scale(shape.geometry->triMesh.scale);
+	if (scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f)
+		return;
+
+	// query box in the unscaled mesh space
+	Vec3 queryLower, queryUpper;
+	ScaleBounds(localX - Vec3(maxDistance), localX + Vec3(maxDistance), Vec3(1.0f/scale.x, 1.0f/scale.y, 1.0f/scale.z), queryLower, queryUpper);
+
+	int r[6];
+	for (int k=0; k < 3; ++k)
+	{
+		const float lo = (queryLower[k]-mesh->gridOrigin[k])/mesh->gridCellSize;
+		const float hi = (queryUpper[k]-mesh->gridOrigin[k])/mesh->gridCellSize;
+
+		if (hi < 0.0f || lo >= mesh->gridDim[k])
+			return;
+
+		r[k] = Clamp(int(lo), 0, mesh->gridDim[k]-1);
+		r[k+3] = Clamp(int(hi), 0, mesh->gridDim[k]-1);
+	}
+
+	// triangles spanning several cells are visited once, the candidate set is small so a linear check suffices
+	const int maxCandidates = 64;
+	int candidates[maxCandidates];
+	int numCandidates = 0;
+
+	for (int z=r[2]; z <= r[5]; ++z)
+	{
+		for (int y=r[1]; y <= r[4]; ++y)
+		{
+			for (int cx=r[0]; cx <= r[3]; ++cx)
+			{
+				const int cell = (z*mesh->gridDim[1] + y)*mesh->gridDim[0] + cx;
+
+				for (int i=mesh->cellStarts[cell]; i < mesh->cellStarts[cell+1]; ++i)
+				{
+					const int t = mesh->cellTriangles[i];
+
+					bool seen = false;
+					for (int c=0; c < numCandidates && !seen; ++c)
+						seen = candidates[c] == t;
+
+					if (seen)
+						continue;
+
+					if (numCandidates < maxCandidates)
+						candidates[numCandidates++] = t;
+
+					const Vec3 a = scale*mesh->vertices[mesh->indices[t*3+0]];
+					const Vec3 b = scale*mesh->vertices[mesh->indices[t*3+1]];
+					const Vec3 c = scale*mesh->vertices[mesh->indices[t*3+2]];
+
+					float v, w;
+					const Vec3 p = ClosestPointOnTriangle(a, b, c, localX, v, w);
+
+					const Vec3 delta = localX-p;
+					const float d = Length(delta);
+
+					if (d >= maxDistance)
+						continue;
+
+					// meshes are two sided, use the face normal when the closest point is on the interior of the face
+					const Vec3 faceNormal = SafeNormalize(Cross(b-a, c-a));
+					const bool interior = v > 0.0f && w > 0.0f && v + w < 1.0f;
+
+					Vec3 n;
+					if (interior || d < 1.e-6f)
+						n = faceNormal*Sign(Dot(delta, faceNormal));
+					else
+						n = delta/d;
+
+					const Vec3 worldNormal = Rotate(shape.rotation, n);
+					const Vec3 worldPoint = shape.position + Rotate(shape.rotation, p);
+
+					list.Add(worldNormal, Dot(worldNormal, x-worldPoint), ShapeVelocity(shape, worldPoint, invDt), shapeIndex, shape.trigger);
+				}
+			}
+		}
+	}
+}
+
+} // anonymous namespace
+
+void CPUCollideShapes(NvFlexSolver* s, float dt)
+{
+	const NvFlexParams& params = s->params;
+	const int numShapes = int(s->shapeFlags.size());
+	const int maxContacts = s->desc.maxContactsPerParticle;
+	const float maxDistance = params.collisionDistance + params.shapeCollisionMargin;
+	const float invDt = 1.0f/dt;
+
+	// resolve geometry and compute world space bounds once per substep
+	std::vector<ShapeInstance> shapes;
+	shapes.reserve(numShapes);
+
+	std::vector<int> shapeIndices;
+	shapeIndices.reserve(numShapes);
+
+	for (int i=0; i < numShapes; ++i)
+	{
+		ShapeInstance shape;
+		shape.type = s->shapeFlags[i] & eNvFlexShapeFlagTypeMask;
+		shape.channels = s->shapeFlags[i] & eNvFlexPhaseShapeChannelMask;
+		shape.trigger = (s->shapeFlags[i] & eNvFlexShapeFlagTrigger) != 0;
+		shape.position = Vec3(s->shapePositions[i]);
+		shape.rotation = s->shapeRotations[i];
+		shape.prevPosition = Vec3(s->shapePrevPositions[i]);
+		shape.prevRotation = s->shapePrevRotations[i];
+		shape.geometry = &s->shapeGeometry[i];
+		shape.mesh = NULL;
+		shape.convex = NULL;
+		shape.field = NULL;
+
+		Vec3 localLower, localUpper;
+
+		switch (shape.type)
+		{
+			case eNvFlexShapeSphere:
+			{
+				localLower = Vec3(-shape.geometry->sphere.radius);
+				localUpper = Vec3(shape.geometry->sphere.radius);
+				break;
+			}
+			case eNvFlexShapeCapsule:
+			{
+				const float r = shape.geometry->capsule.radius;
+				const float h = shape.geometry->capsule.halfHeight;
+				localLower = Vec3(-h-r, -r, -r);
+				localUpper = Vec3(h+r, r, r);
+				break;
+			}
+			case eNvFlexShapeBox:
+			{
+				localUpper = Vec3(shape.geometry->box.halfExtents);
+				localLower = -localUpper;
+				break;
+			}
+			case eNvFlexShapeConvexMesh:
+			{
+				NvFlexLibrary* lib = s->lib;
+				const unsigned int id = shape.geometry->convexMesh.mesh;
+				shape.convex = (id && id <= lib->convexMeshes.size()) ? lib->convexMeshes[id-1] : NULL;
+				if (!shape.convex)
+					continue;
+
+				ScaleBounds(shape.convex->lower, shape.convex->upper, Vec3(shape.geometry->convexMesh.scale), localLower, localUpper);
+				break;
+			}
+			case eNvFlexShapeTriangleMesh:
+			{
+				NvFlexLibrary* lib = s->lib;
+				const unsigned int id = shape.geometry->triMesh.mesh;
+				shape.mesh = (id && id <= lib->triangleMeshes.size()) ? lib->triangleMeshes[id-1] : NULL;
+				if (!shape.mesh || shape.mesh->vertices.empty())
+					continue;
+
+				const Vec3 meshLower = shape.mesh->gridOrigin;
+				const Vec3 meshUpper = shape.mesh->gridOrigin + Vec3(float(shape.mesh->gridDim[0]), float(shape.mesh->gridDim[1]), float(shape.mesh->gridDim[2]))*shape.mesh->gridCellSize;
+
+				ScaleBounds(meshLower, meshUpper, Vec3(shape.geometry->triMesh.scale), localLower, localUpper);
+				break;
+			}
+			case eNvFlexShapeSDF:
+			{
+				NvFlexLibrary* lib = s->lib;
+				const unsigned int id = shape.geometry->sdf.field;
+				shape.field = (id && id <= lib->distanceFields.size()) ? lib->distanceFields[id-1] : NULL;
+				if (!shape.field || shape.field->field.empty())
+					continue;
+
+				localLower = Vec3(0.0f);
+				localUpper = Vec3(shape.geometry->sdf.scale);
+				break;
+			}
+			default:
+				continue;
+		};
+
+		TransformBounds(localLower, localUpper, shape.position, shape.rotation, shape.lower, shape.upper);
+
+		shape.lower -= Vec3(maxDistance);
+		shape.upper += Vec3(maxDistance);
+
+		shapes.push_back(shape);
+		shapeIndices.push_back(i);
+	}
+
+	GetDefaultThreadPool().ParallelFor(0, s->numSorted, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			ContactList list;
+			list.contacts = &s->contacts[size_t(i)*maxContacts];
+			list.count = 0;
+			list.max = maxContacts;
+			list.x = Vec3(s->sortedPredicted[i]);
+
+			const Vec3 x = list.x;
+
+			// fixed particles do not respond to collisions
+			if (s->sortedPredicted[i].w == 0.0f)
+			{
+				s->contactCounts[i] = 0;
+				continue;
+			}
+
+			for (int p=0; p < params.numPlanes; ++p)
+			{
+				const Vec3 n(params.planes[p]);
+				const float d = Dot(n, x) + params.planes[p][3];
+
+				if (d < maxDistance)
+					list.Add(n, d, Vec3(0.0f), -1, false);
+			}
+
+			// particles without any channel bits set collide with every shape
+			int channels = s->sortedPhases[i] & eNvFlexPhaseShapeChannelMask;
+			if (channels == 0)
+				channels = eNvFlexPhaseShapeChannelMask;
+
+			for (size_t j=0; j < shapes.size(); ++j)
+			{
+				const ShapeInstance& shape = shapes[j];
+
+				if ((shape.channels & channels) == 0)
+					continue;
+
+				if (x.x < shape.lower.x || x.y < shape.lower.y || x.z < shape.lower.z ||
+					x.x > shape.upper.x || x.y > shape.upper.y || x.z > shape.upper.z)
+					continue;
+
+				const Vec3 localX = RotateInv(shape.rotation, x - shape.position);
+
+				if (shape.type == eNvFlexShapeTriangleMesh)
+				{
+					CollideTriangleMesh(shape, shapeIndices[j], x, localX, maxDistance, invDt, list);
+					continue;
+				}
+
+				Vec3 n;
+				float d;
+				bool hit = false;
+
+				switch (shape.type)
+				{
+					case eNvFlexShapeSphere: hit = CollideSphere(shape, localX, maxDistance, n, d); break;
+					case eNvFlexShapeCapsule: hit = CollideCapsule(shape, localX, maxDistance, n, d); break;
+					case eNvFlexShapeBox: hit = CollideBox(shape, localX, maxDistance, n, d); break;
+					case eNvFlexShapeConvexMesh: hit = CollideConvex(shape, localX, maxDistance, n, d); break;
+					case eNvFlexShapeSDF: hit = CollideSDF(shape, localX, maxDistance, n, d); break;
+				};
+
+				if (hit)
+				{
+					const Vec3 worldNormal = Rotate(shape.rotation, n);
+					list.Add(worldNormal, d, ShapeVelocity(shape, x - worldNormal*d, invDt), shapeIndices[j], shape.trigger);
+				}
+			}
+
+			s->contactCounts[i] = list.count;
+		}
+
+	}, 0, 256);
+}
@@ -0,0 +1,1499 @@
+// This code contains NVIDIA Confidential Information and is disclosed to you
+// under a form of NVIDIA software license agreement provided separately to you.
+//
+// Notice
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software and related documentation and
+// any modifications thereto. Any use, reproduction, disclosure, or
+// distribution of this software and related documentation without an express
+// license agreement from NVIDIA Corporation is strictly prohibited.
+//
+// ALL NVIDIA DESIGN SPECIFICATIONS, CODE ARE PROVIDED "AS IS.". NVIDIA MAKES
+// NO WARRANTIES, EXPRESSED, IMPLIED, STATUTORY, OR OTHERWISE WITH RESPECT TO
+// THE MATERIALS, AND EXPRESSLY DISCLAIMS ALL IMPLIED WARRANTIES OF NONINFRINGEMENT,
+// MERCHANTABILITY, AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Information and code furnished is believed to be accurate and reliable.
+// However, NVIDIA Corporation assumes no responsibility for the consequences of use of such
+// information or for any infringement of patents or other rights of third parties that may
+// result from its use. No license is granted by implication or otherwise under any patent
+// or patent rights of NVIDIA Corporation. Details are subject to change without notice.
+// This code supersedes and replaces all information previously supplied.
+// NVIDIA Corporation products are not authorized for use as critical
+// components in life support devices or systems without express written approval of
+// NVIDIA Corporation.
+//
+// Copyright (c) 2013-2020 NVIDIA Corporation. All rights reserved.
+
+#include "flexCPU.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cstring>
+
+namespace
+{
+
+const float kPi = 3.14159265358979f;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// accumulates elapsed time into a solver timer when timers are enabled
+struct ScopedTimer
+{
+	ScopedTimer(float* timer, bool enabled) : timer(enabled ? timer : NULL)
+	{
+		if (timer)
+			start = Clock::now();
+	}
+
+	~ScopedTimer()
+	{
+		if (timer)
+			*timer += std::chrono::duration<float>(Clock::now() - start).count();
+	}
+
+	float* timer;
+	Clock::time_point start;
+};
+
+// SPH kernels with support radius h, coefficients are computed once per update
+struct Kernels
+{
+	Kernels(float h) : h(h), hSq(h*h), poly6(315.0f/(64.0f*kPi*powf(h, 9.0f))), spiky(-45.0f/(kPi*powf(h, 6.0f))) {}
+
+	float Poly6(float rSq) const
+	{
+		const float x = hSq - rSq;
+		return x > 0.0f ? poly6*x*x*x : 0.0f;
+	}
+
+	// magnitude of the spiky kernel gradient, the gradient points along the direction between particles
+	float SpikyGrad(float r) const
+	{
+		const float x = h - r;
+		return x > 0.0f ? spiky*x*x : 0.0f;
+	}
+
+	float h;
+	float hSq;
+	float poly6;
+	float spiky;
+};
+
+template <typename Func>
+void ParallelForParticles(NvFlexSolver* s, Func func, int minChunk=256)
+{
+	GetDefaultThreadPool().ParallelFor(0, s->numSorted, func, 0, minChunk);
+}
+
+void InvokeCallback(NvFlexSolver* s, NvFlexSolverCallbackStage stage, Vec4* particles, float dt)
+{
+	const NvFlexSolverCallback& callback = s->callbacks[stage];
+	if (!callback.function)
+		return;
+
+	NvFlexSolverCallbackParams params;
+	params.solver = s;
+	params.userData = callback.userData;
+	params.particles = s->numSorted ? (float*)&particles[0] : NULL;
+	params.velocities = s->numSorted ? (float*)&s->sortedVelocities[0] : NULL;
+	params.phases = s->numSorted ? &s->sortedPhases[0] : NULL;
+	params.numActive = s->numSorted;
+	params.dt = dt;
+	params.originalToSortedMap = s->apiToSorted.empty() ? NULL : &s->apiToSorted[0];
+	params.sortedToOriginalMap = s->sortedToApi.empty() ? NULL : &s->sortedToApi[0];
+
+	callback.function(params);
+}
+
+// builds a compressed per-particle adjacency from constraint indices, entries referencing inactive particles are -1
+void BuildAdjacency(int numParticles, const std::vector<int>& indices, int indicesPerEntry, std::vector<int>& starts, std::vector<int>& entries)
+{
+	starts.assign(numParticles+1, 0);
+
+	for (size_t i=0; i < indices.size(); ++i)
+		if (indices[i] >= 0)
+			starts[indices[i]+1]++;
+
+	for (int i=0; i < numParticles; ++i)
+		starts[i+1] += starts[i];
+
+	entries.resize(starts[numParticles]);
+
+	std::vector<int> cursor(starts.begin(), starts.end()-1);
+
+	for (size_t i=0; i < indices.size(); ++i)
+		if (indices[i] >= 0)
+			entries[cursor[indices[i]]++] = int(i)/indicesPerEntry;
+}
+
+inline int ToSorted(const NvFlexSolver* s, int apiIndex)
+{
+	if (apiIndex < 0 || apiIndex >= s->desc.maxParticles)
+		return -1;
+
+	const int i = s->apiToSorted[apiIndex];
+	return i < s->numSorted ? i : -1;
+}
+
+inline int CellCoord(float x, float invCellSize)
+{
+	return int(floorf(x*invCellSize));
+}
+
+inline unsigned int HashCell(int x, int y, int z, unsigned int mask)
+{
+	return (unsigned(x)*73856093u ^ unsigned(y)*19349663u ^ unsigned(z)*83492791u) & mask;
+}
+
+// interleaves the low 10 bits of each coordinate, used to sort particles spatially
+inline unsigned int MortonKey(int x, int y, int z)
+{
+	unsigned int key = 0;
+
+	for (int b=0; b < 10; ++b)
+	{
+		key |= ((unsigned(x) >> b) & 1u) << (3*b+0);
+		key |= ((unsigned(y) >> b) & 1u) << (3*b+1);
+		key |= ((unsigned(z) >> b) & 1u) << (3*b+2);
+	}
+
+	return key;
+}
+
+// gathers the active particles into solver order sorted by grid cell and remaps constraints to that order
+void Gather(NvFlexSolver* s)
+{
+	const int maxParticles = s->desc.maxParticles;
+	const float invCellSize = 1.0f/(s->params.radius + s->params.particleCollisionMargin);
+
+	std::vector<unsigned char> isActive(maxParticles, 0);
+	std::vector<std::pair<unsigned int, int> > keys;
+	keys.reserve(s->activeCount);
+
+	for (int i=0; i < s->activeCount; ++i)
+	{
+		const int index = s->active[i];
+
+		if (index < 0 || index >= maxParticles || isActive[index])
+			continue;
+
+		isActive[index] = 1;
+
+		const Vec4& p = s->particles[index];
+		keys.push_back(std::make_pair(MortonKey(CellCoord(p.x, invCellSize), CellCoord(p.y, invCellSize), CellCoord(p.z, invCellSize)), index));
+	}
+
+	std::sort(keys.begin(), keys.end());
+
+	s->numSorted = int(keys.size());
+
+	// inactive particles follow in API order so that the maps are a complete permutation
+	int next = 0;
+	for (size_t i=0; i < keys.size(); ++i)
+		s->sortedToApi[next++] = keys[i].second;
+
+	for (int i=0; i < maxParticles; ++i)
+		if (!isActive[i])
+			s->sortedToApi[next++] = i;
+
+	for (int i=0; i < maxParticles; ++i)
+		s->apiToSorted[s->sortedToApi[i]] = i;
+
+	const int n = s->numSorted;
+
+	// outputs for particles that are no longer active are cleared
+	std::fill(s->neighborCounts.begin() + n, s->neighborCounts.end(), 0);
+	std::fill(s->contactCounts.begin() + n, s->contactCounts.end(), 0);
+
+	s->sortedPositions.resize(n);
+	s->sortedPredicted.resize(n);
+	s->sortedVelocities.resize(n);
+	s->sortedStartVelocities.resize(n);
+	s->sortedPhases.resize(n);
+	s->sortedRest.resize(n);
+	s->sortedDensities.assign(n, 0.0f);
+	s->lambdas.resize(n);
+	s->deltas.assign(n, Vec3(0.0f));
+	s->deltaCounts.assign(n, 0);
+	s->particleCells.resize(n);
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const int api = s->sortedToApi[i];
+
+			s->sortedPositions[i] = s->particles[api];
+			s->sortedPredicted[i] = s->particles[api];
+			s->sortedVelocities[i] = Vec4(s->velocities[api], 0.0f);
+			s->sortedPhases[i] = s->phases[api];
+			s->sortedRest[i] = s->restParticles[api];
+		}
+	});
+
+	// springs
+	const int numSprings = int(s->springLengths.size());
+	s->sortedSpringIndices.resize(numSprings*2);
+
+	for (int i=0; i < numSprings; ++i)
+	{
+		const int a = ToSorted(s, s->springIndices[i*2+0]);
+		const int b = ToSorted(s, s->springIndices[i*2+1]);
+
+		const bool valid = a >= 0 && b >= 0 && a != b;
+
+		s->sortedSpringIndices[i*2+0] = valid ? a : -1;
+		s->sortedSpringIndices[i*2+1] = valid ? b : -1;
+	}
+
+	BuildAdjacency(n, s->sortedSpringIndices, 2, s->particleSpringStarts, s->particleSprings);
+
+	// rigids, an entry is an index into the rigid indices array
+	const int numRigids = int(s->rigidStiffness.size());
+	const int numRigidIndices = int(s->rigidIndices.size());
+
+	s->sortedRigidIndices.resize(numRigidIndices);
+	s->rigidOfEntry.assign(numRigidIndices, -1);
+	s->rigidGoals.resize(numRigidIndices);
+	s->rigidCenters.resize(numRigids);
+
+	for (int r=0; r < numRigids; ++r)
+		for (int e=s->rigidOffsets[r]; e < s->rigidOffsets[r+1]; ++e)
+			s->rigidOfEntry[e] = r;
+
+	for (int e=0; e < numRigidIndices; ++e)
+		s->sortedRigidIndices[e] = s->rigidOfEntry[e] >= 0 ? ToSorted(s, s->rigidIndices[e]) : -1;
+
+	BuildAdjacency(n, s->sortedRigidIndices, 1, s->particleRigidStarts, s->particleRigidEntries);
+
+	// dynamic triangles
+	const int numTris = int(s->triangleIndices.size())/3;
+	s->sortedTriangleIndices.resize(numTris*3);
+
+	for (int t=0; t < numTris; ++t)
+	{
+		const int a = ToSorted(s, s->triangleIndices[t*3+0]);
+		const int b = ToSorted(s, s->triangleIndices[t*3+1]);
+		const int c = ToSorted(s, s->triangleIndices[t*3+2]);
+
+		const bool valid = a >= 0 && b >= 0 && c >= 0;
+
+		s->sortedTriangleIndices[t*3+0] = valid ? a : -1;
+		s->sortedTriangleIndices[t*3+1] = valid ? b : -1;
+		s->sortedTriangleIndices[t*3+2] = valid ? c : -1;
+	}
+
+	BuildAdjacency(n, s->sortedTriangleIndices, 3, s->particleTriangleStarts, s->particleTriangles);
+
+	s->triangleNormals.resize(numTris);
+}
+
+// writes solver state back to API order
+void Scatter(NvFlexSolver* s)
+{
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const int api = s->sortedToApi[i];
+
+			s->particles[api] = s->sortedPositions[i];
+			s->velocities[api] = Vec3(s->sortedVelocities[i]);
+			s->phases[api] = s->sortedPhases[i];
+			s->densities[api] = s->sortedDensities[i];
+		}
+	});
+}
+
+// cloth drag and lift for a single triangle, returns the force applied to each of its vertices
+Vec3 TriangleAeroForce(const NvFlexSolver* s, int t)
+{
+	const NvFlexParams& params = s->params;
+
+	const int a = s->sortedTriangleIndices[t*3+0];
+	const int b = s->sortedTriangleIndices[t*3+1];
+	const int c = s->sortedTriangleIndices[t*3+2];
+
+	const Vec3 pa(s->sortedPositions[a]);
+	const Vec3 pb(s->sortedPositions[b]);
+	const Vec3 pc(s->sortedPositions[c]);
+
+	const Vec3 v = (Vec3(s->sortedVelocities[a]) + Vec3(s->sortedVelocities[b]) + Vec3(s->sortedVelocities[c]))/3.0f - Vec3(params.wind);
+
+	const Vec3 areaNormal = 0.5f*Cross(pb-pa, pc-pa);
+	const float area = Length(areaNormal);
+	const float speed = Length(v);
+
+	if (area == 0.0f || speed == 0.0f)
+		return Vec3(0.0f);
+
+	const Vec3 n = areaNormal/area;
+	const Vec3 dir = v/speed;
+
+	// orient the normal to face the flow so that lift has a consistent sign
+	const float cosTheta = Dot(dir, n);
+	const Vec3 flowNormal = cosTheta < 0.0f ? -n : n;
+
+	const Vec3 drag = -params.drag*area*speed*speed*fabsf(cosTheta)*dir;
+
+	Vec3 lift(0.0f);
+	const Vec3 liftDir = Cross(Cross(dir, flowNormal), dir);
+	if (LengthSq(liftDir) > 0.0f)
+		lift = -params.lift*area*speed*speed*fabsf(cosTheta)*sqrtf(Max(0.0f, 1.0f - cosTheta*cosTheta))*Normalize(liftDir);
+
+	return (drag + lift)/3.0f;
+}
+
+void Predict(NvFlexSolver* s, float dt)
+{
+	const NvFlexParams& params = s->params;
+
+	const Vec3 gravity(params.gravity);
+	const float damping = Max(0.0f, 1.0f - params.damping*dt);
+	const bool aero = (params.drag != 0.0f || params.lift != 0.0f) && !s->particleTriangles.empty();
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const Vec4 x = s->sortedPositions[i];
+			Vec3 v = Vec3(s->sortedVelocities[i]);
+
+			if (x.w > 0.0f)
+			{
+				if (s->sortedPhases[i] & eNvFlexPhaseFluid)
+					v += gravity*params.buoyancy*dt;
+				else
+					v += gravity*dt;
+
+				if (aero)
+				{
+					Vec3 f(0.0f);
+					for (int k=s->particleTriangleStarts[i]; k < s->particleTriangleStarts[i+1]; ++k)
+						f += TriangleAeroForce(s, s->particleTriangles[k]);
+
+					v += f*x.w*dt;
+				}
+
+				v *= damping;
+			}
+
+			s->sortedStartVelocities[i] = v;
+			s->sortedVelocities[i] = Vec4(v, 0.0f);
+			s->sortedPredicted[i] = Vec4(Vec3(x) + v*dt, x.w);
+		}
+	});
+}
+
+void UpdateBounds(NvFlexSolver* s)
+{
+	Vec3 lower(FLT_MAX);
+	Vec3 upper(-FLT_MAX);
+
+	for (int i=0; i < s->numSorted; ++i)
+	{
+		lower = Min(lower, Vec3(s->sortedPredicted[i]));
+		upper = Max(upper, Vec3(s->sortedPredicted[i]));
+	}
+
+	s->boundsLower = s->numSorted ? lower : Vec3(0.0f);
+	s->boundsUpper = s->numSorted ? upper : Vec3(0.0f);
+}
+
+// hashed uniform grid over the predicted positions, cells are one interaction distance wide
+void BuildGrid(NvFlexSolver* s, float cellSize)
+{
+	const int n = s->numSorted;
+	const float invCellSize = 1.0f/cellSize;
+
+	unsigned int size = 1;
+	while (size < unsigned(2*n))
+		size *= 2;
+
+	const unsigned int mask = size-1;
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const Vec4& p = s->sortedPredicted[i];
+			s->particleCells[i] = int(HashCell(CellCoord(p.x, invCellSize), CellCoord(p.y, invCellSize), CellCoord(p.z, invCellSize), mask));
+		}
+	});
+
+	// counting sort of particles into buckets
+	s->cellStarts.assign(size+1, 0);
+
+	for (int i=0; i < n; ++i)
+		s->cellStarts[s->particleCells[i]+1]++;
+
+	for (unsigned int c=0; c < size; ++c)
+		s->cellStarts[c+1] += s->cellStarts[c];
+
+	s->cellParticles.resize(n);
+
+	std::vector<int> cursor(s->cellStarts.begin(), s->cellStarts.end()-1);
+
+	for (int i=0; i < n; ++i)
+		s->cellParticles[cursor[s->particleCells[i]]++] = i;
+}
+
+void FindNeighbors(NvFlexSolver* s, float cellSize)
+{
+	const int maxNeighbors = s->desc.maxNeighborsPerParticle;
+	const float invCellSize = 1.0f/cellSize;
+	const float radiusSq = cellSize*cellSize;
+	const unsigned int mask = unsigned(s->cellStarts.size()-2);
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const Vec3 x(s->sortedPredicted[i]);
+
+			const int cx = CellCoord(x.x, invCellSize);
+			const int cy = CellCoord(x.y, invCellSize);
+			const int cz = CellCoord(x.z, invCellSize);
+
+			// distinct cells may hash to the same bucket, visit each bucket once
+			unsigned int buckets[27];
+			int numBuckets = 0;
+
+			for (int dz=-1; dz <= 1; ++dz)
+			{
+				for (int dy=-1; dy <= 1; ++dy)
+				{
+					for (int dx=-1; dx <= 1; ++dx)
+					{
+						const unsigned int h = HashCell(cx+dx, cy+dy, cz+dz, mask);
+
+						bool seen = false;
+						for (int b=0; b < numBuckets && !seen; ++b)
+							seen = buckets[b] == h;
+
+						if (!seen)
+							buckets[numBuckets++] = h;
+					}
+				}
+			}
+
+			int* neighbors = &s->neighbors[size_t(i)*maxNeighbors];
+			int count = 0;
+
+			for (int b=0; b < numBuckets && count < maxNeighbors; ++b)
+			{
+				for (int k=s->cellStarts[buckets[b]]; k < s->cellStarts[buckets[b]+1]; ++k)
+				{
+					const int j = s->cellParticles[k];
+
+					if (j == i || LengthSq(Vec3(s->sortedPredicted[j]) - x) >= radiusSq)
+						continue;
+
+					neighbors[count++] = j;
+
+					if (count == maxNeighbors)
+						break;
+				}
+			}
+
+			s->neighborCounts[i] = count;
+		}
+	});
+}
+
+// applies and clears accumulated deltas using the solver's relaxation mode
+void ApplyDeltas(NvFlexSolver* s)
+{
+	const float relaxation = s->params.relaxationFactor;
+	const bool local = s->params.relaxationMode == eNvFlexRelaxationLocal;
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const int count = s->deltaCounts[i];
+
+			if (count > 0)
+			{
+				const float scale = local ? relaxation/count : relaxation;
+
+				Vec4& p = s->sortedPredicted[i];
+				p = Vec4(Vec3(p) + s->deltas[i]*scale, p.w);
+			}
+
+			s->deltas[i] = Vec3(0.0f);
+			s->deltaCounts[i] = 0;
+		}
+	});
+}
+
+// removes tangential motion relative to a surface, limited by the static and dynamic friction cone
+inline Vec3 FrictionDelta(const Vec3& relativeDisplacement, const Vec3& n, float penetration, float staticFriction, float dynamicFriction)
+{
+	const Vec3 tangent = relativeDisplacement - Dot(relativeDisplacement, n)*n;
+	const float length = Length(tangent);
+
+	if (length == 0.0f)
+		return Vec3(0.0f);
+
+	if (length < staticFriction*penetration)
+		return -tangent;
+
+	return -tangent*Min(dynamicFriction*penetration/length, 1.0f);
+}
+
+void SolveShapeContacts(NvFlexSolver* s, float dt)
+{
+	const NvFlexParams& params = s->params;
+	const int maxContacts = s->desc.maxContactsPerParticle;
+
+	// contacts only affect their own particle so they are applied directly in sequence
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const int count = s->contactCounts[i];
+			if (count == 0)
+				continue;
+
+			Vec3 p(s->sortedPredicted[i]);
+			const Vec3 x(s->sortedPositions[i]);
+
+			for (int c=0; c < count; ++c)
+			{
+				const CPUContact& contact = s->contacts[size_t(i)*maxContacts + c];
+				if (contact.trigger)
+					continue;
+
+				const float d = Dot(contact.normal, p) + contact.offset - params.collisionDistance;
+				if (d >= 0.0f)
+					continue;
+
+				p -= d*contact.normal;
+				p += FrictionDelta((p - x) - contact.velocity*dt, contact.normal, -d, params.staticFriction, params.dynamicFriction);
+			}
+
+			s->sortedPredicted[i] = Vec4(p, s->sortedPredicted[i].w);
+		}
+	});
+}
+
+void SolveParticleContacts(NvFlexSolver* s)
+{
+	const NvFlexParams& params = s->params;
+	const int maxNeighbors = s->desc.maxNeighborsPerParticle;
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const Vec4 pi = s->sortedPredicted[i];
+			if (pi.w == 0.0f)
+				continue;
+
+			const int phase = s->sortedPhases[i];
+			const bool fluid = (phase & eNvFlexPhaseFluid) != 0;
+			const int group = phase & eNvFlexPhaseGroupMask;
+
+			const Vec3 xi(s->sortedPositions[i]);
+
+			Vec3 delta(0.0f);
+			int count = 0;
+
+			const int* neighbors = &s->neighbors[size_t(i)*maxNeighbors];
+
+			for (int k=0; k < s->neighborCounts[i]; ++k)
+			{
+				const int j = neighbors[k];
+				const int otherPhase = s->sortedPhases[j];
+				const bool otherFluid = (otherPhase & eNvFlexPhaseFluid) != 0;
+
+				float restDistance;
+
+				if (fluid && otherFluid)
+				{
+					// handled by the density constraint
+					continue;
+				}
+				else if (fluid || otherFluid)
+				{
+					restDistance = params.fluidRestDistance;
+				}
+				else
+				{
+					if ((otherPhase & eNvFlexPhaseGroupMask) == group)
+					{
+						if (!(phase & eNvFlexPhaseSelfCollide))
+							continue;
+
+						if ((phase & eNvFlexPhaseSelfCollideFilter) && LengthSq(Vec3(s->sortedRest[i]) - Vec3(s->sortedRest[j])) < params.radius*params.radius)
+							continue;
+					}
+
+					restDistance = params.solidRestDistance;
+				}
+
+				const Vec4 pj = s->sortedPredicted[j];
+				const Vec3 dir = Vec3(pi) - Vec3(pj);
+				const float dSq = LengthSq(dir);
+
+				if (dSq >= restDistance*restDistance || dSq == 0.0f)
+					continue;
+
+				const float w = pi.w + pj.w;
+				const float d = sqrtf(dSq);
+				const Vec3 n = dir/d;
+				const float penetration = restDistance - d;
+
+				Vec3 correction = n*penetration;
+
+				if (params.particleFriction > 0.0f)
+				{
+					const Vec3 relative = (Vec3(pi) - xi) - (Vec3(pj) - Vec3(s->sortedPositions[j]));
+					correction += FrictionDelta(relative, n, penetration, params.particleFriction, params.particleFriction);
+				}
+
+				delta += correction*(pi.w/w);
+				count++;
+			}
+
+			s->deltas[i] += delta;
+			s->deltaCounts[i] += count;
+		}
+	});
+}
+
+void SolveDensities(NvFlexSolver* s, bool enableTimers)
+{
+	const NvFlexParams& params = s->params;
+	const int maxNeighbors = s->desc.maxNeighborsPerParticle;
+	const float h = params.radius;
+	const float invRestDensity = 1.0f/s->restDensity;
+	const Kernels kernels(h);
+
+	// constraint force mixing term keeps lambdas bounded for particles with few neighbors
+	const float epsilon = 0.01f/(h*h);
+
+	{
+		ScopedTimer timer(&s->timers.calculateDensity, enableTimers);
+
+		ParallelForParticles(s, [&](int begin, int end)
+		{
+			for (int i=begin; i < end; ++i)
+			{
+				s->lambdas[i] = 0.0f;
+
+				if (!(s->sortedPhases[i] & eNvFlexPhaseFluid))
+					continue;
+
+				const Vec3 xi(s->sortedPredicted[i]);
+
+				float density = kernels.Poly6(0.0f);
+				Vec3 gradI(0.0f);
+				float sumGradSq = 0.0f;
+
+				const int* neighbors = &s->neighbors[size_t(i)*maxNeighbors];
+
+				for (int k=0; k < s->neighborCounts[i]; ++k)
+				{
+					const int j = neighbors[k];
+					if (!(s->sortedPhases[j] & eNvFlexPhaseFluid))
+						continue;
+
+					const Vec3 dir = xi - Vec3(s->sortedPredicted[j]);
+					const float rSq = LengthSq(dir);
+
+					if (rSq >= h*h)
+						continue;
+
+					density += kernels.Poly6(rSq);
+
+					const float r = sqrtf(rSq);
+					if (r > 0.0f)
+					{
+						const Vec3 grad = dir*(kernels.SpikyGrad(r)*invRestDensity/r);
+
+						gradI += grad;
+						sumGradSq += LengthSq(grad);
+					}
+				}
+
+				const float c = density*invRestDensity - 1.0f;
+
+				s->sortedDensities[i] = density*invRestDensity;
+
+				// unilateral, fluid only resists compression
+				if (c > 0.0f && s->sortedPredicted[i].w > 0.0f)
+					s->lambdas[i] = -c/(sumGradSq + LengthSq(gradI) + epsilon);
+			}
+		});
+	}
+
+	ScopedTimer timer(&s->timers.solveDensities, enableTimers);
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			if (!(s->sortedPhases[i] & eNvFlexPhaseFluid) || s->sortedPredicted[i].w == 0.0f)
+				continue;
+
+			const Vec3 xi(s->sortedPredicted[i]);
+			const float lambda = s->lambdas[i];
+
+			Vec3 delta(0.0f);
+
+			const int* neighbors = &s->neighbors[size_t(i)*maxNeighbors];
+
+			for (int k=0; k < s->neighborCounts[i]; ++k)
+			{
+				const int j = neighbors[k];
+				if (!(s->sortedPhases[j] & eNvFlexPhaseFluid))
+					continue;
+
+				const Vec3 dir = xi - Vec3(s->sortedPredicted[j]);
+				const float rSq = LengthSq(dir);
+
+				if (rSq >= h*h || rSq == 0.0f)
+					continue;
+
+				const float r = sqrtf(rSq);
+
+				delta += dir*((lambda + s->lambdas[j])*kernels.SpikyGrad(r)*invRestDensity/r);
+			}
+
+			s->deltas[i] += delta;
+			s->deltaCounts[i] += 1;
+		}
+	});
+}
+
+void SolveSprings(NvFlexSolver* s)
+{
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const int startSpring = s->particleSpringStarts[i];
+			const int endSpring = s->particleSpringStarts[i+1];
+
+			const Vec4 pi = s->sortedPredicted[i];
+			if (startSpring == endSpring || pi.w == 0.0f)
+				continue;
+
+			Vec3 delta(0.0f);
+			int count = 0;
+
+			for (int k=startSpring; k < endSpring; ++k)
+			{
+				const int spring = s->particleSprings[k];
+
+				const int a = s->sortedSpringIndices[spring*2+0];
+				const int j = (a == i) ? s->sortedSpringIndices[spring*2+1] : a;
+
+				const Vec4 pj = s->sortedPredicted[j];
+				const float w = pi.w + pj.w;
+
+				const Vec3 dir = Vec3(pi) - Vec3(pj);
+				const float d = Length(dir);
+
+				if (d == 0.0f)
+					continue;
+
+				const float c = d - s->springLengths[spring];
+				const float stiffness = s->springStiffness[spring];
+
+				// negative stiffness is a tether, it only resists stretching
+				if (stiffness < 0.0f && c < 0.0f)
+					continue;
+
+				delta -= dir*(fabsf(stiffness)*c*(pi.w/w)/d);
+				count++;
+			}
+
+			s->deltas[i] += delta;
+			s->deltaCounts[i] += count;
+		}
+	});
+}
+
+// extracts the rotation of A, warm started from q, see Muller et al. "A Robust Method to Extract the Rotational Part of Deformations"
+Quat ExtractRotation(const Matrix33& a, Quat q, int maxIterations)
+{
+	for (int iter=0; iter < maxIterations; ++iter)
+	{
+		const Matrix33 r(q);
+
+		const Vec3 omega = (Cross(r.cols[0], a.cols[0]) + Cross(r.cols[1], a.cols[1]) + Cross(r.cols[2], a.cols[2]))*
+			(1.0f/(fabsf(Dot(r.cols[0], a.cols[0]) + Dot(r.cols[1], a.cols[1]) + Dot(r.cols[2], a.cols[2])) + 1.e-9f));
+
+		const float w = Length(omega);
+		if (w < 1.e-9f)
+			break;
+
+		q = Normalize(QuatFromAxisAngle<float>(omega/w, w)*q);
+	}
+
+	return q;
+}
+
+// shape matching, computes the best fit rigid transform per rigid then the goal position of each member particle
+void UpdateRigidTransforms(NvFlexSolver* s, int maxIterations)
+{
+	const int numRigids = int(s->rigidStiffness.size());
+
+	GetDefaultThreadPool().ParallelFor(0, numRigids, [&](int begin, int end)
+	{
+		for (int r=begin; r < end; ++r)
+		{
+			const int start = s->rigidOffsets[r];
+			const int finish = s->rigidOffsets[r+1];
+
+			Vec3 center(0.0f);
+			int count = 0;
+
+			for (int e=start; e < finish; ++e)
+			{
+				const int i = s->sortedRigidIndices[e];
+				if (i >= 0)
+				{
+					center += Vec3(s->sortedPredicted[i]);
+					count++;
+				}
+			}
+
+			if (count == 0)
+				continue;
+
+			center /= float(count);
+
+			Matrix33 a(Vec3(0.0f), Vec3(0.0f), Vec3(0.0f));
+
+			for (int e=start; e < finish; ++e)
+			{
+				const int i = s->sortedRigidIndices[e];
+				if (i >= 0)
+					a += Outer(Vec3(s->sortedPredicted[i]) - center, s->rigidRestPositions[e]);
+			}
+
+			const Quat q = ExtractRotation(a, s->rigidRotations[r], maxIterations);
+
+			s->rigidRotations[r] = q;
+			s->rigidTranslations[r] = center;
+			s->rigidCenters[r] = center;
+
+			for (int e=start; e < finish; ++e)
+				s->rigidGoals[e] = center + Rotate(q, s->rigidRestPositions[e]);
+		}
+	}, 0, 16);
+}
+
+void SolveRigids(NvFlexSolver* s)
+{
+	UpdateRigidTransforms(s, 4);
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const int startEntry = s->particleRigidStarts[i];
+			const int endEntry = s->particleRigidStarts[i+1];
+
+			if (startEntry == endEntry || s->sortedPredicted[i].w == 0.0f)
+				continue;
+
+			const Vec3 p(s->sortedPredicted[i]);
+			Vec3 delta(0.0f);
+
+			for (int k=startEntry; k < endEntry; ++k)
+			{
+				const int e = s->particleRigidEntries[k];
+				delta += (s->rigidGoals[e] - p)*s->rigidStiffness[s->rigidOfEntry[e]];
+			}
+
+			s->deltas[i] += delta;
+			s->deltaCounts[i] += endEntry-startEntry;
+		}
+	});
+}
+
+void SolveInflatables(NvFlexSolver* s)
+{
+	const int numInflatables = int(s->inflatableStarts.size());
+	const int numTris = int(s->sortedTriangleIndices.size())/3;
+
+	s->inflatableGradients.resize(s->numSorted);
+
+	// inflatables are few and small so each is solved serially, this also avoids races on shared particles
+	std::vector<int> particles;
+
+	for (int f=0; f < numInflatables; ++f)
+	{
+		const int start = Clamp(s->inflatableStarts[f], 0, numTris);
+		const int end = Clamp(start + s->inflatableCounts[f], start, numTris);
+
+		particles.resize(0);
+
+		for (int t=start; t < end; ++t)
+		{
+			const int* tri = &s->sortedTriangleIndices[t*3];
+			if (tri[0] >= 0)
+				particles.insert(particles.end(), tri, tri+3);
+		}
+
+		std::sort(particles.begin(), particles.end());
+		particles.erase(std::unique(particles.begin(), particles.end()), particles.end());
+
+		for (size_t k=0; k < particles.size(); ++k)
+			s->inflatableGradients[particles[k]] = Vec3(0.0f);
+
+		float volume = 0.0f;
+
+		for (int t=start; t < end; ++t)
+		{
+			const int* tri = &s->sortedTriangleIndices[t*3];
+			if (tri[0] < 0)
+				continue;
+
+			const Vec3 a(s->sortedPredicted[tri[0]]);
+			const Vec3 b(s->sortedPredicted[tri[1]]);
+			const Vec3 c(s->sortedPredicted[tri[2]]);
+
+			volume += Dot(a, Cross(b, c))/6.0f;
+
+			s->inflatableGradients[tri[0]] += Cross(b, c)/6.0f;
+			s->inflatableGradients[tri[1]] += Cross(c, a)/6.0f;
+			s->inflatableGradients[tri[2]] += Cross(a, b)/6.0f;
+		}
+
+		float denominator = 0.0f;
+		for (size_t k=0; k < particles.size(); ++k)
+			denominator += s->sortedPredicted[particles[k]].w*LengthSq(s->inflatableGradients[particles[k]]);
+
+		const float c = volume - s->inflatableRestVolumes[f]*s->inflatableOverPressures[f];
+		const float lambda = denominator > 0.0f ? -c/denominator*s->inflatableScales[f] : 0.0f;
+
+		for (size_t k=0; k < particles.size(); ++k)
+		{
+			const int i = particles[k];
+
+			s->deltas[i] += s->inflatableGradients[i]*(lambda*s->sortedPredicted[i].w);
+			s->deltaCounts[i] += 1;
+		}
+	}
+}
+
+void UpdateVelocities(NvFlexSolver* s, float dt)
+{
+	const NvFlexParams& params = s->params;
+	const int maxContacts = s->desc.maxContactsPerParticle;
+	const int maxNeighbors = s->desc.maxNeighborsPerParticle;
+	const float invDt = 1.0f/dt;
+	const float maxDeltaV = params.maxAcceleration*dt;
+	const Kernels kernels(params.radius);
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const Vec3 x(s->sortedPositions[i]);
+			const Vec3 p(s->sortedPredicted[i]);
+			const Vec3 startVelocity = s->sortedStartVelocities[i];
+
+			Vec3 v = (p - x)*invDt;
+
+			// restitution against shapes the particle was approaching at the start of the step
+			if (params.restitution > 0.0f)
+			{
+				for (int c=0; c < s->contactCounts[i]; ++c)
+				{
+					const CPUContact& contact = s->contacts[size_t(i)*maxContacts + c];
+					if (contact.trigger || Dot(contact.normal, p) + contact.offset > params.collisionDistance + 1.e-4f)
+						continue;
+
+					const float vnStart = Dot(contact.normal, startVelocity - contact.velocity);
+					const float vn = Dot(contact.normal, v - contact.velocity);
+
+					if (vnStart < 0.0f)
+						v += contact.normal*(Max(-params.restitution*vnStart, 0.0f) - vn);
+				}
+			}
+
+			const Vec3 deltaV = v - startVelocity;
+			if (LengthSq(deltaV) > maxDeltaV*maxDeltaV)
+				v = startVelocity + deltaV*(maxDeltaV/Length(deltaV));
+
+			if (params.dissipation > 0.0f)
+				v *= 1.0f/(1.0f + params.dissipation*s->neighborCounts[i]*dt);
+
+			const float speedSq = LengthSq(v);
+			if (speedSq > params.maxSpeed*params.maxSpeed)
+				v *= params.maxSpeed/sqrtf(speedSq);
+
+			s->deltas[i] = v;
+		}
+	});
+
+	// XSPH viscosity reads the velocities of neighbors so it runs as a separate pass
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			Vec3 v = s->deltas[i];
+
+			if (params.viscosity > 0.0f && (s->sortedPhases[i] & eNvFlexPhaseFluid))
+			{
+				const Vec3 xi(s->sortedPredicted[i]);
+				const int* neighbors = &s->neighbors[size_t(i)*maxNeighbors];
+
+				Vec3 sum(0.0f);
+				float weight = 0.0f;
+
+				for (int k=0; k < s->neighborCounts[i]; ++k)
+				{
+					const int j = neighbors[k];
+					if (!(s->sortedPhases[j] & eNvFlexPhaseFluid))
+						continue;
+
+					const float w = kernels.Poly6(LengthSq(xi - Vec3(s->sortedPredicted[j])));
+
+					sum += (s->deltas[j] - v)*w;
+					weight += w;
+				}
+
+				if (weight > 0.0f)
+					v += sum*(Min(params.viscosity, 1.0f)/weight);
+			}
+
+			Vec3 p(s->sortedPredicted[i]);
+
+			// particles moving slower than the threshold stay where they are
+			if (params.sleepThreshold > 0.0f && LengthSq(v) < params.sleepThreshold*params.sleepThreshold)
+			{
+				v = Vec3(0.0f);
+				p = Vec3(s->sortedPositions[i]);
+			}
+
+			s->sortedVelocities[i] = Vec4(v, 0.0f);
+			s->sortedPredicted[i] = Vec4(p, s->sortedPredicted[i].w);
+		}
+	});
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			s->sortedPositions[i] = s->sortedPredicted[i];
+			s->deltas[i] = Vec3(0.0f);
+		}
+	});
+}
+
+// eigen decomposition of a symmetric 3x3 matrix using cyclic Jacobi rotations, eigenvectors are returned in the columns of v
+void EigenDecompose(Matrix33 a, Matrix33& v, Vec3& eigenvalues)
+{
+	v = Matrix33::Identity();
+
+	for (int sweep=0; sweep < 8; ++sweep)
+	{
+		const float offDiagonal = a(0,1)*a(0,1) + a(0,2)*a(0,2) + a(1,2)*a(1,2);
+		if (offDiagonal < 1.e-20f)
+			break;
+
+		for (int p=0; p < 2; ++p)
+		{
+			for (int q=p+1; q < 3; ++q)
+			{
+				if (fabsf(a(p,q)) < 1.e-20f)
+					continue;
+
+				const float theta = (a(q,q) - a(p,p))/(2.0f*a(p,q));
+				const float t = Sign(theta)/(fabsf(theta) + sqrtf(theta*theta + 1.0f));
+				const float c = 1.0f/sqrtf(t*t + 1.0f);
+				const float sn = t*c;
+
+				Matrix33 j = Matrix33::Identity();
+				j(p,p) = c;
+				j(q,q) = c;
+				j(p,q) = sn;
+				j(q,p) = -sn;
+
+				a = Transpose(j)*a*j;
+				v = v*j;
+			}
+		}
+	}
+
+	eigenvalues = Vec3(a(0,0), a(1,1), a(2,2));
+}
+
+void UpdateAnisotropy(NvFlexSolver* s)
+{
+	const NvFlexParams& params = s->params;
+	const int maxNeighbors = s->desc.maxNeighborsPerParticle;
+	const float h = params.radius;
+	const bool anisotropy = params.anisotropyScale > 0.0f;
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const int api = s->sortedToApi[i];
+			const Vec3 xi(s->sortedPositions[i]);
+
+			if (!(s->sortedPhases[i] & eNvFlexPhaseFluid))
+			{
+				s->smoothParticles[api] = s->sortedPositions[i];
+				continue;
+			}
+
+			const int* neighbors = &s->neighbors[size_t(i)*maxNeighbors];
+
+			// weighted mean of the neighborhood, also used as the smoothed position
+			Vec3 mean(0.0f);
+			float weight = 0.0f;
+			int count = 0;
+
+			for (int k=0; k < s->neighborCounts[i]; ++k)
+			{
+				const int j = neighbors[k];
+				if (!(s->sortedPhases[j] & eNvFlexPhaseFluid))
+					continue;
+
+				const Vec3 xj(s->sortedPositions[j]);
+				const float r = Length(xj - xi)/h;
+
+				if (r < 1.0f)
+				{
+					const float w = 1.0f - r*r*r;
+					mean += xj*w;
+					weight += w;
+					count++;
+				}
+			}
+
+			mean = weight > 0.0f ? mean/weight : xi;
+
+			s->smoothParticles[api] = Vec4(Lerp(xi, mean, params.smoothing), s->sortedPositions[i].w);
+
+			if (!anisotropy)
+				continue;
+
+			Matrix33 axes = Matrix33::Identity();
+			Vec3 scales(1.0f);
+
+			if (count >= 4)
+			{
+				Matrix33 covariance(Vec3(0.0f), Vec3(0.0f), Vec3(0.0f));
+
+				for (int k=0; k < s->neighborCounts[i]; ++k)
+				{
+					const int j = neighbors[k];
+					if (!(s->sortedPhases[j] & eNvFlexPhaseFluid))
+						continue;
+
+					const Vec3 xj(s->sortedPositions[j]);
+					const float r = Length(xj - xi)/h;
+
+					if (r < 1.0f)
+						covariance += Outer(xj - mean, xj - mean)*((1.0f - r*r*r)/weight);
+				}
+
+				Vec3 eigenvalues;
+				EigenDecompose(covariance, axes, eigenvalues);
+
+				const float maxEigenvalue = Max(Max(eigenvalues.x, eigenvalues.y), eigenvalues.z);
+				if (maxEigenvalue > 0.0f)
+				{
+					for (int a=0; a < 3; ++a)
+						scales[a] = sqrtf(Max(eigenvalues[a], 0.0f)/maxEigenvalue);
+				}
+			}
+
+			// axis lengths are world space, relative to half the particle radius
+			for (int a=0; a < 3; ++a)
+				scales[a] = Clamp(scales[a]*params.anisotropyScale, params.anisotropyMin, params.anisotropyMax)*h*0.5f;
+
+			s->anisotropy1[api] = Vec4(axes.cols[0], scales[0]);
+			s->anisotropy2[api] = Vec4(axes.cols[1], scales[1]);
+			s->anisotropy3[api] = Vec4(axes.cols[2], scales[2]);
+		}
+	});
+}
+
+void UpdateNormals(NvFlexSolver* s)
+{
+	const int numTris = int(s->sortedTriangleIndices.size())/3;
+
+	GetDefaultThreadPool().ParallelFor(0, numTris, [&](int begin, int end)
+	{
+		for (int t=begin; t < end; ++t)
+		{
+			const int* tri = &s->sortedTriangleIndices[t*3];
+			if (tri[0] < 0)
+				continue;
+
+			const Vec3 a(s->sortedPositions[tri[0]]);
+			const Vec3 b(s->sortedPositions[tri[1]]);
+			const Vec3 c(s->sortedPositions[tri[2]]);
+
+			s->triangleNormals[t] = SafeNormalize(Cross(b-a, c-a));
+		}
+	}, 0, 1024);
+
+	ParallelForParticles(s, [&](int begin, int end)
+	{
+		for (int i=begin; i < end; ++i)
+		{
+			const int api = s->sortedToApi[i];
+
+			if (s->particleRigidStarts[i] != s->particleRigidStarts[i+1])
+			{
+				// rigid particles take their rest normal rotated into the current frame
+				const int e = s->particleRigidEntries[s->particleRigidStarts[i]];
+				const Vec4 n = s->rigidRestNormals[e];
+
+				s->normals[api] = Vec4(Rotate(s->rigidRotations[s->rigidOfEntry[e]], Vec3(n)), n.w);
+			}
+			else if (s->particleTriangleStarts[i] != s->particleTriangleStarts[i+1])
+			{
+				Vec3 n(0.0f);
+
+				for (int k=s->particleTriangleStarts[i]; k < s->particleTriangleStarts[i+1]; ++k)
+				{
+					const int t = s->particleTriangles[k];
+					const int* tri = &s->sortedTriangleIndices[t*3];
+
+					// area weighted
+					n += Cross(Vec3(s->sortedPositions[tri[1]]) - Vec3(s->sortedPositions[tri[0]]), Vec3(s->sortedPositions[tri[2]]) - Vec3(s->sortedPositions[tri[0]]));
+				}
+
+				s->normals[api] = Vec4(SafeNormalize(n), s->normals[api].w);
+			}
+		}
+	});
+}
+
+// diffuse particles are advected ballistically and age out, spawning from the fluid is not performed
+void UpdateDiffuse(NvFlexSolver* s, float dt)
+{
+	const NvFlexParams& params = s->params;
+	const Vec3 gravity = Vec3(params.gravity)*(1.0f - params.diffuseBuoyancy);
+	const float decay = params.diffuseLifetime > 0.0f ? dt/params.diffuseLifetime : 1.0f;
+
+	int count = 0;
+
+	for (int i=0; i < s->diffuseCount; ++i)
+	{
+		Vec4 p = s->diffuseParticles[i];
+		Vec3 v(s->diffuseVelocities[i]);
+
+		p.w -= decay;
+		if (p.w <= 0.0f)
+			continue;
+
+		v += gravity*dt;
+
+		Vec3 x = Vec3(p) + v*dt;
+
+		for (int k=0; k < params.numPlanes; ++k)
+		{
+			const Vec3 n(params.planes[k]);
+			const float d = Dot(n, x) + params.planes[k][3];
+
+			if (d < 0.0f)
+			{
+				x -= n*d;
+				v -= n*Min(Dot(n, v), 0.0f);
+			}
+		}
+
+		s->diffuseParticles[count] = Vec4(x, p.w);
+		s->diffuseVelocities[count] = Vec4(v, 0.0f);
+		count++;
+	}
+
+	s->diffuseCount = count;
+}
+
+} // anonymous namespace
+
+float CPUCalculateRestDensity(const NvFlexParams& params)
+{
+	const float h = params.radius;
+	const float spacing = params.fluidRestDistance > 0.0f ? params.fluidRestDistance : h;
+
+	// sum the kernel over a cubic lattice at the rest spacing
+	const int n = int(ceilf(h/spacing));
+	const Kernels kernels(h);
+
+	float density = 0.0f;
+
+	for (int z=-n; z <= n; ++z)
+		for (int y=-n; y <= n; ++y)
+			for (int x=-n; x <= n; ++x)
+				density += kernels.Poly6(spacing*spacing*float(x*x + y*y + z*z));
+
+	return density;
+}
+
+void CPUUpdateSolver(NvFlexSolver* s, float dt, int substeps, bool enableTimers)
+{
+	const Clock::time_point start = Clock::now();
+
+	if (enableTimers)
+		memset(&s->timers, 0, sizeof(s->timers));
+
+	const NvFlexParams& params = s->params;
+	const float stepDt = dt/substeps;
+	const float cellSize = params.radius + params.particleCollisionMargin;
+
+	{
+		ScopedTimer timer(&s->timers.reorder, enableTimers);
+		Gather(s);
+	}
+
+	bool hasFluid = false;
+	for (int i=0; i < s->numSorted && !hasFluid; ++i)
+		hasFluid = (s->sortedPhases[i] & eNvFlexPhaseFluid) != 0;
+
+	for (int step=0; step < substeps; ++step)
+	{
+		{
+			ScopedTimer timer(&s->timers.predict, enableTimers);
+			Predict(s, stepDt);
+		}
+
+		InvokeCallback(s, eNvFlexStageSubstepBegin, s->sortedPredicted.data(), dt);
+
+		if (step == substeps-1)
+		{
+			ScopedTimer timer(&s->timers.updateBounds, enableTimers);
+			UpdateBounds(s);
+		}
+
+		{
+			ScopedTimer timer(&s->timers.createGrid, enableTimers);
+			BuildGrid(s, cellSize);
+		}
+
+		{
+			ScopedTimer timer(&s->timers.collideParticles, enableTimers);
+			FindNeighbors(s, cellSize);
+		}
+
+		{
+			ScopedTimer timer(&s->timers.collideShapes, enableTimers);
+			CPUCollideShapes(s, stepDt);
+		}
+
+		for (int iteration=0; iteration < params.numIterations; ++iteration)
+		{
+			InvokeCallback(s, eNvFlexStageIterationStart, s->sortedPredicted.data(), dt);
+
+			{
+				ScopedTimer timer(&s->timers.solveContacts, enableTimers);
+				SolveShapeContacts(s, stepDt);
+				SolveParticleContacts(s);
+			}
+
+			if (hasFluid)
+				SolveDensities(s, enableTimers);
+
+			{
+				ScopedTimer timer(&s->timers.applyDeltas, enableTimers);
+				ApplyDeltas(s);
+			}
+
+			if (!s->springLengths.empty())
+			{
+				{
+					ScopedTimer timer(&s->timers.solveSprings, enableTimers);
+					SolveSprings(s);
+				}
+
+				ScopedTimer timer(&s->timers.applyDeltas, enableTimers);
+				ApplyDeltas(s);
+			}
+
+			if (!s->rigidStiffness.empty())
+			{
+				{
+					ScopedTimer timer(&s->timers.solveShapes, enableTimers);
+					SolveRigids(s);
+				}
+
+				ScopedTimer timer(&s->timers.applyDeltas, enableTimers);
+				ApplyDeltas(s);
+			}
+
+			if (!s->inflatableStarts.empty())
+			{
+				{
+					ScopedTimer timer(&s->timers.solveInflatables, enableTimers);
+					SolveInflatables(s);
+				}
+
+				ScopedTimer timer(&s->timers.applyDeltas, enableTimers);
+				ApplyDeltas(s);
+			}
+
+			InvokeCallback(s, eNvFlexStageIterationEnd, s->sortedPredicted.data(), dt);
+		}
+
+		{
+			ScopedTimer timer(&s->timers.solveVelocities, enableTimers);
+			UpdateVelocities(s, stepDt);
+		}
+
+		InvokeCallback(s, eNvFlexStageSubstepEnd, s->sortedPositions.data(), dt);
+	}
+
+	{
+		ScopedTimer timer(&s->timers.finalize, enableTimers);
+
+		// final rigid transforms are computed from the end of step positions
+		if (!s->rigidStiffness.empty())
+		{
+			s->sortedPredicted = s->sortedPositions;
+			UpdateRigidTransforms(s, 8);
+		}
+	}
+
+	{
+		ScopedTimer timer(&s->timers.updateNormals, enableTimers);
+		UpdateNormals(s);
+	}
+
+	if (hasFluid)
+	{
+		ScopedTimer timer(&s->timers.calculateAnisotropy, enableTimers);
+		UpdateAnisotropy(s);
+	}
+
+	{
+		ScopedTimer timer(&s->timers.updateDiffuse, enableTimers);
+		UpdateDiffuse(s, dt);
+	}
+
+	InvokeCallback(s, eNvFlexStageUpdateEnd, s->sortedPositions.data(), dt);
+
+	{
+		ScopedTimer timer(&s->timers.reorder, enableTimers);
+		Scatter(s);
+	}
+
+	s->lastUpdateTime = std::chrono::duration<float>(Clock::now() - start).count();
+
+	if (enableTimers)
+	{
+		const NvFlexTimers& t = s->timers;
+		s->timers.total = t.predict + t.createCellIndices + t.sortCellIndices + t.createGrid + t.reorder + t.collideParticles + t.collideShapes + 
+			t.collideTriangles + t.collideFields + t.calculateDensity + t.solveDensities + t.solveVelocities + t.solveShapes + t.solveSprings + 
+			t.solveContacts + t.solveInflatables + t.applyDeltas + t.calculateAnisotropy + t.updateDiffuse + t.updateTriangles + t.updateNormals + 
+			t.finalize + t.updateBounds;
+	}
+}